@@ -61,7 +61,12 @@ $(function() {
 
 
 	$('#refreshStatus').click(function(){
-		readStatus();
+		if(statusSocket !== null && statusSocket.readyState == WebSocket.OPEN){
+			statusSocket.send('status');
+		}
+		else{
+			readStatus();
+		}
 	});
 	
 
@@ -373,6 +378,12 @@ $(function() {
         var homing_speed_rotation = $("#config_homing_speed_rotation").val();
         var steps_per_mm_slider = $("#config_steps_per_mm_slider").val();
         var steps_per_mm_rotation = $("#config_steps_per_mm_rotation").val();
+        var jerk_slider = $("#config_jerk_slider").val();
+        var jerk_rotation = $("#config_jerk_rotation").val();
+        var focus_prewake = $("#config_focus_prewake").val();
+        var shutter_latency = $("#config_shutter_latency").val();
+        var pan_limit_min = $("#config_pan_limit_min").val();
+        var pan_limit_max = $("#config_pan_limit_max").val();
         var invert_homing_direction = $("#invert_homing_direction").is(":checked")
         var invert_slider_direction = $("#invert_slider_direction").is(":checked")
         var invert_rotation_direction = $("#invert_rotation_direction").is(":checked")
@@ -410,6 +421,12 @@ $(function() {
        update_settings('set_homing_speed_pan', homing_speed_rotation);
        update_settings('set_steps_per_mm_slider', steps_per_mm_slider);
        update_settings('set_steps_per_deg', steps_per_mm_rotation);
+       update_settings('set_slide_jerk', jerk_slider);
+       update_settings('set_pan_jerk', jerk_rotation);
+       update_settings('set_focus_prewake', focus_prewake);
+       update_settings('set_shutter_latency', shutter_latency);
+       update_settings('set_pan_limit_min', pan_limit_min);
+       update_settings('set_pan_limit_max', pan_limit_max);
        update_settings('set_homing_direction', invert_homing_direction);
        update_settings('set_slider_direction', invert_slider_direction);
        update_settings('set_pan_direction', invert_rotation_direction);
@@ -417,8 +434,9 @@ $(function() {
 
 
 
-	// Finally update status
+	// Finally update status, from now on the slider pushes it over the WebSocket
 	readStatus();
+	connectStatusSocket();
 });
 
 function mousewheel_slide(event){
@@ -512,8 +530,38 @@ function readStatus(){
 	  success: function(response) {
 	    console.log(response);
 
-	    var jsonResponse = jQuery.parseJSON(response);
+	    ui_update_status(jQuery.parseJSON(response));
+	  },
+	  error: function(xhr) {
+	    //Do Something to handle error
+	  }
+	});
+}
+
+// Status pushed by the slider whenever it changes (see WebAPI_PushStatus() in the firmware).
+// Other messages are answers to commands sent on the socket, "OK <command>" or "ERROR <command>: <reason>".
+var statusSocket = null;
+
+function connectStatusSocket(){
+	statusSocket = new WebSocket('ws://' + window.location.host + '/ws');
+
+	statusSocket.onmessage = function(event) {
+		if(event.data.charAt(0) == '{'){
+			ui_update_status(JSON.parse(event.data));
+		}
+		else{
+			console.log(event.data);
+		}
+	};
+
+	// Slider rebooted or WiFi dropped, try again in a bit
+	statusSocket.onclose = function(event) {
+		statusSocket = null;
+		setTimeout(connectStatusSocket, 2000);
+	};
+}
 
+function ui_update_status(jsonResponse){
 	    // Current position and rotation
 	    $('#slider-state').text(jsonResponse.state);
 
@@ -535,7 +583,21 @@ function readStatus(){
 
 
 	    // Homed status
-	    if(jsonResponse.homed == 1)
+	    if(jsonResponse.homingPhase > 0)
+	    {
+	    	// Homing in progress
+	    	$('#status-homed').text('Homing ' + jsonResponse.homingProgress + '%');
+	    	$('#status-homed').removeClass('badge-success');
+	    	$('#status-homed').addClass('badge-warning');
+	    }
+	    else if(jsonResponse.homingError > 0 && jsonResponse.homingError != homingErrorCancelled)
+	    {
+	    	// Homing failed, endstop not found
+	    	$('#status-homed').text('Homing failed');
+	    	$('#status-homed').removeClass('badge-success');
+	    	$('#status-homed').addClass('badge-warning');
+	    }
+	    else if(jsonResponse.homed == 1)
 	    {
 	    	// Homed
 	    	$('#status-homed').text('Homed and ready');
@@ -549,12 +611,6 @@ function readStatus(){
 	    	$('#status-homed').removeClass('badge-success');
 	    	$('#status-homed').addClass('badge-warning');
 	    }
-
-	  },
-	  error: function(xhr) {
-	    //Do Something to handle error
-	  }
-	});
 }
 
 function update_settings(parameter, value){
@@ -595,11 +651,20 @@ var update_settings_urls ={
     'set_slider_direction' : '/api/set-slide-direction',
     'set_pan_direction' : '/api/set-pan-direction',
     'set_rail_length' : '/api/set-rail-length',
-    'set_slider_min_step': '/api/set-slider-min-step'
+    'set_slider_min_step': '/api/set-slider-min-step',
+    'set_slide_jerk' : '/api/set-slide-jerk',
+    'set_pan_jerk' : '/api/set-pan-jerk',
+    'set_focus_prewake' : '/api/set-focus-prewake',
+    'set_shutter_latency' : '/api/set-shutter-latency',
+    'set_pan_limit_min' : '/api/set-pan-limit-min',
+    'set_pan_limit_max' : '/api/set-pan-limit-max'
 }
 
 
 
+// homingError in the status, see homingError_t in SliderConfig.h
+var homingErrorCancelled = 4;
+
 var sliderStates = 
 [
 	'SLIDER_MOTORS_OFF', 
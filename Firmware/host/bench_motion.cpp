@@ -0,0 +1,775 @@
+/*
+Motion benchmark
+Description: Runs the firmware motion code (MotorControl, FlexyStepper and the
+StepEngine) in the slider simulator (host/sim) and reports
+    - CPU cost of every step, split between step planning and the step interrupt
+    - how long timed moves really take against the requested slideDurationSec
+    - up to which step rate the step timing still matches the requested speed
+    - how repeatable homing is at different seek speeds, pan homing to a switch and to a stop
+    - how close the intervalometer keeps to its interval, and the slack it reports
+    - where position triggered shots expose, with and without a camera latency
+    - that moves past the soft limits are refused or clamped once homed, and allowed before
+    - that a move only takes over from a running one when the steppers plan both
+
+Build and run with: pio run -e bench_motion -t exec
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <algorithm>
+#include <vector>
+#include "SliderSim.h"
+#include "DIY_CameraSlider_MotorControl.h"
+
+// Firmware side, see DIY_CameraSlider_MotorControl.cpp
+extern sliderState_t sliderState;
+extern FlexyStepperT<SLIDE_RAMP_GENERATOR> stepper_slide;
+extern uint8_t panHomingMode;
+
+#define BENCH_MOTION_CARRIAGE_MM    5.0     // Carriage position at power up, away from the endstop
+#define BENCH_MOTION_TIMEOUT_US     600000000
+#define BENCH_MOTION_MAX_RATE_ERROR 1.0     // %, for the highest feasible step rate
+#define BENCH_MOTION_MAX_DISTANCE   250.0   // mm, step rate moves stay on the rail
+#define BENCH_MOTION_HOMING_CYCLES  20
+#define BENCH_MOTION_STEPPING_FRAMES 40
+#define BENCH_MOTION_PAN_HOMING_CYCLES 10
+#define BENCH_MOTION_PAN_HOME_DEG   -90.0   // Pan switch or stop, from where the pan stands at power up
+#define BENCH_MOTION_PAN_SEEK_SPEED 10.0    // deg/s
+
+typedef struct
+{
+    const char *name;
+    bool coordinated;
+} BenchMotionMode_t;
+
+static const BenchMotionMode_t benchModes[] =
+{
+    {"independent", false},
+    {"coordinated", true},
+};
+
+static const uint32_t benchDurations[] = {5, 10, 30, 60};
+
+static const float benchStepRates[] = {5000, 20000, 50000, 100000, 200000, 250000, 330000, 500000};
+
+static const uint16_t benchHomingSpeeds[] = {6, 30, 60};
+
+// Timed move of 200mm with a shot every 10mm, move duration and camera latency
+static const uint32_t benchTriggerDurations[] = {40, 20, 4};
+static const uint16_t benchTriggerLatencies[] = {0, 50, 120};
+
+// Intervals for 5mm stepping frames, from plenty of time down to overrunning
+static const uint32_t benchIntervals[] = {5000, 3000, 2500, 2000};
+
+// Bulb ramp, sunset like from 1/4s to 6s, the last interval is too short for the long bulbs
+#define BENCH_MOTION_RAMP_FRAMES    20
+static const ExposureKeyframe_t benchRamp[] = {{0, 250}, {10, 2000}, {19, 6000}};
+static const uint32_t benchRampIntervals[] = {9000, 8000, 6000};
+
+// Drives into the right endstop at these speeds
+static const float benchEndstopSpeeds[] = {5.0, 30.0, 60.0, 100.0};
+#define BENCH_MOTION_ENDSTOP_RUN_MM 40.0    // Start this far from the endstop
+
+// Host time and cycles of running one move to the end
+typedef struct
+{
+    long steps;
+    double elapsed_InNS;
+    double alarmCyclesPerStep;
+    double refillCyclesPerStep;
+} BenchMotionCost_t;
+
+// Run whatever move was started until all steps are out
+static void runMove(BenchMotionCost_t *pCost)
+{
+    std::chrono::steady_clock::time_point start;
+    long slideStart = SliderSim_GetStepCount(SLIDER_AXIS_SLIDE);
+    long panStart = SliderSim_GetStepCount(SLIDER_AXIS_PAN);
+
+    SliderSim_ClearProfile();
+    start = std::chrono::steady_clock::now();
+    SliderSim_RunUntilMotionComplete(BENCH_MOTION_TIMEOUT_US);
+    pCost->elapsed_InNS = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    pCost->steps = labs(SliderSim_GetStepCount(SLIDER_AXIS_SLIDE) - slideStart) + labs(SliderSim_GetStepCount(SLIDER_AXIS_PAN) - panStart);
+    if(pCost->steps == 0)
+    {
+        pCost->steps = 1;
+    }
+
+    pCost->alarmCyclesPerStep = (double)SliderSim_GetProfile().alarmCycles / pCost->steps;
+    pCost->refillCyclesPerStep = (double)SliderSim_GetProfile().refillCycles / pCost->steps;
+}
+
+// First and last step edge of the recorded edges
+static double stepSpan_InUS(void)
+{
+    const std::vector<SliderSimEdge_t> &edges = SliderSim_GetEdges();
+    uint32_t first_InUS = 0;
+    uint32_t last_InUS = 0;
+    bool found = false;
+
+    for(size_t i = 0; i < edges.size(); i++)
+    {
+        if((edges[i].level != HIGH) || ((edges[i].pin != PIN_MOTOR_X_STEP) && (edges[i].pin != PIN_MOTOR_Z_STEP)))
+        {
+            continue;
+        }
+
+        if(!found)
+        {
+            first_InUS = edges[i].time_InUS;
+            found = true;
+        }
+        last_InUS = edges[i].time_InUS;
+    }
+
+    return (double)(last_InUS - first_InUS);
+}
+
+// Mean slide step rate over the middle third of the move, where it cruises
+static double cruiseRate(void)
+{
+    const std::vector<SliderSimEdge_t> &edges = SliderSim_GetEdges();
+    std::vector<uint32_t> stepTimes;
+    size_t first;
+    size_t last;
+
+    for(size_t i = 0; i < edges.size(); i++)
+    {
+        if((edges[i].pin == PIN_MOTOR_X_STEP) && (edges[i].level == HIGH))
+        {
+            stepTimes.push_back(edges[i].time_InUS);
+        }
+    }
+
+    first = stepTimes.size() / 3;
+    last = 2 * stepTimes.size() / 3;
+    if(last <= first)
+    {
+        return 0.0;
+    }
+
+    return 1E6 * (last - first) / (double)(stepTimes[last] - stepTimes[first]);
+}
+
+static void benchStepCost(void)
+{
+    BenchMotionCost_t cost;
+
+    printf("\nStep cost, 250mm slide and 90deg pan, firmware default profile\n");
+    printf("  %-12s | %8s | %10s | %10s %10s | %12s\n", "mode", "steps", "ns/step", "isr cyc", "plan cyc", "max st/s");
+
+    SliderSim_RecordEdges(false);
+
+    for(size_t i = 0; i < sizeof(benchModes) / sizeof(benchModes[0]); i++)
+    {
+        CameraSlider_SetCoordinatedMotion(benchModes[i].coordinated);
+
+        CameraSlider_MoveToPositionAbsolute(250.0, 20.0, 60.0, 90.0 * SliderConfig.Config.pan_steps_per_degree, 30.0, 60.0, false);
+        runMove(&cost);
+        printf("  %-12s | %8ld | %10.1f | %10.1f %10.1f | %12.0f\n", benchModes[i].name, cost.steps,
+               cost.elapsed_InNS / cost.steps, cost.alarmCyclesPerStep, cost.refillCyclesPerStep,
+               1E9 * cost.steps / cost.elapsed_InNS);
+
+        // Back to the start, not measured
+        CameraSlider_MoveToPositionAbsolute(0.0, 50.0, 100.0, 0.0, 90.0, 100.0, false);
+        SliderSim_RunUntilMotionComplete(BENCH_MOTION_TIMEOUT_US);
+    }
+
+    SliderSim_RecordEdges(true);
+    CameraSlider_SetCoordinatedMotion(false);
+}
+
+static void benchDuration(void)
+{
+    double span_InUS;
+
+    printf("\nTimed move (start/end positions), 250mm slide and 45deg pan\n");
+    printf("  %-12s | %8s | %10s | %8s\n", "mode", "set s", "sim s", "error %");
+
+    for(size_t i = 0; i < sizeof(benchModes) / sizeof(benchModes[0]); i++)
+    {
+        CameraSlider_SetCoordinatedMotion(benchModes[i].coordinated);
+
+        for(size_t d = 0; d < sizeof(benchDurations) / sizeof(benchDurations[0]); d++)
+        {
+            CameraSlider_SetStartPosition(0.0, 0.0);
+            CameraSlider_SetEndPosition(250.0, 45.0 * SliderConfig.Config.pan_steps_per_degree);
+            CameraSlider_SetDuration(benchDurations[d]);
+            CameraSlider_StartMotion();
+
+            SliderSim_RunUntilState(SLIDER_MOVING_TO_END, BENCH_MOTION_TIMEOUT_US);
+            SliderSim_ClearEdges();
+            SliderSim_RunUntilState(SLIDER_READY, BENCH_MOTION_TIMEOUT_US);
+
+            span_InUS = stepSpan_InUS();
+            printf("  %-12s | %8u | %10.3f | %8.2f\n", benchModes[i].name, benchDurations[d], span_InUS / 1E6,
+                   100.0 * (span_InUS / 1E6 - benchDurations[d]) / benchDurations[d]);
+        }
+    }
+
+    SliderSim_ClearEdges();
+    CameraSlider_SetCoordinatedMotion(false);
+}
+
+// Trapezoidal moves at rising speed, reaching the speed after 25ms and
+// cruising for up to 0.2s. The step pulse and the shortest alarm lead
+// of the timer (see SliderSim.h) put a lower limit on the step period,
+// past that the real rate ends up below the requested one.
+static void benchStepRate(void)
+{
+    BenchMotionCost_t cost;
+    float stepsPerMM = SliderConfig.Config.slide_steps_per_mm;
+    float maxFeasible = 0.0;
+    double rate;
+    double error;
+
+    printf("\nSlide step rate, trapezoidal profile\n");
+    printf("  %10s | %10s | %8s | %10s | %12s\n", "set st/s", "sim st/s", "error %", "ns/step", "host st/s");
+
+    SliderConfig.Config.slide_jerk = 0;
+    CameraSlider_UpdateJerk();
+
+    for(size_t i = 0; i < sizeof(benchStepRates) / sizeof(benchStepRates[0]); i++)
+    {
+        float distance_InMM = fmin(benchStepRates[i] * 0.25 / stepsPerMM, BENCH_MOTION_MAX_DISTANCE);
+
+        SliderSim_ClearEdges();
+        CameraSlider_MoveToPositionAbsolute(distance_InMM, benchStepRates[i] / stepsPerMM, 40.0 * benchStepRates[i] / stepsPerMM, 0.0, 30.0, 60.0, false);
+        runMove(&cost);
+
+        rate = cruiseRate();
+        error = 100.0 * (rate - benchStepRates[i]) / benchStepRates[i];
+        printf("  %10.0f | %10.0f | %8.2f | %10.1f | %12.0f\n", benchStepRates[i], rate, error,
+               cost.elapsed_InNS / cost.steps, 1E9 * cost.steps / cost.elapsed_InNS);
+
+        if(fabs(error) <= BENCH_MOTION_MAX_RATE_ERROR)
+        {
+            maxFeasible = benchStepRates[i];
+        }
+
+        CameraSlider_MoveToPositionAbsolute(0.0, 50.0, 100.0, 0.0, 90.0, 100.0, false);
+        SliderSim_RunUntilMotionComplete(BENCH_MOTION_TIMEOUT_US);
+    }
+
+    SliderConfig.Config.slide_jerk = DEFAULT_SLIDE_JERK;
+    CameraSlider_UpdateJerk();
+
+    printf("  highest step rate within %.1f%%: %.0f steps/s (%.1f mm/s)\n", BENCH_MOTION_MAX_RATE_ERROR, maxFeasible, maxFeasible / stepsPerMM);
+}
+
+// Home over and over from random places on the rail, with the motion task
+// tick landing somewhere else between the steps every time. Spread of the
+// real carriage position after homing, and as the firmware measured it
+// from the switch edges (/api/metrics/homing).
+static void benchHoming(void)
+{
+    char metrics[500];
+    float pos_InMM;
+    float min_InMM;
+    float max_InMM;
+    float duration_InS;
+    uint32_t start_InUS;
+
+    printf("\nHoming repeatability, %d cycles from random positions\n", BENCH_MOTION_HOMING_CYCLES);
+    printf("  %10s | %10s | %12s | %s\n", "seek mm/s", "avg s", "spread um", "firmware /api/metrics/homing");
+
+    srand(1);
+
+    for(size_t i = 0; i < sizeof(benchHomingSpeeds) / sizeof(benchHomingSpeeds[0]); i++)
+    {
+        SliderConfig.Config.homing_speed_slide = benchHomingSpeeds[i];
+
+        // First homing only finds home
+        CameraSlider_SetState(SLIDER_HOMING);
+        SliderSim_RunUntilState(SLIDER_MOTORS_OFF, BENCH_MOTION_TIMEOUT_US);
+        CameraSlider_ResetHomingMetrics();
+
+        min_InMM = 1E6;
+        max_InMM = -1E6;
+        duration_InS = 0.0;
+
+        for(int cycle = 0; cycle < BENCH_MOTION_HOMING_CYCLES; cycle++)
+        {
+            CameraSlider_EnableMotors(true);
+            CameraSlider_MoveToPositionAbsolute(5.0 + rand() % 100, 50.0, 100.0, 0.0, 30.0, 60.0, false);
+            SliderSim_RunUntilMotionComplete(BENCH_MOTION_TIMEOUT_US);
+            SliderSim_Run(rand() % (TASK_MOTION_POLL_MS * 1000));
+
+            start_InUS = SliderSim_Now();
+            CameraSlider_SetState(SLIDER_HOMING);
+            SliderSim_RunUntilState(SLIDER_MOTORS_OFF, BENCH_MOTION_TIMEOUT_US);
+            duration_InS += (SliderSim_Now() - start_InUS) / 1E6;
+
+            pos_InMM = SliderSim_GetCarriagePos();
+            min_InMM = fmin(min_InMM, pos_InMM);
+            max_InMM = fmax(max_InMM, pos_InMM);
+        }
+
+        CameraSlider_FormatJSON_HomingMetrics(metrics, sizeof(metrics));
+        printf("  %10u | %10.2f | %12.1f | %s\n", benchHomingSpeeds[i], duration_InS / BENCH_MOTION_HOMING_CYCLES,
+               1000.0 * (max_InMM - min_InMM), metrics);
+    }
+
+    SliderConfig.Config.homing_speed_slide = DEFAULT_HOMING_SPEED_SLIDE;
+}
+
+// Pan homing with a switch and against a mechanical stop. Home has to be
+// PAN_HOMING_RETRACT_DEG off the switch or stop, wherever pan started from.
+static void benchPanHoming(void)
+{
+    static const uint8_t modes[] = {PAN_HOMING_SWITCH, PAN_HOMING_HARD_STOP};
+    char metrics[500];
+    char *pPan;
+    float home_InDeg = BENCH_MOTION_PAN_HOME_DEG - PAN_HOMING_DIRECTION * PAN_HOMING_RETRACT_DEG;
+    float pos_InDeg;
+    float min_InDeg;
+    float max_InDeg;
+    float error_InDeg;
+    float duration_InS;
+    uint32_t start_InUS;
+    bool bFailed;
+
+    printf("\nPan homing, %d cycles from random angles, switch or stop at %.0fdeg\n", BENCH_MOTION_PAN_HOMING_CYCLES, BENCH_MOTION_PAN_HOME_DEG);
+    printf("  %10s | %10s | %12s | %12s | %s\n", "mode", "avg s", "spread deg", "home err deg", "firmware /api/metrics/homing, pan");
+
+    srand(1);
+
+    for(size_t i = 0; i < sizeof(modes) / sizeof(modes[0]); i++)
+    {
+        SliderSim_Begin(BENCH_MOTION_CARRIAGE_MM);
+        SliderSim_SetPanHome((modes[i] == PAN_HOMING_SWITCH) ? SLIDER_SIM_PAN_SWITCH : SLIDER_SIM_PAN_HARD_STOP, BENCH_MOTION_PAN_HOME_DEG);
+        panHomingMode = modes[i];
+        SliderConfig.Config.homing_speed_pan = BENCH_MOTION_PAN_SEEK_SPEED * SliderConfig.Config.pan_steps_per_degree;
+
+        // First homing only finds home
+        CameraSlider_StartPanHoming();
+        SliderSim_RunUntilState(SLIDER_MOTORS_OFF, BENCH_MOTION_TIMEOUT_US);
+        CameraSlider_ResetHomingMetrics();
+
+        min_InDeg = 1E6;
+        max_InDeg = -1E6;
+        error_InDeg = 0.0;
+        duration_InS = 0.0;
+        bFailed = false;
+
+        for(int cycle = 0; cycle < BENCH_MOTION_PAN_HOMING_CYCLES; cycle++)
+        {
+            CameraSlider_EnableMotors(true);
+            CameraSlider_MoveToPositionAbsolute(0.0, 50.0, 100.0, (10 + rand() % 300) * SliderConfig.Config.pan_steps_per_degree, 60.0, 120.0, false);
+            SliderSim_RunUntilMotionComplete(BENCH_MOTION_TIMEOUT_US);
+            SliderSim_Run(rand() % (TASK_MOTION_POLL_MS * 1000));
+
+            start_InUS = SliderSim_Now();
+            CameraSlider_StartPanHoming();
+            bFailed |= !SliderSim_RunUntilState(SLIDER_MOTORS_OFF, BENCH_MOTION_TIMEOUT_US);
+            duration_InS += (SliderSim_Now() - start_InUS) / 1E6;
+
+            pos_InDeg = SliderSim_GetPanPos();
+            min_InDeg = fmin(min_InDeg, pos_InDeg);
+            max_InDeg = fmax(max_InDeg, pos_InDeg);
+            error_InDeg = fmax(error_InDeg, fabs(pos_InDeg - home_InDeg));
+        }
+
+        // Only the pan axis
+        CameraSlider_FormatJSON_HomingMetrics(metrics, sizeof(metrics));
+        pPan = strstr(metrics, "{\"axis\":\"pan\"");
+        if(pPan != NULL)
+        {
+            pPan[strlen(pPan) - 2] = '\0';
+        }
+
+        printf("  %10s | %10.2f | %12.3f | %12.3f | %s\n", (modes[i] == PAN_HOMING_SWITCH) ? "switch" : "hard stop",
+               duration_InS / BENCH_MOTION_PAN_HOMING_CYCLES, max_InDeg - min_InDeg, error_InDeg,
+               bFailed ? "FAILED" : ((pPan != NULL) ? pPan : metrics));
+    }
+
+    panHomingMode = PAN_HOMING_MODE;
+    SliderConfig.Config.homing_speed_pan = DEFAULT_HOMING_SPEED_PAN;
+}
+
+// Stepping with an interval, frames of 5mm, 600ms settle, 500ms exposure.
+// Drift is how far the last shutter is off the time of the first one plus
+// the frames times the interval, jitter the worst shutter off its time.
+static void benchIntervalometer(void)
+{
+    CameraSliderStepping_t stepping;
+    char metrics[600];
+    char *pSlack;
+    uint16_t noFitFrame;
+    uint32_t noFitNeed_InMS;
+    uint32_t first_InUS;
+    double off_InMS;
+    double jitter_InMS;
+    double drift_InMS;
+
+    printf("\nIntervalometer, %d frames of 5mm, 600ms settle, 500ms exposure\n", BENCH_MOTION_STEPPING_FRAMES);
+    printf("  %10s | %10s | %10s | %s\n", "interval ms", "drift ms", "jitter ms", "firmware /api/metrics/stepping");
+
+    for(size_t i = 0; i < sizeof(benchIntervals) / sizeof(benchIntervals[0]); i++)
+    {
+        SliderSim_Begin(BENCH_MOTION_CARRIAGE_MM);
+
+        stepping.distance_InMM = 5.0 * (BENCH_MOTION_STEPPING_FRAMES - 1);
+        stepping.step_InMM = 5.0;
+        stepping.pan_InDeg = 0.0;
+        stepping.settle_InMS = 600;
+        stepping.exposure_InMS = 500;
+        stepping.interval_InMS = benchIntervals[i];
+        stepping.frames = BENCH_MOTION_STEPPING_FRAMES;
+
+        if(!CameraSlider_StartStepping(&stepping))
+        {
+            CameraSlider_GetSteppingError(&noFitFrame, &noFitNeed_InMS);
+            printf("  %10u | rejected, frame %u needs %u ms\n", benchIntervals[i], noFitFrame, noFitNeed_InMS);
+            continue;
+        }
+        SliderSim_RunUntilState(SLIDER_MOTORS_OFF, BENCH_MOTION_TIMEOUT_US);
+
+        const std::vector<SliderSimShot_t> &shots = SliderSim_GetShots();
+        first_InUS = shots.empty() ? 0 : shots[0].time_InUS;
+        jitter_InMS = 0.0;
+        drift_InMS = 0.0;
+
+        for(size_t frame = 0; frame < shots.size(); frame++)
+        {
+            off_InMS = ((double)(shots[frame].time_InUS - first_InUS) - frame * benchIntervals[i] * 1000.0) / 1000.0;
+            jitter_InMS = fmax(jitter_InMS, fabs(off_InMS));
+            drift_InMS = off_InMS;
+        }
+
+        // Only the summary, the slack of every frame makes a long line
+        CameraSlider_FormatJSON_SteppingMetrics(metrics, sizeof(metrics));
+        pSlack = strstr(metrics, ",\"first_frame\"");
+        if(pSlack != NULL)
+        {
+            strcpy(pSlack, "}");
+        }
+
+        printf("  %10u | %10.1f | %10.1f | %s\n", benchIntervals[i], drift_InMS, jitter_InMS, metrics);
+    }
+}
+
+// Bulb ramp over 20 frames of 5mm. Every shot has to be the bulb of the ramp
+// for its frame and the slide must not step while the shutter is open.
+static void benchBulbRamp(void)
+{
+    CameraSliderStepping_t stepping;
+    char metrics[600];
+    char *pSlack;
+    uint16_t noFitFrame;
+    uint32_t noFitNeed_InMS;
+    uint32_t end_InUS;
+    long exposedSteps;
+    double bulbError_InMS;
+    double expected_InMS;
+    size_t edge;
+
+    printf("\nBulb ramp, %d frames of 5mm, 250ms to 6s bulb, 600ms settle, 500ms exposure\n", BENCH_MOTION_RAMP_FRAMES);
+    printf("  %10s | %6s | %14s | %14s | %s\n", "interval ms", "shots", "bulb err ms", "exposed steps", "firmware /api/metrics/stepping");
+
+    for(size_t i = 0; i < sizeof(benchRampIntervals) / sizeof(benchRampIntervals[0]); i++)
+    {
+        SliderSim_Begin(BENCH_MOTION_CARRIAGE_MM);
+
+        stepping.distance_InMM = 5.0 * (BENCH_MOTION_RAMP_FRAMES - 1);
+        stepping.step_InMM = 5.0;
+        stepping.pan_InDeg = 0.0;
+        stepping.settle_InMS = 600;
+        stepping.exposure_InMS = 500;
+        stepping.interval_InMS = benchRampIntervals[i];
+        stepping.frames = BENCH_MOTION_RAMP_FRAMES;
+
+        CameraSlider_SetExposureRamp(benchRamp, sizeof(benchRamp) / sizeof(benchRamp[0]));
+        if(!CameraSlider_StartStepping(&stepping))
+        {
+            CameraSlider_GetSteppingError(&noFitFrame, &noFitNeed_InMS);
+            printf("  %10u | rejected, frame %u needs %u ms\n", benchRampIntervals[i], noFitFrame, noFitNeed_InMS);
+            continue;
+        }
+        SliderSim_RunUntilState(SLIDER_MOTORS_OFF, BENCH_MOTION_TIMEOUT_US);
+
+        const std::vector<SliderSimShot_t> &shots = SliderSim_GetShots();
+        const std::vector<SliderSimEdge_t> &edges = SliderSim_GetEdges();
+        bulbError_InMS = 0.0;
+        exposedSteps = 0;
+        edge = 0;
+
+        for(size_t frame = 0; frame < shots.size(); frame++)
+        {
+            const ExposureKeyframe_t *pFrom = (frame < benchRamp[1].frame) ? &benchRamp[0] : &benchRamp[1];
+            const ExposureKeyframe_t *pTo = pFrom + 1;
+
+            expected_InMS = pFrom->bulb_InMS * pow((double)pTo->bulb_InMS / pFrom->bulb_InMS,
+                                                    (double)(frame - pFrom->frame) / (pTo->frame - pFrom->frame));
+            bulbError_InMS = fmax(bulbError_InMS, fabs(shots[frame].duration_InMS - expected_InMS));
+
+            end_InUS = shots[frame].time_InUS + shots[frame].duration_InMS * 1000;
+            for(; (edge < edges.size()) && ((int32_t)(edges[edge].time_InUS - end_InUS) <= 0); edge++)
+            {
+                if((edges[edge].pin == PIN_MOTOR_X_STEP) && (edges[edge].level == HIGH) &&
+                   ((int32_t)(edges[edge].time_InUS - shots[frame].time_InUS) >= 0))
+                {
+                    exposedSteps++;
+                }
+            }
+        }
+
+        CameraSlider_FormatJSON_SteppingMetrics(metrics, sizeof(metrics));
+        pSlack = strstr(metrics, ",\"first_frame\"");
+        if(pSlack != NULL)
+        {
+            strcpy(pSlack, "}");
+        }
+
+        printf("  %10u | %6zu | %14.1f | %14ld | %s\n", benchRampIntervals[i], shots.size(), bulbError_InMS, exposedSteps, metrics);
+    }
+
+    CameraSlider_SetExposureRamp(NULL, 0);
+}
+
+// Move past the end of the rail into the endstop. The step engine brakes
+// from the switch edge on, latency is from the edge to the last step. After
+// the stop the slider has to find its way back to where it started, with
+// all steps the motors made accounted for.
+static void benchEndstop(void)
+{
+    char metrics[300];
+    float start_InMM;
+    float back_InMM;
+    bool positionOk;
+
+    printf("\nEndstop stop, run into the right endstop, braking at %.0fmm/s^2\n", ENDSTOP_STOP_DECEL);
+    printf("  %10s | %12s | %12s | %12s | %8s | %s\n", "speed mm/s", "ideal ms", "ideal mm", "back err um", "position", "firmware /api/metrics/endstop");
+
+    for(size_t i = 0; i < sizeof(benchEndstopSpeeds) / sizeof(benchEndstopSpeeds[0]); i++)
+    {
+        start_InMM = SliderConfig.Config.rail_length - BENCH_MOTION_ENDSTOP_RUN_MM;
+        SliderSim_Begin(start_InMM);
+
+        CameraSlider_MoveToPositionAbsolute(2 * BENCH_MOTION_ENDSTOP_RUN_MM, benchEndstopSpeeds[i], 1000.0, 0.0, 30.0, 60.0, false);
+        SliderSim_RunUntilMotionComplete(BENCH_MOTION_TIMEOUT_US);
+        SliderSim_Run(2 * TASK_MOTION_POLL_MS * 1000);
+
+        CameraSlider_FormatJSON_EndstopMetrics(metrics, sizeof(metrics));
+
+        // Stepper, step engine and the steps the motor really made have to agree
+        positionOk = (stepper_slide.getCurrentPositionInSteps() == SliderSim_GetStepCount(SLIDER_AXIS_SLIDE)) &&
+                     (sliderState == SLIDER_IDLE);
+
+        CameraSlider_MoveToPositionAbsolute(0.0, 30.0, 1000.0, 0.0, 30.0, 60.0, false);
+        SliderSim_RunUntilMotionComplete(BENCH_MOTION_TIMEOUT_US);
+        back_InMM = SliderSim_GetCarriagePos() - start_InMM;
+
+        printf("  %10.0f | %12.1f | %12.2f | %12.1f | %8s | %s\n", benchEndstopSpeeds[i],
+               1000.0 * benchEndstopSpeeds[i] / ENDSTOP_STOP_DECEL,
+               benchEndstopSpeeds[i] * benchEndstopSpeeds[i] / (2.0 * ENDSTOP_STOP_DECEL),
+               1000.0 * back_InMM, positionOk ? "ok" : "LOST", metrics);
+    }
+}
+
+// Soft limits: before homing every move goes, once homed a move past them is
+// refused without touching a running move, or stops at the limit with clamp.
+// Home (0) is HOMING_RETRACT_MM off the left endstop, the far limit as far off the right one.
+static void benchEnvelope(void)
+{
+    char error[120];
+    float farLimit_InMM = SliderConfig.Config.rail_length - SOFT_LIMIT_MARGIN_MM;
+    float expected_InMM;
+    bool accepted;
+    bool ok;
+
+    printf("\nSoft limits, slide between %.0fmm and %.0fmm of the rail once homed\n", HOMING_RETRACT_MM, farLimit_InMM);
+    printf("  %-24s | %8s | %11s | %11s | %6s | %s\n", "move", "accepted", "carriage mm", "expected mm", "result", "firmware");
+
+    // Unhomed, 0 is where the carriage stands
+    SliderSim_Begin(BENCH_MOTION_CARRIAGE_MM);
+    accepted = CameraSlider_MoveToPositionAbsolute(-3.0, 20.0, 100.0, 0.0, 30.0, 60.0, false);
+    SliderSim_RunUntilMotionComplete(BENCH_MOTION_TIMEOUT_US);
+    expected_InMM = BENCH_MOTION_CARRIAGE_MM - 3.0;
+    ok = accepted && (fabs(SliderSim_GetCarriagePos() - expected_InMM) < 0.01);
+    printf("  %-24s | %8s | %11.2f | %11.2f | %6s |\n", "unhomed, past home", accepted ? "yes" : "no",
+           SliderSim_GetCarriagePos(), expected_InMM, ok ? "ok" : "FAIL");
+
+    CameraSlider_SetState(SLIDER_HOMING);
+    SliderSim_RunUntilState(SLIDER_MOTORS_OFF, BENCH_MOTION_TIMEOUT_US);
+    CameraSlider_EnableMotors(true);
+
+    // Refused while a coordinated move runs, that move carries on
+    CameraSlider_SetCoordinatedMotion(true);
+    CameraSlider_MoveToPositionAbsolute(100.0, 20.0, 100.0, 0.0, 30.0, 60.0, false);
+    SliderSim_Run(500000);
+    accepted = CameraSlider_MoveToPositionRelative(-10.0, 20.0, 100.0, 0.0, 30.0, 60.0, false);
+    CameraSlider_FormatEnvelopeError(error, sizeof(error));
+    SliderSim_RunUntilMotionComplete(BENCH_MOTION_TIMEOUT_US);
+    CameraSlider_SetCoordinatedMotion(false);
+    expected_InMM = HOMING_RETRACT_MM + 100.0;
+    ok = !accepted && (fabs(SliderSim_GetCarriagePos() - expected_InMM) < 0.01);
+    printf("  %-24s | %8s | %11.2f | %11.2f | %6s | %s\n", "homed, past home", accepted ? "yes" : "no",
+           SliderSim_GetCarriagePos(), expected_InMM, ok ? "ok" : "FAIL", error);
+
+    // Clamped onto the far limit
+    accepted = CameraSlider_MoveToPositionAbsolute(SliderConfig.Config.rail_length + 50.0, 50.0, 100.0, 0.0, 30.0, 60.0, true);
+    SliderSim_RunUntilMotionComplete(BENCH_MOTION_TIMEOUT_US);
+    expected_InMM = farLimit_InMM;
+    ok = accepted && (fabs(SliderSim_GetCarriagePos() - expected_InMM) < 0.01);
+    printf("  %-24s | %8s | %11.2f | %11.2f | %6s |\n", "homed, past far, clamp", accepted ? "yes" : "no",
+           SliderSim_GetCarriagePos(), expected_InMM, ok ? "ok" : "FAIL");
+}
+
+// Carriage position at timeInUS, from the slide step edges of a move in positive direction
+static float carriagePosAt(uint32_t timeInUS, float start_InMM)
+{
+    const std::vector<SliderSimEdge_t> &edges = SliderSim_GetEdges();
+    long steps = 0;
+
+    for(size_t i = 0; (i < edges.size()) && ((int32_t)(edges[i].time_InUS - timeInUS) <= 0); i++)
+    {
+        if((edges[i].pin == PIN_MOTOR_X_STEP) && (edges[i].level == HIGH))
+        {
+            steps++;
+        }
+    }
+
+    return start_InMM + (float)steps / SliderConfig.Config.slide_steps_per_mm;
+}
+
+// Timed move from 10 to 210mm shooting every 10mm while sliding. The camera
+// exposes its latency after the shutter pulse, error is how far from the
+// trigger position the carriage was by then. The lead for the latency comes
+// from the speed at the time, shots in the ramps at both ends are off by the
+// speed change over the latency. The median error is the one while cruising.
+static void benchPositionTriggers(void)
+{
+    std::vector<float> errors_InUM;
+    float start_InMM;
+    float exposure_InMM;
+    float target_InMM;
+
+    printf("\nPosition triggers, timed move of 200mm, shot every 10mm\n");
+    printf("  %10s | %10s | %10s | %6s | %14s | %14s\n", "duration s", "speed mm/s", "latency ms", "shots", "median err um", "max error um");
+
+    for(size_t i = 0; i < sizeof(benchTriggerDurations) / sizeof(benchTriggerDurations[0]); i++)
+    {
+        for(size_t l = 0; l < sizeof(benchTriggerLatencies) / sizeof(benchTriggerLatencies[0]); l++)
+        {
+            SliderSim_Begin(BENCH_MOTION_CARRIAGE_MM);
+            SliderConfig.Config.shutter_latency_ms = benchTriggerLatencies[l];
+
+            CameraSlider_SetStartPosition(10.0, 0.0);
+            CameraSlider_SetEndPosition(210.0, 0.0);
+            CameraSlider_SetDuration(benchTriggerDurations[i]);
+            CameraSlider_SetPositionTriggers(10.0);
+            CameraSlider_StartMotion();
+
+            // Edges of the move to the start position don't count
+            SliderSim_RunUntilState(SLIDER_MOVING_TO_END, BENCH_MOTION_TIMEOUT_US);
+            start_InMM = SliderSim_GetCarriagePos();
+            SliderSim_ClearEdges();
+            SliderSim_RunUntilState(SLIDER_READY, BENCH_MOTION_TIMEOUT_US);
+
+            const std::vector<SliderSimShot_t> &shots = SliderSim_GetShots();
+            errors_InUM.clear();
+
+            for(size_t shot = 0; shot < shots.size(); shot++)
+            {
+                target_InMM = BENCH_MOTION_CARRIAGE_MM + 10.0 + 10.0 * (shot + 1);
+                exposure_InMM = carriagePosAt(shots[shot].time_InUS + benchTriggerLatencies[l] * 1000, start_InMM);
+                errors_InUM.push_back(1000.0 * fabs(exposure_InMM - target_InMM));
+            }
+            std::sort(errors_InUM.begin(), errors_InUM.end());
+            if(errors_InUM.empty())
+            {
+                errors_InUM.push_back(0.0);
+            }
+
+            printf("  %10u | %10.1f | %10u | %6u | %14.1f | %14.1f\n", benchTriggerDurations[i], 200.0 / benchTriggerDurations[i],
+                   benchTriggerLatencies[l], (unsigned)shots.size(), errors_InUM[errors_InUM.size() / 2], errors_InUM.back());
+        }
+    }
+
+    SliderConfig.Config.shutter_latency_ms = DEFAULT_SHUTTER_LATENCY_MS;
+    CameraSlider_SetPositionTriggers(0.0);
+}
+
+// First move from position (mm), the second one half a second in. Both coordinated or not.
+static void benchTakeoverCase(const char *pName, bool firstCoordinated, float first_InMM, bool secondCoordinated, float second_InMM, bool bAccept)
+{
+    float start_InMM = SliderSim_GetCarriagePos() - BENCH_MOTION_CARRIAGE_MM;
+    float expected_InMM;
+    bool accepted;
+    bool ok;
+
+    CameraSlider_SetCoordinatedMotion(firstCoordinated);
+    CameraSlider_MoveToPositionAbsolute(first_InMM, 50.0, 200.0, 0.0, 30.0, 60.0, false);
+    SliderSim_Run(500000);
+
+    // Same order as the web API, see WebAPI_MoveToPosition()
+    accepted = CameraSlider_SetCoordinatedMotion(secondCoordinated) && CameraSlider_CanStartMove(secondCoordinated) &&
+               CameraSlider_MoveToPositionAbsolute(second_InMM, 50.0, 200.0, 0.0, 30.0, 60.0, false);
+    SliderSim_RunUntilMotionComplete(BENCH_MOTION_TIMEOUT_US);
+    CameraSlider_SetCoordinatedMotion(false);
+
+    expected_InMM = BENCH_MOTION_CARRIAGE_MM + (accepted ? second_InMM : first_InMM);
+    ok = (accepted == bAccept) && (fabs(SliderSim_GetCarriagePos() - expected_InMM) < 0.01) &&
+         (fabs(getSliderPos() - (expected_InMM - BENCH_MOTION_CARRIAGE_MM)) < 0.01);
+    printf("  %-24s | %8.0f | %8s | %11.2f | %11.2f | %6s\n", pName, start_InMM, accepted ? "yes" : "no",
+           SliderSim_GetCarriagePos(), expected_InMM, ok ? "ok" : "FAIL");
+}
+
+// A running move is never cut off, the step engine has to stand before a move that
+// plans with another step source starts. Any lost step would show as carriage != firmware.
+static void benchTakeover(void)
+{
+    CameraSliderStepping_t stepping = {20.0, 5.0, 0.0, 100, 100, 1000, 5};
+    uint16_t frame;
+    uint32_t need_InMS;
+    float start_InMM;
+    bool accepted;
+
+    printf("\nTakeover, second move half a second into the first one, carriage and firmware have to agree\n");
+    printf("  %-24s | %8s | %8s | %11s | %11s | %6s\n", "second move", "from mm", "accepted", "carriage mm", "expected mm", "result");
+
+    SliderSim_Begin(BENCH_MOTION_CARRIAGE_MM);
+    benchTakeoverCase("coordinated over coord.", true, 100.0, true, 50.0, false);
+    benchTakeoverCase("plain over coordinated", true, 200.0, false, 150.0, false);
+    benchTakeoverCase("coordinated over plain", false, 100.0, true, 150.0, false);
+    benchTakeoverCase("plain over plain", false, 250.0, false, 50.0, true);
+
+    // Stepping counts its frames from where the slider stands, it waits for standstill too
+    start_InMM = SliderSim_GetCarriagePos() - BENCH_MOTION_CARRIAGE_MM;
+    CameraSlider_MoveToPositionAbsolute(150.0, 50.0, 200.0, 0.0, 30.0, 60.0, false);
+    SliderSim_Run(500000);
+    accepted = CameraSlider_StartStepping(&stepping);
+    SliderSim_RunUntilMotionComplete(BENCH_MOTION_TIMEOUT_US);
+    printf("  %-24s | %8.0f | %8s | %11.2f | %11.2f | %6s\n", "stepping over plain", start_InMM, accepted ? "yes" : "no",
+           SliderSim_GetCarriagePos(), BENCH_MOTION_CARRIAGE_MM + 150.0,
+           (!accepted && (CameraSlider_GetSteppingError(&frame, &need_InMS) == STEPPING_ERROR_BUSY) &&
+            (fabs(SliderSim_GetCarriagePos() - (BENCH_MOTION_CARRIAGE_MM + 150.0)) < 0.01)) ? "ok" : "FAIL");
+}
+
+int main(void)
+{
+    SliderSim_Begin(BENCH_MOTION_CARRIAGE_MM);
+
+    benchStepCost();
+    benchDuration();
+    benchStepRate();
+    benchHoming();
+    benchPanHoming();
+    benchIntervalometer();
+    benchBulbRamp();
+    benchPositionTriggers();
+    benchEndstop();
+    benchEnvelope();
+    benchTakeover();
+
+    printf("\nns/step and host st/s include the whole simulator, only good for comparison between runs.\n");
+    printf("The ESP32 runs the same code a lot slower, cycles are host CPU cycles.\n");
+
+    return 0;
+}
@@ -0,0 +1,203 @@
+/*
+Ramp generator benchmark
+Description: Runs the same moves trough every FlexyStepper ramp generator on the
+host. For each generator reports the CPU cycles it takes to plan a step, the
+highest step rate it could plan, how far the velocity profile is from an ideal
+trapezoidal profile and how far the step timing is from the original floating
+point ramp.
+
+Build and run with: pio run -e bench_ramp -t exec
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <chrono>
+#include <vector>
+#include "FlexyStepperRamp.h"
+#include "ramp_plan.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_RAMP_HAS_CYCLE_COUNTER
+#endif
+
+#define BENCH_RAMP_REPEATS  20
+
+typedef struct
+{
+    const char *name;
+    float speed_InStepsPerSecond;
+    float acceleration_InStepsPerSecondPerSecond;
+    long distance_InSteps;
+} BenchRampMove_t;
+
+typedef struct
+{
+    double cyclesPerStep;
+    double stepsPerSecond;
+    double maxVelocityError;        // Relative to the set speed
+    double rmsVelocityError;        // Relative to the set speed
+    double moveTime_InUS;
+    double idealMoveTime_InUS;
+    double maxTimeErrorToFloat_InUS;
+} BenchRampResult_t;
+
+// Slide moves use the firmware defaults (see SliderConfig.h) at 16 and 32 microsteps
+static const BenchRampMove_t benchMoves[] =
+{
+    {"slide default",       1122.0f,   11220.0f,  20000},
+    {"slide fast",          4000.0f,   20000.0f,  20000},
+    {"slide 32 microsteps", 59840.0f,  359040.0f, 200000},
+    {"short move",          4000.0f,   2000.0f,   500},
+};
+
+// Time at which an ideal trapezoidal (or triangular) move reaches a position
+static double idealTime_InUS(const BenchRampMove_t &move, double position_InSteps)
+{
+    double speed = move.speed_InStepsPerSecond;
+    double acceleration = move.acceleration_InStepsPerSecondPerSecond;
+    double distance = move.distance_InSteps;
+    double rampDistance = speed * speed / (2.0 * acceleration);
+    double moveTime;
+
+    // Move too short to reach the set speed
+    if(2.0 * rampDistance > distance)
+    {
+        rampDistance = distance / 2.0;
+        speed = sqrt(acceleration * distance);
+    }
+
+    moveTime = 2.0 * speed / acceleration + (distance - 2.0 * rampDistance) / speed;
+
+    if(position_InSteps <= rampDistance)
+    {
+        return 1E6 * sqrt(2.0 * position_InSteps / acceleration);
+    }
+    else if(position_InSteps < distance - rampDistance)
+    {
+        return 1E6 * (speed / acceleration + (position_InSteps - rampDistance) / speed);
+    }
+    else
+    {
+        return 1E6 * (moveTime - sqrt(2.0 * (distance - position_InSteps) / acceleration));
+    }
+}
+
+static inline uint64_t readCycles(void)
+{
+#ifdef BENCH_RAMP_HAS_CYCLE_COUNTER
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+template <class Ramp>
+static void benchMove(const BenchRampMove_t &move, const std::vector<float> &floatPeriods,
+                      std::vector<float> *pPeriods, BenchRampResult_t *pResult)
+{
+    Ramp ramp;
+    std::chrono::steady_clock::time_point start;
+    uint64_t startCycles;
+    double elapsed_InNS;
+    double plannedSteps;
+    double time_InUS = 0.0;
+    double floatTime_InUS = 0.0;
+    double idealPeriod_InUS;
+    double velocityError;
+    double sumSquaredError = 0.0;
+    size_t comparedSteps = 0;
+
+    ramp.setSpeedInStepsPerSecond(move.speed_InStepsPerSecond);
+    ramp.setAccelerationInStepsPerSecondPerSecond(move.acceleration_InStepsPerSecondPerSecond);
+    pPeriods->reserve(move.distance_InSteps + 16);
+
+    start = std::chrono::steady_clock::now();
+    startCycles = readCycles();
+    for(int repeat = 0; repeat < BENCH_RAMP_REPEATS; repeat++)
+    {
+        pPeriods->clear();
+        planMove(ramp, move.distance_InSteps, pPeriods);
+    }
+    plannedSteps = (double)pPeriods->size() * BENCH_RAMP_REPEATS;
+    pResult->cyclesPerStep = (double)(readCycles() - startCycles) / plannedSteps;
+    elapsed_InNS = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    pResult->stepsPerSecond = 1E9 * plannedSteps / elapsed_InNS;
+
+    // Velocity of every step against the ideal velocity over the same step,
+    // plus step time against the floating point ramp
+    pResult->maxVelocityError = 0.0;
+    pResult->maxTimeErrorToFloat_InUS = 0.0;
+
+    for(size_t step = 0; step < pPeriods->size(); step++)
+    {
+        time_InUS += (*pPeriods)[step];
+
+        if(step < floatPeriods.size())
+        {
+            floatTime_InUS += floatPeriods[step];
+            pResult->maxTimeErrorToFloat_InUS = fmax(pResult->maxTimeErrorToFloat_InUS, fabs(time_InUS - floatTime_InUS));
+        }
+
+        if(step < (size_t)move.distance_InSteps)
+        {
+            idealPeriod_InUS = idealTime_InUS(move, step + 1) - idealTime_InUS(move, step);
+            velocityError = fabs(1E6 / (*pPeriods)[step] - 1E6 / idealPeriod_InUS) / move.speed_InStepsPerSecond;
+
+            pResult->maxVelocityError = fmax(pResult->maxVelocityError, velocityError);
+            sumSquaredError += velocityError * velocityError;
+            comparedSteps++;
+        }
+    }
+
+    pResult->rmsVelocityError = sqrt(sumSquaredError / comparedSteps);
+    pResult->moveTime_InUS = time_InUS;
+    pResult->idealMoveTime_InUS = idealTime_InUS(move, move.distance_InSteps);
+}
+
+static void printResult(const char *name, const BenchRampResult_t &result)
+{
+    printf("  %-8s | %10.1f %12.0f | %8.3f %8.3f | %10.2f %10.2f | %10.1f\n",
+           name, result.cyclesPerStep, result.stepsPerSecond,
+           result.maxVelocityError * 100.0, result.rmsVelocityError * 100.0,
+           result.moveTime_InUS / 1000.0, result.idealMoveTime_InUS / 1000.0,
+           result.maxTimeErrorToFloat_InUS);
+}
+
+int main(void)
+{
+    std::vector<float> floatPeriods;
+    std::vector<float> periods;
+    BenchRampResult_t result;
+
+#ifndef BENCH_RAMP_HAS_CYCLE_COUNTER
+    printf("No cycle counter on this host, cycles/step is not available\n");
+#endif
+
+    for(size_t i = 0; i < sizeof(benchMoves) / sizeof(benchMoves[0]); i++)
+    {
+        printf("\n%s: %ld steps, %.0f steps/s, %.0f steps/s^2\n", benchMoves[i].name, benchMoves[i].distance_InSteps,
+               benchMoves[i].speed_InStepsPerSecond, benchMoves[i].acceleration_InStepsPerSecondPerSecond);
+        printf("  %-8s | %10s %12s | %8s %8s | %10s %10s | %10s\n",
+               "ramp", "cyc/step", "max st/s", "max dV %", "rms dV %", "move ms", "ideal ms", "dT float us");
+
+        benchMove<FlexyRampFloat>(benchMoves[i], std::vector<float>(), &floatPeriods, &result);
+        benchMove<FlexyRampFloat>(benchMoves[i], floatPeriods, &periods, &result);
+        printResult("float", result);
+
+        benchMove<FlexyRampFixed>(benchMoves[i], floatPeriods, &periods, &result);
+        printResult("fixed", result);
+
+        benchMove<FlexyRampLeib>(benchMoves[i], floatPeriods, &periods, &result);
+        printResult("leib", result);
+
+        benchMove<FlexyRampAvr446>(benchMoves[i], floatPeriods, &periods, &result);
+        printResult("avr446", result);
+    }
+
+    printf("\ndV - step velocity against an ideal trapezoidal profile, in %% of the set speed\n");
+    printf("dT float - step time against the floating point ramp\n");
+
+    return 0;
+}
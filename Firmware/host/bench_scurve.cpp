@@ -0,0 +1,139 @@
+/*
+S-curve profile comparison
+Description: Plans the same moves with the trapezoidal ramp (FlexyRampFloat)
+and the jerk limited S-curve ramp (FlexyRampSCurve) at a few jerk settings.
+For each one reports the total move time against the peak acceleration and
+peak jerk the motor actually sees, measured from the step timing.
+
+Build and run with: pio run -e bench_scurve -t exec
+*/
+
+#include <stdio.h>
+#include <math.h>
+#include <vector>
+#include "FlexyStepperRamp.h"
+#include "ramp_plan.h"
+
+typedef struct
+{
+    const char *name;
+    float speed_InStepsPerSecond;
+    float acceleration_InStepsPerSecondPerSecond;
+    long distance_InSteps;
+} BenchSCurveMove_t;
+
+typedef struct
+{
+    double moveTime_InUS;
+    double peakAcceleration;
+    double peakJerk;
+} BenchSCurveResult_t;
+
+// Slide moves use the firmware defaults (see SliderConfig.h), steps/mm = 187
+static const BenchSCurveMove_t benchMoves[] =
+{
+    {"slide default",       1122.0f,  11220.0f, 20000},
+    {"slide slow",          187.0f,   935.0f,   9350},
+    {"slide fast",          4000.0f,  20000.0f, 40000},
+    {"short move",          1122.0f,  11220.0f, 300},
+};
+
+// Jerk settings to try, as the time it takes to ramp up to full acceleration
+// (Jerk = Acceleration / time), 0 is the trapezoidal profile
+static const float jerkRampTimes_InSeconds[] = {0.0f, 0.05f, 0.1f, 0.2f, 0.4f};
+
+// Velocity of every step is 1 / period, in the middle of the step. Acceleration
+// and jerk are the differences between neighbouring steps. The very first step
+// from standstill and the last one to standstill are not part of it, they only
+// have a period from or to 0 velocity.
+static void measure(const std::vector<float> &periods, BenchSCurveResult_t *pResult)
+{
+    std::vector<double> time_InS;
+    std::vector<double> velocity;
+    std::vector<double> accelerationTime_InS;
+    std::vector<double> acceleration;
+    double now_InS = 0.0;
+    double jerk;
+
+    pResult->moveTime_InUS = 0.0;
+    pResult->peakAcceleration = 0.0;
+    pResult->peakJerk = 0.0;
+
+    for(size_t step = 0; step < periods.size(); step++)
+    {
+        now_InS += periods[step] / 1E6;
+        time_InS.push_back(now_InS - periods[step] / 2E6);
+        velocity.push_back(1E6 / periods[step]);
+        pResult->moveTime_InUS += periods[step];
+    }
+
+    for(size_t step = 1; step < velocity.size(); step++)
+    {
+        accelerationTime_InS.push_back((time_InS[step] + time_InS[step - 1]) / 2.0);
+        acceleration.push_back((velocity[step] - velocity[step - 1]) / (time_InS[step] - time_InS[step - 1]));
+        pResult->peakAcceleration = fmax(pResult->peakAcceleration, fabs(acceleration.back()));
+    }
+
+    for(size_t step = 1; step < acceleration.size(); step++)
+    {
+        jerk = (acceleration[step] - acceleration[step - 1]) / (accelerationTime_InS[step] - accelerationTime_InS[step - 1]);
+        pResult->peakJerk = fmax(pResult->peakJerk, fabs(jerk));
+    }
+}
+
+int main(void)
+{
+    std::vector<float> periods;
+    BenchSCurveResult_t result;
+    BenchSCurveResult_t trapezoidResult = {0.0, 0.0, 0.0};
+    float jerk;
+
+    for(size_t i = 0; i < sizeof(benchMoves) / sizeof(benchMoves[0]); i++)
+    {
+        const BenchSCurveMove_t &move = benchMoves[i];
+
+        printf("\n%s: %ld steps, %.0f steps/s, %.0f steps/s^2\n", move.name, move.distance_InSteps,
+               move.speed_InStepsPerSecond, move.acceleration_InStepsPerSecondPerSecond);
+        printf("  %-10s | %12s | %10s %8s | %12s %12s\n",
+               "profile", "jerk set", "move ms", "vs trap", "peak accel", "peak jerk");
+
+        for(size_t j = 0; j < sizeof(jerkRampTimes_InSeconds) / sizeof(jerkRampTimes_InSeconds[0]); j++)
+        {
+            FlexyRampSCurve ramp;
+
+            jerk = 0.0f;
+            if(jerkRampTimes_InSeconds[j] > 0.0f)
+            {
+                jerk = move.acceleration_InStepsPerSecondPerSecond / jerkRampTimes_InSeconds[j];
+            }
+
+            ramp.setSpeedInStepsPerSecond(move.speed_InStepsPerSecond);
+            ramp.setAccelerationInStepsPerSecondPerSecond(move.acceleration_InStepsPerSecondPerSecond);
+            ramp.setJerkInStepsPerSecondPerSecondPerSecond(jerk);
+
+            periods.clear();
+            planMove(ramp, move.distance_InSteps, &periods);
+            measure(periods, &result);
+
+            if(jerk == 0.0f)
+            {
+                trapezoidResult = result;
+                printf("  %-10s | %12s |", "trapezoid", "-");
+            }
+            else
+            {
+                printf("  s %4.2fs   | %12.0f |", jerkRampTimes_InSeconds[j], jerk);
+            }
+
+            printf(" %10.2f %7.1f%% | %12.0f %12.0f\n",
+                   result.moveTime_InUS / 1000.0,
+                   100.0 * (result.moveTime_InUS - trapezoidResult.moveTime_InUS) / trapezoidResult.moveTime_InUS,
+                   result.peakAcceleration, result.peakJerk);
+        }
+    }
+
+    printf("\ns <t> - S-curve, acceleration ramps up to its limit in <t> seconds\n");
+    printf("Peak acceleration and jerk are measured from the step timing, in steps/s^2 and steps/s^3\n");
+
+    return 0;
+}
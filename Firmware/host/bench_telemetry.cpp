@@ -0,0 +1,189 @@
+/*
+Telemetry benchmark
+Description: Streams the status of the slider while it runs a move in the slider simulator
+(host/sim), once as the status JSON (CameraSlider_FormatJSON_CameraSliderStatus(), one message
+per sample like /api/camera-slider-status) and once as binary telemetry frames (CameraSlider_FormatTelemetry(),
+batched like WebAPI_PushTelemetry() does). Reports for every sample rate
+    - bytes/s and messages/s of both
+    - host CPU time per frame of both
+    - that the host decoder (host/telemetry) reads back every position the firmware had
+
+Build and run with: pio run -e bench_telemetry -t exec
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+#include <StepEngine.h>
+#include <StepEngineHal_Virtual.h>
+#include "SliderSim.h"
+#include "TelemetryDecoder.h"
+#include "DIY_CameraSlider_MotorControl.h"
+
+// Firmware side, see DIY_CameraSlider_MotorControl.cpp
+extern StepEngine<StepEngineHal_Virtual> stepEngine;
+
+#define BENCH_TELEMETRY_CARRIAGE_MM 5.0     // Carriage position at power up, away from the endstop
+#define BENCH_TELEMETRY_SLIDE_MM    250.0
+#define BENCH_TELEMETRY_PAN_DEG     90.0
+#define BENCH_TELEMETRY_IDLE_US     1000000 // Keeps streaming this long after the move
+#define BENCH_TELEMETRY_TIMEOUT_US  120000000
+
+static const uint32_t benchRates[] = {10, 50, 100, 200};
+
+typedef struct
+{
+    uint32_t frames;
+    uint32_t messages;
+    uint64_t bytes;
+    double elapsed_InNS;
+} BenchTelemetryStream_t;
+
+typedef struct
+{
+    int32_t slide_InSteps;
+    int32_t pan_InSteps;
+} BenchTelemetryPosition_t;
+
+static double nowInNS(void)
+{
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Decodes one message and checks it against the positions the frames were taken at
+static uint32_t checkMessage(TelemetryDecoder_t *pDecoder, const uint8_t *pMessage, int len, const std::vector<BenchTelemetryPosition_t> &expected)
+{
+    std::vector<TelemetryFrame_t> frames;
+    uint32_t mismatches = 0;
+
+    if(!TelemetryDecoder_Decode(pDecoder, pMessage, len, &frames) || (frames.size() != expected.size()))
+    {
+        return expected.size();
+    }
+
+    for(size_t i = 0; i < frames.size(); i++)
+    {
+        if((frames[i].slide_InSteps != expected[i].slide_InSteps) || (frames[i].pan_InSteps != expected[i].pan_InSteps))
+        {
+            mismatches++;
+        }
+    }
+
+    return mismatches;
+}
+
+static void benchRate(uint32_t rate_InHz)
+{
+    BenchTelemetryStream_t json = {0, 0, 0, 0.0};
+    BenchTelemetryStream_t binary = {0, 0, 0, 0.0};
+    TelemetryDecoder_t decoder;
+    std::vector<BenchTelemetryPosition_t> expected;
+    BenchTelemetryPosition_t position;
+    uint8_t message[TELEMETRY_MESSAGE_SIZE];
+    char buff[512];
+    uint32_t period_InUS = 1000000 / rate_InHz;
+    uint32_t start_InUS;
+    uint32_t sample_InUS;
+    uint32_t messageStart_InUS = 0;
+    uint32_t idleSince_InUS = 0;
+    uint32_t mismatches = 0;
+    double seconds;
+    double t0;
+    int messageLength = 0;
+    int len;
+
+    SliderSim_Begin(BENCH_TELEMETRY_CARRIAGE_MM);
+    CameraSlider_EnableMotors(true);
+    TelemetryDecoder_Init(&decoder);
+
+    CameraSlider_MoveToPositionRelative(BENCH_TELEMETRY_SLIDE_MM, 40.0, 200.0, BENCH_TELEMETRY_PAN_DEG, 60.0, 120.0, false);
+    start_InUS = SliderSim_Now();
+    sample_InUS = start_InUS;
+
+    while((SliderSim_Now() - start_InUS) < BENCH_TELEMETRY_TIMEOUT_US)
+    {
+        // Simulator runs in ticks, keep the sample rate on average
+        sample_InUS += period_InUS;
+        if((int32_t)(sample_InUS - SliderSim_Now()) > 0)
+        {
+            SliderSim_Run(sample_InUS - SliderSim_Now());
+        }
+
+        // Status JSON, one message per sample
+        t0 = nowInNS();
+        CameraSlider_FormatJSON_CameraSliderStatus(buff, sizeof(buff));
+        json.elapsed_InNS += nowInNS() - t0;
+        json.bytes += strlen(buff);
+        json.frames++;
+        json.messages++;
+
+        // Binary frames, one message per TELEMETRY_SEND_PERIOD_MS starting with a key frame
+        if(messageLength == 0)
+        {
+            messageStart_InUS = SliderSim_Now();
+            expected.clear();
+        }
+        position.slide_InSteps = stepEngine.getPosition(SLIDER_AXIS_SLIDE);
+        position.pan_InSteps = stepEngine.getPosition(SLIDER_AXIS_PAN);
+        expected.push_back(position);
+
+        t0 = nowInNS();
+        len = CameraSlider_FormatTelemetry(&message[messageLength], sizeof(message) - messageLength, messageLength == 0);
+        binary.elapsed_InNS += nowInNS() - t0;
+        messageLength += len;
+        binary.frames++;
+
+        if((SliderSim_Now() - messageStart_InUS) >= TELEMETRY_SEND_PERIOD_MS * 1000)
+        {
+            mismatches += checkMessage(&decoder, message, messageLength, expected);
+            binary.bytes += messageLength;
+            binary.messages++;
+            messageLength = 0;
+        }
+
+        if(!CameraSlider_MotionComplete())
+        {
+            idleSince_InUS = SliderSim_Now();
+        }
+        else if((SliderSim_Now() - idleSince_InUS) > BENCH_TELEMETRY_IDLE_US)
+        {
+            break;
+        }
+    }
+
+    if(messageLength > 0)
+    {
+        mismatches += checkMessage(&decoder, message, messageLength, expected);
+        binary.bytes += messageLength;
+        binary.messages++;
+    }
+
+    seconds = (SliderSim_Now() - start_InUS) / 1e6;
+
+    printf("  %4u Hz | %8.0f %6.1f %7.0f | %8.0f %6.1f %7.0f %5.1f | %6.1fx | %6u %4u %s\n",
+           rate_InHz,
+           json.bytes / seconds, json.messages / seconds, json.elapsed_InNS / json.frames,
+           binary.bytes / seconds, binary.messages / seconds, binary.elapsed_InNS / binary.frames, (double)binary.bytes / binary.frames,
+           (double)json.bytes / binary.bytes,
+           decoder.frames, decoder.lost + mismatches,
+           ((decoder.frames == binary.frames) && (decoder.lost == 0) && (mismatches == 0)) ? "ok" : "FAIL");
+}
+
+int main(void)
+{
+    printf("Telemetry of a %.0fmm slide and %.0fdeg pan move, then %.1fs standing\n\n",
+           BENCH_TELEMETRY_SLIDE_MM, BENCH_TELEMETRY_PAN_DEG, BENCH_TELEMETRY_IDLE_US / 1e6);
+    printf("     rate |       JSON status         |        binary telemetry        |  JSON  |    decoded\n");
+    printf("          |      B/s  msg/s ns/frame |      B/s  msg/s ns/frame B/frm | /binary| frames  bad\n");
+
+    for(size_t i = 0; i < sizeof(benchRates) / sizeof(benchRates[0]); i++)
+    {
+        benchRate(benchRates[i]);
+    }
+
+    printf("\nBytes are payload only, every message adds its WebSocket and TCP/IP headers on top.\n");
+    printf("ns/frame is host CPU time, only good for comparison between runs.\n");
+
+    return 0;
+}
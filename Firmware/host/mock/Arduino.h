@@ -0,0 +1,98 @@
+/*
+Mock Arduino
+Description: Just enough of the Arduino (ESP32) core to build the motion code of
+the firmware on a host. Time is virtual, it only moves when delay() or
+delayMicroseconds() is called, when the simulator sets it or by
+MOCK_ARDUINO_MICROS_PER_CALL on every micros() call, so busy loops waiting for
+the next step time still get there. Pin writes are reported to a handler, the
+simulator records them as GPIO edges.
+*/
+
+#ifndef __MOCK_ARDUINO__
+#define __MOCK_ARDUINO__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+
+#define MOCK_ARDUINO_PINS               40
+#define MOCK_ARDUINO_MICROS_PER_CALL    1
+
+#define IRAM_ATTR
+
+#define HIGH            1
+#define LOW             0
+#define INPUT           0x01
+#define OUTPUT          0x02
+#define INPUT_PULLUP    0x05
+
+#define RISING          0x01
+#define FALLING         0x02
+#define CHANGE          0x03
+
+#define DEC             10
+
+#define log_e(...)      MockArduino_Log(__VA_ARGS__)
+#define log_w(...)      MockArduino_Log(__VA_ARGS__)
+#define log_i(...)      MockArduino_Log(__VA_ARGS__)
+#define log_d(...)      MockArduino_Log(__VA_ARGS__)
+
+typedef uint8_t byte;
+
+unsigned long micros(void);
+unsigned long millis(void);
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t level);
+int digitalRead(uint8_t pin);
+
+void attachInterrupt(uint8_t pin, void (*handler)(void), int mode);
+void detachInterrupt(uint8_t pin);
+#define digitalPinToInterrupt(pin)  (pin)
+
+class MockSerial
+{
+    public:
+        void begin(unsigned long baud);
+        void print(const char *text);
+        void print(int value, int base = DEC) { print((long)value, base); }
+        void print(unsigned int value, int base = DEC) { print((unsigned long)value, base); }
+        void print(long value, int base = DEC);
+        void print(unsigned long value, int base = DEC);
+        void print(double value, int digits = 2);
+        void println(void);
+        void println(const char *text);
+        void println(int value, int base = DEC) { println((long)value, base); }
+        void println(unsigned int value, int base = DEC) { println((unsigned long)value, base); }
+        void println(long value, int base = DEC);
+        void println(unsigned long value, int base = DEC);
+        void println(double value, int digits = 2);
+        void printf(const char *format, ...);
+
+        // Serial output goes to stdout only when enabled
+        void setEcho(bool echo) { mEcho = echo; }
+
+    private:
+        bool mEcho = false;
+};
+
+extern MockSerial Serial;
+
+// Simulator side
+//      - pin       -> GPIO number
+//      - level     -> new pin level
+//      - timeInUS  -> virtual time of the write
+typedef void (*MockArduino_PinHandler)(uint8_t pin, uint8_t level, uint32_t timeInUS);
+
+void MockArduino_SetMicros(uint32_t timeInUS);
+uint32_t MockArduino_GetMicros(void);
+void MockArduino_SetWriteHandler(MockArduino_PinHandler pHandler);
+void MockArduino_SetPinInput(uint8_t pin, uint8_t level);
+void MockArduino_Log(const char *format, ...);
+
+#endif
@@ -0,0 +1,226 @@
+/*
+Mock Arduino
+Description: Virtual clock, pins and Serial of the mock Arduino core (see Arduino.h)
+*/
+
+#include <stdarg.h>
+#include "Arduino.h"
+
+MockSerial Serial;
+
+typedef struct
+{
+    uint8_t level;
+    void (*interruptHandler)(void);
+    int interruptMode;
+} MockPin_t;
+
+static uint32_t clock_InUS = 0;
+static MockPin_t pins[MOCK_ARDUINO_PINS];
+static MockArduino_PinHandler pWriteHandler = NULL;
+
+void MockArduino_SetMicros(uint32_t timeInUS)
+{
+    clock_InUS = timeInUS;
+}
+
+// Current virtual time, without moving it on like micros() does
+uint32_t MockArduino_GetMicros(void)
+{
+    return clock_InUS;
+}
+
+void MockArduino_SetWriteHandler(MockArduino_PinHandler pHandler)
+{
+    pWriteHandler = pHandler;
+}
+
+// Drive an input from outside (i.e. an endstop), fires an attached interrupt on a matching edge
+void MockArduino_SetPinInput(uint8_t pin, uint8_t level)
+{
+    MockPin_t *pPin;
+    bool rising;
+    bool falling;
+
+    if(pin >= MOCK_ARDUINO_PINS)
+    {
+        return;
+    }
+
+    pPin = &pins[pin];
+    rising = (pPin->level == LOW) && (level != LOW);
+    falling = (pPin->level != LOW) && (level == LOW);
+    pPin->level = level;
+
+    if(pPin->interruptHandler == NULL)
+    {
+        return;
+    }
+
+    if((rising && (pPin->interruptMode != FALLING)) || (falling && (pPin->interruptMode != RISING)))
+    {
+        pPin->interruptHandler();
+    }
+}
+
+void MockArduino_Log(const char *format, ...)
+{
+    va_list args;
+
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+}
+
+unsigned long micros(void)
+{
+    uint32_t now_InUS = clock_InUS;
+
+    clock_InUS += MOCK_ARDUINO_MICROS_PER_CALL;
+
+    return now_InUS;
+}
+
+unsigned long millis(void)
+{
+    return clock_InUS / 1000;
+}
+
+void delay(uint32_t ms)
+{
+    clock_InUS += ms * 1000;
+}
+
+void delayMicroseconds(uint32_t us)
+{
+    clock_InUS += us;
+}
+
+// Inputs are driven by the simulator (MockArduino_SetPinInput()), pull ups don't change them
+void pinMode(uint8_t pin, uint8_t mode)
+{
+}
+
+void digitalWrite(uint8_t pin, uint8_t level)
+{
+    if(pin >= MOCK_ARDUINO_PINS)
+    {
+        return;
+    }
+
+    level = (level != LOW) ? HIGH : LOW;
+    if(pins[pin].level == level)
+    {
+        return;
+    }
+
+    pins[pin].level = level;
+    if(pWriteHandler != NULL)
+    {
+        pWriteHandler(pin, level, clock_InUS);
+    }
+}
+
+int digitalRead(uint8_t pin)
+{
+    if(pin >= MOCK_ARDUINO_PINS)
+    {
+        return LOW;
+    }
+
+    return pins[pin].level;
+}
+
+void attachInterrupt(uint8_t pin, void (*handler)(void), int mode)
+{
+    if(pin < MOCK_ARDUINO_PINS)
+    {
+        pins[pin].interruptHandler = handler;
+        pins[pin].interruptMode = mode;
+    }
+}
+
+void detachInterrupt(uint8_t pin)
+{
+    if(pin < MOCK_ARDUINO_PINS)
+    {
+        pins[pin].interruptHandler = NULL;
+    }
+}
+
+void MockSerial::begin(unsigned long baud)
+{
+}
+
+void MockSerial::print(const char *text)
+{
+    if(mEcho)
+    {
+        fputs(text, stdout);
+    }
+}
+
+void MockSerial::print(long value, int base)
+{
+    if(mEcho)
+    {
+        printf((base == 16) ? "%lx" : "%ld", value);
+    }
+}
+
+void MockSerial::print(unsigned long value, int base)
+{
+    if(mEcho)
+    {
+        printf((base == 16) ? "%lx" : "%lu", value);
+    }
+}
+
+void MockSerial::print(double value, int digits)
+{
+    if(mEcho)
+    {
+        printf("%.*f", digits, value);
+    }
+}
+
+void MockSerial::println(void)
+{
+    print("\r\n");
+}
+
+void MockSerial::println(const char *text)
+{
+    print(text);
+    println();
+}
+
+void MockSerial::println(long value, int base)
+{
+    print(value, base);
+    println();
+}
+
+void MockSerial::println(unsigned long value, int base)
+{
+    print(value, base);
+    println();
+}
+
+void MockSerial::println(double value, int digits)
+{
+    print(value, digits);
+    println();
+}
+
+void MockSerial::printf(const char *format, ...)
+{
+    va_list args;
+
+    if(mEcho)
+    {
+        va_start(args, format);
+        vprintf(format, args);
+        va_end(args);
+    }
+}
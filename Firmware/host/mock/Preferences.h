@@ -0,0 +1,26 @@
+/*
+Mock Preferences
+Description: Stands in for the ESP32 NVS storage used by PersistSettings.
+Nothing is stored, every run starts from the default slider config.
+*/
+
+#ifndef __MOCK_PREFERENCES__
+#define __MOCK_PREFERENCES__
+
+#include "Arduino.h"
+
+class Preferences
+{
+    public:
+        bool begin(const char *name, bool readOnly = false) { return true; }
+        void end(void) {}
+
+        unsigned int getUInt(const char *key, unsigned int defaultValue = 0) { return defaultValue; }
+        size_t putUInt(const char *key, unsigned int value) { return sizeof(value); }
+
+        size_t getBytesLength(const char *key) { return 0; }
+        size_t getBytes(const char *key, void *pBuffer, size_t length) { return 0; }
+        size_t putBytes(const char *key, const void *pBuffer, size_t length) { return length; }
+};
+
+#endif
@@ -0,0 +1,45 @@
+/*
+Host tools - Ramp planning
+Description: Plans a whole move with a FlexyStepper ramp generator, without a
+stepper, so the step timing can be measured on the host.
+*/
+
+#ifndef __HOST_RAMP_PLAN__
+#define __HOST_RAMP_PLAN__
+
+#include <vector>
+#include "FlexyStepperRamp.h"
+
+// Same decisions FlexyStepper::DeterminePeriodOfNextStep() makes for a move
+// toward the target, plans the whole move and returns the period of every step
+template <class Ramp>
+static void planMove(Ramp &ramp, long distance_InSteps, std::vector<float> *pPeriods)
+{
+    long position = 0;
+
+    ramp.startFromStop();
+
+    while(1)
+    {
+        pPeriods->push_back(ramp.getPeriodInUS());
+        position++;
+
+        if((position >= distance_InSteps) ||
+           ramp.isWithinStoppingDistance((unsigned long)(distance_InSteps - position)) || ramp.isFasterThanDesired())
+        {
+            ramp.slowDown();
+        }
+        else
+        {
+            ramp.speedUp();
+        }
+
+        if((position >= distance_InSteps) && ramp.isSlowEnoughToStop())
+        {
+            ramp.stop();
+            break;
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,447 @@
+/*
+Slider simulator
+Description: Virtual time loop, GPIO recording, carriage, endstop and pan model and
+stand-ins for the firmware parts that don't build on the host (see SliderSim.h)
+*/
+
+#include <StepEngine.h>
+#include <StepEngineHal_Virtual.h>
+#include "SliderSim.h"
+#include "DIY_CameraSlider_MotorControl.h"
+#include "DIY_CameraSlider_CameraControl.h"
+#include "DIY_CameraSlider_Tasks.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define SLIDER_SIM_HAS_CYCLE_COUNTER
+#endif
+
+// Firmware side, see DIY_CameraSlider_MotorControl.cpp
+extern StepEngineHal_Virtual stepEngineHal;
+extern sliderState_t sliderState;
+extern volatile bool bEndstopLatched;
+extern bool bhomingComplete;
+extern bool bPanHomed;
+extern FlexyStepperT<SLIDE_RAMP_GENERATOR> stepper_slide;
+extern FlexyStepperT<PAN_RAMP_GENERATOR> stepper_pan;
+
+PersistSettings<SliderConfigStruct> SliderConfig(SliderConfigStruct::Version);
+
+const char* sliderStateStr[] = {
+    "SLIDER_FIRST",
+    "SLIDER_MOTORS_OFF",
+    "SLIDER_IDLE",
+    "SLIDER_HOMING",
+    "SLIDER_MOVING_TO_START",
+    "SLIDER_MOVING_TO_END",
+    "SLIDER_READY",
+    "SLIDER_WORKING",
+    "SLIDER_STEPPING",
+    "SLIDER_STEP_FINISHED",
+    "SLIDER_HOMING_FAILED",
+    "SLIDER_LAST"
+};
+
+static std::vector<SliderSimEdge_t> edges;
+static bool bRecordEdges = true;
+static long stepCount[STEP_ENGINE_MAX_AXES];
+static float carriageStart_InMM = 0.0;
+static SliderSimPanHome_t panHome = SLIDER_SIM_PAN_FREE;
+static long panHome_InSteps = 0;
+static long panPos_InSteps = 0;             // Where the pan really is, steps against a stop don't count
+static uint32_t shutterCount = 0;
+static std::vector<SliderSimShot_t> shots;
+static uint32_t exposureEnd_InUS = 0;
+static uint32_t lastBulb_InUS = 0;
+static uint32_t lastTick_InUS = 0;
+static bool bInSlice = false;
+static bool bEndstopPending = false;
+static SliderSimProfile_t profile;
+
+static inline uint64_t readCycles(void)
+{
+#ifdef SLIDER_SIM_HAS_CYCLE_COUNTER
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+float SliderSim_GetCarriagePos(void)
+{
+    return carriageStart_InMM + (float)(stepCount[SLIDER_AXIS_SLIDE] * SliderConfig.Config.slider_direction) / SliderConfig.Config.slide_steps_per_mm;
+}
+
+float SliderSim_GetPanPos(void)
+{
+    return (float)panPos_InSteps / SliderConfig.Config.pan_steps_per_degree;
+}
+
+// Endstops are pressed (high) while the carriage is at either end of the rail,
+// the pan switch from the home angle on
+static void SliderSim_UpdateEndstops(void)
+{
+    float pos_InMM = SliderSim_GetCarriagePos();
+    bool bPanHome = ((panPos_InSteps - panHome_InSteps) * PAN_HOMING_DIRECTION >= 0);
+
+    MockArduino_SetPinInput(PIN_END_SWICH_X_LEFT, (pos_InMM <= 0.0) ? HIGH : LOW);
+    MockArduino_SetPinInput(PIN_END_SWICH_X_RIGHT, (pos_InMM >= SliderConfig.Config.rail_length) ? HIGH : LOW);
+    MockArduino_SetPinInput(PIN_HOME_SWITCH_PAN, ((panHome == SLIDER_SIM_PAN_SWITCH) && bPanHome) ? HIGH : LOW);
+}
+
+// A step of the pan motor, against the stop it is lost
+static void SliderSim_TurnPan(int step)
+{
+    if((panHome == SLIDER_SIM_PAN_HARD_STOP) && ((panPos_InSteps + step - panHome_InSteps) * PAN_HOMING_DIRECTION > 0))
+    {
+        return;
+    }
+
+    panPos_InSteps += step;
+}
+
+void SliderSim_SetPanHome(SliderSimPanHome_t type, float home_InDeg)
+{
+    panHome = type;
+    panHome_InSteps = lround(home_InDeg * SliderConfig.Config.pan_steps_per_degree);
+    SliderSim_UpdateEndstops();
+}
+
+// Every pin write ends up here, from the step engine and from code writing pins itself
+static void SliderSim_RecordEdge(uint8_t pin, uint8_t level, uint32_t timeInUS)
+{
+    SliderSimEdge_t edge;
+    int step;
+
+    if(bRecordEdges)
+    {
+        edge.time_InUS = timeInUS;
+        edge.pin = pin;
+        edge.level = level;
+        edges.push_back(edge);
+    }
+
+    if(level != HIGH)
+    {
+        return;
+    }
+
+    for(uint8_t axis = 0; axis < STEP_ENGINE_MAX_AXES; axis++)
+    {
+        if((stepEngineHal.getStepPin(axis) != pin) || (pin == 0))
+        {
+            continue;
+        }
+
+        // High direction pin is the negative direction, for FlexyStepper and the step engine
+        step = (digitalRead(stepEngineHal.getDirectionPin(axis)) == HIGH) ? -1 : 1;
+        stepCount[axis] += step;
+
+        if(axis == SLIDER_AXIS_PAN)
+        {
+            SliderSim_TurnPan(step);
+        }
+
+        // Endstop interrupts can't run in the middle of the step interrupt
+        if(bInSlice)
+        {
+            bEndstopPending = true;
+        }
+        else
+        {
+            SliderSim_UpdateEndstops();
+        }
+    }
+}
+
+// Step engine edges go trough the mock pins, so pin levels and the edge
+// log look the same as for pins written with digitalWrite()
+static void SliderSim_EngineEdge(void *pContext, uint8_t axis, bool isStep, bool level, uint32_t timeInUS)
+{
+    uint8_t pin = isStep ? stepEngineHal.getStepPin(axis) : stepEngineHal.getDirectionPin(axis);
+    uint32_t now_InUS = MockArduino_GetMicros();
+
+    MockArduino_SetMicros(timeInUS);
+    digitalWrite(pin, level ? HIGH : LOW);
+    MockArduino_SetMicros(now_InUS);
+}
+
+static void SliderSim_AlarmHandler(void)
+{
+    uint64_t start = readCycles();
+
+    CameraSlider_StepEngineISR();
+    profile.alarmCycles += readCycles() - start;
+    profile.alarms++;
+}
+
+static void SliderSim_RefillHandler(void)
+{
+    uint64_t start = readCycles();
+
+    CameraSlider_StepEngineRefill();
+    profile.refillCycles += readCycles() - start;
+    profile.refills++;
+}
+
+void SliderSim_Begin(float carriagePos_InMM)
+{
+    // Starting over, whatever ran before has to stop where it is.
+    // Pins keep their level, the step engine remembers the direction pins.
+    CameraSlider_HaltMotors();
+    CameraSlider_SetCoordinatedMotion(false);
+    stepper_slide.abortMotion(0);
+    stepper_pan.abortMotion(0);
+    bhomingComplete = false;
+    bPanHomed = false;
+    if(bEndstopLatched)
+    {
+        CameraSlider_FinishEndstopStop();
+    }
+
+    MockArduino_SetMicros(0);
+    MockArduino_SetWriteHandler(SliderSim_RecordEdge);
+
+    edges.clear();
+    memset(stepCount, 0, sizeof(stepCount));
+    carriageStart_InMM = carriagePos_InMM;
+    panHome = SLIDER_SIM_PAN_FREE;
+    panHome_InSteps = 0;
+    panPos_InSteps = 0;
+    shutterCount = 0;
+    shots.clear();
+    exposureEnd_InUS = 0;
+    lastBulb_InUS = 0;
+    lastTick_InUS = 0;
+    bEndstopPending = false;
+    SliderSim_ClearProfile();
+
+    SliderConfig.Begin();
+    setupMotors();
+
+    // Same handlers, wrapped to measure them
+    stepEngineHal.begin(STEP_ENGINE_TIMER, SliderSim_AlarmHandler, SliderSim_RefillHandler);
+    stepEngineHal.setEdgeHandler(SliderSim_EngineEdge, NULL);
+    stepEngineHal.setPulseWidth(SLIDER_SIM_PULSE_WIDTH_US);
+    stepEngineHal.setMinAlarmLead(SLIDER_SIM_MIN_ALARM_LEAD_US);
+    stepEngineHal.setTime(MockArduino_GetMicros());
+
+    SliderSim_UpdateEndstops();
+    CameraSlider_ResetStepMetrics();
+    CameraSlider_EnableMotors(true);
+}
+
+// Step interrupt and refill task up to timeInUS, in slices so endstop
+// changes get in between
+static void SliderSim_RunEngine(uint32_t timeInUS)
+{
+    uint32_t slice_InUS = stepEngineHal.nowInUS();
+
+    while((int32_t)(timeInUS - slice_InUS) > 0)
+    {
+        slice_InUS += SLIDER_SIM_SLICE_US;
+        if((int32_t)(slice_InUS - timeInUS) > 0)
+        {
+            slice_InUS = timeInUS;
+        }
+
+        bInSlice = true;
+        stepEngineHal.runUntil(slice_InUS);
+        bInSlice = false;
+
+        MockArduino_SetMicros(stepEngineHal.nowInUS());
+
+        if(bEndstopPending)
+        {
+            bEndstopPending = false;
+            SliderSim_UpdateEndstops();
+        }
+    }
+}
+
+// One period of the motion task: CameraSlider_tick() and everything the
+// interrupt does until the task runs again. Code in the tick can take
+// virtual time itself (delay(), busy loops), the interrupt catches up after.
+static void SliderSim_Tick(void)
+{
+    uint32_t next_InUS;
+
+    CameraSlider_tick();
+
+    next_InUS = lastTick_InUS + TASK_MOTION_POLL_MS * 1000;
+    if((int32_t)(MockArduino_GetMicros() - next_InUS) > 0)
+    {
+        next_InUS = MockArduino_GetMicros();
+    }
+    lastTick_InUS = next_InUS;
+
+    SliderSim_RunEngine(next_InUS);
+}
+
+void SliderSim_Run(uint32_t duration_InUS)
+{
+    uint32_t end_InUS = SliderSim_Now() + duration_InUS;
+
+    while((int32_t)(end_InUS - SliderSim_Now()) > 0)
+    {
+        SliderSim_Tick();
+    }
+}
+
+bool SliderSim_RunUntilState(sliderState_t state, uint32_t timeout_InUS)
+{
+    uint32_t end_InUS = SliderSim_Now() + timeout_InUS;
+
+    while(sliderState != state)
+    {
+        if((int32_t)(end_InUS - SliderSim_Now()) <= 0)
+        {
+            return false;
+        }
+        SliderSim_Tick();
+    }
+
+    return true;
+}
+
+bool SliderSim_RunUntilMotionComplete(uint32_t timeout_InUS)
+{
+    uint32_t end_InUS = SliderSim_Now() + timeout_InUS;
+
+    while(!CameraSlider_MotionComplete())
+    {
+        if((int32_t)(end_InUS - SliderSim_Now()) <= 0)
+        {
+            return false;
+        }
+        SliderSim_Tick();
+    }
+
+    return true;
+}
+
+uint32_t SliderSim_Now(void)
+{
+    return MockArduino_GetMicros();
+}
+
+long SliderSim_GetStepCount(uint8_t axis)
+{
+    return (axis < STEP_ENGINE_MAX_AXES) ? stepCount[axis] : 0;
+}
+
+uint32_t SliderSim_GetShutterCount(void)
+{
+    return shutterCount;
+}
+
+const std::vector<SliderSimShot_t> &SliderSim_GetShots(void)
+{
+    return shots;
+}
+
+void SliderSim_RecordEdges(bool record)
+{
+    bRecordEdges = record;
+}
+
+const std::vector<SliderSimEdge_t> &SliderSim_GetEdges(void)
+{
+    return edges;
+}
+
+void SliderSim_ClearEdges(void)
+{
+    edges.clear();
+}
+
+const SliderSimProfile_t &SliderSim_GetProfile(void)
+{
+    return profile;
+}
+
+void SliderSim_ClearProfile(void)
+{
+    memset(&profile, 0, sizeof(profile));
+}
+
+// Stand-ins for DIY_CameraSlider_Tasks.cpp, there is only one thread in the simulator
+void CameraSlider_WakeMotion(void)
+{
+}
+
+void CameraSlider_AddBusyTime(CameraSliderTask_t task, uint32_t busy_InUS)
+{
+}
+
+static void SliderSim_Shot(bool triggered, uint32_t duration_InMS)
+{
+    SliderSimShot_t shot;
+
+    // Inside a slice the mock clock still stands at its start, the HAL has the time of the step
+    shot.time_InUS = triggered ? stepEngineHal.nowInUS() : MockArduino_GetMicros();
+    shot.carriage_InMM = SliderSim_GetCarriagePos();
+    shot.bTriggered = triggered;
+    shot.duration_InMS = duration_InMS;
+    shots.push_back(shot);
+    shutterCount++;
+
+    exposureEnd_InUS = shot.time_InUS + duration_InMS * 1000;
+}
+
+// Stand-ins for DIY_CameraSlider_CameraControl.cpp
+void CameraControl_ReleaseShutter()
+{
+    SliderSim_Shot(false, CAMERA_SHUTTER_PULSE_MS);
+}
+
+// Only shots count, the bulb ends by its duration
+bool CameraControl_Post(CameraEventType_t type, uint32_t duration_InMS)
+{
+    if((type == CAMERA_EVENT_SHUTTER_PRESS) || (type == CAMERA_EVENT_BULB_START))
+    {
+        SliderSim_Shot(false, duration_InMS);
+    }
+    if(type == CAMERA_EVENT_BULB_START)
+    {
+        lastBulb_InUS = duration_InMS * 1000;
+    }
+
+    return true;
+}
+
+bool CameraControl_IsExposing()
+{
+    return ((int32_t)(exposureEnd_InUS - MockArduino_GetMicros()) > 0);
+}
+
+uint32_t CameraControl_GetLastBulb()
+{
+    return lastBulb_InUS;
+}
+
+void CameraControl_Focus()
+{
+}
+
+void CameraControl_AttachTrigger(bool attach)
+{
+}
+
+// From the step interrupt, while the HAL runs a slice. The carriage already took the step.
+void CameraControl_TriggerShutterFromISR()
+{
+    SliderSim_Shot(true, CAMERA_TRIGGER_PULSE_US / 1000);
+}
+
+uint32_t CameraControl_GetTriggerShots()
+{
+    uint32_t count = 0;
+
+    for(size_t i = 0; i < shots.size(); i++)
+    {
+        count += shots[i].bTriggered ? 1 : 0;
+    }
+
+    return count;
+}
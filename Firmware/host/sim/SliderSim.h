@@ -0,0 +1,97 @@
+/*
+Slider simulator
+Description: Runs the motion code of the firmware (DIY_CameraSlider_MotorControl.cpp,
+FlexyStepper and the StepEngine) on the host against the mock Arduino core.
+The motion task and the step interrupt are played in virtual time, so a move
+of a minute takes milliseconds to simulate. Every GPIO edge is recorded, the
+carriage follows the slide motor steps and presses the endstops at both ends
+of the rail. The pan can have a home switch or a mechanical stop, like the pan
+homing modes of the firmware (PAN_HOMING_MODE).
+
+Firmware parts that need FreeRTOS (tasks, camera control) are replaced by
+stand-ins here, shutter releases are only counted and logged with the time and
+carriage position they happened at. The camera counts as exposing for the
+shutter pulse or bulb time after a shot.
+*/
+
+#ifndef __SLIDER_SIM__
+#define __SLIDER_SIM__
+
+#include <Arduino.h>
+#include <vector>
+#include "SliderConfig.h"
+
+// Virtual time between HAL slices, endstop inputs change at the end of a slice
+// like an interrupt that comes in right after the step interrupt
+#define SLIDER_SIM_SLICE_US         20
+#define SLIDER_SIM_PULSE_WIDTH_US   2       // Same as the ESP32 HAL
+#define SLIDER_SIM_MIN_ALARM_LEAD_US 5      // Same as the ESP32 HAL
+
+typedef struct
+{
+    uint32_t time_InUS;
+    uint8_t pin;
+    uint8_t level;
+} SliderSimEdge_t;
+
+typedef struct
+{
+    uint32_t time_InUS;
+    float carriage_InMM;
+    uint32_t duration_InMS;         // Shutter pulse or bulb time
+    bool bTriggered;                // Position trigger from the step interrupt, not a shot of the camera task
+} SliderSimShot_t;
+
+typedef enum
+{
+    SLIDER_SIM_PAN_FREE,            // Turns without limits
+    SLIDER_SIM_PAN_SWITCH,          // Home switch on PIN_HOME_SWITCH_PAN, pressed from the home angle on
+    SLIDER_SIM_PAN_HARD_STOP        // Mechanical stop at the home angle, steps into it are lost
+} SliderSimPanHome_t;
+
+typedef struct
+{
+    uint64_t alarmCycles;           // Spent in the step interrupt handler
+    uint64_t refillCycles;          // Spent planning steps
+    uint32_t alarms;
+    uint32_t refills;
+} SliderSimProfile_t;
+
+// Power up: default config, setupMotors() and motors enabled. Can be called
+// again to start over, motors stop and the time goes back to 0.
+//      - carriagePos_InMM  -> where the carriage really is on the rail, the firmware starts at 0
+void SliderSim_Begin(float carriagePos_InMM);
+
+// Run the motion task and the step interrupt for duration_InUS of virtual time
+void SliderSim_Run(uint32_t duration_InUS);
+
+// Run until the slider enters state (or timeout_InUS passes), false on timeout
+bool SliderSim_RunUntilState(sliderState_t state, uint32_t timeout_InUS);
+
+// Run until the step engine has emitted every planned step, false on timeout
+bool SliderSim_RunUntilMotionComplete(uint32_t timeout_InUS);
+
+uint32_t SliderSim_Now(void);
+
+// Steps counted from the step and direction pins of each axis
+long SliderSim_GetStepCount(uint8_t axis);
+float SliderSim_GetCarriagePos(void);
+uint32_t SliderSim_GetShutterCount(void);
+
+// Pan mechanics, SLIDER_SIM_PAN_FREE after SliderSim_Begin(). Angles are in the direction
+// the pan motor steps, counted from where the pan stood at SliderSim_Begin(), the switch
+// or stop is at home_InDeg and in the way of PAN_HOMING_DIRECTION.
+void SliderSim_SetPanHome(SliderSimPanHome_t type, float home_InDeg);
+float SliderSim_GetPanPos(void);
+const std::vector<SliderSimShot_t> &SliderSim_GetShots(void);
+
+// Recorded GPIO edges, recording costs memory on long runs
+void SliderSim_RecordEdges(bool record);
+const std::vector<SliderSimEdge_t> &SliderSim_GetEdges(void);
+void SliderSim_ClearEdges(void);
+
+// CPU cycles spent in the step engine handlers, 0 without a cycle counter
+const SliderSimProfile_t &SliderSim_GetProfile(void);
+void SliderSim_ClearProfile(void);
+
+#endif
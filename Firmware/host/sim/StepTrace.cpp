@@ -0,0 +1,136 @@
+/*
+Step trace
+Description: Reading and writing step trace files (see StepTrace.h)
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "StepTrace.h"
+
+static const char traceMagic[4] = {'S', 'T', 'R', 'C'};
+
+static void writeVarint(FILE *pFile, uint64_t value)
+{
+    while(value >= 0x80)
+    {
+        fputc((int)(value & 0x7F) | 0x80, pFile);
+        value >>= 7;
+    }
+    fputc((int)value, pFile);
+}
+
+static bool readVarint(FILE *pFile, uint64_t *pValue)
+{
+    uint64_t value = 0;
+    int shift = 0;
+    int c;
+
+    do
+    {
+        c = fgetc(pFile);
+        if((c == EOF) || (shift > 63))
+        {
+            return false;
+        }
+        value |= (uint64_t)(c & 0x7F) << shift;
+        shift += 7;
+    } while(c & 0x80);
+
+    *pValue = value;
+    return true;
+}
+
+bool StepTrace_Save(const char *pPath, const std::vector<StepTraceStep_t> &steps)
+{
+    uint8_t header[12] = {0};
+    uint32_t count = steps.size();
+    uint32_t lastTime_InUS[STEP_TRACE_MAX_AXES] = {0};
+    int64_t lastDelta_InUS[STEP_TRACE_MAX_AXES] = {0};
+    int64_t delta_InUS;
+    int64_t change_InUS;
+    uint64_t zigzag;
+    FILE *pFile;
+
+    pFile = fopen(pPath, "wb");
+    if(pFile == NULL)
+    {
+        return false;
+    }
+
+    memcpy(header, traceMagic, sizeof(traceMagic));
+    header[4] = STEP_TRACE_VERSION;
+    header[8] = count & 0xFF;
+    header[9] = (count >> 8) & 0xFF;
+    header[10] = (count >> 16) & 0xFF;
+    header[11] = (count >> 24) & 0xFF;
+    fwrite(header, 1, sizeof(header), pFile);
+
+    for(size_t i = 0; i < steps.size(); i++)
+    {
+        uint8_t axis = steps[i].axis % STEP_TRACE_MAX_AXES;
+
+        delta_InUS = (int64_t)steps[i].time_InUS - lastTime_InUS[axis];
+        change_InUS = delta_InUS - lastDelta_InUS[axis];
+        zigzag = (change_InUS < 0) ? ((uint64_t)(-change_InUS) * 2 - 1) : ((uint64_t)change_InUS * 2);
+
+        writeVarint(pFile, (zigzag << 3) | ((steps[i].negative ? 1 : 0) << 2) | axis);
+
+        lastTime_InUS[axis] = steps[i].time_InUS;
+        lastDelta_InUS[axis] = delta_InUS;
+    }
+
+    return (fclose(pFile) == 0);
+}
+
+bool StepTrace_Load(const char *pPath, std::vector<StepTraceStep_t> *pSteps)
+{
+    uint8_t header[12];
+    uint32_t count;
+    int64_t lastTime_InUS[STEP_TRACE_MAX_AXES] = {0};
+    int64_t lastDelta_InUS[STEP_TRACE_MAX_AXES] = {0};
+    int64_t change_InUS;
+    uint64_t value = 0;
+    uint64_t zigzag;
+    StepTraceStep_t step;
+    FILE *pFile;
+    bool ok = true;
+
+    pSteps->clear();
+
+    pFile = fopen(pPath, "rb");
+    if(pFile == NULL)
+    {
+        return false;
+    }
+
+    if((fread(header, 1, sizeof(header), pFile) != sizeof(header)) ||
+       (memcmp(header, traceMagic, sizeof(traceMagic)) != 0) ||
+       (header[4] != STEP_TRACE_VERSION))
+    {
+        fclose(pFile);
+        return false;
+    }
+
+    count = header[8] | (header[9] << 8) | (header[10] << 16) | ((uint32_t)header[11] << 24);
+    pSteps->reserve(count);
+
+    for(uint32_t i = 0; (i < count) && ok; i++)
+    {
+        ok = readVarint(pFile, &value);
+
+        step.axis = value & 0x03;
+        step.negative = (value >> 2) & 1;
+        zigzag = value >> 3;
+        change_InUS = (zigzag & 1) ? -(int64_t)((zigzag + 1) / 2) : (int64_t)(zigzag / 2);
+
+        lastDelta_InUS[step.axis] += change_InUS;
+        lastTime_InUS[step.axis] += lastDelta_InUS[step.axis];
+        step.time_InUS = (uint32_t)lastTime_InUS[step.axis];
+
+        pSteps->push_back(step);
+    }
+
+    fclose(pFile);
+
+    return ok;
+}
@@ -0,0 +1,38 @@
+/*
+Step trace
+Description: Compact binary recording of the steps of a move, to compare step
+timing between firmware versions (see host/trace_check.cpp).
+
+File layout, all numbers little endian:
+    "STRC"              magic
+    uint8               version (STEP_TRACE_VERSION)
+    uint8[3]            reserved, 0
+    uint32              number of steps
+    varint[]            one per step, in the order the steps were emitted
+
+Every step is stored as the change of the time since the previous step of the
+same axis (delta of delta, zigzag coded), shifted left by 3, with the direction
+in bit 2 and the axis in bits 0..1. While an axis cruises that is 0 and the
+step takes a single byte.
+*/
+
+#ifndef __STEP_TRACE__
+#define __STEP_TRACE__
+
+#include <stdint.h>
+#include <vector>
+
+#define STEP_TRACE_VERSION      1
+#define STEP_TRACE_MAX_AXES     4
+
+typedef struct
+{
+    uint32_t time_InUS;         // Since the start of the trace
+    uint8_t axis;
+    uint8_t negative;           // 1 for a step in the negative direction
+} StepTraceStep_t;
+
+bool StepTrace_Save(const char *pPath, const std::vector<StepTraceStep_t> &steps);
+bool StepTrace_Load(const char *pPath, std::vector<StepTraceStep_t> *pSteps);
+
+#endif
@@ -0,0 +1,105 @@
+/*
+Telemetry decoder
+Description: Reading binary telemetry messages (see TelemetryDecoder.h)
+*/
+
+#include "TelemetryDecoder.h"
+
+void TelemetryDecoder_Init(TelemetryDecoder_t *pDecoder)
+{
+    pDecoder->bSynced = false;
+    pDecoder->nextSequence = 0;
+    pDecoder->slide_InSteps = 0;
+    pDecoder->pan_InSteps = 0;
+    pDecoder->frames = 0;
+    pDecoder->lost = 0;
+    pDecoder->errors = 0;
+}
+
+// Reads the varints of one frame, returns the bytes used or 0 if the frame is cut short
+static int readValues(const uint8_t *pData, int size, int32_t *pValues, int count)
+{
+    int pos = 0;
+    int len;
+
+    for(int i = 0; i < count; i++)
+    {
+        len = Telemetry_GetVarint(&pData[pos], size - pos, &pValues[i]);
+        if(len == 0)
+        {
+            return 0;
+        }
+        pos += len;
+    }
+
+    return pos;
+}
+
+bool TelemetryDecoder_Decode(TelemetryDecoder_t *pDecoder, const uint8_t *pData, size_t len, std::vector<TelemetryFrame_t> *pFrames)
+{
+    TelemetryFrame_t frame;
+    int32_t values[4];
+    size_t pos = 0;
+    int used;
+
+    while(pos < len)
+    {
+        if(((len - pos) < TELEMETRY_HEADER_SIZE) || (pData[pos] != TELEMETRY_MAGIC))
+        {
+            break;
+        }
+
+        frame.flags = pData[pos + 1];
+        frame.sequence = pData[pos + 2] | (pData[pos + 3] << 8);
+        frame.time_InUS = pData[pos + 4] | (pData[pos + 5] << 8) | (pData[pos + 6] << 16) | ((uint32_t)pData[pos + 7] << 24);
+        frame.state = pData[pos + 8];
+
+        used = readValues(&pData[pos + TELEMETRY_HEADER_SIZE], len - pos - TELEMETRY_HEADER_SIZE, values, 4);
+        if(used == 0)
+        {
+            break;
+        }
+        pos += TELEMETRY_HEADER_SIZE + used;
+
+        if(frame.flags & TELEMETRY_FLAG_KEY)
+        {
+            frame.slide_InSteps = values[0];
+            frame.pan_InSteps = values[1];
+        }
+        else if(pDecoder->bSynced && (frame.sequence == pDecoder->nextSequence))
+        {
+            frame.slide_InSteps = pDecoder->slide_InSteps + values[0];
+            frame.pan_InSteps = pDecoder->pan_InSteps + values[1];
+        }
+        else
+        {
+            // Delta against a frame we never got, wait for the next key frame
+            pDecoder->bSynced = false;
+            continue;
+        }
+        frame.slideVelocity_InStepsPerSecond = values[2];
+        frame.panVelocity_InStepsPerSecond = values[3];
+
+        if(pDecoder->frames > 0)
+        {
+            pDecoder->lost += (uint16_t)(frame.sequence - pDecoder->nextSequence);
+        }
+
+        pDecoder->bSynced = true;
+        pDecoder->nextSequence = frame.sequence + 1;
+        pDecoder->slide_InSteps = frame.slide_InSteps;
+        pDecoder->pan_InSteps = frame.pan_InSteps;
+        pDecoder->frames++;
+
+        pFrames->push_back(frame);
+    }
+
+    if(pos < len)
+    {
+        pDecoder->errors++;
+        pDecoder->bSynced = false;
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,36 @@
+/*
+Telemetry decoder
+Description: Reads the binary telemetry the slider sends over the WebSocket at /telemetry
+(frame layout in src/TelemetryFrame.h), for monitoring tools on the host.
+
+Feed it every message in the order they came in. It keeps the positions of the last frame to
+undo the delta encoding, counts frames that went missing (sequence gaps) and messages it could
+not read. After a lost or broken message it picks up again at the key frame of the next one.
+*/
+
+#ifndef __TELEMETRY_DECODER__
+#define __TELEMETRY_DECODER__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include "TelemetryFrame.h"
+
+typedef struct
+{
+    bool bSynced;               // Positions of the last frame are known
+    uint16_t nextSequence;
+    int32_t slide_InSteps;
+    int32_t pan_InSteps;
+    uint32_t frames;            // Decoded
+    uint32_t lost;              // Missing from the sequence numbers
+    uint32_t errors;            // Messages, or the rest of them, that could not be read
+} TelemetryDecoder_t;
+
+void TelemetryDecoder_Init(TelemetryDecoder_t *pDecoder);
+
+// Decodes all frames of one message and appends them to pFrames, returns false if
+// (part of) the message could not be read. Frames before the broken one are kept.
+bool TelemetryDecoder_Decode(TelemetryDecoder_t *pDecoder, const uint8_t *pData, size_t len, std::vector<TelemetryFrame_t> *pFrames);
+
+#endif
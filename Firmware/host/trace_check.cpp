@@ -0,0 +1,327 @@
+/*
+Step trace check
+Description: Runs a set of canonical moves in the slider simulator (host/sim)
+and compares their steps against the golden traces in host/traces. For every
+move it checks
+    - step count and end position of each axis, these have to match exactly
+    - time of every step, against the same step in the golden trace
+    - duration, from the start of the move to the last step
+    - smoothness, the largest velocity change from one step to the next
+
+Any change to the step planning (i.e. DeterminePeriodOfNextStep()) or to the
+slider state machine shows up here before it reaches the slider. When a change
+is meant to alter the step timing, check the numbers and record new golden
+traces with --update.
+
+Build and run with: pio run -e trace_check -t exec
+Record golden traces: .pio/build/trace_check/program --update
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include "SliderSim.h"
+#include "StepTrace.h"
+#include "DIY_CameraSlider_MotorControl.h"
+
+#define TRACE_CHECK_DIR                 "host/traces"
+#define TRACE_CHECK_TIMEOUT_US          300000000
+#define TRACE_CHECK_DURATION_ERROR_US   1000    // Difference in move duration
+#define TRACE_CHECK_SMOOTHNESS_ERROR    1.0     // %, more velocity change than the golden trace
+#define TRACE_CHECK_STANDSTILL_US       100000  // Longer step periods start from standstill, no smoothness there
+
+typedef struct
+{
+    const char *name;
+    void (*run)(void);
+    uint32_t maxTimeError_InUS;     // Of any step against the golden trace
+} TraceCheckMove_t;
+
+typedef struct
+{
+    long steps[STEP_TRACE_MAX_AXES];
+    long position[STEP_TRACE_MAX_AXES];
+    uint32_t duration_InUS;
+    double smoothness;              // Largest step to step velocity change, in % of the top speed
+} TraceCheckStats_t;
+
+// Short jog with the default profile
+static void moveJog(void)
+{
+    SliderSim_Begin(100.0);
+    CameraSlider_MoveToPositionAbsolute(5.0, 10.0, 60.0, 0.0, 30.0, 60.0, false);
+    SliderSim_RunUntilMotionComplete(TRACE_CHECK_TIMEOUT_US);
+}
+
+// Timed move between start and end position over almost the whole rail
+static void moveFullRail(void)
+{
+    SliderSim_Begin(5.0);
+    CameraSlider_SetStartPosition(0.0, 0.0);
+    CameraSlider_SetEndPosition(SliderConfig.Config.rail_length - 10.0, 0.0);
+    CameraSlider_SetDuration(20);
+    CameraSlider_StartMotion();
+    SliderSim_RunUntilState(SLIDER_READY, TRACE_CHECK_TIMEOUT_US);
+}
+
+static void movePan(void)
+{
+    SliderSim_Begin(100.0);
+    CameraSlider_MoveToPositionRelative(0.0, 10.0, 60.0, 90.0, 30.0, 60.0, false);
+    SliderSim_RunUntilMotionComplete(TRACE_CHECK_TIMEOUT_US);
+}
+
+// New target behind the carriage while it is still moving
+static void moveReversal(void)
+{
+    SliderSim_Begin(5.0);
+    CameraSlider_MoveToPositionAbsolute(200.0, 20.0, 60.0, 0.0, 30.0, 60.0, false);
+    SliderSim_Run(3000000);
+    CameraSlider_MoveToPositionAbsolute(50.0, 20.0, 60.0, 0.0, 30.0, 60.0, false);
+    SliderSim_RunUntilMotionComplete(TRACE_CHECK_TIMEOUT_US);
+}
+
+static void moveHoming(void)
+{
+    SliderSim_Begin(40.0);
+    CameraSlider_SetState(SLIDER_HOMING);
+    SliderSim_RunUntilState(SLIDER_MOTORS_OFF, TRACE_CHECK_TIMEOUT_US);
+}
+
+static const TraceCheckMove_t traceMoves[] =
+{
+    {"jog",         moveJog,        20},
+    {"full_rail",   moveFullRail,   20},
+    {"pan",         movePan,        20},
+    {"reversal",    moveReversal,   20},
+    {"homing",      moveHoming,     20},
+};
+
+// Steps of both motors out of the recorded GPIO edges
+static void collectSteps(std::vector<StepTraceStep_t> *pSteps)
+{
+    const std::vector<SliderSimEdge_t> &edges = SliderSim_GetEdges();
+    const uint8_t stepPin[] = {PIN_MOTOR_X_STEP, PIN_MOTOR_Z_STEP};
+    const uint8_t directionPin[] = {PIN_MOTOR_X_DIR, PIN_MOTOR_Z_DIR};
+    uint8_t direction[] = {LOW, LOW};
+    StepTraceStep_t step;
+
+    pSteps->clear();
+
+    for(size_t i = 0; i < edges.size(); i++)
+    {
+        for(uint8_t axis = SLIDER_AXIS_SLIDE; axis <= SLIDER_AXIS_PAN; axis++)
+        {
+            if(edges[i].pin == directionPin[axis])
+            {
+                direction[axis] = edges[i].level;
+            }
+            else if((edges[i].pin == stepPin[axis]) && (edges[i].level == HIGH))
+            {
+                step.time_InUS = edges[i].time_InUS;
+                step.axis = axis;
+                step.negative = (direction[axis] == HIGH) ? 1 : 0;
+                pSteps->push_back(step);
+            }
+        }
+    }
+}
+
+static void getStats(const std::vector<StepTraceStep_t> &steps, TraceCheckStats_t *pStats)
+{
+    uint32_t lastTime_InUS[STEP_TRACE_MAX_AXES] = {0};
+    double lastPeriod_InUS[STEP_TRACE_MAX_AXES] = {0};
+    int lastDirection[STEP_TRACE_MAX_AXES] = {0};
+    double peakVelocity[STEP_TRACE_MAX_AXES] = {0};
+    long count[STEP_TRACE_MAX_AXES] = {0};
+    double period_InUS;
+    double change;
+    int direction;
+
+    memset(pStats, 0, sizeof(TraceCheckStats_t));
+
+    // Step counts, end position and top speed of each axis
+    for(size_t i = 0; i < steps.size(); i++)
+    {
+        uint8_t axis = steps[i].axis;
+
+        pStats->steps[axis]++;
+        pStats->position[axis] += steps[i].negative ? -1 : 1;
+        pStats->duration_InUS = steps[i].time_InUS;
+
+        if((pStats->steps[axis] > 1) && (steps[i].time_InUS > lastTime_InUS[axis]))
+        {
+            peakVelocity[axis] = fmax(peakVelocity[axis], 1E6 / (steps[i].time_InUS - lastTime_InUS[axis]));
+        }
+        lastTime_InUS[axis] = steps[i].time_InUS;
+    }
+
+    // Velocity change between one step and the next, while the axis keeps
+    // moving the same way, in % of its top speed
+    for(size_t i = 0; i < steps.size(); i++)
+    {
+        uint8_t axis = steps[i].axis;
+
+        direction = steps[i].negative ? -1 : 1;
+        count[axis]++;
+        period_InUS = (count[axis] > 1) ? (double)(steps[i].time_InUS - lastTime_InUS[axis]) : 0.0;
+
+        if((period_InUS > 0.0) && (period_InUS < TRACE_CHECK_STANDSTILL_US) &&
+           (lastPeriod_InUS[axis] > 0.0) && (lastPeriod_InUS[axis] < TRACE_CHECK_STANDSTILL_US) &&
+           (direction == lastDirection[axis]))
+        {
+            change = 100.0 * fabs(1E6 / period_InUS - 1E6 / lastPeriod_InUS[axis]) / peakVelocity[axis];
+            pStats->smoothness = fmax(pStats->smoothness, change);
+        }
+
+        lastTime_InUS[axis] = steps[i].time_InUS;
+        lastPeriod_InUS[axis] = period_InUS;
+        lastDirection[axis] = direction;
+    }
+}
+
+// Largest time difference between the same steps of both traces
+static uint32_t maxTimeError(const std::vector<StepTraceStep_t> &steps, const std::vector<StepTraceStep_t> &golden)
+{
+    std::vector<uint32_t> stepTimes[STEP_TRACE_MAX_AXES];
+    std::vector<uint32_t> goldenTimes[STEP_TRACE_MAX_AXES];
+    uint32_t maxError = 0;
+    uint32_t error;
+
+    for(size_t i = 0; i < steps.size(); i++)
+    {
+        stepTimes[steps[i].axis].push_back(steps[i].time_InUS);
+    }
+
+    for(size_t i = 0; i < golden.size(); i++)
+    {
+        goldenTimes[golden[i].axis].push_back(golden[i].time_InUS);
+    }
+
+    for(uint8_t axis = 0; axis < STEP_TRACE_MAX_AXES; axis++)
+    {
+        for(size_t i = 0; (i < stepTimes[axis].size()) && (i < goldenTimes[axis].size()); i++)
+        {
+            error = (stepTimes[axis][i] > goldenTimes[axis][i]) ? (stepTimes[axis][i] - goldenTimes[axis][i]) : (goldenTimes[axis][i] - stepTimes[axis][i]);
+            if(error > maxError)
+            {
+                maxError = error;
+            }
+        }
+    }
+
+    return maxError;
+}
+
+static bool checkMove(const TraceCheckMove_t &move, const std::vector<StepTraceStep_t> &steps, const std::vector<StepTraceStep_t> &golden)
+{
+    TraceCheckStats_t stats;
+    TraceCheckStats_t goldenStats;
+    uint32_t timeError;
+    int32_t durationError;
+    bool ok = true;
+
+    getStats(steps, &stats);
+    getStats(golden, &goldenStats);
+    timeError = maxTimeError(steps, golden);
+    durationError = (int32_t)(stats.duration_InUS - goldenStats.duration_InUS);
+
+    for(uint8_t axis = 0; axis < STEP_TRACE_MAX_AXES; axis++)
+    {
+        if((stats.steps[axis] != goldenStats.steps[axis]) || (stats.position[axis] != goldenStats.position[axis]))
+        {
+            ok = false;
+        }
+    }
+
+    if((timeError > move.maxTimeError_InUS) ||
+       (abs(durationError) > TRACE_CHECK_DURATION_ERROR_US) ||
+       (stats.smoothness > goldenStats.smoothness + TRACE_CHECK_SMOOTHNESS_ERROR))
+    {
+        ok = false;
+    }
+
+    printf("  %-10s | %7ld %7ld | %7ld %7ld | %10.3f %+8d | %8u | %7.2f %7.2f | %s\n", move.name,
+           stats.steps[SLIDER_AXIS_SLIDE], goldenStats.steps[SLIDER_AXIS_SLIDE],
+           stats.steps[SLIDER_AXIS_PAN], goldenStats.steps[SLIDER_AXIS_PAN],
+           stats.duration_InUS / 1E6, durationError, timeError,
+           stats.smoothness, goldenStats.smoothness, ok ? "ok" : "FAIL");
+
+    return ok;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *pDir = TRACE_CHECK_DIR;
+    bool update = false;
+    std::vector<StepTraceStep_t> steps;
+    std::vector<StepTraceStep_t> golden;
+    char path[256];
+    int failed = 0;
+
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "--update") == 0)
+        {
+            update = true;
+        }
+        else if((strcmp(argv[i], "--dir") == 0) && (i + 1 < argc))
+        {
+            pDir = argv[++i];
+        }
+        else
+        {
+            printf("Usage: %s [--update] [--dir <golden trace folder>]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    if(!update)
+    {
+        printf("  %-10s | %15s | %15s | %19s | %8s | %15s |\n", "", "slide steps", "pan steps", "duration", "step", "max dV %");
+        printf("  %-10s | %7s %7s | %7s %7s | %10s %8s | %8s | %7s %7s |\n", "move", "sim", "golden", "sim", "golden", "sim s", "dT us", "dT us", "sim", "golden");
+    }
+
+    for(size_t i = 0; i < sizeof(traceMoves) / sizeof(traceMoves[0]); i++)
+    {
+        snprintf(path, sizeof(path), "%s/%s.trace", pDir, traceMoves[i].name);
+
+        traceMoves[i].run();
+        collectSteps(&steps);
+
+        if(update)
+        {
+            if(StepTrace_Save(path, steps))
+            {
+                printf("  %-10s | %7zu steps -> %s\n", traceMoves[i].name, steps.size(), path);
+            }
+            else
+            {
+                printf("  %-10s | could not write %s\n", traceMoves[i].name, path);
+                failed++;
+            }
+            continue;
+        }
+
+        if(!StepTrace_Load(path, &golden))
+        {
+            printf("  %-10s | no golden trace %s, record it with --update\n", traceMoves[i].name, path);
+            failed++;
+            continue;
+        }
+
+        if(!checkMove(traceMoves[i], steps, golden))
+        {
+            failed++;
+        }
+    }
+
+    if(failed)
+    {
+        printf("\n%d of %zu moves failed\n", failed, sizeof(traceMoves) / sizeof(traceMoves[0]));
+        return 1;
+    }
+
+    return 0;
+}
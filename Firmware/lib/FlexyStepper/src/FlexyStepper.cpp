@@ -62,6 +62,11 @@
 // less linear.  This is likely to only be a problem when coordinating multiple 
 // axis that all need to start and finish motions precisely at the same time.
 //
+// The ramp math is done by a ramp generator that the stepper class is templated 
+// on (see FlexyStepperRamp.h for the ones available).  FlexyStepper uses the 
+// default ramp generator, to pick another one declare the stepper as:
+//        FlexyStepperT<FlexyRampAvr446> stepper1;
+//
 //
 // Usage:
 //    Near the top of the program, add:
@@ -209,7 +214,8 @@
 //
 // constructor for the stepper class
 //
-FlexyStepper::FlexyStepper()
+template <class RampGenerator>
+FlexyStepperT<RampGenerator>::FlexyStepperT()
 {
   //
   // initialize constants
@@ -222,7 +228,7 @@ FlexyStepper::FlexyStepper()
   setSpeedInStepsPerSecond(200);
   setAccelerationInStepsPerSecondPerSecond(200.0);
   currentStepPeriod_InUS = 0.0;
-  nextStepPeriod_InUS = 0.0;
+  ramp.stop();
 }
 
 
@@ -235,7 +241,8 @@ FlexyStepper::FlexyStepper()
 //          enablePinNumber = IO pin number for the enable bit (LOW is enabled)
 //            set to 0 if enable is not supported
 //
-void FlexyStepper::connectToPins(byte stepPinNumber, byte directionPinNumber)
+template <class RampGenerator>
+void FlexyStepperT<RampGenerator>::connectToPins(byte stepPinNumber, byte directionPinNumber)
 {
   //
   // remember the pin numbers
@@ -262,7 +269,8 @@ void FlexyStepper::connectToPins(byte stepPinNumber, byte directionPinNumber)
 //
 // set the number of steps the motor has per millimeters
 //
-void FlexyStepper::setStepsPerMillimeter(float motorStepsPerMillimeter)
+template <class RampGenerator>
+void FlexyStepperT<RampGenerator>::setStepsPerMillimeter(float motorStepsPerMillimeter)
 {
   stepsPerMillimeter = motorStepsPerMillimeter;
 }
@@ -274,7 +282,8 @@ void FlexyStepper::setStepsPerMillimeter(float motorStepsPerMillimeter)
 // while the motor moves
 //  Exit:  a signed motor position in millimeters returned
 //
-float FlexyStepper::getCurrentPositionInMillimeters()
+template <class RampGenerator>
+float FlexyStepperT<RampGenerator>::getCurrentPositionInMillimeters()
 {
   return((float)getCurrentPositionInSteps() / stepsPerMillimeter);
 }
@@ -285,7 +294,8 @@ float FlexyStepper::getCurrentPositionInMillimeters()
 // set the current position of the motor in millimeters, this does not move the 
 // motor
 //
-void FlexyStepper::setCurrentPositionInMillimeters(
+template <class RampGenerator>
+void FlexyStepperT<RampGenerator>::setCurrentPositionInMillimeters(
                    float currentPositionInMillimeters)
 {
   setCurrentPositionInSteps((long) round(currentPositionInMillimeters * 
@@ -300,7 +310,8 @@ void FlexyStepper::setCurrentPositionInMillimeters(
 //  Enter:  speedInMillimetersPerSecond = speed to accelerate up to, units in 
 //            millimeters/second
 //
-void FlexyStepper::setSpeedInMillimetersPerSecond(float speedInMillimetersPerSecond)
+template <class RampGenerator>
+void FlexyStepperT<RampGenerator>::setSpeedInMillimetersPerSecond(float speedInMillimetersPerSecond)
 {
   setSpeedInStepsPerSecond(speedInMillimetersPerSecond * stepsPerMillimeter);
 }
@@ -312,7 +323,8 @@ void FlexyStepper::setSpeedInMillimetersPerSecond(float speedInMillimetersPerSec
 //  Enter:  accelerationInMillimetersPerSecondPerSecond = rate of acceleration,  
 //          units in millimeters/second/second
 //
-void FlexyStepper::setAccelerationInMillimetersPerSecondPerSecond(
+template <class RampGenerator>
+void FlexyStepperT<RampGenerator>::setAccelerationInMillimetersPerSecondPerSecond(
                       float accelerationInMillimetersPerSecondPerSecond)
 {
     setAccelerationInStepsPerSecondPerSecond(
@@ -321,6 +333,22 @@ void FlexyStepper::setAccelerationInMillimetersPerSecondPerSecond(
 
 
 
+//
+// set the jerk, the rate the acceleration changes at, units in 
+// millimeters/second/second/second, 0 for a trapezoidal profile
+//  Enter:  jerkInMillimetersPerSecondPerSecondPerSecond = rate of change of 
+//          acceleration, units in millimeters/second/second/second
+//
+template <class RampGenerator>
+void FlexyStepperT<RampGenerator>::setJerkInMillimetersPerSecondPerSecondPerSecond(
+                      float jerkInMillimetersPerSecondPerSecondPerSecond)
+{
+    setJerkInStepsPerSecondPerSecondPerSecond(
+      jerkInMillimetersPerSecondPerSecondPerSecond * stepsPerMillimeter);
+}
+
+
+
 //
 // home the motor by moving until the homing sensor is activated, then set the  
 // position to zero, with units in millimeters
@@ -334,7 +362,8 @@ void FlexyStepper::setAccelerationInMillimetersPerSecondPerSecond(
 //            configured to go low when at home
 //  Exit:   true returned if successful, else false
 //
-bool FlexyStepper::moveToHomeInMillimeters(long directionTowardHome,  
+template <class RampGenerator>
+bool FlexyStepperT<RampGenerator>::moveToHomeInMillimeters(long directionTowardHome,  
   float speedInMillimetersPerSecond, long maxDistanceToMoveInMillimeters, 
   int homeLimitSwitchPin, int limitSwitchTriggerState)
 {
@@ -352,7 +381,8 @@ bool FlexyStepper::moveToHomeInMillimeters(long directionTowardHome,
 //  Enter:  distanceToMoveInMillimeters = signed distance to move relative to the  
 //          current position in millimeters
 //
-void FlexyStepper::moveRelativeInMillimeters(float distanceToMoveInMillimeters)
+template <class RampGenerator>
+void FlexyStepperT<RampGenerator>::moveRelativeInMillimeters(float distanceToMoveInMillimeters)
 {
   setTargetPositionRelativeInMillimeters(distanceToMoveInMillimeters);
   
@@ -368,7 +398,8 @@ void FlexyStepper::moveRelativeInMillimeters(float distanceToMoveInMillimeters)
 //  Enter:  distanceToMoveInMillimeters = signed distance to move relative to the  
 //          current position in millimeters
 //
-void FlexyStepper::setTargetPositionRelativeInMillimeters(
+template <class RampGenerator>
+void FlexyStepperT<RampGenerator>::setTargetPositionRelativeInMillimeters(
                      float distanceToMoveInMillimeters)
 {
   setTargetPositionRelativeInSteps((long) round(distanceToMoveInMillimeters * 
@@ -383,7 +414,8 @@ void FlexyStepper::setTargetPositionRelativeInMillimeters(
 //  Enter:  absolutePositionToMoveToInMillimeters = signed absolute position to  
 //          move to in units of millimeters
 //
-void FlexyStepper::moveToPositionInMillimeters(
+template <class RampGenerator>
+void FlexyStepperT<RampGenerator>::moveToPositionInMillimeters(
                     float absolutePositionToMoveToInMillimeters)
 {
   setTargetPositionInMillimeters(absolutePositionToMoveToInMillimeters);
@@ -400,7 +432,8 @@ void FlexyStepper::moveToPositionInMillimeters(
 //  Enter:  absolutePositionToMoveToInMillimeters = signed absolute position to  
 //          move to in units of millimeters
 //
-void FlexyStepper::setTargetPositionInMillimeters(
+template <class RampGenerator>
+void FlexyStepperT<RampGenerator>::setTargetPositionInMillimeters(
                     float absolutePositionToMoveToInMillimeters)
 {
  setTargetPositionInSteps((long) round(absolutePositionToMoveToInMillimeters * 
@@ -419,7 +452,8 @@ void FlexyStepper::setTargetPositionInMillimeters(
 // great for the amount of torque that it can generate.
 //  Exit:  velocity speed in steps per second returned, signed
 //
-float FlexyStepper::getCurrentVelocityInMillimetersPerSecond()
+template <class RampGenerator>
+float FlexyStepperT<RampGenerator>::getCurrentVelocityInMillimetersPerSecond()
 {
   return(getCurrentVelocityInStepsPerSecond() / stepsPerMillimeter);
 }
@@ -433,7 +467,8 @@ float FlexyStepper::getCurrentVelocityInMillimetersPerSecond()
 //
 // set the number of steps the motor has per revolution
 //
-void FlexyStepper::setStepsPerRevolution(float motorStepPerRevolution)
+template <class RampGenerator>
+void FlexyStepperT<RampGenerator>::setStepsPerRevolution(float motorStepPerRevolution)
 {
   stepsPerRevolution = motorStepPerRevolution;
 }
@@ -445,7 +480,8 @@ void FlexyStepper::setStepsPerRevolution(float motorStepPerRevolution)
 // while the motor moves
 //  Exit:  a signed motor position in revolutions returned
 //
-float FlexyStepper::getCurrentPositionInRevolutions()
+template <class RampGenerator>
+float FlexyStepperT<RampGenerator>::getCurrentPositionInRevolutions()
 {
   return((float)getCurrentPositionInSteps() / stepsPerRevolution);
 }
@@ -456,7 +492,8 @@ float FlexyStepper::getCurrentPositionInRevolutions()
 // set the current position of the motor in revolutions, this does not move the 
 // motor
 //
-void FlexyStepper::setCurrentPositionInRevolutions(
+template <class RampGenerator>
+void FlexyStepperT<RampGenerator>::setCurrentPositionInRevolutions(
                      float currentPositionInRevolutions)
 {
   setCurrentPositionInSteps((long) round(currentPositionInRevolutions * 
@@ -471,7 +508,8 @@ void FlexyStepper::setCurrentPositionInRevolutions(
 //  Enter:  speedInRevolutionsPerSecond = speed to accelerate up to, units in 
 //            revolutions/second
 //
-void FlexyStepper::setSpeedInRevolutionsPerSecond(float speedInRevolutionsPerSecond)
+template <class RampGenerator>
+void FlexyStepperT<RampGenerator>::setSpeedInRevolutionsPerSecond(float speedInRevolutionsPerSecond)
 {
   setSpeedInStepsPerSecond(speedInRevolutionsPerSecond * stepsPerRevolution);
 }
@@ -483,7 +521,8 @@ void FlexyStepper::setSpeedInRevolutionsPerSecond(float speedInRevolutionsPerSec
 //  Enter:  accelerationInRevolutionsPerSecondPerSecond = rate of acceleration,  
 //          units in revolutions/second/second
 //
-void FlexyStepper::setAccelerationInRevolutionsPerSecondPerSecond(
+template <class RampGenerator>
+void FlexyStepperT<RampGenerator>::setAccelerationInRevolutionsPerSecondPerSecond(
        float accelerationInRevolutionsPerSecondPerSecond)
 {
     setAccelerationInStepsPerSecondPerSecond(
@@ -492,6 +531,22 @@ void FlexyStepper::setAccelerationInRevolutionsPerSecondPerSecond(
 
 
 
+//
+// set the jerk, the rate the acceleration changes at, units in 
+// revolutions/second/second/second, 0 for a trapezoidal profile
+//  Enter:  jerkInRevolutionsPerSecondPerSecondPerSecond = rate of change of 
+//          acceleration, units in revolutions/second/second/second
+//
+template <class RampGenerator>
+void FlexyStepperT<RampGenerator>::setJerkInRevolutionsPerSecondPerSecondPerSecond(
+       float jerkInRevolutionsPerSecondPerSecondPerSecond)
+{
+    setJerkInStepsPerSecondPerSecondPerSecond(
+      jerkInRevolutionsPerSecondPerSecondPerSecond * stepsPerRevolution);
+}
+
+
+
 //
 // home the motor by moving until the homing sensor is activated, then set the 
 //  position to zero, with units in revolutions
@@ -505,7 +560,8 @@ void FlexyStepper::setAccelerationInRevolutionsPerSecondPerSecond(
 //            configured to go low when at home
 //  Exit:   true returned if successful, else false
 //
-bool FlexyStepper::moveToHomeInRevolutions(long directionTowardHome,  
+template <class RampGenerator>
+bool FlexyStepperT<RampGenerator>::moveToHomeInRevolutions(long directionTowardHome,  
   float speedInRevolutionsPerSecond, long maxDistanceToMoveInRevolutions, 
   int homeLimitSwitchPin, int limitSwitchTriggerState)
 {
@@ -523,7 +579,8 @@ bool FlexyStepper::moveToHomeInRevolutions(long directionTowardHome,
 //  Enter:  distanceToMoveInRevolutions = signed distance to move relative to the  
 //          current position in revolutions
 //
-void FlexyStepper::moveRelativeInRevolutions(float distanceToMoveInRevolutions)
+template <class RampGenerator>
+void FlexyStepperT<RampGenerator>::moveRelativeInRevolutions(float distanceToMoveInRevolutions)
 {
   setTargetPositionRelativeInRevolutions(distanceToMoveInRevolutions);
   
@@ -539,7 +596,8 @@ void FlexyStepper::moveRelativeInRevolutions(float distanceToMoveInRevolutions)
 //  Enter:  distanceToMoveInRevolutions = signed distance to move relative to the  
 //            currentposition in revolutions
 //
-void FlexyStepper::setTargetPositionRelativeInRevolutions(
+template <class RampGenerator>
+void FlexyStepperT<RampGenerator>::setTargetPositionRelativeInRevolutions(
                      float distanceToMoveInRevolutions)
 {
   setTargetPositionRelativeInSteps((long) round(distanceToMoveInRevolutions * 
@@ -554,7 +612,8 @@ void FlexyStepper::setTargetPositionRelativeInRevolutions(
 //  Enter:  absolutePositionToMoveToInRevolutions = signed absolute position to 
 //            move to in units of revolutions
 //
-void FlexyStepper::moveToPositionInRevolutions(
+template <class RampGenerator>
+void FlexyStepperT<RampGenerator>::moveToPositionInRevolutions(
                     float absolutePositionToMoveToInRevolutions)
 {
   setTargetPositionInRevolutions(absolutePositionToMoveToInRevolutions);
@@ -571,7 +630,8 @@ void FlexyStepper::moveToPositionInRevolutions(
 //  Enter:  absolutePositionToMoveToInRevolutions = signed absolute position to  
 //          move to in units of revolutions
 //
-void FlexyStepper::setTargetPositionInRevolutions(
+template <class RampGenerator>
+void FlexyStepperT<RampGenerator>::setTargetPositionInRevolutions(
        float absolutePositionToMoveToInRevolutions)
 {
  setTargetPositionInSteps((long) round(absolutePositionToMoveToInRevolutions * 
@@ -590,7 +650,8 @@ void FlexyStepper::setTargetPositionInRevolutions(
 // great for the amount of torque that it can generate.
 //  Exit:  velocity speed in steps per second returned, signed
 //
-float FlexyStepper::getCurrentVelocityInRevolutionsPerSecond()
+template <class RampGenerator>
+float FlexyStepperT<RampGenerator>::getCurrentVelocityInRevolutionsPerSecond()
 {
   return(getCurrentVelocityInStepsPerSecond() / stepsPerRevolution);
 }
@@ -605,7 +666,8 @@ float FlexyStepper::getCurrentVelocityInRevolutionsPerSecond()
 // Note: This function should only be called when the motor is stopped
 //    Enter:  currentPositionInSteps = the new position of the motor in steps
 //
-void FlexyStepper::setCurrentPositionInSteps(long currentPositionInSteps)
+template <class RampGenerator>
+void FlexyStepperT<RampGenerator>::setCurrentPositionInSteps(long currentPositionInSteps)
 {
   currentPosition_InSteps = currentPositionInSteps;
 }
@@ -617,7 +679,8 @@ void FlexyStepper::setCurrentPositionInSteps(long currentPositionInSteps)
 // while the motor moves
 //  Exit:  a signed motor position in steps returned
 //
-long FlexyStepper::getCurrentPositionInSteps()
+template <class RampGenerator>
+long FlexyStepperT<RampGenerator>::getCurrentPositionInSteps()
 {
   return(currentPosition_InSteps);
 }
@@ -629,10 +692,10 @@ long FlexyStepper::getCurrentPositionInSteps()
 // while accelerating
 //  Enter:  speedInStepsPerSecond = speed to accelerate up to, units in steps/second
 //
-void FlexyStepper::setSpeedInStepsPerSecond(float speedInStepsPerSecond)
+template <class RampGenerator>
+void FlexyStepperT<RampGenerator>::setSpeedInStepsPerSecond(float speedInStepsPerSecond)
 {
-  desiredSpeed_InStepsPerSecond = speedInStepsPerSecond;
-  desiredPeriod_InUSPerStep = 1000000.0 / desiredSpeed_InStepsPerSecond;
+  ramp.setSpeedInStepsPerSecond(speedInStepsPerSecond);
 }
 
 
@@ -642,15 +705,27 @@ void FlexyStepper::setSpeedInStepsPerSecond(float speedInStepsPerSecond)
 //  Enter:  accelerationInStepsPerSecondPerSecond = rate of acceleration, units in 
 //          steps/second/second
 //
-void FlexyStepper::setAccelerationInStepsPerSecondPerSecond(
+template <class RampGenerator>
+void FlexyStepperT<RampGenerator>::setAccelerationInStepsPerSecondPerSecond(
                      float accelerationInStepsPerSecondPerSecond)
 {
-  acceleration_InStepsPerSecondPerSecond = accelerationInStepsPerSecondPerSecond;
-  acceleration_InStepsPerUSPerUS = acceleration_InStepsPerSecondPerSecond / 1E12;
+  ramp.setAccelerationInStepsPerSecondPerSecond(accelerationInStepsPerSecondPerSecond);
+}
+
+
 
-  periodOfSlowestStep_InUS = 
-      1000000.0 / sqrt(2.0 * acceleration_InStepsPerSecondPerSecond);
-  minimumPeriodForAStoppedMotion = periodOfSlowestStep_InUS / 2.8;
+//
+// set the jerk, the rate the acceleration changes at, units in 
+// steps/second/second/second.  Only ramp generators with an S-curve profile 
+// (FlexyRampSCurve) use it, 0 gives a trapezoidal profile
+//  Enter:  jerkInStepsPerSecondPerSecondPerSecond = rate of change of 
+//          acceleration, units in steps/second/second/second
+//
+template <class RampGenerator>
+void FlexyStepperT<RampGenerator>::setJerkInStepsPerSecondPerSecondPerSecond(
+                     float jerkInStepsPerSecondPerSecondPerSecond)
+{
+  ramp.setJerkInStepsPerSecondPerSecondPerSecond(jerkInStepsPerSecondPerSecondPerSecond);
 }
 
 
@@ -669,7 +744,8 @@ void FlexyStepper::setAccelerationInStepsPerSecondPerSecond(
 //          triggerState = state of the switch that indicates it is at home (HIGH / LOW)
 //  Exit:   true returned if successful, else false
 //
-bool FlexyStepper::moveToHomeInSteps(long directionTowardHome,  
+template <class RampGenerator>
+bool FlexyStepperT<RampGenerator>::moveToHomeInSteps(long directionTowardHome,  
   float speedInStepsPerSecond, long maxDistanceToMoveInSteps, 
   int homeLimitSwitchPin, int limitSwitchTriggerState)
 {
@@ -690,7 +766,7 @@ bool FlexyStepper::moveToHomeInSteps(long directionTowardHome,
   //
   // remember the current speed setting
   //
-  originalDesiredSpeed_InStepsPerSecond = desiredSpeed_InStepsPerSecond; 
+  originalDesiredSpeed_InStepsPerSecond = ramp.getSpeedInStepsPerSecond(); 
  
  
   //
@@ -791,7 +867,8 @@ bool FlexyStepper::moveToHomeInSteps(long directionTowardHome,
 //  Enter:  distanceToMoveInSteps = signed distance to move relative to the current  
 //          position in steps
 //
-void FlexyStepper::moveRelativeInSteps(long distanceToMoveInSteps)
+template <class RampGenerator>
+void FlexyStepperT<RampGenerator>::moveRelativeInSteps(long distanceToMoveInSteps)
 {
   setTargetPositionRelativeInSteps(distanceToMoveInSteps);
   
@@ -807,7 +884,8 @@ void FlexyStepper::moveRelativeInSteps(long distanceToMoveInSteps)
 //  Enter:  distanceToMoveInSteps = signed distance to move relative to the current  
 //            positionin steps
 //
-void FlexyStepper::setTargetPositionRelativeInSteps(long distanceToMoveInSteps)
+template <class RampGenerator>
+void FlexyStepperT<RampGenerator>::setTargetPositionRelativeInSteps(long distanceToMoveInSteps)
 {
   setTargetPositionInSteps(currentPosition_InSteps + distanceToMoveInSteps);
 }
@@ -820,7 +898,8 @@ void FlexyStepper::setTargetPositionRelativeInSteps(long distanceToMoveInSteps)
 //  Enter:  absolutePositionToMoveToInSteps = signed absolute position to move to  
 //            in unitsof steps
 //
-void FlexyStepper::moveToPositionInSteps(long absolutePositionToMoveToInSteps)
+template <class RampGenerator>
+void FlexyStepperT<RampGenerator>::moveToPositionInSteps(long absolutePositionToMoveToInSteps)
 {
   setTargetPositionInSteps(absolutePositionToMoveToInSteps);
   
@@ -835,7 +914,8 @@ void FlexyStepper::moveToPositionInSteps(long absolutePositionToMoveToInSteps)
 //  Enter:  absolutePositionToMoveToInSteps = signed absolute position to move to  
 //            in units of steps
 //
-void FlexyStepper::setTargetPositionInSteps(long absolutePositionToMoveToInSteps)
+template <class RampGenerator>
+void FlexyStepperT<RampGenerator>::setTargetPositionInSteps(long absolutePositionToMoveToInSteps)
 {
   targetPosition_InSteps = absolutePositionToMoveToInSteps;
 }
@@ -848,16 +928,15 @@ void FlexyStepper::setTargetPositionInSteps(long absolutePositionToMoveToInSteps
 // Note: This function can be used to stop a motion initiated in units of steps 
 // or revolutions
 //
-void FlexyStepper::setTargetPositionToStop()
+template <class RampGenerator>
+void FlexyStepperT<RampGenerator>::setTargetPositionToStop()
 {
   long decelerationDistance_InSteps;
   
   //
   // move the target position so that the motor will begin deceleration now
   //
-  decelerationDistance_InSteps = (long) round(
-    5E11 / (acceleration_InStepsPerSecondPerSecond * currentStepPeriod_InUS * 
-    currentStepPeriod_InUS));
+  decelerationDistance_InSteps = ramp.getStepsToStop();
 
   if (directionOfMotion > 0)
     setTargetPositionInSteps(currentPosition_InSteps + decelerationDistance_InSteps);
@@ -872,11 +951,13 @@ void FlexyStepper::setTargetPositionToStop()
 //  Exit:  true returned if movement complete, false returned not a final target 
 //           position yet
 //
-bool FlexyStepper::processMovement(void)
+template <class RampGenerator>
+bool FlexyStepperT<RampGenerator>::processMovement(void)
 { 
   unsigned long currentTime_InUS;
   unsigned long periodSinceLastStep_InUS;
   long distanceToTarget_Signed;
+  int previousDirectionOfMotion;
 
 
   //
@@ -893,7 +974,7 @@ bool FlexyStepper::processMovement(void)
     {
       directionOfMotion = 1;
       digitalWrite(directionPin, POSITIVE_DIRECTION);
-      nextStepPeriod_InUS = periodOfSlowestStep_InUS;
+      ramp.startFromStop();
       lastStepTime_InUS = micros(); 
       return(false);
     }
@@ -905,7 +986,7 @@ bool FlexyStepper::processMovement(void)
     {
       directionOfMotion = -1;
       digitalWrite(directionPin, NEGATIVE_DIRECTION);
-      nextStepPeriod_InUS = periodOfSlowestStep_InUS;
+      ramp.startFromStop();
       lastStepTime_InUS = micros(); 
       return(false);
     }
@@ -926,7 +1007,7 @@ bool FlexyStepper::processMovement(void)
   //
   // if it is not time for the next step, return
   //
-  if (periodSinceLastStep_InUS < (unsigned long) nextStepPeriod_InUS)
+  if (periodSinceLastStep_InUS < (unsigned long) ramp.getPeriodInUS())
     return(false);
   
 
@@ -946,7 +1027,7 @@ bool FlexyStepper::processMovement(void)
   // update the current position and speed
   //
   currentPosition_InSteps += directionOfMotion;
-  currentStepPeriod_InUS = nextStepPeriod_InUS;
+  currentStepPeriod_InUS = ramp.getPeriodInUS();
 
 
   //
@@ -956,9 +1037,18 @@ bool FlexyStepper::processMovement(void)
  
  
   //
-  // figure out how long before the next step
+  // figure out how long before the next step, change the direction bit if the 
+  // motor is reversing
   //
+  previousDirectionOfMotion = directionOfMotion;
   DeterminePeriodOfNextStep();
+  if (directionOfMotion != previousDirectionOfMotion)
+  {
+    if (directionOfMotion > 0)
+      digitalWrite(directionPin, POSITIVE_DIRECTION);
+    else
+      digitalWrite(directionPin, NEGATIVE_DIRECTION);
+  }
  
 
   //
@@ -976,10 +1066,10 @@ bool FlexyStepper::processMovement(void)
     //
     // at final position, make sure the motor is not going too fast
     //
-    if (nextStepPeriod_InUS >= minimumPeriodForAStoppedMotion) 
+    if (ramp.isSlowEnoughToStop()) 
     {
       currentStepPeriod_InUS = 0.0;
-      nextStepPeriod_InUS = 0.0;
+      ramp.stop();
       directionOfMotion = 0;
       return(true);
     }
@@ -990,6 +1080,88 @@ bool FlexyStepper::processMovement(void)
 
 
 
+//
+// plan the next step of the motion without issuing it, this is used when the step 
+// pulses are generated by an external step generator (such as a hardware timer 
+// interrupt) instead of processMovement().  The step is accounted for as soon as 
+// it is planned, so the position runs ahead of the motor by the number of steps 
+// the step generator has queued.  The direction pin is not touched.
+//  Exit:  true returned if a step was planned, false returned if the motion is 
+//           complete
+//         periodBeforeStep_InUS = time to wait after the previous step (or after 
+//           the start of the motion) before issuing this step
+//         stepDirection = 1 for a step in the positive direction, -1 for a step 
+//           in the negative direction
+//
+template <class RampGenerator>
+bool FlexyStepperT<RampGenerator>::planNextStep(float *periodBeforeStep_InUS, int *stepDirection)
+{
+  long distanceToTarget_Signed;
+
+
+  //
+  // check if currently stopped, if so start moving toward the target
+  //
+  if (directionOfMotion == 0)
+  {
+    distanceToTarget_Signed = targetPosition_InSteps - currentPosition_InSteps;
+
+    if (distanceToTarget_Signed > 0)
+      directionOfMotion = 1;
+    else if (distanceToTarget_Signed < 0)
+      directionOfMotion = -1;
+    else
+      return(false);
+
+    ramp.startFromStop();
+  }
+
+
+  //
+  // hand out the step, then update the position and speed as if it was issued
+  //
+  *periodBeforeStep_InUS = ramp.getPeriodInUS();
+  *stepDirection = directionOfMotion;
+
+  currentPosition_InSteps += directionOfMotion;
+  currentStepPeriod_InUS = *periodBeforeStep_InUS;
+  DeterminePeriodOfNextStep();
+
+
+  //
+  // at the final position, stop if the motor is not going too fast
+  //
+  if ((currentPosition_InSteps == targetPosition_InSteps) &&
+      ramp.isSlowEnoughToStop())
+  {
+    currentStepPeriod_InUS = 0.0;
+    ramp.stop();
+    directionOfMotion = 0;
+  }
+
+  return(true);
+}
+
+
+
+//
+// abandon the current motion immediately, without decelerating.  This is used 
+// with an external step generator when planned steps were discarded before they 
+// were issued (i.e. the motor was stopped)
+//  Enter:  actualPositionInSteps = position of the last step that was issued
+//
+template <class RampGenerator>
+void FlexyStepperT<RampGenerator>::abortMotion(long actualPositionInSteps)
+{
+  currentPosition_InSteps = actualPositionInSteps;
+  targetPosition_InSteps = actualPositionInSteps;
+  currentStepPeriod_InUS = 0.0;
+  ramp.stop();
+  directionOfMotion = 0;
+}
+
+
+
 //
 // Get the current velocity of the motor in steps/second.  This functions is 
 // updated while it accelerates up and down in speed.  This is not the desired  
@@ -1000,7 +1172,8 @@ bool FlexyStepper::processMovement(void)
 // great for the amount of torque that it can generate.
 //  Exit:  velocity speed in steps per second returned, signed
 //
-float FlexyStepper::getCurrentVelocityInStepsPerSecond()
+template <class RampGenerator>
+float FlexyStepperT<RampGenerator>::getCurrentVelocityInStepsPerSecond()
 {
   if (currentStepPeriod_InUS == 0.0)
     return(0);
@@ -1019,7 +1192,8 @@ float FlexyStepper::getCurrentVelocityInStepsPerSecond()
 // check if the motor has competed its move to the target position
 //  Exit:  true returned if the stepper is at the target position
 //
-bool FlexyStepper::motionComplete()
+template <class RampGenerator>
+bool FlexyStepperT<RampGenerator>::motionComplete()
 {
   if ((directionOfMotion == 0) && 
       (currentPosition_InSteps == targetPosition_InSteps))
@@ -1032,15 +1206,14 @@ bool FlexyStepper::motionComplete()
 
 //
 // determine the period for the next step, either speed up a little, slow down a  
-// little or go the same speed
+// little or go the same speed.  The period math itself is done by the ramp kernel 
+// (see FlexyStepperRamp.h)
 //
-void FlexyStepper::DeterminePeriodOfNextStep()
+template <class RampGenerator>
+void FlexyStepperT<RampGenerator>::DeterminePeriodOfNextStep()
 {
   long distanceToTarget_Signed;
   long distanceToTarget_Unsigned;
-  float currentSpeed_InStepsPerSecond;
-  long decelerationDistance_InSteps;
-  float currentStepPeriodSquared;
   bool speedUpFlag = false;
   bool slowDownFlag = false;
   bool targetInPositiveDirectionFlag = false;
@@ -1063,15 +1236,6 @@ void FlexyStepper::DeterminePeriodOfNextStep()
   }
 
 
-  //
-  // determine the number of steps needed to go from the current speed down to a 
-  // velocity of 0, Steps = Velocity^2 / (2 * Acceleration)
-  //
-  currentStepPeriodSquared = currentStepPeriod_InUS * currentStepPeriod_InUS;
-  decelerationDistance_InSteps = (long) round(
-    5E11 / (acceleration_InStepsPerSecondPerSecond * currentStepPeriodSquared));
-  
-  
   //
   // check if: Moving in a positive direction & Moving toward the target
   //    (directionOfMotion == 1) && (distanceToTarget_Signed > 0)
@@ -1082,8 +1246,8 @@ void FlexyStepper::DeterminePeriodOfNextStep()
     // check if need to start slowing down as we reach the target, or if we 
     // need to slow down because we are going too fast
     //
-    if ((distanceToTarget_Unsigned < decelerationDistance_InSteps) || 
-        (nextStepPeriod_InUS < desiredPeriod_InUSPerStep))
+    if (ramp.isWithinStoppingDistance(distanceToTarget_Unsigned) || 
+        ramp.isFasterThanDesired())
       slowDownFlag = true;
     else 
       speedUpFlag = true;
@@ -1099,14 +1263,13 @@ void FlexyStepper::DeterminePeriodOfNextStep()
     //
     // need to slow down, then reverse direction
     //
-    if (currentStepPeriod_InUS < periodOfSlowestStep_InUS)
+    if (!ramp.isSlowEnoughToReverse())
     {
       slowDownFlag = true;
     }
     else
     {
       directionOfMotion = -1;
-      digitalWrite(directionPin, NEGATIVE_DIRECTION);
     }
   }
 
@@ -1121,8 +1284,8 @@ void FlexyStepper::DeterminePeriodOfNextStep()
     // check if need to start slowing down as we reach the target, or if we 
     // need to slow down because we are going too fast
     //
-    if ((distanceToTarget_Unsigned < decelerationDistance_InSteps) || 
-        (nextStepPeriod_InUS < desiredPeriod_InUSPerStep))
+    if (ramp.isWithinStoppingDistance(distanceToTarget_Unsigned) || 
+        ramp.isFasterThanDesired())
       slowDownFlag = true;
     else 
       speedUpFlag = true;
@@ -1138,14 +1301,13 @@ void FlexyStepper::DeterminePeriodOfNextStep()
     //
     // need to slow down, then reverse direction
     //
-    if (currentStepPeriod_InUS < periodOfSlowestStep_InUS)
+    if (!ramp.isSlowEnoughToReverse())
     {
       slowDownFlag = true;
     }
     else
     {
       directionOfMotion = 1;
-      digitalWrite(directionPin, POSITIVE_DIRECTION);
     }
   }
 
@@ -1155,14 +1317,7 @@ void FlexyStepper::DeterminePeriodOfNextStep()
   //
   if (speedUpFlag)
   {
-    //
-    // StepPeriod = StepPeriod(1 - a * StepPeriod^2)
-    //
-    nextStepPeriod_InUS = currentStepPeriod_InUS - acceleration_InStepsPerUSPerUS * 
-      currentStepPeriodSquared * currentStepPeriod_InUS;
-
-    if (nextStepPeriod_InUS < desiredPeriod_InUSPerStep)
-      nextStepPeriod_InUS = desiredPeriod_InUSPerStep;
+    ramp.speedUp();
   }
 
   
@@ -1171,17 +1326,22 @@ void FlexyStepper::DeterminePeriodOfNextStep()
   //
   if (slowDownFlag)
   {
-    //
-    // StepPeriod = StepPeriod(1 + a * StepPeriod^2)
-    //
-    nextStepPeriod_InUS = currentStepPeriod_InUS + acceleration_InStepsPerUSPerUS * 
-      currentStepPeriodSquared * currentStepPeriod_InUS;
-
-    if (nextStepPeriod_InUS > periodOfSlowestStep_InUS)
-      nextStepPeriod_InUS = periodOfSlowestStep_InUS;
+    ramp.slowDown();
   }
 }
 
 
+
+//
+// the implementation lives in this file, so generate the stepper class for 
+// every ramp generator that comes with the library
+//
+template class FlexyStepperT<FlexyRampFloat>;
+template class FlexyStepperT<FlexyRampFixed>;
+template class FlexyStepperT<FlexyRampAvr446>;
+template class FlexyStepperT<FlexyRampLeib>;
+template class FlexyStepperT<FlexyRampSCurve>;
+
+
 // -------------------------------------- End --------------------------------------
 
@@ -34,20 +34,33 @@
 #ifndef FlexyStepper_h
 #define FlexyStepper_h
 
-#include <arduino.h>
+#include <Arduino.h>
 #include <stdlib.h>
+#include "FlexyStepperRamp.h"
 
 
 //
-// the FlexyStepper class
+// select the default ramp generator, the fixed point one does not use floating 
+// point math when planning a step
 //
-class FlexyStepper
+#ifdef FLEXYSTEPPER_FIXED_POINT_RAMP
+typedef FlexyRampFixed FlexyStepperRamp;
+#else
+typedef FlexyRampFloat FlexyStepperRamp;
+#endif
+
+
+//
+// the FlexyStepper class, templated on the ramp generator (see FlexyStepperRamp.h)
+//
+template <class RampGenerator>
+class FlexyStepperT
 {
   public:
     //
     // public functions
     //
-    FlexyStepper();
+    FlexyStepperT();
     void connectToPins(byte stepPinNumber, byte directionPinNumber);
 
     void setStepsPerMillimeter(float motorStepPerMillimeter);
@@ -56,6 +69,7 @@ class FlexyStepper
     void setCurrentPositionInMillimeter(float currentPositionInMillimeter);
     void setSpeedInMillimetersPerSecond(float speedInMillimetersPerSecond);
     void setAccelerationInMillimetersPerSecondPerSecond(float accelerationInMillimetersPerSecondPerSecond);
+    void setJerkInMillimetersPerSecondPerSecondPerSecond(float jerkInMillimetersPerSecondPerSecondPerSecond);
     bool moveToHomeInMillimeters(long directionTowardHome, float speedInMillimetersPerSecond, long maxDistanceToMoveInMillimeters, int homeLimitSwitchPin, int limitSwitchTriggerState);
     void moveRelativeInMillimeters(float distanceToMoveInMillimeters);
     void setTargetPositionRelativeInMillimeters(float distanceToMoveInMillimeters);
@@ -68,6 +82,7 @@ class FlexyStepper
     float getCurrentPositionInRevolutions();
     void setSpeedInRevolutionsPerSecond(float speedInRevolutionsPerSecond);
     void setAccelerationInRevolutionsPerSecondPerSecond(float accelerationInRevolutionsPerSecondPerSecond);
+    void setJerkInRevolutionsPerSecondPerSecondPerSecond(float jerkInRevolutionsPerSecondPerSecondPerSecond);
     bool moveToHomeInRevolutions(long directionTowardHome, float speedInRevolutionsPerSecond, long maxDistanceToMoveInRevolutions, int homeLimitSwitchPin, int limitSwitchTriggerState);
     void moveRelativeInRevolutions(float distanceToMoveInRevolutions);
     void setTargetPositionRelativeInRevolutions(float distanceToMoveInRevolutions);
@@ -79,6 +94,7 @@ class FlexyStepper
     long getCurrentPositionInSteps();
     void setSpeedInStepsPerSecond(float speedInStepsPerSecond);
     void setAccelerationInStepsPerSecondPerSecond(float accelerationInStepsPerSecondPerSecond);
+    void setJerkInStepsPerSecondPerSecondPerSecond(float jerkInStepsPerSecondPerSecondPerSecond);
     bool moveToHomeInSteps(long directionTowardHome, float speedInStepsPerSecond, long maxDistanceToMoveInSteps, int homeSwitchPin, int limitSwitchTriggerState);
     void moveRelativeInSteps(long distanceToMoveInSteps);
     void setTargetPositionRelativeInSteps(long distanceToMoveInSteps);
@@ -88,6 +104,8 @@ class FlexyStepper
     bool motionComplete();
     float getCurrentVelocityInStepsPerSecond(); 
     bool processMovement(void);
+    bool planNextStep(float *periodBeforeStep_InUS, int *stepDirection);
+    void abortMotion(long actualPositionInSteps);
 
 
   private:
@@ -107,17 +125,17 @@ class FlexyStepper
     int directionOfMotion;
     long currentPosition_InSteps;
     long targetPosition_InSteps;
-    float desiredSpeed_InStepsPerSecond;
-    float desiredPeriod_InUSPerStep;
-    float acceleration_InStepsPerSecondPerSecond;
-    float acceleration_InStepsPerUSPerUS;
-    float periodOfSlowestStep_InUS;
-    float minimumPeriodForAStoppedMotion;
-    float nextStepPeriod_InUS;
+    RampGenerator ramp;
     unsigned long lastStepTime_InUS;
     float currentStepPeriod_InUS;
 };
 
+
+//
+// stepper with the default ramp generator
+//
+typedef FlexyStepperT<FlexyStepperRamp> FlexyStepper;
+
 // ------------------------------------ End ---------------------------------
 #endif
 
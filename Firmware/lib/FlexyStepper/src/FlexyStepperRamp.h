@@ -0,0 +1,905 @@
+//      ******************************************************************
+//      *                                                                *
+//      *          Ramp generators used by FlexyStepper.cpp              *
+//      *                                                                *
+//      ******************************************************************
+
+//
+// A ramp generator holds the period of the next step and knows how to make it
+// one step faster or slower.  FlexyStepperT<> decides when to speed up and slow
+// down, the ramp generator does the math.  Every ramp generator has the same
+// set of functions (there are no virtual functions, the stepper is templated
+// on the generator):
+//
+//    setSpeedInStepsPerSecond(), getSpeedInStepsPerSecond()
+//    setAccelerationInStepsPerSecondPerSecond(), getAccelerationInStepsPerSecondPerSecond()
+//    setJerkInStepsPerSecondPerSecondPerSecond(), getJerkInStepsPerSecondPerSecondPerSecond()
+//                                - ignored by the trapezoidal ramps, which
+//                                  always report a jerk of 0
+//    startFromStop()             - period of the first step of a motion
+//    stop(), isStopped()
+//    getPeriodInUS()             - period of the next step
+//    speedUp(), slowDown()       - change the period by one step of acceleration
+//    isFasterThanDesired()       - going faster than the set speed
+//    isSlowEnoughToReverse()     - slow enough to change direction
+//    isSlowEnoughToStop()        - slow enough to stop at the target
+//    isWithinStoppingDistance()  - has to slow down to stop within the distance
+//    getStepsToStop()            - steps needed to come to a stop
+//
+// Ramp generators:
+//    FlexyRampFloat  - Aryeh Eiderman's ramp: StepPeriod(1 -/+ a * StepPeriod^2),
+//                      the original floating point FlexyStepper implementation
+//    FlexyRampFixed  - same ramp, integer only, no divisions or sqrt() on a
+//                      step, safe to run where the FPU can't be used, but
+//                      slower than FlexyRampFloat (see below)
+//    FlexyRampLeib   - Eiderman's more accurate ramp from the same paper, adds
+//                      the 2nd order term: StepPeriod(1 -/+ q + 1.5 * q^2)
+//    FlexyRampAvr446 - David Austin's ramp (Atmel AVR446 application note),
+//                      integer, one division per step, most linear of all
+//    FlexyRampSCurve - jerk limited 7 segment S-curve, with a jerk of 0 it is
+//                      FlexyRampFloat, so the profile can be picked at runtime
+//
+// Define FLEXYSTEPPER_FIXED_POINT_RAMP to have FlexyStepper use FlexyRampFixed.
+//
+// Note: this file does not depend on Arduino, so the ramp generators can be
+// benchmarked on a host (see Firmware/host/bench_ramp.cpp)
+//
+
+#ifndef FlexyStepperRamp_h
+#define FlexyStepperRamp_h
+
+#include <stdint.h>
+#include <math.h>
+
+
+// ---------------------------------------------------------------------------------
+//                             Floating point kernel
+// ---------------------------------------------------------------------------------
+
+class FlexyRampFloat
+{
+  public:
+    FlexyRampFloat()
+    {
+      stepPeriod_InUS = 0.0;
+      setSpeedInStepsPerSecond(200);
+      setAccelerationInStepsPerSecondPerSecond(200.0);
+    }
+
+    void setSpeedInStepsPerSecond(float speedInStepsPerSecond)
+    {
+      desiredSpeed_InStepsPerSecond = speedInStepsPerSecond;
+      desiredPeriod_InUSPerStep = 1000000.0 / desiredSpeed_InStepsPerSecond;
+    }
+
+    float getSpeedInStepsPerSecond() { return(desiredSpeed_InStepsPerSecond); }
+
+    void setAccelerationInStepsPerSecondPerSecond(float accelerationInStepsPerSecondPerSecond)
+    {
+      acceleration_InStepsPerSecondPerSecond = accelerationInStepsPerSecondPerSecond;
+      acceleration_InStepsPerUSPerUS = acceleration_InStepsPerSecondPerSecond / 1E12;
+
+      periodOfSlowestStep_InUS =
+          1000000.0 / sqrt(2.0 * acceleration_InStepsPerSecondPerSecond);
+      minimumPeriodForAStoppedMotion = periodOfSlowestStep_InUS / 2.8;
+    }
+
+    float getAccelerationInStepsPerSecondPerSecond() { return(acceleration_InStepsPerSecondPerSecond); }
+
+    void setJerkInStepsPerSecondPerSecondPerSecond(float) { }
+    float getJerkInStepsPerSecondPerSecondPerSecond() { return(0.0); }
+
+    //
+    // first step of a motion starts at the slowest speed
+    //
+    void startFromStop() { stepPeriod_InUS = periodOfSlowestStep_InUS; }
+    void stop() { stepPeriod_InUS = 0.0; }
+    bool isStopped() { return(stepPeriod_InUS == 0.0); }
+    float getPeriodInUS() { return(stepPeriod_InUS); }
+
+    bool isFasterThanDesired() { return(stepPeriod_InUS < desiredPeriod_InUSPerStep); }
+    bool isSlowEnoughToReverse() { return(stepPeriod_InUS >= periodOfSlowestStep_InUS); }
+    bool isSlowEnoughToStop() { return(stepPeriod_InUS >= minimumPeriodForAStoppedMotion); }
+
+    //
+    // number of steps needed to go from the current speed down to a velocity
+    // of 0, Steps = Velocity^2 / (2 * Acceleration)
+    //
+    long getStepsToStop()
+    {
+      if (stepPeriod_InUS == 0.0)
+        return(0);
+
+      return((long) round(
+        5E11 / (acceleration_InStepsPerSecondPerSecond * stepPeriod_InUS * stepPeriod_InUS)));
+    }
+
+    bool isWithinStoppingDistance(unsigned long distanceToTarget_InSteps)
+    {
+      return((long) distanceToTarget_InSteps < getStepsToStop());
+    }
+
+    //
+    // StepPeriod = StepPeriod(1 - a * StepPeriod^2)
+    //
+    void speedUp()
+    {
+      stepPeriod_InUS = stepPeriod_InUS - acceleration_InStepsPerUSPerUS *
+        stepPeriod_InUS * stepPeriod_InUS * stepPeriod_InUS;
+
+      if (stepPeriod_InUS < desiredPeriod_InUSPerStep)
+        stepPeriod_InUS = desiredPeriod_InUSPerStep;
+    }
+
+    //
+    // StepPeriod = StepPeriod(1 + a * StepPeriod^2)
+    //
+    void slowDown()
+    {
+      stepPeriod_InUS = stepPeriod_InUS + acceleration_InStepsPerUSPerUS *
+        stepPeriod_InUS * stepPeriod_InUS * stepPeriod_InUS;
+
+      if (stepPeriod_InUS > periodOfSlowestStep_InUS)
+        stepPeriod_InUS = periodOfSlowestStep_InUS;
+    }
+
+  protected:
+    float desiredSpeed_InStepsPerSecond;
+    float desiredPeriod_InUSPerStep;
+    float acceleration_InStepsPerSecondPerSecond;
+    float acceleration_InStepsPerUSPerUS;
+    float periodOfSlowestStep_InUS;
+    float minimumPeriodForAStoppedMotion;
+    float stepPeriod_InUS;
+};
+
+
+
+// ---------------------------------------------------------------------------------
+//                              Fixed point kernel
+// ---------------------------------------------------------------------------------
+
+//
+// The period is kept in unsigned Q24.40 microseconds.  Rather than a * p^3 the
+// kernel tracks q = a * p^2 (in Q0.48), which is always <= 0.5 since the period
+// never gets longer than the slowest step (a * slowest^2 = 0.5):
+//
+//    q      = (a * p) * p
+//    p     -/+= p * q
+//
+// The products are done with 32 x 32 bit multiplies into a 128 bit result,
+// shifted back down to 64 bits.  Keeping the full precision matters, the
+// period error made on every step adds up over a long ramp and is magnified
+// at the slow end of a deceleration.
+//
+// That precision has a price: a step takes three of these products, twelve
+// 32 x 32 bit multiplies, against three float multiplies for FlexyRampFloat.
+// bench_ramp measures about 33 cycles a step against 19 for float on a PC,
+// and the ESP32 has a single precision FPU, so float is the faster kernel
+// there too.  FlexyRampFixed is kept for where float can't be used at all:
+// planning steps from an interrupt (the ESP32 does not save the FPU
+// registers for an interrupt) or on a chip without an FPU.  It also gives
+// the same step times on every CPU and compiler.  The StepEngine plans in
+// task context, so the firmware uses float by default.
+//
+// The stopping distance test Steps < Velocity^2 / (2 * Acceleration) turns into
+// Steps * q < 0.5, so no division is needed either (moves longer than 2^31
+// steps are not supported).  Setting speed or acceleration still uses floating
+// point, but that does not happen per step.
+//
+#define FLEXY_RAMP_FIXED_PERIOD_SHIFT   40
+#define FLEXY_RAMP_FIXED_ACCEL_SHIFT    80
+#define FLEXY_RAMP_FIXED_Q_SHIFT        48
+
+class FlexyRampFixed
+{
+  public:
+    FlexyRampFixed()
+    {
+      stepPeriod_InQ40US = 0;
+      q_InQ48 = 0;
+      setSpeedInStepsPerSecond(200);
+      setAccelerationInStepsPerSecondPerSecond(200.0);
+    }
+
+    void setSpeedInStepsPerSecond(float speedInStepsPerSecond)
+    {
+      desiredSpeed_InStepsPerSecond = speedInStepsPerSecond;
+      desiredPeriod_InQ40US = toQ40(1000000.0 / desiredSpeed_InStepsPerSecond);
+    }
+
+    float getSpeedInStepsPerSecond() { return(desiredSpeed_InStepsPerSecond); }
+
+    //
+    // a in Q80 fits 64 bits up to about 15,000,000 steps/second/second
+    //
+    void setAccelerationInStepsPerSecondPerSecond(float accelerationInStepsPerSecondPerSecond)
+    {
+      double periodOfSlowestStep_InUS;
+
+      acceleration_InStepsPerSecondPerSecond = accelerationInStepsPerSecondPerSecond;
+      acceleration_InQ80 = (uint64_t) (acceleration_InStepsPerSecondPerSecond / 1E12 *
+        ldexp(1.0, FLEXY_RAMP_FIXED_ACCEL_SHIFT) + 0.5);
+
+      periodOfSlowestStep_InUS = 1000000.0 / sqrt(2.0 * acceleration_InStepsPerSecondPerSecond);
+      periodOfSlowestStep_InQ40US = toQ40(periodOfSlowestStep_InUS);
+      minimumPeriodForAStoppedMotion_InQ40US = toQ40(periodOfSlowestStep_InUS / 2.8);
+
+      if (stepPeriod_InQ40US > periodOfSlowestStep_InQ40US)
+        setPeriod(periodOfSlowestStep_InQ40US);
+      else
+        setPeriod(stepPeriod_InQ40US);
+    }
+
+    float getAccelerationInStepsPerSecondPerSecond() { return(acceleration_InStepsPerSecondPerSecond); }
+
+    void setJerkInStepsPerSecondPerSecondPerSecond(float) { }
+    float getJerkInStepsPerSecondPerSecondPerSecond() { return(0.0); }
+
+    void startFromStop() { setPeriod(periodOfSlowestStep_InQ40US); }
+    void stop() { setPeriod(0); }
+    bool isStopped() { return(stepPeriod_InQ40US == 0); }
+
+    //
+    // Q24.8 is plenty for the period handed to the step generator, and it fits
+    // the 24 bit mantissa of a float
+    //
+    float getPeriodInUS()
+    {
+      return((float) (uint32_t) (stepPeriod_InQ40US >> (FLEXY_RAMP_FIXED_PERIOD_SHIFT - 8)) / 256.0f);
+    }
+
+    bool isFasterThanDesired() { return(stepPeriod_InQ40US < desiredPeriod_InQ40US); }
+    bool isSlowEnoughToReverse() { return(stepPeriod_InQ40US >= periodOfSlowestStep_InQ40US); }
+    bool isSlowEnoughToStop() { return(stepPeriod_InQ40US >= minimumPeriodForAStoppedMotion_InQ40US); }
+
+    long getStepsToStop()
+    {
+      if (q_InQ48 == 0)
+        return(0);
+
+      return((long) (((1ULL << (FLEXY_RAMP_FIXED_Q_SHIFT - 1)) + q_InQ48 / 2) / q_InQ48));
+    }
+
+    //
+    // Steps < round(1 / (2 * q)), multiplied out to (2 * Steps + 1) * q <= 1.  The
+    // product is kept within 64 bits by first ruling out the cases where q is
+    // too big for the distance to be anywhere near the stopping distance
+    //
+    bool isWithinStoppingDistance(unsigned long distanceToTarget_InSteps)
+    {
+      if (distanceToTarget_InSteps >= (1UL << 31))
+        return(false);
+
+      if ((distanceToTarget_InSteps >= (1UL << 15)) && (q_InQ48 >= (1ULL << 32)))
+        return(false);
+
+      return((2 * (uint64_t) distanceToTarget_InSteps + 1) * q_InQ48 <=
+             (1ULL << FLEXY_RAMP_FIXED_Q_SHIFT));
+    }
+
+    //
+    // StepPeriod = StepPeriod(1 - q)
+    //
+    void speedUp()
+    {
+      uint64_t period = stepPeriod_InQ40US -
+        multiplyShift(stepPeriod_InQ40US, q_InQ48, FLEXY_RAMP_FIXED_Q_SHIFT);
+
+      if (period < desiredPeriod_InQ40US)
+        period = desiredPeriod_InQ40US;
+
+      setPeriod(period);
+    }
+
+    //
+    // StepPeriod = StepPeriod(1 + q)
+    //
+    void slowDown()
+    {
+      uint64_t period = stepPeriod_InQ40US +
+        multiplyShift(stepPeriod_InQ40US, q_InQ48, FLEXY_RAMP_FIXED_Q_SHIFT);
+
+      if (period > periodOfSlowestStep_InQ40US)
+        period = periodOfSlowestStep_InQ40US;
+
+      setPeriod(period);
+    }
+
+  private:
+    static uint64_t toQ40(double period_InUS)
+    {
+      return((uint64_t) (period_InUS * (double) (1ULL << FLEXY_RAMP_FIXED_PERIOD_SHIFT)));
+    }
+
+    //
+    // (x * y) >> shift, rounded, with a 128 bit intermediate result
+    //  Enter:  shift = 32 to 95, the result must fit 64 bits
+    //
+    static uint64_t multiplyShift(uint64_t x, uint64_t y, uint8_t shift)
+    {
+      uint64_t xLow = (uint32_t) x;
+      uint64_t xHigh = x >> 32;
+      uint64_t yLow = (uint32_t) y;
+      uint64_t yHigh = y >> 32;
+      uint64_t low = xLow * yLow;
+      uint64_t middle1 = xHigh * yLow;
+      uint64_t middle2 = xLow * yHigh;
+      uint64_t high = xHigh * yHigh;
+      uint64_t middle;
+      uint64_t resultLow;
+      uint64_t resultHigh;
+
+      //
+      // add up the partial products, bits 32 to 95 of the 128 bit result end 
+      // up in "middle", the carries in "resultHigh"
+      //
+      middle = (low >> 32) + (uint32_t) middle1 + (uint32_t) middle2;
+      resultLow = (middle << 32) | (uint32_t) low;
+      resultHigh = high + (middle1 >> 32) + (middle2 >> 32) + (middle >> 32);
+
+      //
+      // round, then shift
+      //
+      if (resultLow + (1ULL << (shift - 1)) < resultLow)
+        resultHigh++;
+      resultLow += (1ULL << (shift - 1));
+
+      if (shift == 64)
+        return(resultHigh);
+      else if (shift > 64)
+        return(resultHigh >> (shift - 64));
+      else
+        return((resultHigh << (64 - shift)) | (resultLow >> shift));
+    }
+
+    //
+    // q = a * p^2, (a in Q80 * p in Q40) >> 48 gives a * p in Q72
+    //
+    void setPeriod(uint64_t period_InQ40US)
+    {
+      uint64_t accelerationTimesPeriod_InQ72;
+
+      stepPeriod_InQ40US = period_InQ40US;
+      accelerationTimesPeriod_InQ72 = multiplyShift(acceleration_InQ80, period_InQ40US, 48);
+      q_InQ48 = multiplyShift(accelerationTimesPeriod_InQ72, period_InQ40US, 64);
+    }
+
+    float desiredSpeed_InStepsPerSecond;
+    float acceleration_InStepsPerSecondPerSecond;
+    uint64_t acceleration_InQ80;
+    uint64_t desiredPeriod_InQ40US;
+    uint64_t periodOfSlowestStep_InQ40US;
+    uint64_t minimumPeriodForAStoppedMotion_InQ40US;
+    uint64_t stepPeriod_InQ40US;
+    uint64_t q_InQ48;
+};
+
+
+
+// ---------------------------------------------------------------------------------
+//                                  Leib ramp
+// ---------------------------------------------------------------------------------
+
+//
+// Exactly one step of constant acceleration changes the period to 
+// StepPeriod / sqrt(1 -/+ 2q), with q = a * StepPeriod^2.  FlexyRampFloat only 
+// keeps the 1st order term of the series, this one keeps the 2nd order term as
+// well, which makes the ramp a lot more linear at the slow end
+//
+class FlexyRampLeib : public FlexyRampFloat
+{
+  public:
+    //
+    // StepPeriod = StepPeriod(1 - q + 1.5 * q^2)
+    //
+    void speedUp()
+    {
+      float q = acceleration_InStepsPerUSPerUS * stepPeriod_InUS * stepPeriod_InUS;
+
+      stepPeriod_InUS = stepPeriod_InUS * (1.0f - q + 1.5f * q * q);
+
+      if (stepPeriod_InUS < desiredPeriod_InUSPerStep)
+        stepPeriod_InUS = desiredPeriod_InUSPerStep;
+    }
+
+    //
+    // StepPeriod = StepPeriod(1 + q + 1.5 * q^2)
+    //
+    void slowDown()
+    {
+      float q = acceleration_InStepsPerUSPerUS * stepPeriod_InUS * stepPeriod_InUS;
+
+      stepPeriod_InUS = stepPeriod_InUS * (1.0f + q + 1.5f * q * q);
+
+      if (stepPeriod_InUS > periodOfSlowestStep_InUS)
+        stepPeriod_InUS = periodOfSlowestStep_InUS;
+    }
+};
+
+
+
+// ---------------------------------------------------------------------------------
+//                                 AVR446 ramp
+// ---------------------------------------------------------------------------------
+
+//
+// David Austin's "Generate stepper-motor speed profiles in real time", as used
+// in Atmel's AVR446 application note.  The ramp counts the steps n it takes to
+// get from standstill to the current speed, then:
+//
+//    accelerating:   n = n + 1,  StepPeriod = StepPeriod - 2 * StepPeriod / (4n + 1)
+//    decelerating:   StepPeriod = StepPeriod + 2 * StepPeriod / (4n - 1),  n = n - 1
+//
+// The remainder of the division is carried to the next step, so the rounding
+// does not add up.  n is also the number of steps needed to stop.  The first
+// step uses the 0.676 correction factor from the paper.  The period is kept in
+// Q24.8 microseconds, which limits acceleration to at least 0.02 steps/sec/sec.
+//
+class FlexyRampAvr446
+{
+  public:
+    FlexyRampAvr446()
+    {
+      stepPeriod_InQ8US = 0;
+      stepCount = 0;
+      remainder = 0;
+      setSpeedInStepsPerSecond(200);
+      setAccelerationInStepsPerSecondPerSecond(200.0);
+    }
+
+    void setSpeedInStepsPerSecond(float speedInStepsPerSecond)
+    {
+      desiredSpeed_InStepsPerSecond = speedInStepsPerSecond;
+      desiredPeriod_InQ8US = (uint32_t) (1000000.0 * 256.0 / desiredSpeed_InStepsPerSecond);
+    }
+
+    float getSpeedInStepsPerSecond() { return(desiredSpeed_InStepsPerSecond); }
+
+    //
+    // changing the acceleration while moving, find the step count that goes
+    // with the current speed
+    //
+    void setAccelerationInStepsPerSecondPerSecond(float accelerationInStepsPerSecondPerSecond)
+    {
+      float periodOfSlowestStep_InUS;
+      float stepPeriod_InUS;
+
+      acceleration_InStepsPerSecondPerSecond = accelerationInStepsPerSecondPerSecond;
+
+      firstStepPeriod_InQ8US = (uint32_t) (0.676 * 1000000.0 * 256.0 * 
+        sqrt(2.0 / acceleration_InStepsPerSecondPerSecond));
+
+      periodOfSlowestStep_InUS = 1000000.0 / sqrt(2.0 * acceleration_InStepsPerSecondPerSecond);
+      minimumPeriodForAStoppedMotion_InQ8US = (uint32_t) (periodOfSlowestStep_InUS * 256.0 / 2.8);
+
+      if (stepPeriod_InQ8US != 0)
+      {
+        stepPeriod_InUS = getPeriodInUS();
+        stepCount = (long) round(5E11 / 
+          (acceleration_InStepsPerSecondPerSecond * stepPeriod_InUS * stepPeriod_InUS));
+        remainder = 0;
+
+        if ((stepCount == 0) || (stepPeriod_InQ8US > firstStepPeriod_InQ8US))
+          startFromStop();
+      }
+    }
+
+    float getAccelerationInStepsPerSecondPerSecond() { return(acceleration_InStepsPerSecondPerSecond); }
+
+    void setJerkInStepsPerSecondPerSecondPerSecond(float) { }
+    float getJerkInStepsPerSecondPerSecondPerSecond() { return(0.0); }
+
+    void startFromStop()
+    {
+      stepPeriod_InQ8US = firstStepPeriod_InQ8US;
+      stepCount = 0;
+      remainder = 0;
+    }
+
+    void stop()
+    {
+      stepPeriod_InQ8US = 0;
+      stepCount = 0;
+      remainder = 0;
+    }
+
+    bool isStopped() { return(stepPeriod_InQ8US == 0); }
+    float getPeriodInUS() { return((float) stepPeriod_InQ8US / 256.0f); }
+
+    bool isFasterThanDesired() { return(stepPeriod_InQ8US < desiredPeriod_InQ8US); }
+    bool isSlowEnoughToReverse() { return(stepCount == 0); }
+    bool isSlowEnoughToStop() { return(stepPeriod_InQ8US >= minimumPeriodForAStoppedMotion_InQ8US); }
+
+    long getStepsToStop() { return(stepCount); }
+
+    bool isWithinStoppingDistance(unsigned long distanceToTarget_InSteps)
+    {
+      return((long) distanceToTarget_InSteps < stepCount);
+    }
+
+    //
+    // once at the set speed the step count is left alone, so it keeps
+    // matching the speed the motor is actually going
+    //
+    void speedUp()
+    {
+      uint32_t dividend;
+      uint32_t divisor;
+      uint32_t period;
+
+      if (stepPeriod_InQ8US > desiredPeriod_InQ8US)
+      {
+        dividend = 2 * stepPeriod_InQ8US + remainder;
+        divisor = 4 * (stepCount + 1) + 1;
+        period = stepPeriod_InQ8US - dividend / divisor;
+
+        if (period >= desiredPeriod_InQ8US)
+        {
+          stepPeriod_InQ8US = period;
+          remainder = dividend % divisor;
+          stepCount++;
+          return;
+        }
+      }
+
+      stepPeriod_InQ8US = desiredPeriod_InQ8US;
+      remainder = 0;
+    }
+
+    void slowDown()
+    {
+      uint32_t dividend;
+      uint32_t divisor;
+
+      if (stepCount <= 1)
+      {
+        startFromStop();
+        return;
+      }
+
+      dividend = 2 * stepPeriod_InQ8US + remainder;
+      divisor = 4 * stepCount - 1;
+      stepPeriod_InQ8US += dividend / divisor;
+      remainder = dividend % divisor;
+      stepCount--;
+    }
+
+  private:
+    float desiredSpeed_InStepsPerSecond;
+    float acceleration_InStepsPerSecondPerSecond;
+    uint32_t desiredPeriod_InQ8US;
+    uint32_t firstStepPeriod_InQ8US;
+    uint32_t minimumPeriodForAStoppedMotion_InQ8US;
+    uint32_t stepPeriod_InQ8US;
+    long stepCount;
+    uint32_t remainder;
+};
+
+
+
+// ---------------------------------------------------------------------------------
+//                                S-curve ramp
+// ---------------------------------------------------------------------------------
+
+//
+// Jerk limited ramp: acceleration is not switched on and off, it is ramped up
+// and down at the set jerk, giving the classic 7 segment profile (jerk up,
+// constant acceleration, jerk down, cruise, and the same mirrored to stop).
+// Velocity and acceleration are integrated over every step:
+//
+//    Acceleration' = Acceleration +/- Jerk * StepPeriod      (limited to +/- a)
+//    Velocity'     = Velocity + (Acceleration + Acceleration') / 2 * StepPeriod
+//
+// Acceleration is ramped down before the set speed is reached (or, slowing
+// down, before the speed gets to 0) as soon as ramping it down would take the
+// motor all the way there, Velocity +/- Acceleration^2 / (2 * Jerk).  The
+// stopping distance has to follow the same profile, so it is worked out
+// segment by segment, see getStepsToStop().  It costs a sqrt() and a division
+// per step, it is not meant to run in an interrupt.
+//
+// With the jerk set to 0 every function goes straight to FlexyRampFloat.
+//
+class FlexyRampSCurve : public FlexyRampFloat
+{
+  public:
+    FlexyRampSCurve()
+    {
+      jerk_InStepsPerSecondPerSecondPerSecond = 0.0;
+      velocity_InStepsPerSecond = 0.0;
+      currentAcceleration_InStepsPerSecondPerSecond = 0.0;
+      stopping = false;
+      stoppingDistance_InSteps = 0;
+      stepsToStop_InSteps = 0;
+      setFirstStep();
+    }
+
+    void setAccelerationInStepsPerSecondPerSecond(float accelerationInStepsPerSecondPerSecond)
+    {
+      FlexyRampFloat::setAccelerationInStepsPerSecondPerSecond(accelerationInStepsPerSecondPerSecond);
+      setFirstStep();
+    }
+
+    //
+    // 0 turns the S-curve off, acceleration then changes in one go
+    //
+    void setJerkInStepsPerSecondPerSecondPerSecond(float jerkInStepsPerSecondPerSecondPerSecond)
+    {
+      jerk_InStepsPerSecondPerSecondPerSecond = jerkInStepsPerSecondPerSecondPerSecond;
+      setFirstStep();
+    }
+
+    float getJerkInStepsPerSecondPerSecondPerSecond() { return(jerk_InStepsPerSecondPerSecondPerSecond); }
+
+    void startFromStop()
+    {
+      if (jerk_InStepsPerSecondPerSecondPerSecond == 0.0)
+      {
+        FlexyRampFloat::startFromStop();
+        return;
+      }
+
+      stepPeriod_InUS = firstStepPeriod_InUS;
+      velocity_InStepsPerSecond = 1000000.0 / firstStepPeriod_InUS;
+      currentAcceleration_InStepsPerSecondPerSecond = firstStepAcceleration_InStepsPerSecondPerSecond;
+      stopping = false;
+    }
+
+    void stop()
+    {
+      FlexyRampFloat::stop();
+      velocity_InStepsPerSecond = 0.0;
+      currentAcceleration_InStepsPerSecondPerSecond = 0.0;
+      stopping = false;
+    }
+
+    bool isSlowEnoughToReverse()
+    {
+      if (jerk_InStepsPerSecondPerSecondPerSecond == 0.0)
+        return(FlexyRampFloat::isSlowEnoughToReverse());
+
+      return(stepPeriod_InUS >= firstStepPeriod_InUS);
+    }
+
+    bool isSlowEnoughToStop()
+    {
+      if (jerk_InStepsPerSecondPerSecondPerSecond == 0.0)
+        return(FlexyRampFloat::isSlowEnoughToStop());
+
+      return(stepPeriod_InUS >= firstStepPeriod_InUS / 2.8);
+    }
+
+    //
+    // distance covered while (1) ramping a positive acceleration down to 0, 
+    // (2) ramping the deceleration up, (3) decelerating at the peak and (4)
+    // ramping the deceleration back down, reaching 0 velocity and 0
+    // acceleration together.  The peak deceleration is the set acceleration,
+    // unless the velocity is too low to get there
+    //
+    long getStepsToStop()
+    {
+      float jerk = jerk_InStepsPerSecondPerSecondPerSecond;
+      float velocity = velocity_InStepsPerSecond;
+      float deceleration = -currentAcceleration_InStepsPerSecondPerSecond;
+      float peakDeceleration;
+      float distance = 0.0;
+      float time;
+
+      if (jerk == 0.0)
+        return(FlexyRampFloat::getStepsToStop());
+
+      if (stepPeriod_InUS == 0.0)
+        return(0);
+
+      if (deceleration < 0.0)
+      {
+        time = -deceleration / jerk;
+        distance += velocity * time - deceleration * time * time / 2.0 - jerk * time * time * time / 6.0;
+        velocity += deceleration * deceleration / (2.0 * jerk);
+        deceleration = 0.0;
+      }
+
+      //
+      // too late to ramp the deceleration down before the velocity gets to 0
+      //
+      if (velocity <= deceleration * deceleration / (2.0 * jerk))
+      {
+        time = (deceleration - sqrt(deceleration * deceleration - 2.0 * jerk * velocity)) / jerk;
+        distance += velocity * time - deceleration * time * time / 2.0 + jerk * time * time * time / 6.0;
+        return((long) round(distance));
+      }
+
+      peakDeceleration = sqrt((2.0 * jerk * velocity + deceleration * deceleration) / 2.0);
+      if (peakDeceleration > acceleration_InStepsPerSecondPerSecond)
+        peakDeceleration = acceleration_InStepsPerSecondPerSecond;
+
+      time = (peakDeceleration - deceleration) / jerk;
+      distance += velocity * time - deceleration * time * time / 2.0 - jerk * time * time * time / 6.0;
+      velocity -= deceleration * time + jerk * time * time / 2.0;
+
+      time = (velocity - peakDeceleration * peakDeceleration / (2.0 * jerk)) / peakDeceleration;
+      if (time > 0.0)
+      {
+        distance += velocity * time - peakDeceleration * time * time / 2.0;
+        velocity -= peakDeceleration * time;
+      }
+
+      time = peakDeceleration / jerk;
+      distance += velocity * time - peakDeceleration * time * time / 2.0 + jerk * time * time * time / 6.0;
+
+      return((long) round(distance));
+    }
+
+    //
+    // once it starts stopping it keeps on stopping, unless the target moves
+    // further away.  Rounding makes the stopping distance go up and down by a
+    // step, speeding up in between would ramp the acceleration back up
+    //
+    bool isWithinStoppingDistance(unsigned long distanceToTarget_InSteps)
+    {
+      if (jerk_InStepsPerSecondPerSecondPerSecond == 0.0)
+        return(FlexyRampFloat::isWithinStoppingDistance(distanceToTarget_InSteps));
+
+      stepsToStop_InSteps = getStepsToStop();
+
+      if (!stopping || (distanceToTarget_InSteps > stoppingDistance_InSteps))
+        stopping = ((long) distanceToTarget_InSteps < stepsToStop_InSteps);
+
+      stoppingDistance_InSteps = distanceToTarget_InSteps;
+      return(stopping);
+    }
+
+    void speedUp()
+    {
+      float acceleration = currentAcceleration_InStepsPerSecondPerSecond;
+      float jerkTimesPeriod = jerk_InStepsPerSecondPerSecondPerSecond * stepPeriod_InUS / 1000000.0;
+
+      if (jerk_InStepsPerSecondPerSecondPerSecond == 0.0)
+      {
+        FlexyRampFloat::speedUp();
+        return;
+      }
+
+      //
+      // ramp the acceleration down once that is enough to reach the set speed.
+      // It follows Acceleration = sqrt(2 * Jerk * VelocityLeft), which ramps
+      // down at the set jerk, so rounding made on every step can't add up and
+      // the set speed is reached without a jump in acceleration
+      //
+      if ((acceleration > 0.0) && (velocity_InStepsPerSecond + acceleration * acceleration / 
+          (2.0 * jerk_InStepsPerSecondPerSecondPerSecond) >= desiredSpeed_InStepsPerSecond))
+      {
+        acceleration = rampDownAcceleration(desiredSpeed_InStepsPerSecond - velocity_InStepsPerSecond);
+      }
+      else
+      {
+        acceleration += jerkTimesPeriod;
+        if (acceleration > acceleration_InStepsPerSecondPerSecond)
+          acceleration = acceleration_InStepsPerSecondPerSecond;
+      }
+
+      integrate(acceleration);
+
+      if (velocity_InStepsPerSecond >= desiredSpeed_InStepsPerSecond)
+      {
+        velocity_InStepsPerSecond = desiredSpeed_InStepsPerSecond;
+        currentAcceleration_InStepsPerSecondPerSecond = 0.0;
+        stepPeriod_InUS = desiredPeriod_InUSPerStep;
+      }
+    }
+
+    void slowDown()
+    {
+      float acceleration = currentAcceleration_InStepsPerSecondPerSecond;
+      float jerkTimesPeriod = jerk_InStepsPerSecondPerSecondPerSecond * stepPeriod_InUS / 1000000.0;
+
+      if (jerk_InStepsPerSecondPerSecondPerSecond == 0.0)
+      {
+        FlexyRampFloat::slowDown();
+        return;
+      }
+
+      //
+      // ramp the deceleration down once that is enough to come to a stop
+      //
+      if ((acceleration < 0.0) && (velocity_InStepsPerSecond - acceleration * acceleration / 
+          (2.0 * jerk_InStepsPerSecondPerSecondPerSecond) <= 0.0))
+      {
+        acceleration = -rampDownAcceleration(velocity_InStepsPerSecond);
+      }
+      else
+      {
+        //
+        // at a low jerk the stopping distance grows by more than a step per 
+        // step while accelerating, so stopping can start a few steps late.
+        // Make up for it with a slightly higher jerk instead of overshooting
+        //
+        if (stopping && (stoppingDistance_InSteps > 0) && 
+            (stepsToStop_InSteps > (long) stoppingDistance_InSteps))
+          jerkTimesPeriod = jerkTimesPeriod * stepsToStop_InSteps / stoppingDistance_InSteps;
+
+        acceleration -= jerkTimesPeriod;
+        if (acceleration < -acceleration_InStepsPerSecondPerSecond)
+          acceleration = -acceleration_InStepsPerSecondPerSecond;
+      }
+
+      integrate(acceleration);
+    }
+
+  private:
+    //
+    // acceleration that ramps down to 0 at the set jerk while the velocity 
+    // changes by velocityLeft
+    //
+    float rampDownAcceleration(float velocityLeft_InStepsPerSecond)
+    {
+      if (velocityLeft_InStepsPerSecond <= 0.0)
+        return(0.0);
+
+      return(sqrt(2.0 * jerk_InStepsPerSecondPerSecondPerSecond * velocityLeft_InStepsPerSecond));
+    }
+
+    //
+    // first step from standstill: ramping the acceleration up at the set jerk
+    // the motor gets 1 step in cbrt(6 / Jerk), ending at Jerk * t^2 / 2.  If the
+    // acceleration limit is reached before that, the constant acceleration 
+    // speed after 1 step, sqrt(2 * a), is lower, and is used instead
+    //
+    void setFirstStep()
+    {
+      float time;
+      float velocity;
+
+      if (jerk_InStepsPerSecondPerSecondPerSecond == 0.0)
+      {
+        firstStepPeriod_InUS = periodOfSlowestStep_InUS;
+        firstStepAcceleration_InStepsPerSecondPerSecond = acceleration_InStepsPerSecondPerSecond;
+        return;
+      }
+
+      time = cbrt(6.0 / jerk_InStepsPerSecondPerSecondPerSecond);
+      velocity = jerk_InStepsPerSecondPerSecondPerSecond * time * time / 2.0;
+      firstStepAcceleration_InStepsPerSecondPerSecond = jerk_InStepsPerSecondPerSecondPerSecond * time;
+
+      if (velocity > sqrt(2.0 * acceleration_InStepsPerSecondPerSecond))
+        velocity = sqrt(2.0 * acceleration_InStepsPerSecondPerSecond);
+
+      if (firstStepAcceleration_InStepsPerSecondPerSecond > acceleration_InStepsPerSecondPerSecond)
+        firstStepAcceleration_InStepsPerSecondPerSecond = acceleration_InStepsPerSecondPerSecond;
+
+      firstStepPeriod_InUS = 1000000.0 / velocity;
+    }
+
+    //
+    // advance the velocity over the period of the step just taken, never
+    // slower than the first step, a motion creeps in at that speed
+    //
+    void integrate(float newAcceleration)
+    {
+      float period_InSeconds = stepPeriod_InUS / 1000000.0;
+
+      velocity_InStepsPerSecond += (currentAcceleration_InStepsPerSecondPerSecond + newAcceleration) / 
+        2.0 * period_InSeconds;
+      currentAcceleration_InStepsPerSecondPerSecond = newAcceleration;
+
+      if (velocity_InStepsPerSecond * firstStepPeriod_InUS < 1000000.0)
+      {
+        velocity_InStepsPerSecond = 1000000.0 / firstStepPeriod_InUS;
+        if (currentAcceleration_InStepsPerSecondPerSecond < 0.0)
+          currentAcceleration_InStepsPerSecondPerSecond = 0.0;
+      }
+
+      stepPeriod_InUS = 1000000.0 / velocity_InStepsPerSecond;
+    }
+
+    float jerk_InStepsPerSecondPerSecondPerSecond;
+    float velocity_InStepsPerSecond;
+    float currentAcceleration_InStepsPerSecondPerSecond;
+    float firstStepPeriod_InUS;
+    float firstStepAcceleration_InStepsPerSecondPerSecond;
+    bool stopping;
+    unsigned long stoppingDistance_InSteps;
+    long stepsToStop_InSteps;
+};
+
+#endif
@@ -0,0 +1,263 @@
+/*
+StepEngine - Coordinated step source
+Description: Moves a set of FlexyStepper's along a straight line, all axes
+share one speed profile so they accelerate, cruise, decelerate and finish
+together.
+*/
+
+#include <math.h>
+#include "CoordinatedStepSource.h"
+
+CoordinatedStepSource::CoordinatedStepSource()
+{
+    for(uint8_t axis = 0; axis < STEP_ENGINE_MAX_AXES; axis++)
+    {
+        mpStepper[axis] = NULL;
+        mpGetPosition[axis] = NULL;
+        mpSetTarget[axis] = NULL;
+        mpSetPosition[axis] = NULL;
+        mPosition_InSteps[axis] = 0;
+        mDistance_InSteps[axis] = 0;
+        mNegative[axis] = false;
+        mError[axis] = 0;
+    }
+
+    mMajorDistance_InSteps = 0;
+    mPeriodFraction = 0.0;
+}
+
+// Start a move of all attached steppers to the given targets.
+// Speed and acceleration are the limits of each axis, the master profile is
+// scaled so that none of the axes goes over its limits.
+// Steppers have to stand still and the caller has to hold the source lock.
+//      - pTarget_InSteps   -> absolute target of each axis, STEP_ENGINE_MAX_AXES entries
+//      - pSpeed_InStepsPerSecond, pAcceleration_InStepsPerSecondPerSecond -> limit of each axis
+// returns
+//      - false     -> nothing to move or invalid limits
+bool CoordinatedStepSource::beginMove(const long *pTarget_InSteps, const float *pSpeed_InStepsPerSecond, const float *pAcceleration_InStepsPerSecondPerSecond)
+{
+    float speed_InStepsPerSecond;
+    float acceleration_InStepsPerSecondPerSecond;
+
+    if(!prepareMove(pTarget_InSteps))
+    {
+        return false;
+    }
+
+    speed_InStepsPerSecond = scaleToMaster(pSpeed_InStepsPerSecond);
+    acceleration_InStepsPerSecondPerSecond = scaleToMaster(pAcceleration_InStepsPerSecondPerSecond);
+    if((speed_InStepsPerSecond <= 0.0) || (acceleration_InStepsPerSecondPerSecond <= 0.0))
+    {
+        mMajorDistance_InSteps = 0;
+        return false;
+    }
+
+    mMaster.setSpeedInStepsPerSecond(speed_InStepsPerSecond);
+    mMaster.setAccelerationInStepsPerSecondPerSecond(acceleration_InStepsPerSecondPerSecond);
+    mMaster.setTargetPositionInSteps(mMajorDistance_InSteps);
+
+    return true;
+}
+
+// Same as beginMove(), but picks the cruise speed so the whole move (including
+// acceleration and deceleration) takes duration_InSeconds. If the move can't be
+// done in time with the given accelerations, it is done as fast as possible.
+bool CoordinatedStepSource::beginTimedMove(const long *pTarget_InSteps, float duration_InSeconds, const float *pAcceleration_InStepsPerSecondPerSecond)
+{
+    float distance;
+    float acceleration;
+    float speed;
+    float discriminant;
+
+    if(!prepareMove(pTarget_InSteps))
+    {
+        return false;
+    }
+
+    distance = mMajorDistance_InSteps;
+    acceleration = scaleToMaster(pAcceleration_InStepsPerSecondPerSecond);
+    if((acceleration <= 0.0) || (duration_InSeconds <= 0.0))
+    {
+        mMajorDistance_InSteps = 0;
+        return false;
+    }
+
+    // Trapezoid: duration = distance / speed + speed / acceleration
+    for(uint8_t pass = 0; pass < 2; pass++)
+    {
+        discriminant = acceleration * acceleration * duration_InSeconds * duration_InSeconds - 4.0 * acceleration * distance;
+        if(discriminant < 0.0)
+        {
+            // Not enough time, triangle profile
+            speed = sqrt(acceleration * distance);
+            break;
+        }
+
+        speed = (acceleration * duration_InSeconds - sqrt(discriminant)) / 2.0;
+
+        // FlexyStepper never goes slower than its first step, sqrt(2 * acceleration).
+        // For slow moves lower the acceleration so the cruise speed can be reached.
+        if(speed * speed >= 2.0 * acceleration)
+        {
+            break;
+        }
+        acceleration = speed * speed / 2.0;
+    }
+
+    mMaster.setSpeedInStepsPerSecond(speed);
+    mMaster.setAccelerationInStepsPerSecondPerSecond(acceleration);
+    mMaster.setTargetPositionInSteps(mMajorDistance_InSteps);
+
+    return true;
+}
+
+// Hand out the next master step, together with the steps of all other
+// axes that fall on it
+bool CoordinatedStepSource::nextEvent(StepEvent *pEvent)
+{
+    uint8_t axis;
+    float period_InUS;
+    uint32_t wholePeriod_InUS;
+    int direction;
+    int axisDirection;
+
+    if(mMajorDistance_InSteps == 0)
+    {
+        return false;
+    }
+
+    if(!mMaster.planNextStep(&period_InUS, &direction))
+    {
+        mMajorDistance_InSteps = 0;
+        return false;
+    }
+
+    period_InUS += mPeriodFraction;
+    wholePeriod_InUS = (uint32_t)period_InUS;
+    mPeriodFraction = period_InUS - wholePeriod_InUS;
+
+    pEvent->delay_InUS = wholePeriod_InUS;
+    pEvent->stepMask = 0;
+    pEvent->directionMask = 0;
+
+    for(axis = 0; axis < STEP_ENGINE_MAX_AXES; axis++)
+    {
+        if(mDistance_InSteps[axis] == 0)
+        {
+            continue;
+        }
+
+        // Bresenham, the axis steps every time the error wraps around.
+        // Master only goes back if it overshoots the end of the move.
+        axisDirection = 0;
+        if(direction > 0)
+        {
+            mError[axis] += mDistance_InSteps[axis];
+            if(mError[axis] >= mMajorDistance_InSteps)
+            {
+                mError[axis] -= mMajorDistance_InSteps;
+                axisDirection = 1;
+            }
+        }
+        else
+        {
+            mError[axis] -= mDistance_InSteps[axis];
+            if(mError[axis] < 0)
+            {
+                mError[axis] += mMajorDistance_InSteps;
+                axisDirection = -1;
+            }
+        }
+
+        if(axisDirection == 0)
+        {
+            continue;
+        }
+
+        if(mNegative[axis])
+        {
+            axisDirection = -axisDirection;
+        }
+
+        pEvent->stepMask |= (1 << axis);
+        if(axisDirection < 0)
+        {
+            pEvent->directionMask |= (1 << axis);
+        }
+
+        mPosition_InSteps[axis] += axisDirection;
+        if(mpStepper[axis] != NULL)
+        {
+            mpSetPosition[axis](mpStepper[axis], mPosition_InSteps[axis]);
+        }
+    }
+
+    return true;
+}
+
+// Work out the distance of every axis and find the major axis
+bool CoordinatedStepSource::prepareMove(const long *pTarget_InSteps)
+{
+    uint8_t axis;
+    long distance_InSteps;
+
+    mMajorDistance_InSteps = 0;
+    mPeriodFraction = 0.0;
+
+    for(axis = 0; axis < STEP_ENGINE_MAX_AXES; axis++)
+    {
+        mDistance_InSteps[axis] = 0;
+        mNegative[axis] = false;
+        mError[axis] = 0;
+
+        if(mpStepper[axis] == NULL)
+        {
+            continue;
+        }
+
+        mPosition_InSteps[axis] = mpGetPosition[axis](mpStepper[axis]);
+        mpSetTarget[axis](mpStepper[axis], pTarget_InSteps[axis]);
+
+        distance_InSteps = pTarget_InSteps[axis] - mPosition_InSteps[axis];
+        mNegative[axis] = (distance_InSteps < 0);
+        mDistance_InSteps[axis] = mNegative[axis] ? -distance_InSteps : distance_InSteps;
+
+        if(mDistance_InSteps[axis] > mMajorDistance_InSteps)
+        {
+            mMajorDistance_InSteps = mDistance_InSteps[axis];
+        }
+    }
+
+    // Master profile always runs from 0 to the major axis distance
+    mMaster.abortMotion(0);
+
+    return (mMajorDistance_InSteps != 0);
+}
+
+// Master runs in steps of the major axis, an axis moving a shorter distance
+// goes proportionally slower. Pick the highest master limit at which none
+// of the axes goes over its own limit.
+float CoordinatedStepSource::scaleToMaster(const float *pLimit)
+{
+    uint8_t axis;
+    float limit;
+    float masterLimit = 0.0;
+    bool found = false;
+
+    for(axis = 0; axis < STEP_ENGINE_MAX_AXES; axis++)
+    {
+        if(mDistance_InSteps[axis] == 0)
+        {
+            continue;
+        }
+
+        limit = pLimit[axis] * mMajorDistance_InSteps / mDistance_InSteps[axis];
+        if(!found || (limit < masterLimit))
+        {
+            masterLimit = limit;
+            found = true;
+        }
+    }
+
+    return masterLimit;
+}
@@ -0,0 +1,88 @@
+/*
+StepEngine - Coordinated step source
+Description: Moves a set of FlexyStepper's along a straight line, all axes
+share one speed profile so they accelerate, cruise, decelerate and finish
+together.
+
+A master profile (a FlexyStepper that is not connected to any pins) is planned
+in steps of the axis with the longest move, the major axis. Steps of all the
+other axes are distributed over the master steps with Bresenham's algorithm
+(DDA), so every axis finishes on the very last step event of the move.
+
+The attached steppers are not planning while a coordinated move runs, their
+position is updated for every step handed to the engine, so it runs ahead of
+the motor just like it does with FlexyStepSource.
+*/
+
+#ifndef __COORDINATED_STEP_SOURCE__
+#define __COORDINATED_STEP_SOURCE__
+
+#include <FlexyStepper.h>
+#include "StepEngine.h"
+
+class CoordinatedStepSource : public StepSource
+{
+    public:
+        CoordinatedStepSource();
+
+        template <class Stepper>
+        void attachStepper(uint8_t axis, Stepper *pStepper)
+        {
+            if(axis >= STEP_ENGINE_MAX_AXES)
+            {
+                return;
+            }
+
+            mpStepper[axis] = pStepper;
+            mpGetPosition[axis] = getPosition<Stepper>;
+            mpSetTarget[axis] = setTarget<Stepper>;
+            mpSetPosition[axis] = setPosition<Stepper>;
+        }
+
+        bool beginMove(const long *pTarget_InSteps, const float *pSpeed_InStepsPerSecond, const float *pAcceleration_InStepsPerSecondPerSecond);
+        bool beginTimedMove(const long *pTarget_InSteps, float duration_InSeconds, const float *pAcceleration_InStepsPerSecondPerSecond);
+
+        bool nextEvent(StepEvent *pEvent);
+
+    private:
+        typedef long (*GetPosition)(void *pStepper);
+        typedef void (*SetTarget)(void *pStepper, long target_InSteps);
+        typedef void (*SetPosition)(void *pStepper, long position_InSteps);
+
+        template <class Stepper>
+        static long getPosition(void *pStepper)
+        {
+            return ((Stepper *)pStepper)->getCurrentPositionInSteps();
+        }
+
+        // Stepper stands still and only keeps track of the move
+        template <class Stepper>
+        static void setTarget(void *pStepper, long target_InSteps)
+        {
+            ((Stepper *)pStepper)->abortMotion(((Stepper *)pStepper)->getCurrentPositionInSteps());
+            ((Stepper *)pStepper)->setTargetPositionInSteps(target_InSteps);
+        }
+
+        template <class Stepper>
+        static void setPosition(void *pStepper, long position_InSteps)
+        {
+            ((Stepper *)pStepper)->setCurrentPositionInSteps(position_InSteps);
+        }
+
+        bool prepareMove(const long *pTarget_InSteps);
+        float scaleToMaster(const float *pLimit);
+
+        FlexyStepper mMaster;                               // Speed profile, in steps of the major axis
+        void *mpStepper[STEP_ENGINE_MAX_AXES];
+        GetPosition mpGetPosition[STEP_ENGINE_MAX_AXES];
+        SetTarget mpSetTarget[STEP_ENGINE_MAX_AXES];
+        SetPosition mpSetPosition[STEP_ENGINE_MAX_AXES];
+        long mPosition_InSteps[STEP_ENGINE_MAX_AXES];       // Planned position of each axis
+        long mDistance_InSteps[STEP_ENGINE_MAX_AXES];       // Unsigned distance of each axis
+        bool mNegative[STEP_ENGINE_MAX_AXES];               // Axis moves toward lower step positions
+        long mError[STEP_ENGINE_MAX_AXES];                  // Bresenham error term, 0..mMajorDistance_InSteps-1
+        long mMajorDistance_InSteps;
+        float mPeriodFraction;                              // Sub microsecond part, carried to the next step
+};
+
+#endif
@@ -0,0 +1,107 @@
+/*
+StepEngine - FlexyStepper source
+Description: Plans steps for a set of independently moving FlexyStepper's and
+merges them into one timeline of step events for the StepEngine.
+*/
+
+#include "FlexyStepSource.h"
+
+FlexyStepSource::FlexyStepSource()
+{
+    for(uint8_t axis = 0; axis < STEP_ENGINE_MAX_AXES; axis++)
+    {
+        mpStepper[axis] = NULL;
+        mpPlanNextStep[axis] = NULL;
+        mAxisMoving[axis] = false;
+        mStepPending[axis] = false;
+        mStepNegative[axis] = false;
+        mStepTime_InUS[axis] = 0;
+        mStepTimeFraction[axis] = 0.0;
+    }
+
+    mEventTime_InUS = 0;
+}
+
+// Hand out the earliest planned step of all steppers. Steppers
+// that are due at the same microsecond are stepped together.
+bool FlexyStepSource::nextEvent(StepEvent *pEvent)
+{
+    uint8_t axis;
+    float period_InUS;
+    uint32_t wholePeriod_InUS;
+    int direction;
+    bool found = false;
+    uint32_t earliest_InUS = 0;
+
+    // Make sure every moving stepper has its next step planned
+    for(axis = 0; axis < STEP_ENGINE_MAX_AXES; axis++)
+    {
+        if((mpStepper[axis] == NULL) || mStepPending[axis])
+        {
+            continue;
+        }
+
+        if(!mpPlanNextStep[axis](mpStepper[axis], &period_InUS, &direction))
+        {
+            mAxisMoving[axis] = false;
+            continue;
+        }
+
+        // Stepper starts moving, its first step is timed from the current plan time
+        if(!mAxisMoving[axis])
+        {
+            mAxisMoving[axis] = true;
+            mStepTime_InUS[axis] = mEventTime_InUS;
+            mStepTimeFraction[axis] = 0.0;
+        }
+
+        period_InUS += mStepTimeFraction[axis];
+        wholePeriod_InUS = (uint32_t)period_InUS;
+        mStepTimeFraction[axis] = period_InUS - wholePeriod_InUS;
+
+        mStepTime_InUS[axis] += wholePeriod_InUS;
+        mStepNegative[axis] = (direction < 0);
+        mStepPending[axis] = true;
+    }
+
+    // Find the earliest one
+    for(axis = 0; axis < STEP_ENGINE_MAX_AXES; axis++)
+    {
+        if(!mStepPending[axis])
+        {
+            continue;
+        }
+
+        if(!found || ((int32_t)(mStepTime_InUS[axis] - earliest_InUS) < 0))
+        {
+            earliest_InUS = mStepTime_InUS[axis];
+            found = true;
+        }
+    }
+
+    if(!found)
+    {
+        return false;
+    }
+
+    pEvent->delay_InUS = earliest_InUS - mEventTime_InUS;
+    pEvent->stepMask = 0;
+    pEvent->directionMask = 0;
+
+    for(axis = 0; axis < STEP_ENGINE_MAX_AXES; axis++)
+    {
+        if(mStepPending[axis] && (mStepTime_InUS[axis] == earliest_InUS))
+        {
+            pEvent->stepMask |= (1 << axis);
+            if(mStepNegative[axis])
+            {
+                pEvent->directionMask |= (1 << axis);
+            }
+            mStepPending[axis] = false;
+        }
+    }
+
+    mEventTime_InUS = earliest_InUS;
+
+    return true;
+}
@@ -0,0 +1,53 @@
+/*
+StepEngine - FlexyStepper source
+Description: Plans steps for a set of independently moving FlexyStepper's and
+merges them into one timeline of step events for the StepEngine.
+*/
+
+#ifndef __FLEXY_STEP_SOURCE__
+#define __FLEXY_STEP_SOURCE__
+
+#include <FlexyStepper.h>
+#include "StepEngine.h"
+
+class FlexyStepSource : public StepSource
+{
+    public:
+        FlexyStepSource();
+
+        // Steppers may use different ramp generators, i.e. FlexyStepper on
+        // one axis and FlexyStepperT<FlexyRampAvr446> on another
+        template <class Stepper>
+        void attachStepper(uint8_t axis, Stepper *pStepper)
+        {
+            if(axis >= STEP_ENGINE_MAX_AXES)
+            {
+                return;
+            }
+
+            mpStepper[axis] = pStepper;
+            mpPlanNextStep[axis] = planNextStep<Stepper>;
+        }
+
+        bool nextEvent(StepEvent *pEvent);
+
+    private:
+        typedef bool (*PlanNextStep)(void *pStepper, float *pPeriod_InUS, int *pDirection);
+
+        template <class Stepper>
+        static bool planNextStep(void *pStepper, float *pPeriod_InUS, int *pDirection)
+        {
+            return ((Stepper *)pStepper)->planNextStep(pPeriod_InUS, pDirection);
+        }
+
+        void *mpStepper[STEP_ENGINE_MAX_AXES];
+        PlanNextStep mpPlanNextStep[STEP_ENGINE_MAX_AXES];
+        bool mAxisMoving[STEP_ENGINE_MAX_AXES];
+        bool mStepPending[STEP_ENGINE_MAX_AXES];
+        bool mStepNegative[STEP_ENGINE_MAX_AXES];
+        uint32_t mStepTime_InUS[STEP_ENGINE_MAX_AXES];     // Plan time of the pending (or last) step
+        float mStepTimeFraction[STEP_ENGINE_MAX_AXES];     // Sub microsecond part, carried to the next step
+        uint32_t mEventTime_InUS;                          // Plan time of the last event handed out
+};
+
+#endif
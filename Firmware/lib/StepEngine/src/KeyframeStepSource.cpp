@@ -0,0 +1,399 @@
+/*
+StepEngine - Keyframe step source
+Description: Moves a set of FlexyStepper's trough a list of keyframes without
+stopping at the keyframes in between, the whole sequence is planned up front.
+*/
+
+#include <math.h>
+#include "KeyframeStepSource.h"
+
+KeyframeStepSource::KeyframeStepSource()
+{
+    for(uint8_t axis = 0; axis < STEP_ENGINE_MAX_AXES; axis++)
+    {
+        mpStepper[axis] = NULL;
+        mpGetPosition[axis] = NULL;
+        mpSetTarget[axis] = NULL;
+        mpSetPosition[axis] = NULL;
+        mError[axis] = 0;
+        mPosition_InSteps[axis] = 0;
+    }
+
+    mSegmentCount = 0;
+    mDuration_InSeconds = 0.0;
+    mSegmentIndex = 0;
+    mStep = 0;
+    mPeriod_InUS = 0.0;
+    mPeriodFraction = 0.0;
+}
+
+// Plan a sequence trough the given keyframes. The sequence starts where the
+// steppers are, the positions of the first keyframe are not used, only its time.
+// Steppers have to stand still and the caller has to hold the source lock.
+//      - pKeyframes        -> count keyframes, times have to go up
+//      - pSpeed_InStepsPerSecond, pAcceleration_InStepsPerSecondPerSecond -> limit of each axis
+// returns
+//      - false     -> too few or too many keyframes, times out of order or invalid limits
+bool KeyframeStepSource::plan(const Keyframe *pKeyframes, uint8_t count, const float *pSpeed_InStepsPerSecond, const float *pAcceleration_InStepsPerSecondPerSecond)
+{
+    uint8_t axis;
+    uint8_t i;
+    long start_InSteps[STEP_ENGINE_MAX_AXES];
+    long distance_InSteps;
+    float duration_InSeconds[KEYFRAME_MAX_SEGMENTS];
+    float nominalSpeed[KEYFRAME_MAX_SEGMENTS];          // In steps of the segments major axis
+    float acceleration[KEYFRAME_MAX_SEGMENTS];
+    float maxSpeed[KEYFRAME_MAX_SEGMENTS];
+    float junction[KEYFRAME_MAX_KEYFRAMES];             // Fraction of the nominal speed kept at each keyframe
+    float axisSpeed;
+    float nextAxisSpeed;
+    float speedJump;
+    float limit;
+    float entrySpeed;
+    float exitSpeed;
+    float speed;
+    float b;
+    float c;
+    float discriminant;
+    float firstStepPeriod_InUS;
+    long accelerationSteps;
+    long decelerationSteps;
+
+    mSegmentCount = 0;
+    mDuration_InSeconds = 0.0;
+
+    if((count < 2) || (count > KEYFRAME_MAX_KEYFRAMES))
+    {
+        return false;
+    }
+
+    for(axis = 0; axis < STEP_ENGINE_MAX_AXES; axis++)
+    {
+        start_InSteps[axis] = pKeyframes[0].position_InSteps[axis];
+        if(mpStepper[axis] != NULL)
+        {
+            start_InSteps[axis] = mpGetPosition[axis](mpStepper[axis]);
+            mpSetTarget[axis](mpStepper[axis], pKeyframes[count - 1].position_InSteps[axis]);
+        }
+        mPosition_InSteps[axis] = start_InSteps[axis];
+    }
+
+    // Segments in steps of their major axis, with the limits scaled to it
+    for(i = 0; i < count - 1; i++)
+    {
+        Segment &segment = mSegment[i];
+
+        duration_InSeconds[i] = pKeyframes[i + 1].time_InSeconds - pKeyframes[i].time_InSeconds;
+        if(duration_InSeconds[i] <= 0.0)
+        {
+            return false;
+        }
+
+        segment.directionMask = 0;
+        segment.majorDistance_InSteps = 0;
+        for(axis = 0; axis < STEP_ENGINE_MAX_AXES; axis++)
+        {
+            distance_InSteps = pKeyframes[i + 1].position_InSteps[axis] - ((i == 0) ? start_InSteps[axis] : pKeyframes[i].position_InSteps[axis]);
+            if(mpStepper[axis] == NULL)
+            {
+                distance_InSteps = 0;
+            }
+
+            if(distance_InSteps < 0)
+            {
+                segment.directionMask |= (1 << axis);
+                distance_InSteps = -distance_InSteps;
+            }
+            segment.distance_InSteps[axis] = distance_InSteps;
+
+            if(distance_InSteps > segment.majorDistance_InSteps)
+            {
+                segment.majorDistance_InSteps = distance_InSteps;
+            }
+        }
+
+        segment.dwell_InUS = (uint32_t)(duration_InSeconds[i] * 1E6);
+        if(segment.majorDistance_InSteps == 0)
+        {
+            nominalSpeed[i] = 0.0;
+            acceleration[i] = 0.0;
+            maxSpeed[i] = 0.0;
+            continue;
+        }
+
+        acceleration[i] = scaleToMajor(segment, pAcceleration_InStepsPerSecondPerSecond);
+        maxSpeed[i] = scaleToMajor(segment, pSpeed_InStepsPerSecond);
+        if((acceleration[i] <= 0.0) || (maxSpeed[i] <= 0.0))
+        {
+            return false;
+        }
+
+        nominalSpeed[i] = segment.majorDistance_InSteps / duration_InSeconds[i];
+        if(nominalSpeed[i] > maxSpeed[i])
+        {
+            nominalSpeed[i] = maxSpeed[i];
+        }
+    }
+
+    // Junctions: slow both segments down until no axis changes its speed by more
+    // than a first step from standstill, sqrt(2 * acceleration). Sequence starts
+    // and ends at standstill, a dwell stops the rig as well.
+    junction[0] = 0.0;
+    junction[count - 1] = 0.0;
+    for(i = 1; i < count - 1; i++)
+    {
+        junction[i] = 0.0;
+        if((nominalSpeed[i - 1] == 0.0) || (nominalSpeed[i] == 0.0))
+        {
+            continue;
+        }
+
+        junction[i] = 1.0;
+        for(axis = 0; axis < STEP_ENGINE_MAX_AXES; axis++)
+        {
+            axisSpeed = nominalSpeed[i - 1] * mSegment[i - 1].distance_InSteps[axis] / mSegment[i - 1].majorDistance_InSteps;
+            if(mSegment[i - 1].directionMask & (1 << axis))
+            {
+                axisSpeed = -axisSpeed;
+            }
+
+            nextAxisSpeed = nominalSpeed[i] * mSegment[i].distance_InSteps[axis] / mSegment[i].majorDistance_InSteps;
+            if(mSegment[i].directionMask & (1 << axis))
+            {
+                nextAxisSpeed = -nextAxisSpeed;
+            }
+
+            speedJump = fabs(axisSpeed - nextAxisSpeed);
+            limit = sqrt(2.0 * pAcceleration_InStepsPerSecondPerSecond[axis]);
+            if(speedJump * junction[i] > limit)
+            {
+                junction[i] = limit / speedJump;
+            }
+        }
+    }
+
+    // Reverse pass, every segment has to be able to slow down to its exit speed
+    for(i = count - 1; i > 1; i--)
+    {
+        exitSpeed = junction[i] * nominalSpeed[i - 1];
+        limit = sqrt(exitSpeed * exitSpeed + 2.0 * acceleration[i - 1] * mSegment[i - 1].majorDistance_InSteps);
+        if(junction[i - 1] * nominalSpeed[i - 1] > limit)
+        {
+            junction[i - 1] = limit / nominalSpeed[i - 1];
+        }
+    }
+
+    // Forward pass, every segment has to be able to speed up to its exit speed
+    for(i = 0; i < count - 2; i++)
+    {
+        entrySpeed = junction[i] * nominalSpeed[i];
+        limit = sqrt(entrySpeed * entrySpeed + 2.0 * acceleration[i] * mSegment[i].majorDistance_InSteps);
+        if(junction[i + 1] * nominalSpeed[i] > limit)
+        {
+            junction[i + 1] = limit / nominalSpeed[i];
+        }
+    }
+
+    // Cruise speed of every segment, so it takes the time to its keyframe:
+    // duration = (2 * speed - entry - exit) / acceleration + (distance - ramp distance) / speed
+    for(i = 0; i < count - 1; i++)
+    {
+        Segment &segment = mSegment[i];
+
+        if(segment.majorDistance_InSteps == 0)
+        {
+            segment.accelerateUntil_InSteps = 0;
+            segment.decelerateFrom_InSteps = 0;
+            segment.entryPeriod_InUS = 0.0;
+            segment.cruisePeriod_InUS = 0.0;
+            segment.exitPeriod_InUS = 0.0;
+            segment.acceleration_InStepsPerUSPerUS = 0.0;
+            mDuration_InSeconds += duration_InSeconds[i];
+            continue;
+        }
+
+        entrySpeed = junction[i] * nominalSpeed[i];
+        exitSpeed = junction[i + 1] * nominalSpeed[i];
+
+        b = acceleration[i] * duration_InSeconds[i] + entrySpeed + exitSpeed;
+        c = acceleration[i] * segment.majorDistance_InSteps + (entrySpeed * entrySpeed + exitSpeed * exitSpeed) / 2.0;
+        discriminant = b * b - 4.0 * c;
+        if(discriminant < 0.0)
+        {
+            // Not enough time, triangle profile
+            speed = sqrt(c);
+        }
+        else
+        {
+            speed = (b - sqrt(discriminant)) / 2.0;
+        }
+        speed = fmin(fmax(speed, fmax(entrySpeed, exitSpeed)), maxSpeed[i]);
+
+        accelerationSteps = lround((speed * speed - entrySpeed * entrySpeed) / (2.0 * acceleration[i]));
+        decelerationSteps = lround((speed * speed - exitSpeed * exitSpeed) / (2.0 * acceleration[i]));
+        segment.decelerateFrom_InSteps = segment.majorDistance_InSteps - decelerationSteps;
+        if(segment.decelerateFrom_InSteps < 0)
+        {
+            segment.decelerateFrom_InSteps = 0;
+        }
+        segment.accelerateUntil_InSteps = (accelerationSteps < segment.decelerateFrom_InSteps) ? accelerationSteps : segment.decelerateFrom_InSteps;
+
+        // Never slower than a first step from standstill, like FlexyStepper
+        firstStepPeriod_InUS = 1E6 / sqrt(2.0 * acceleration[i]);
+        segment.cruisePeriod_InUS = 1E6 / speed;
+        segment.entryPeriod_InUS = (entrySpeed > 0.0) ? fmin(1E6 / entrySpeed, firstStepPeriod_InUS) : firstStepPeriod_InUS;
+        segment.entryPeriod_InUS = fmax(segment.entryPeriod_InUS, segment.cruisePeriod_InUS);
+        segment.exitPeriod_InUS = (exitSpeed > 0.0) ? fmin(1E6 / exitSpeed, firstStepPeriod_InUS) : firstStepPeriod_InUS;
+        segment.exitPeriod_InUS = fmax(segment.exitPeriod_InUS, segment.cruisePeriod_InUS);
+        segment.acceleration_InStepsPerUSPerUS = acceleration[i] / 1E12;
+
+        mDuration_InSeconds += (2.0 * speed - entrySpeed - exitSpeed) / acceleration[i] +
+                               (segment.majorDistance_InSteps - accelerationSteps - decelerationSteps) / speed;
+    }
+
+    mSegmentCount = count - 1;
+    mSegmentIndex = 0;
+    startSegment();
+
+    return true;
+}
+
+// Planned length of the sequence, longer than the time of the last keyframe
+// when segments can't keep up with their keyframes
+float KeyframeStepSource::getDuration(void)
+{
+    return mDuration_InSeconds;
+}
+
+// Hand out the next step of the running segment. Cost per step is the same
+// for any number of keyframes, the ramps only take a multiply and a divide:
+// speed + acceleration * period -> period / (1 + acceleration * period^2)
+bool KeyframeStepSource::nextEvent(StepEvent *pEvent)
+{
+    uint8_t axis;
+    float period_InUS;
+    uint32_t wholePeriod_InUS;
+
+    if(mSegmentIndex >= mSegmentCount)
+    {
+        return false;
+    }
+
+    Segment &segment = mSegment[mSegmentIndex];
+
+    pEvent->stepMask = 0;
+    pEvent->directionMask = segment.directionMask;
+
+    // Stand still
+    if(segment.majorDistance_InSteps == 0)
+    {
+        pEvent->delay_InUS = segment.dwell_InUS;
+        mSegmentIndex++;
+        startSegment();
+        return true;
+    }
+
+    period_InUS = mPeriod_InUS + mPeriodFraction;
+    wholePeriod_InUS = (uint32_t)period_InUS;
+    mPeriodFraction = period_InUS - wholePeriod_InUS;
+    pEvent->delay_InUS = wholePeriod_InUS;
+
+    for(axis = 0; axis < STEP_ENGINE_MAX_AXES; axis++)
+    {
+        if(segment.distance_InSteps[axis] == 0)
+        {
+            continue;
+        }
+
+        mError[axis] += segment.distance_InSteps[axis];
+        if(mError[axis] < segment.majorDistance_InSteps)
+        {
+            continue;
+        }
+        mError[axis] -= segment.majorDistance_InSteps;
+
+        pEvent->stepMask |= (1 << axis);
+        mPosition_InSteps[axis] += (segment.directionMask & (1 << axis)) ? -1 : 1;
+        if(mpStepper[axis] != NULL)
+        {
+            mpSetPosition[axis](mpStepper[axis], mPosition_InSteps[axis]);
+        }
+    }
+
+    mStep++;
+    if(mStep >= segment.majorDistance_InSteps)
+    {
+        mSegmentIndex++;
+        startSegment();
+    }
+    else if(mStep < segment.accelerateUntil_InSteps)
+    {
+        mPeriod_InUS = mPeriod_InUS / (1.0 + segment.acceleration_InStepsPerUSPerUS * mPeriod_InUS * mPeriod_InUS);
+        if(mPeriod_InUS < segment.cruisePeriod_InUS)
+        {
+            mPeriod_InUS = segment.cruisePeriod_InUS;
+        }
+    }
+    else if(mStep >= segment.decelerateFrom_InSteps)
+    {
+        // Exit period is at most a first step, acceleration * period^2 stays below 0.5
+        if(mPeriod_InUS < segment.exitPeriod_InUS)
+        {
+            mPeriod_InUS = mPeriod_InUS / (1.0 - segment.acceleration_InStepsPerUSPerUS * mPeriod_InUS * mPeriod_InUS);
+        }
+        if(mPeriod_InUS > segment.exitPeriod_InUS)
+        {
+            mPeriod_InUS = segment.exitPeriod_InUS;
+        }
+    }
+    else
+    {
+        mPeriod_InUS = segment.cruisePeriod_InUS;
+    }
+
+    return true;
+}
+
+// Same as CoordinatedStepSource, the highest major axis limit at which none
+// of the axes goes over its own limit
+float KeyframeStepSource::scaleToMajor(const Segment &segment, const float *pLimit)
+{
+    uint8_t axis;
+    float limit;
+    float majorLimit = 0.0;
+    bool found = false;
+
+    for(axis = 0; axis < STEP_ENGINE_MAX_AXES; axis++)
+    {
+        if(segment.distance_InSteps[axis] == 0)
+        {
+            continue;
+        }
+
+        limit = pLimit[axis] * segment.majorDistance_InSteps / segment.distance_InSteps[axis];
+        if(!found || (limit < majorLimit))
+        {
+            majorLimit = limit;
+            found = true;
+        }
+    }
+
+    return majorLimit;
+}
+
+// Reset the per segment state, the sub microsecond part carries over so
+// keyframe times don't drift
+void KeyframeStepSource::startSegment(void)
+{
+    mStep = 0;
+
+    for(uint8_t axis = 0; axis < STEP_ENGINE_MAX_AXES; axis++)
+    {
+        mError[axis] = 0;
+    }
+
+    if(mSegmentIndex < mSegmentCount)
+    {
+        mPeriod_InUS = mSegment[mSegmentIndex].entryPeriod_InUS;
+    }
+}
@@ -0,0 +1,124 @@
+/*
+StepEngine - Keyframe step source
+Description: Moves a set of FlexyStepper's trough a list of keyframes (a
+position for every axis plus the time to be there), without stopping at the
+keyframes in between.
+
+The whole sequence is planned before the motion starts. Every stretch between
+two keyframes becomes a segment that moves all axes along a straight line,
+like CoordinatedStepSource does: the axis with the longest move sets the pace,
+the other axes are spread over its steps with Bresenham's algorithm.
+
+Junction velocities are planned with look-ahead: at every keyframe both
+segments are slowed down by the same factor until no axis changes its velocity
+by more than it would on the first step from standstill. A reverse and a
+forward pass then make sure every junction velocity can be reached (and left)
+within the acceleration limits of its segments. Last, the cruise speed of each
+segment is picked so the segment (ramps included) takes the time between its
+keyframes. A segment that can't make it in time takes as long as it needs, the
+following keyframes are reached that much later.
+
+While running, nextEvent() only walks the precomputed segment list, the cost
+of a step does not depend on the number of keyframes.
+*/
+
+#ifndef __KEYFRAME_STEP_SOURCE__
+#define __KEYFRAME_STEP_SOURCE__
+
+#include "StepEngine.h"
+
+#define KEYFRAME_MAX_KEYFRAMES      16
+#define KEYFRAME_MAX_SEGMENTS       (KEYFRAME_MAX_KEYFRAMES - 1)
+
+struct Keyframe
+{
+    long position_InSteps[STEP_ENGINE_MAX_AXES];
+    float time_InSeconds;                           // Since the first keyframe
+};
+
+class KeyframeStepSource : public StepSource
+{
+    public:
+        KeyframeStepSource();
+
+        template <class Stepper>
+        void attachStepper(uint8_t axis, Stepper *pStepper)
+        {
+            if(axis >= STEP_ENGINE_MAX_AXES)
+            {
+                return;
+            }
+
+            mpStepper[axis] = pStepper;
+            mpGetPosition[axis] = getPosition<Stepper>;
+            mpSetTarget[axis] = setTarget<Stepper>;
+            mpSetPosition[axis] = setPosition<Stepper>;
+        }
+
+        bool plan(const Keyframe *pKeyframes, uint8_t count, const float *pSpeed_InStepsPerSecond, const float *pAcceleration_InStepsPerSecondPerSecond);
+        float getDuration(void);
+
+        bool nextEvent(StepEvent *pEvent);
+
+    private:
+        typedef long (*GetPosition)(void *pStepper);
+        typedef void (*SetTarget)(void *pStepper, long target_InSteps);
+        typedef void (*SetPosition)(void *pStepper, long position_InSteps);
+
+        // One straight move between two keyframes, in steps of its major axis
+        struct Segment
+        {
+            long distance_InSteps[STEP_ENGINE_MAX_AXES];
+            uint8_t directionMask;
+            long majorDistance_InSteps;                 // 0 -> stand still for dwell_InUS
+            uint32_t dwell_InUS;
+            long accelerateUntil_InSteps;
+            long decelerateFrom_InSteps;
+            float entryPeriod_InUS;
+            float cruisePeriod_InUS;
+            float exitPeriod_InUS;
+            float acceleration_InStepsPerUSPerUS;
+        };
+
+        template <class Stepper>
+        static long getPosition(void *pStepper)
+        {
+            return ((Stepper *)pStepper)->getCurrentPositionInSteps();
+        }
+
+        // Stepper stands still and only keeps track of the sequence
+        template <class Stepper>
+        static void setTarget(void *pStepper, long target_InSteps)
+        {
+            ((Stepper *)pStepper)->abortMotion(((Stepper *)pStepper)->getCurrentPositionInSteps());
+            ((Stepper *)pStepper)->setTargetPositionInSteps(target_InSteps);
+        }
+
+        template <class Stepper>
+        static void setPosition(void *pStepper, long position_InSteps)
+        {
+            ((Stepper *)pStepper)->setCurrentPositionInSteps(position_InSteps);
+        }
+
+        float scaleToMajor(const Segment &segment, const float *pLimit);
+        void startSegment(void);
+
+        void *mpStepper[STEP_ENGINE_MAX_AXES];
+        GetPosition mpGetPosition[STEP_ENGINE_MAX_AXES];
+        SetTarget mpSetTarget[STEP_ENGINE_MAX_AXES];
+        SetPosition mpSetPosition[STEP_ENGINE_MAX_AXES];
+
+        Segment mSegment[KEYFRAME_MAX_SEGMENTS];
+        uint8_t mSegmentCount;
+        float mDuration_InSeconds;
+
+        // State of the running segment
+        uint8_t mSegmentIndex;
+        long mStep;
+        long mError[STEP_ENGINE_MAX_AXES];
+        long mPosition_InSteps[STEP_ENGINE_MAX_AXES];
+        float mPeriod_InUS;
+        float mPeriodFraction;
+};
+
+#endif
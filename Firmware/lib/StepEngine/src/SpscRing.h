@@ -0,0 +1,90 @@
+/*
+StepEngine - Single producer, single consumer ring buffer
+Description: Lock-free queue between exactly one producer and one consumer,
+which may run on different cores (i.e. a planning task and a timer interrupt).
+
+Head is only written by the producer, tail only by the consumer. An item is
+written before the head that publishes it (release) and read after the head
+was loaded (acquire), so neither side ever has to wait for the other one.
+Indexes run freely and wrap at 2^16, Length has to be a power of two.
+*/
+
+#ifndef __SPSC_RING__
+#define __SPSC_RING__
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Consumer side is used from interrupts, it has to end up inside the
+// (IRAM) interrupt handler instead of being called in flash
+#define SPSC_RING_INLINE    inline __attribute__((always_inline))
+
+template <class T, uint16_t Length>
+class SpscRing
+{
+    static_assert((Length & (Length - 1)) == 0, "Length has to be a power of two");
+
+    public:
+        SpscRing()
+        {
+            mHead = 0;
+            mTail = 0;
+        }
+
+        // Producer: add an item, false if the ring is full
+        SPSC_RING_INLINE bool push(const T &item)
+        {
+            uint16_t head = mHead;
+
+            if((uint16_t)(head - __atomic_load_n(&mTail, __ATOMIC_ACQUIRE)) >= Length)
+            {
+                return false;
+            }
+
+            mItem[head & (Length - 1)] = item;
+            __atomic_store_n(&mHead, (uint16_t)(head + 1), __ATOMIC_RELEASE);
+
+            return true;
+        }
+
+        // Consumer: oldest item, NULL if the ring is empty
+        SPSC_RING_INLINE T *front(void)
+        {
+            uint16_t tail = mTail;
+
+            if(__atomic_load_n(&mHead, __ATOMIC_ACQUIRE) == tail)
+            {
+                return NULL;
+            }
+
+            return &mItem[tail & (Length - 1)];
+        }
+
+        // Consumer: drop the item returned by front()
+        SPSC_RING_INLINE void pop(void)
+        {
+            __atomic_store_n(&mTail, (uint16_t)(mTail + 1), __ATOMIC_RELEASE);
+        }
+
+        // Consumer: drop everything, only the consumer side may call this
+        SPSC_RING_INLINE void clear(void)
+        {
+            __atomic_store_n(&mTail, __atomic_load_n(&mHead, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+        }
+
+        // Either side, the other side may change it right after
+        SPSC_RING_INLINE uint16_t size(void)
+        {
+            return (uint16_t)(__atomic_load_n(&mHead, __ATOMIC_ACQUIRE) - __atomic_load_n(&mTail, __ATOMIC_ACQUIRE));
+        }
+
+        SPSC_RING_INLINE bool isEmpty(void) { return size() == 0; }
+        SPSC_RING_INLINE bool isFull(void) { return size() >= Length; }
+
+    private:
+        T mItem[Length];
+        uint16_t mHead;                     // Next slot to write, producer only
+        uint16_t mTail;                     // Next slot to read, consumer only
+};
+
+#endif
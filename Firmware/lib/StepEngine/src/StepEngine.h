@@ -0,0 +1,792 @@
+/*
+StepEngine
+Description: Timer driven step pulse generator.
+
+The motion is planned ahead (in task context) by a StepSource into a queue of
+step events. The alarm interrupt of a hardware timer consumes the queue, emits
+the step pulses and reprograms the alarm for the next event, so the pulse
+timing no longer depends on how often the main loop gets to run.
+
+Planner (refill) and executor (alarm interrupt) can run on different cores.
+The queue between them is a lock-free single producer, single consumer ring
+(SpscRing.h), the interrupt never waits for the planner. If the planner falls
+behind and the queue runs dry while the source still has steps, the executor
+counts an underrun and hands the timer back, the planner restarts it with the
+next event it queues. Underruns and the lowest queue level seen tell if the
+queue is deep enough (getUnderrunCount(), getQueueLowWater()).
+
+For every step the executor records how late it fired against the time it was
+scheduled for, in a log scale histogram per axis (getTiming()). Steps later than
+the deadline (setDeadline()) are counted as missed.
+
+A position trigger (armTrigger()) compares the position of one axis on every
+step it makes, like the compare unit of a hardware timer. On the step that lands
+on the trigger position the executor calls the trigger handler, still inside
+the step interrupt. With a lead time it fires that much earlier instead, as soon
+as the steps left to the position take less than the lead at the current step
+rate. The trigger disarms itself when it fires, the handler can arm the next one.
+
+brake() is a stop with bounded deceleration that can be requested from an
+interrupt (i.e. an endstop). The executor keeps emitting the planned steps,
+but stretches the time between them so the speed of all axes falls linearly
+to a crawl, then it stops like stop(). Every emitted step is counted, so the
+position stays valid and all axes stay on their common path.
+
+All hardware access goes trough the HAL class given as template parameter.
+A HAL has to provide:
+    uint32_t nowInUS(void)                  - free running microsecond clock
+    void armAlarmAt(uint32_t timeInUS)      - call onAlarm() at given time (or asap if in the past)
+    void disarmAlarm(void)
+    void writeDirections(uint8_t axisMask, uint8_t negativeMask) - direction pins of all axes in axisMask at once
+    void writeSteps(uint8_t axisMask, bool level) - step pins of all axes in axisMask at once
+    void holdStepPulse(void)                - minimum step pulse (and direction setup) time
+    void requestRefill(void)                - ask producer context to call refill()
+    void lockSource(void) / unlockSource(void) - mutex protecting the StepSource
+
+See StepEngineHal_ESP32.h for the target and StepEngineHal_Virtual.h for a
+virtual clock that runs the very same scheduler on a host.
+*/
+
+#ifndef __STEP_ENGINE__
+#define __STEP_ENGINE__
+
+#include <stdint.h>
+#include <stddef.h>
+#include "SpscRing.h"
+
+#ifdef ARDUINO_ARCH_ESP32
+#include <esp_attr.h>
+#define STEP_ENGINE_ISR_ATTR        IRAM_ATTR
+#else
+#define STEP_ENGINE_ISR_ATTR
+#endif
+
+#define STEP_ENGINE_MAX_AXES        4
+#define STEP_ENGINE_QUEUE_LENGTH    256     // Has to be a power of two, ~8ms at 30k steps/s
+#define STEP_ENGINE_REFILL_LEVEL    (STEP_ENGINE_QUEUE_LENGTH / 2)
+#define STEP_ENGINE_JITTER_BUCKETS  16
+#define STEP_ENGINE_DEFAULT_DEADLINE_US 50
+#define STEP_ENGINE_BRAKE_MAX_US    1000000 // Longest brake, slower decelerations are cut short
+#define STEP_ENGINE_BRAKE_ONE       4096    // Full speed, fixed point speed factor while braking
+#define STEP_ENGINE_BRAKE_MIN       128     // Stop dead below 1/32 of the speed the brake started at
+#define STEP_ENGINE_BRAKE_MAX_DELAY (1UL << 20) // Events further apart than this are a standstill
+
+// One entry of the step queue
+struct StepEvent
+{
+    uint32_t delay_InUS;        // Time between the previous event and this one
+    uint8_t stepMask;           // Bit per axis, set if the axis steps on this event
+    uint8_t directionMask;      // Bit per axis, set if the step is in negative direction
+};
+
+// Timing of the steps of one axis, how late they were emitted against their schedule.
+// Histogram bucket 0 counts steps on time, bucket n steps 2^(n-1)..2^n-1 us late,
+// the last bucket everything later than that.
+struct StepTiming
+{
+    uint32_t steps;
+    uint32_t missedDeadlines;
+    uint32_t maxLateness_InUS;
+    uint32_t histogram[STEP_ENGINE_JITTER_BUCKETS];
+};
+
+// Anything that can plan steps for the engine (i.e. a set of FlexyStepper's)
+// nextEvent() is always called from task context, it is fine to do floating
+// point math in here. Return false once the motion is complete.
+class StepSource
+{
+    public:
+        virtual bool nextEvent(StepEvent *pEvent) = 0;
+};
+
+// Called from the step interrupt when a position trigger fires, with the
+// position the axis is at. Has to be interrupt safe (and in IRAM on the ESP32).
+typedef void (*StepTriggerHandler)(void *pContext, uint8_t axis, long position);
+
+template <class Hal>
+class StepEngine
+{
+    public:
+        StepEngine(Hal &hal);
+
+        void start(StepSource *pSource);
+        void stop(void);
+        void brake(uint8_t axis, uint32_t decel_InStepsPerSecondPerSecond);
+        void refill(void);
+        void onAlarm(void);
+
+        bool isIdle(void);
+        bool isBraking(void);
+        StepSource *getSource(void);
+        long getPosition(uint8_t axis);
+        void setPosition(uint8_t axis, long position);
+        uint32_t getLastStepTime(void);
+        long getVelocity(uint8_t axis);
+        int getDirection(uint8_t axis);
+
+        uint32_t getUnderrunCount(void);
+        uint16_t getQueueLowWater(void);
+        void resetStatistics(void);
+
+        void getTiming(uint8_t axis, StepTiming *pTiming);
+        void resetTiming(void);
+        void setDeadline(uint32_t deadline_InUS);
+        uint32_t getDeadline(void);
+
+        void lockSource(void);
+        void unlockSource(void);
+
+        void setTriggerHandler(StepTriggerHandler handler, void *pContext);
+        void armTrigger(uint8_t axis, long position, uint32_t lead_InUS);
+        void disarmTrigger(void);
+        bool isTriggerArmed(void);
+
+    private:
+        // Who owns the timer alarm
+        enum
+        {
+            TIMER_IDLE = 0,                     // Nobody, the planner may start it
+            TIMER_RUNNING,                      // Executor, alarm reprograms itself
+            TIMER_STOPPED                       // Nobody, queue holds stale events until the next refill()
+        };
+
+        bool changeTimerState(uint32_t from, uint32_t to);
+        void armFirstEvent(void);
+        void checkTrigger(uint8_t axis, bool negative);
+        bool stretchForBrake(uint32_t *pDelay_InUS);
+
+        Hal &mHal;
+
+        SpscRing<StepEvent, STEP_ENGINE_QUEUE_LENGTH> mQueue;
+
+        StepSource * volatile mpSource;
+        volatile bool mSourceFinished;
+        uint32_t mTimerState;                   // TIMER_xxx, only changed atomically
+        uint32_t mInAlarm;                      // Executor is inside onAlarm()
+        uint32_t mDueTime_InUS;                 // When the event at the queue tail is due
+
+        uint8_t mDirectionState;                // Last level written to the direction pins
+        uint8_t mDirectionValid;                // Direction pins we trust mDirectionState for
+        volatile long mPosition[STEP_ENGINE_MAX_AXES];
+        uint32_t mLastDue_InUS[STEP_ENGINE_MAX_AXES];   // When the last step of each axis was due
+        uint32_t mStepPeriod_InUS[STEP_ENGINE_MAX_AXES];
+        volatile uint8_t mStepNegative;         // Axes whose last step went backwards
+        volatile uint32_t mLastStep_InUS;       // When the last step was emitted, any axis
+
+        volatile uint32_t mUnderrunCount;       // Queue ran dry while the source had more steps
+        volatile uint16_t mQueueLowWater;       // Fewest events queued after a step, while planning
+
+        StepTiming mTiming[STEP_ENGINE_MAX_AXES];   // Written by the executor only
+        volatile uint32_t mDeadline_InUS;
+
+        StepTriggerHandler mTriggerHandler;
+        void *mpTriggerContext;
+        volatile bool mTriggerArmed;
+        volatile uint8_t mTriggerAxis;
+        volatile long mTriggerPosition;
+        volatile uint32_t mTriggerLead_InUS;
+        uint32_t mTriggerLastDue_InUS;          // When the last step of the trigger axis was due
+        bool mTriggerLastValid;
+
+        volatile bool mBraking;
+        uint32_t mBrakeTime_InUS;               // From full speed to standstill
+        uint32_t mBrakeElapsed_InUS;
+};
+
+
+template <class Hal>
+StepEngine<Hal>::StepEngine(Hal &hal) : mHal(hal)
+{
+    mpSource = NULL;
+    mSourceFinished = true;
+    mTimerState = TIMER_IDLE;
+    mInAlarm = 0;
+    mDueTime_InUS = 0;
+    mDirectionState = 0;
+    mDirectionValid = 0;
+    mUnderrunCount = 0;
+    mQueueLowWater = STEP_ENGINE_QUEUE_LENGTH;
+    mDeadline_InUS = STEP_ENGINE_DEFAULT_DEADLINE_US;
+    mTriggerHandler = NULL;
+    mpTriggerContext = NULL;
+    mTriggerArmed = false;
+    mTriggerAxis = 0;
+    mTriggerPosition = 0;
+    mTriggerLead_InUS = 0;
+    mTriggerLastDue_InUS = 0;
+    mTriggerLastValid = false;
+    mLastStep_InUS = 0;
+    mStepNegative = 0;
+    mBraking = false;
+    mBrakeTime_InUS = 0;
+    mBrakeElapsed_InUS = 0;
+
+    for(uint8_t axis = 0; axis < STEP_ENGINE_MAX_AXES; axis++)
+    {
+        mPosition[axis] = 0;
+        mLastDue_InUS[axis] = 0;
+        mStepPeriod_InUS[axis] = 0;
+    }
+
+    resetTiming();
+}
+
+// Start (or continue) executing steps planned by pSource.
+// Call this every time the targets of the source change, without holding
+// the source lock. Waits for the planner to finish its current batch.
+template <class Hal>
+void StepEngine<Hal>::start(StepSource *pSource)
+{
+    mHal.lockSource();
+    if(__atomic_load_n(&mTimerState, __ATOMIC_SEQ_CST) != TIMER_RUNNING)
+    {
+        // Direction pins could have been changed by someone else while we were idle
+        mDirectionValid = 0;
+        mTriggerLastValid = false;
+    }
+    mpSource = pSource;
+    mSourceFinished = false;
+    mHal.unlockSource();
+
+    mHal.requestRefill();
+}
+
+// Stop immediately, all queued steps are discarded (by the next refill()).
+// Safe to call from an interrupt, on any core.
+template <class Hal>
+void STEP_ENGINE_ISR_ATTR StepEngine<Hal>::stop(void)
+{
+    mpSource = NULL;
+    mSourceFinished = true;
+    mBraking = false;
+    __atomic_store_n(&mTimerState, (uint32_t)TIMER_STOPPED, __ATOMIC_SEQ_CST);
+    mHal.disarmAlarm();
+}
+
+// Stop with bounded deceleration, from the speed axis has right now at
+// decel_InStepsPerSecondPerSecond. The other axes slow down in proportion.
+// Steps keep coming until the speed is down to a crawl (or the planned
+// move ends first), then the engine stops like stop(). Once braking, a
+// start() with new targets does not end the brake. Safe to call from an
+// interrupt, on any core, an idle engine simply stays idle.
+template <class Hal>
+void STEP_ENGINE_ISR_ATTR StepEngine<Hal>::brake(uint8_t axis, uint32_t decel_InStepsPerSecondPerSecond)
+{
+    uint32_t period_InUS;
+    uint32_t since_InUS;
+    uint64_t brake_InUS;
+
+    if((axis >= STEP_ENGINE_MAX_AXES) || (__atomic_load_n(&mTimerState, __ATOMIC_SEQ_CST) != TIMER_RUNNING) ||
+       (decel_InStepsPerSecondPerSecond == 0) || mBraking)
+    {
+        if(!mBraking)
+        {
+            stop();
+        }
+        return;
+    }
+
+    // Speed of the axis from its last step period, or slower if it has not stepped for longer
+    period_InUS = mStepPeriod_InUS[axis];
+    since_InUS = mDueTime_InUS - mLastDue_InUS[axis];
+    if(since_InUS > period_InUS)
+    {
+        period_InUS = since_InUS;
+    }
+
+    // Time to stop: speed / deceleration = 1e12 / (period * deceleration)
+    brake_InUS = (period_InUS == 0) ? 0 : (1000000000000ULL / ((uint64_t)period_InUS * decel_InStepsPerSecondPerSecond));
+    if(brake_InUS == 0)
+    {
+        stop();
+        return;
+    }
+
+    mBrakeTime_InUS = (brake_InUS > STEP_ENGINE_BRAKE_MAX_US) ? STEP_ENGINE_BRAKE_MAX_US : (uint32_t)brake_InUS;
+    mBrakeElapsed_InUS = 0;
+    mBraking = true;
+}
+
+// Top up the step queue from the active source.
+// Must be called from task context, one producer only.
+template <class Hal>
+void StepEngine<Hal>::refill(void)
+{
+    StepSource *pSource;
+    StepEvent event;
+
+    mHal.lockSource();
+
+    // After a stop the executor is out of the way, drop what it left in the queue.
+    // It could still be finishing the alarm it was in when stop() was called.
+    if(__atomic_load_n(&mTimerState, __ATOMIC_SEQ_CST) == TIMER_STOPPED)
+    {
+        while(__atomic_load_n(&mInAlarm, __ATOMIC_SEQ_CST))
+        {
+        }
+        mQueue.clear();
+        changeTimerState(TIMER_STOPPED, TIMER_IDLE);
+    }
+
+    pSource = mpSource;
+    while((pSource != NULL) && !mQueue.isFull())
+    {
+        if(!pSource->nextEvent(&event))
+        {
+            if(mpSource == pSource)
+            {
+                mSourceFinished = true;
+            }
+            break;
+        }
+
+        // Source could have been stopped while we were planning
+        if(mpSource != pSource)
+        {
+            break;
+        }
+
+        mQueue.push(event);
+
+        // Idle or starved, (re)start the timer from this event
+        if(changeTimerState(TIMER_IDLE, TIMER_RUNNING))
+        {
+            armFirstEvent();
+        }
+    }
+
+    mHal.unlockSource();
+}
+
+// Timer alarm handler, emits the step event at the queue tail and
+// schedules the next one. Never waits for the planner.
+template <class Hal>
+void STEP_ENGINE_ISR_ATTR StepEngine<Hal>::onAlarm(void)
+{
+    StepEvent *pEvent;
+    uint8_t directionChange;
+    uint8_t axis;
+    uint32_t now;
+    uint32_t delay;
+    uint32_t lateness_InUS;
+    uint8_t bucket;
+    uint16_t queued;
+
+    // Tell refill() we are using the queue before looking at the timer state
+    __atomic_store_n(&mInAlarm, (uint32_t)1, __ATOMIC_SEQ_CST);
+
+    pEvent = mQueue.front();
+    if((__atomic_load_n(&mTimerState, __ATOMIC_SEQ_CST) != TIMER_RUNNING) || (pEvent == NULL))
+    {
+        __atomic_store_n(&mInAlarm, (uint32_t)0, __ATOMIC_SEQ_CST);
+        return;
+    }
+
+    // How late we are, alarm never fires early
+    now = mHal.nowInUS();
+    lateness_InUS = now - mDueTime_InUS;
+    if((int32_t)lateness_InUS < 0)
+    {
+        lateness_InUS = 0;
+    }
+
+    // Update direction pins first, they need some setup time before the step edge
+    directionChange = ((pEvent->directionMask ^ mDirectionState) | (uint8_t)~mDirectionValid) & pEvent->stepMask;
+    if(directionChange)
+    {
+        mHal.writeDirections(directionChange, pEvent->directionMask);
+        mDirectionState = (mDirectionState & ~directionChange) | (pEvent->directionMask & directionChange);
+        mDirectionValid |= directionChange;
+        mHal.holdStepPulse();
+    }
+
+    // Step pulse, all axes stepping on this event share the same edges
+    if(pEvent->stepMask)
+    {
+        mHal.writeSteps(pEvent->stepMask, true);
+        mHal.holdStepPulse();
+        mHal.writeSteps(pEvent->stepMask, false);
+        mLastStep_InUS = now;
+
+        for(axis = 0; axis < STEP_ENGINE_MAX_AXES; axis++)
+        {
+            if(!(pEvent->stepMask & (1 << axis)))
+            {
+                continue;
+            }
+
+            mPosition[axis] += ((pEvent->directionMask >> axis) & 1) ? -1 : 1;
+            mStepPeriod_InUS[axis] = mDueTime_InUS - mLastDue_InUS[axis];
+            mLastDue_InUS[axis] = mDueTime_InUS;
+            mStepNegative = (mStepNegative & ~(1 << axis)) | (pEvent->directionMask & (1 << axis));
+
+            if(mTriggerArmed && (axis == mTriggerAxis))
+            {
+                checkTrigger(axis, (pEvent->directionMask >> axis) & 1);
+            }
+
+            // Log scale bucket, number of significant bits of the lateness
+            bucket = (lateness_InUS == 0) ? 0 : (32 - __builtin_clz(lateness_InUS));
+            if(bucket >= STEP_ENGINE_JITTER_BUCKETS)
+            {
+                bucket = STEP_ENGINE_JITTER_BUCKETS - 1;
+            }
+            mTiming[axis].histogram[bucket]++;
+            mTiming[axis].steps++;
+            if(lateness_InUS > mDeadline_InUS)
+            {
+                mTiming[axis].missedDeadlines++;
+            }
+            if(lateness_InUS > mTiming[axis].maxLateness_InUS)
+            {
+                mTiming[axis].maxLateness_InUS = lateness_InUS;
+            }
+        }
+    }
+
+    mQueue.pop();
+
+    // Schedule next event relative to when this one was due, so small
+    // interrupt latencies do not add up. If we are late by more than
+    // a whole step period, start counting from now instead.
+    pEvent = mQueue.front();
+    if((pEvent != NULL) && mBraking && !stretchForBrake(&pEvent->delay_InUS))
+    {
+        // Down to a crawl, the rest of the queue is dropped
+        stop();
+        pEvent = NULL;
+    }
+    else if(pEvent != NULL)
+    {
+        delay = pEvent->delay_InUS;
+        now = mHal.nowInUS();
+        if((int32_t)(now - mDueTime_InUS) > (int32_t)delay)
+        {
+            mDueTime_InUS = now;
+        }
+        mDueTime_InUS += delay;
+        mHal.armAlarmAt(mDueTime_InUS);
+    }
+    else
+    {
+        if(!mSourceFinished)
+        {
+            mUnderrunCount = mUnderrunCount + 1;
+        }
+        else
+        {
+            // Planned move ended before the brake did
+            mBraking = false;
+        }
+
+        // Hand the timer back to the planner. It could have queued an event
+        // after we looked, then nobody would restart the timer, so look again.
+        if(changeTimerState(TIMER_RUNNING, TIMER_IDLE) && !mQueue.isEmpty() && changeTimerState(TIMER_IDLE, TIMER_RUNNING))
+        {
+            armFirstEvent();
+        }
+    }
+
+    // stop() could have run on the other core while we were stepping
+    if(__atomic_load_n(&mTimerState, __ATOMIC_SEQ_CST) == TIMER_STOPPED)
+    {
+        mHal.disarmAlarm();
+    }
+
+    queued = mQueue.size();
+    if(!mSourceFinished && (queued < mQueueLowWater))
+    {
+        mQueueLowWater = queued;
+    }
+
+    __atomic_store_n(&mInAlarm, (uint32_t)0, __ATOMIC_SEQ_CST);
+
+    if((queued <= STEP_ENGINE_REFILL_LEVEL) && !mSourceFinished)
+    {
+        mHal.requestRefill();
+    }
+}
+
+// True once the source has no more steps to plan and all queued steps
+// were emitted
+template <class Hal>
+bool STEP_ENGINE_ISR_ATTR StepEngine<Hal>::isIdle(void)
+{
+    return mSourceFinished && (__atomic_load_n(&mTimerState, __ATOMIC_SEQ_CST) != TIMER_RUNNING);
+}
+
+template <class Hal>
+bool StepEngine<Hal>::isBraking(void)
+{
+    return mBraking;
+}
+
+// Source the steps come from, NULL after stop()
+template <class Hal>
+StepSource *StepEngine<Hal>::getSource(void)
+{
+    return mpSource;
+}
+
+// Position of the motor in steps, counting only steps that were emitted
+template <class Hal>
+long STEP_ENGINE_ISR_ATTR StepEngine<Hal>::getPosition(uint8_t axis)
+{
+    if(axis >= STEP_ENGINE_MAX_AXES)
+    {
+        return 0;
+    }
+
+    return mPosition[axis];
+}
+
+// Should only be called while the engine is idle
+template <class Hal>
+void StepEngine<Hal>::setPosition(uint8_t axis, long position)
+{
+    if(axis >= STEP_ENGINE_MAX_AXES)
+    {
+        return;
+    }
+
+    mPosition[axis] = position;
+}
+
+// When the last step pulse (of any axis) went out, on the clock of the HAL
+template <class Hal>
+uint32_t StepEngine<Hal>::getLastStepTime(void)
+{
+    return mLastStep_InUS;
+}
+
+// Speed of the motor in steps/s from the time between its last two steps, negative
+// when it stepped backwards. 0 once the axis was quiet for two of those periods.
+template <class Hal>
+long StepEngine<Hal>::getVelocity(uint8_t axis)
+{
+    uint32_t period_InUS;
+    uint32_t since_InUS;
+    long velocity;
+
+    if(axis >= STEP_ENGINE_MAX_AXES)
+    {
+        return 0;
+    }
+
+    period_InUS = mStepPeriod_InUS[axis];
+    since_InUS = mHal.nowInUS() - mLastDue_InUS[axis];
+    if((period_InUS == 0) || (since_InUS > 2 * period_InUS))
+    {
+        return 0;
+    }
+
+    velocity = 1000000 / period_InUS;
+    return (mStepNegative & (1 << axis)) ? -velocity : velocity;
+}
+
+// Direction of the last step of the motor, 1 or -1 when it stepped backwards
+template <class Hal>
+int STEP_ENGINE_ISR_ATTR StepEngine<Hal>::getDirection(uint8_t axis)
+{
+    if(axis >= STEP_ENGINE_MAX_AXES)
+    {
+        return 1;
+    }
+
+    return (mStepNegative & (1 << axis)) ? -1 : 1;
+}
+
+// Number of times the executor found the queue empty while the source still
+// had steps to plan. Every underrun stretches the step period it hit.
+template <class Hal>
+uint32_t StepEngine<Hal>::getUnderrunCount(void)
+{
+    return mUnderrunCount;
+}
+
+// Fewest events that were queued after a step, STEP_ENGINE_QUEUE_LENGTH if
+// nothing ran yet. Close to 0 means the queue is barely deep enough.
+template <class Hal>
+uint16_t StepEngine<Hal>::getQueueLowWater(void)
+{
+    return mQueueLowWater;
+}
+
+template <class Hal>
+void StepEngine<Hal>::resetStatistics(void)
+{
+    mUnderrunCount = 0;
+    mQueueLowWater = STEP_ENGINE_QUEUE_LENGTH;
+}
+
+// Copy of the step timing of one axis. The executor keeps counting while
+// this runs, counters of the copy can be a step apart from each other.
+template <class Hal>
+void StepEngine<Hal>::getTiming(uint8_t axis, StepTiming *pTiming)
+{
+    if(axis >= STEP_ENGINE_MAX_AXES)
+    {
+        return;
+    }
+
+    *pTiming = mTiming[axis];
+}
+
+// Start over with the step timing of all axes. Steps emitted while this
+// runs could still end up in the old numbers.
+template <class Hal>
+void StepEngine<Hal>::resetTiming(void)
+{
+    for(uint8_t axis = 0; axis < STEP_ENGINE_MAX_AXES; axis++)
+    {
+        mTiming[axis].steps = 0;
+        mTiming[axis].missedDeadlines = 0;
+        mTiming[axis].maxLateness_InUS = 0;
+        for(uint8_t bucket = 0; bucket < STEP_ENGINE_JITTER_BUCKETS; bucket++)
+        {
+            mTiming[axis].histogram[bucket] = 0;
+        }
+    }
+}
+
+// Steps emitted more than deadline_InUS after they were due count as missed
+template <class Hal>
+void StepEngine<Hal>::setDeadline(uint32_t deadline_InUS)
+{
+    mDeadline_InUS = deadline_InUS;
+}
+
+template <class Hal>
+uint32_t StepEngine<Hal>::getDeadline(void)
+{
+    return mDeadline_InUS;
+}
+
+// Anyone changing the state of the step source (i.e. setting new targets
+// on a stepper) while the engine runs needs to hold this lock
+template <class Hal>
+void StepEngine<Hal>::lockSource(void)
+{
+    mHal.lockSource();
+}
+
+template <class Hal>
+void StepEngine<Hal>::unlockSource(void)
+{
+    mHal.unlockSource();
+}
+
+// Call handler when a position trigger fires, set before arming the first trigger
+template <class Hal>
+void StepEngine<Hal>::setTriggerHandler(StepTriggerHandler handler, void *pContext)
+{
+    mTriggerArmed = false;
+    mpTriggerContext = pContext;
+    mTriggerHandler = handler;
+}
+
+// Fire the trigger handler once, on the step of axis that lands on position.
+// With lead_InUS > 0 it fires as soon as the steps left to position take less
+// than lead_InUS at the current step rate. Can be called from the trigger
+// handler to arm the next trigger.
+template <class Hal>
+void STEP_ENGINE_ISR_ATTR StepEngine<Hal>::armTrigger(uint8_t axis, long position, uint32_t lead_InUS)
+{
+    if((axis >= STEP_ENGINE_MAX_AXES) || (mTriggerHandler == NULL))
+    {
+        return;
+    }
+
+    mTriggerArmed = false;
+    if(axis != mTriggerAxis)
+    {
+        mTriggerLastValid = false;
+    }
+    mTriggerAxis = axis;
+    mTriggerPosition = position;
+    mTriggerLead_InUS = lead_InUS;
+    mTriggerArmed = true;
+}
+
+template <class Hal>
+void STEP_ENGINE_ISR_ATTR StepEngine<Hal>::disarmTrigger(void)
+{
+    mTriggerArmed = false;
+}
+
+template <class Hal>
+bool StepEngine<Hal>::isTriggerArmed(void)
+{
+    return mTriggerArmed;
+}
+
+// Position compare of the trigger axis, right after it stepped. Steps left to
+// the trigger position are counted in the direction the axis moves, moving
+// away it never fires.
+template <class Hal>
+void STEP_ENGINE_ISR_ATTR StepEngine<Hal>::checkTrigger(uint8_t axis, bool negative)
+{
+    long left = negative ? (mPosition[axis] - mTriggerPosition) : (mTriggerPosition - mPosition[axis]);
+    uint32_t period_InUS = mDueTime_InUS - mTriggerLastDue_InUS;
+    bool fire = (left == 0);
+
+    if(!fire && (left > 0) && (mTriggerLead_InUS > 0) && mTriggerLastValid)
+    {
+        fire = ((uint64_t)left * period_InUS <= mTriggerLead_InUS);
+    }
+
+    mTriggerLastDue_InUS = mDueTime_InUS;
+    mTriggerLastValid = true;
+
+    if(fire)
+    {
+        mTriggerArmed = false;
+        mTriggerHandler(mpTriggerContext, axis, mPosition[axis]);
+    }
+}
+
+// Stretch the delay of the next event for the brake. The speed factor falls
+// linearly over the brake time, from STEP_ENGINE_BRAKE_ONE to 0, counted in
+// the stretched time that was emitted since braking began. False once the
+// brake is over and the engine has to stop.
+template <class Hal>
+bool STEP_ENGINE_ISR_ATTR StepEngine<Hal>::stretchForBrake(uint32_t *pDelay_InUS)
+{
+    uint32_t speed;
+
+    if((mBrakeElapsed_InUS >= mBrakeTime_InUS) || (*pDelay_InUS >= STEP_ENGINE_BRAKE_MAX_DELAY))
+    {
+        return false;
+    }
+
+    speed = STEP_ENGINE_BRAKE_ONE - (mBrakeElapsed_InUS * STEP_ENGINE_BRAKE_ONE) / mBrakeTime_InUS;
+    if(speed < STEP_ENGINE_BRAKE_MIN)
+    {
+        return false;
+    }
+
+    *pDelay_InUS = (*pDelay_InUS * STEP_ENGINE_BRAKE_ONE) / speed;
+    mBrakeElapsed_InUS += *pDelay_InUS;
+
+    return true;
+}
+
+// Hand the timer over, only if nobody else changed its state in the meantime.
+// Planner and executor can race for it, only one of them wins.
+template <class Hal>
+bool STEP_ENGINE_ISR_ATTR StepEngine<Hal>::changeTimerState(uint32_t from, uint32_t to)
+{
+    return __atomic_compare_exchange_n(&mTimerState, &from, to, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+// Start the timer from the event at the queue tail, caller owns the timer
+template <class Hal>
+void STEP_ENGINE_ISR_ATTR StepEngine<Hal>::armFirstEvent(void)
+{
+    StepEvent *pEvent = mQueue.front();
+
+    mDueTime_InUS = mHal.nowInUS() + pEvent->delay_InUS;
+    mHal.armAlarmAt(mDueTime_InUS);
+}
+
+#endif
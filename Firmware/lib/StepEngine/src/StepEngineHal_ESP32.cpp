@@ -0,0 +1,252 @@
+/*
+StepEngine - ESP32 HAL
+Description: Runs the StepEngine from the alarm interrupt of one of the ESP32
+general purpose timers.
+*/
+
+#ifdef ARDUINO_ARCH_ESP32
+
+#include "StepEngineHal_ESP32.h"
+
+StepEngineHal_ESP32::StepEngineHal_ESP32()
+{
+    mpTimer = NULL;
+    mpTimerGroup = &TIMERG0;
+    mTimerIndex = 0;
+    mSourceMutex = NULL;
+    mRefillTask = NULL;
+    mpRefillHandler = NULL;
+
+    for(uint8_t axis = 0; axis < STEP_ENGINE_MAX_AXES; axis++)
+    {
+        mStepPin[axis] = 0xFF;
+        mDirectionPin[axis] = 0xFF;
+    }
+
+    buildPinMasks();
+}
+
+// Configure the timer and start the refill task.
+// Call this from STEP_ENGINE_EXECUTOR_CORE, the alarm interrupt is allocated
+// on the calling core.
+//      - timerNumber   -> 0..3, timer used for step generation
+//      - alarmHandler  -> IRAM function calling StepEngine::onAlarm()
+//      - refillHandler -> function calling StepEngine::refill()
+void StepEngineHal_ESP32::begin(uint8_t timerNumber, void (*alarmHandler)(void), void (*refillHandler)(void))
+{
+    mpTimerGroup = (timerNumber < 2) ? &TIMERG0 : &TIMERG1;
+    mTimerIndex = timerNumber % 2;
+    mpRefillHandler = refillHandler;
+
+    if(xPortGetCoreID() != STEP_ENGINE_EXECUTOR_CORE)
+    {
+        log_w("Step engine interrupt runs on core %d, not on %d", xPortGetCoreID(), STEP_ENGINE_EXECUTOR_CORE);
+    }
+
+    mSourceMutex = xSemaphoreCreateMutex();
+    xTaskCreatePinnedToCore(refillTask, "StepEngine", STEP_ENGINE_REFILL_STACK, this, STEP_ENGINE_REFILL_PRIORITY, &mRefillTask, STEP_ENGINE_REFILL_CORE);
+
+    // Free running counter, alarm is only enabled when a step is due
+    mpTimer = timerBegin(timerNumber, STEP_ENGINE_TIMER_DIVIDER, true);
+    timerAttachInterrupt(mpTimer, alarmHandler, true);
+}
+
+void StepEngineHal_ESP32::attachAxis(uint8_t axis, uint8_t stepPin, uint8_t directionPin)
+{
+    if(axis >= STEP_ENGINE_MAX_AXES)
+    {
+        return;
+    }
+
+    mStepPin[axis] = stepPin;
+    mDirectionPin[axis] = directionPin;
+    buildPinMasks();
+}
+
+// Register bits for every combination of axes, so the interrupt does not have
+// to loop over the axes. Unattached axes (pin 0xFF) don't set any bit.
+void StepEngineHal_ESP32::buildPinMasks(void)
+{
+    uint8_t axisMask;
+    uint8_t axis;
+
+    for(axisMask = 0; axisMask < (1 << STEP_ENGINE_MAX_AXES); axisMask++)
+    {
+        mStepMask[axisMask].low = 0;
+        mStepMask[axisMask].high = 0;
+        mDirectionMask[axisMask].low = 0;
+        mDirectionMask[axisMask].high = 0;
+
+        for(axis = 0; axis < STEP_ENGINE_MAX_AXES; axis++)
+        {
+            if(!(axisMask & (1 << axis)))
+            {
+                continue;
+            }
+
+            if(mStepPin[axis] < 32)
+            {
+                mStepMask[axisMask].low |= (1UL << mStepPin[axis]);
+            }
+            else if(mStepPin[axis] < 40)
+            {
+                mStepMask[axisMask].high |= (1UL << (mStepPin[axis] - 32));
+            }
+
+            if(mDirectionPin[axis] < 32)
+            {
+                mDirectionMask[axisMask].low |= (1UL << mDirectionPin[axis]);
+            }
+            else if(mDirectionPin[axis] < 40)
+            {
+                mDirectionMask[axisMask].high |= (1UL << (mDirectionPin[axis] - 32));
+            }
+        }
+    }
+}
+
+uint64_t IRAM_ATTR StepEngineHal_ESP32::readCounter(void)
+{
+    mpTimerGroup->hw_timer[mTimerIndex].update = 1;
+    return ((uint64_t)mpTimerGroup->hw_timer[mTimerIndex].cnt_high << 32) | mpTimerGroup->hw_timer[mTimerIndex].cnt_low;
+}
+
+uint32_t IRAM_ATTR StepEngineHal_ESP32::nowInUS(void)
+{
+    return (uint32_t)readCounter();
+}
+
+// Timer registers are accessed directly, arduino timerAlarmWrite() is not
+// in IRAM and would crash while the flash cache is disabled (NVS writes)
+void IRAM_ATTR StepEngineHal_ESP32::armAlarmAt(uint32_t timeInUS)
+{
+    uint64_t now;
+    uint64_t alarm;
+    int32_t lead;
+
+    now = readCounter();
+    lead = (int32_t)(timeInUS - (uint32_t)now);
+    if(lead < STEP_ENGINE_MIN_ALARM_LEAD_US)
+    {
+        lead = STEP_ENGINE_MIN_ALARM_LEAD_US;
+    }
+    alarm = now + lead;
+
+    mpTimerGroup->hw_timer[mTimerIndex].alarm_high = (uint32_t)(alarm >> 32);
+    mpTimerGroup->hw_timer[mTimerIndex].alarm_low = (uint32_t)alarm;
+    mpTimerGroup->hw_timer[mTimerIndex].config.alarm_en = 1;
+}
+
+void IRAM_ATTR StepEngineHal_ESP32::disarmAlarm(void)
+{
+    mpTimerGroup->hw_timer[mTimerIndex].config.alarm_en = 0;
+}
+
+// Same levels as FlexyStepper, LOW for positive direction
+void IRAM_ATTR StepEngineHal_ESP32::writeDirections(uint8_t axisMask, uint8_t negativeMask)
+{
+    axisMask &= (1 << STEP_ENGINE_MAX_AXES) - 1;
+    negativeMask &= axisMask;
+
+    writePins(mDirectionMask[negativeMask], mDirectionMask[axisMask & ~negativeMask]);
+}
+
+void IRAM_ATTR StepEngineHal_ESP32::writeSteps(uint8_t axisMask, bool level)
+{
+    PinMask none = {0, 0};              // On the stack, constants could sit in flash
+
+    axisMask &= (1 << STEP_ENGINE_MAX_AXES) - 1;
+
+    if(level)
+    {
+        writePins(mStepMask[axisMask], none);
+    }
+    else
+    {
+        writePins(none, mStepMask[axisMask]);
+    }
+}
+
+// Set and clear pins with one write per register, pins without a bit keep their level
+void IRAM_ATTR StepEngineHal_ESP32::writePins(const PinMask &set, const PinMask &clear)
+{
+    if(set.low)
+    {
+        GPIO.out_w1ts = set.low;
+    }
+    if(clear.low)
+    {
+        GPIO.out_w1tc = clear.low;
+    }
+    if(set.high)
+    {
+        GPIO.out1_w1ts.val = set.high;
+    }
+    if(clear.high)
+    {
+        GPIO.out1_w1tc.val = clear.high;
+    }
+}
+
+void IRAM_ATTR StepEngineHal_ESP32::holdStepPulse(void)
+{
+    ets_delay_us(STEP_ENGINE_PULSE_WIDTH_US);
+}
+
+void IRAM_ATTR StepEngineHal_ESP32::requestRefill(void)
+{
+    BaseType_t higherPriorityTaskWoken = pdFALSE;
+
+    if(mRefillTask == NULL)
+    {
+        return;
+    }
+
+    if(xPortInIsrContext())
+    {
+        vTaskNotifyGiveFromISR(mRefillTask, &higherPriorityTaskWoken);
+        if(higherPriorityTaskWoken)
+        {
+            portYIELD_FROM_ISR();
+        }
+    }
+    else
+    {
+        xTaskNotifyGive(mRefillTask);
+    }
+}
+
+void StepEngineHal_ESP32::lockSource(void)
+{
+    if(mSourceMutex != NULL)
+    {
+        xSemaphoreTake(mSourceMutex, portMAX_DELAY);
+    }
+}
+
+void StepEngineHal_ESP32::unlockSource(void)
+{
+    if(mSourceMutex != NULL)
+    {
+        xSemaphoreGive(mSourceMutex);
+    }
+}
+
+// High priority task planning steps ahead of the timer interrupt.
+// Woken up by the interrupt once the queue runs half empty.
+void StepEngineHal_ESP32::refillTask(void *pParameter)
+{
+    StepEngineHal_ESP32 *pHal = (StepEngineHal_ESP32 *)pParameter;
+
+    while(1)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        if(pHal->mpRefillHandler != NULL)
+        {
+            pHal->mpRefillHandler();
+        }
+    }
+}
+
+#endif
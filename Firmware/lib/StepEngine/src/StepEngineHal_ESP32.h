@@ -0,0 +1,87 @@
+/*
+StepEngine - ESP32 HAL
+Description: Runs the StepEngine from the alarm interrupt of one of the ESP32
+general purpose timers. The timer counts microseconds (APB 80MHz / 80), the
+alarm is reprogrammed from inside the interrupt for every step event.
+Everything called from the interrupt lives in IRAM and does not use the FPU.
+
+Step and direction pins are driven trough the GPIO set/clear registers
+(out_w1ts/out_w1tc), all axes stepping on the same event get their edges
+from one register write. The pin masks for every combination of axes are
+worked out in attachAxis(), so the interrupt only does a table lookup.
+Pins 32 and up sit in the second GPIO bank and take a second write.
+
+Steps are planned by a task on STEP_ENGINE_REFILL_CORE while the interrupt
+executes them on STEP_ENGINE_EXECUTOR_CORE, WiFi and web requests running next
+to either of them can't hold up the other side.
+*/
+
+#ifndef __STEP_ENGINE_HAL_ESP32__
+#define __STEP_ENGINE_HAL_ESP32__
+
+#ifdef ARDUINO_ARCH_ESP32
+
+#include <Arduino.h>
+#include "soc/timer_group_struct.h"
+#include "soc/gpio_struct.h"
+#include "StepEngine.h"
+
+#define STEP_ENGINE_TIMER_DIVIDER       80      // 80MHz APB clock -> 1us per tick
+#define STEP_ENGINE_PULSE_WIDTH_US      2       // DRV8825 needs >= 1.9us
+#define STEP_ENGINE_MIN_ALARM_LEAD_US   5       // Alarm closer than this to "now" could be missed
+#define STEP_ENGINE_REFILL_STACK        4096
+#define STEP_ENGINE_REFILL_PRIORITY     (configMAX_PRIORITIES - 2)
+#define STEP_ENGINE_REFILL_CORE         0       // Planner, the other core than the timer interrupt (executor)
+#define STEP_ENGINE_EXECUTOR_CORE       1       // Timer interrupt, Arduino setup() and loop() run here
+
+class StepEngineHal_ESP32
+{
+    public:
+        StepEngineHal_ESP32();
+
+        void begin(uint8_t timerNumber, void (*alarmHandler)(void), void (*refillHandler)(void));
+        void attachAxis(uint8_t axis, uint8_t stepPin, uint8_t directionPin);
+
+        uint32_t nowInUS(void);
+        void armAlarmAt(uint32_t timeInUS);
+        void disarmAlarm(void);
+
+        void writeDirections(uint8_t axisMask, uint8_t negativeMask);
+        void writeSteps(uint8_t axisMask, bool level);
+        void holdStepPulse(void);
+
+        void requestRefill(void);
+
+        void lockSource(void);
+        void unlockSource(void);
+
+    private:
+        // GPIO register bits of a set of pins, one word per bank
+        struct PinMask
+        {
+            uint32_t low;                   // GPIO0..31
+            uint32_t high;                  // GPIO32..39
+        };
+
+        static void refillTask(void *pParameter);
+        uint64_t readCounter(void);
+        void buildPinMasks(void);
+        void writePins(const PinMask &set, const PinMask &clear);
+
+        hw_timer_t *mpTimer;
+        timg_dev_t *mpTimerGroup;
+        uint8_t mTimerIndex;
+
+        uint8_t mStepPin[STEP_ENGINE_MAX_AXES];
+        uint8_t mDirectionPin[STEP_ENGINE_MAX_AXES];
+        PinMask mStepMask[1 << STEP_ENGINE_MAX_AXES];          // Indexed by axis mask
+        PinMask mDirectionMask[1 << STEP_ENGINE_MAX_AXES];
+
+        SemaphoreHandle_t mSourceMutex;
+        TaskHandle_t mRefillTask;
+        void (*mpRefillHandler)(void);
+};
+
+#endif
+
+#endif
@@ -0,0 +1,215 @@
+/*
+StepEngine - Virtual HAL
+Description: Runs the StepEngine against a virtual microsecond clock, so the
+scheduler can be exercised on a host without any hardware. Alarms fire exactly
+when they are due, every step edge is reported trough an optional callback.
+
+Tests drive an engine directly with runUntilIdle(). The firmware itself builds
+against this HAL on the host (see host/sim), it is set up trough begin() and
+attachAxis() just like the ESP32 HAL and runUntil() plays the interrupt and
+refill task by calling the firmware handlers.
+*/
+
+#ifndef __STEP_ENGINE_HAL_VIRTUAL__
+#define __STEP_ENGINE_HAL_VIRTUAL__
+
+#include <stdint.h>
+#include <stddef.h>
+#include "StepEngine.h"
+
+class StepEngineHal_Virtual
+{
+    public:
+        // Called for every step and direction edge
+        //      - axis      -> axis index
+        //      - isStep    -> true for step pin, false for direction pin
+        //      - level     -> new pin level
+        //      - timeInUS  -> virtual time of the edge
+        typedef void (*EdgeHandler)(void *pContext, uint8_t axis, bool isStep, bool level, uint32_t timeInUS);
+
+        StepEngineHal_Virtual()
+        {
+            mClock_InUS = 0;
+            mAlarmArmed = false;
+            mAlarm_InUS = 0;
+            mRefillRequested = false;
+            mPulseWidth_InUS = 0;
+            mMinAlarmLead_InUS = 0;
+            mPortWrites = 0;
+            mpEdgeHandler = NULL;
+            mpEdgeContext = NULL;
+            mpAlarmHandler = NULL;
+            mpRefillHandler = NULL;
+
+            for(uint8_t axis = 0; axis < STEP_ENGINE_MAX_AXES; axis++)
+            {
+                mStepPin[axis] = 0;
+                mDirectionPin[axis] = 0;
+            }
+        }
+
+        // Same as StepEngineHal_ESP32, there is no timer to set up
+        void begin(uint8_t timerNumber, void (*alarmHandler)(void), void (*refillHandler)(void))
+        {
+            mpAlarmHandler = alarmHandler;
+            mpRefillHandler = refillHandler;
+        }
+
+        void attachAxis(uint8_t axis, uint8_t stepPin, uint8_t directionPin)
+        {
+            if(axis < STEP_ENGINE_MAX_AXES)
+            {
+                mStepPin[axis] = stepPin;
+                mDirectionPin[axis] = directionPin;
+            }
+        }
+
+        uint8_t getStepPin(uint8_t axis) { return (axis < STEP_ENGINE_MAX_AXES) ? mStepPin[axis] : 0; }
+        uint8_t getDirectionPin(uint8_t axis) { return (axis < STEP_ENGINE_MAX_AXES) ? mDirectionPin[axis] : 0; }
+
+        void setEdgeHandler(EdgeHandler pHandler, void *pContext)
+        {
+            mpEdgeHandler = pHandler;
+            mpEdgeContext = pContext;
+        }
+
+        // Virtual time spent in holdStepPulse(), 0 makes pulses take no time
+        void setPulseWidth(uint32_t pulseWidth_InUS) { mPulseWidth_InUS = pulseWidth_InUS; }
+
+        // Alarms closer than this to "now" are moved out, like StepEngineHal_ESP32 does
+        void setMinAlarmLead(uint32_t lead_InUS) { mMinAlarmLead_InUS = lead_InUS; }
+
+        void setTime(uint32_t timeInUS) { mClock_InUS = timeInUS; }
+        uint32_t nowInUS(void) { return mClock_InUS; }
+
+        void armAlarmAt(uint32_t timeInUS)
+        {
+            // Alarms in the past fire right away (or after the minimum lead), just like on the target
+            if((int32_t)(timeInUS - mClock_InUS) < (int32_t)mMinAlarmLead_InUS)
+            {
+                timeInUS = mClock_InUS + mMinAlarmLead_InUS;
+            }
+            mAlarm_InUS = timeInUS;
+            mAlarmArmed = true;
+        }
+
+        void disarmAlarm(void) { mAlarmArmed = false; }
+
+        // Like a port register write, all edges of one call happen at the same time
+        void writeDirections(uint8_t axisMask, uint8_t negativeMask)
+        {
+            mPortWrites++;
+            for(uint8_t axis = 0; axis < STEP_ENGINE_MAX_AXES; axis++)
+            {
+                if((axisMask & (1 << axis)) && (mpEdgeHandler != NULL))
+                {
+                    mpEdgeHandler(mpEdgeContext, axis, false, (negativeMask >> axis) & 1, mClock_InUS);
+                }
+            }
+        }
+
+        void writeSteps(uint8_t axisMask, bool level)
+        {
+            mPortWrites++;
+            for(uint8_t axis = 0; axis < STEP_ENGINE_MAX_AXES; axis++)
+            {
+                if((axisMask & (1 << axis)) && (mpEdgeHandler != NULL))
+                {
+                    mpEdgeHandler(mpEdgeContext, axis, true, level, mClock_InUS);
+                }
+            }
+        }
+
+        // Number of writeSteps() and writeDirections() calls, one register write each on the target
+        uint32_t getPortWrites(void) { return mPortWrites; }
+
+        void holdStepPulse(void) { mClock_InUS += mPulseWidth_InUS; }
+
+        void requestRefill(void) { mRefillRequested = true; }
+
+        void lockSource(void) {}
+        void unlockSource(void) {}
+
+        // Run the engine until it goes idle (or timeout expires), playing
+        // both the refill task and the timer interrupt.
+        // Returns false on timeout.
+        template <class Engine>
+        bool runUntilIdle(Engine &engine, uint32_t timeout_InUS)
+        {
+            uint32_t start_InUS = mClock_InUS;
+
+            while(!engine.isIdle())
+            {
+                if(mRefillRequested)
+                {
+                    mRefillRequested = false;
+                    engine.refill();
+                }
+                else if(mAlarmArmed)
+                {
+                    if((uint32_t)(mAlarm_InUS - start_InUS) > timeout_InUS)
+                    {
+                        mClock_InUS = start_InUS + timeout_InUS;
+                        return false;
+                    }
+
+                    mClock_InUS = mAlarm_InUS;
+                    mAlarmArmed = false;
+                    engine.onAlarm();
+                }
+                else
+                {
+                    // Nothing scheduled and nothing to plan, engine is stuck
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+        // Move the clock on to timeInUS, running the refill and alarm
+        // handlers from begin() for everything that comes due on the way
+        void runUntil(uint32_t timeInUS)
+        {
+            while(true)
+            {
+                if(mRefillRequested && (mpRefillHandler != NULL))
+                {
+                    mRefillRequested = false;
+                    mpRefillHandler();
+                }
+                else if(mAlarmArmed && (mpAlarmHandler != NULL) && ((int32_t)(mAlarm_InUS - timeInUS) <= 0))
+                {
+                    mClock_InUS = mAlarm_InUS;
+                    mAlarmArmed = false;
+                    mpAlarmHandler();
+                }
+                else
+                {
+                    break;
+                }
+            }
+
+            if((int32_t)(timeInUS - mClock_InUS) > 0)
+            {
+                mClock_InUS = timeInUS;
+            }
+        }
+
+    private:
+        uint32_t mClock_InUS;
+        bool mAlarmArmed;
+        uint32_t mAlarm_InUS;
+        bool mRefillRequested;
+        uint32_t mPulseWidth_InUS;
+        uint32_t mMinAlarmLead_InUS;
+        uint32_t mPortWrites;
+        EdgeHandler mpEdgeHandler;
+        void *mpEdgeContext;
+        void (*mpAlarmHandler)(void);
+        void (*mpRefillHandler)(void);
+        uint8_t mStepPin[STEP_ENGINE_MAX_AXES];
+        uint8_t mDirectionPin[STEP_ENGINE_MAX_AXES];
+};
+
+#endif
@@ -0,0 +1,91 @@
+# Builds the file system image from a copy of the data folder with the static assets gzipped.
+#
+# Used by platformio.ini (extra_scripts), runs only for `pio run -t buildfs` / `-t uploadfs`:
+#   - .html pages are copied as they are, the web server fills in their template variables
+#   - every other file is stored as <name>.gz when that saves at least 10%, otherwise as it is
+#     (fonts like woff2 are compressed already). The web server sends the .gz with
+#     Content-Encoding: gzip when only that one exists.
+#   - <name>.js / <name>.css are left out when <name>.min.js / <name>.min.css is there
+#   - assets.txt lists a strong ETag (hash of the stored file) of every asset and an asset
+#     version (hash of all of them) the pages add to their links, see WebAPI_ServeAsset()
+
+Import("env")
+
+import gzip
+import hashlib
+import os
+import shutil
+
+GZIP_MIN_SAVING = 0.10
+SPIFFS_MAX_NAME = 31        # CONFIG_SPIFFS_OBJ_NAME_LEN - 1
+MANIFEST_NAME = "assets.txt"
+TEMPLATE_PAGES = (".html",)
+
+
+def has_minified_copy(folder, name):
+    base, ext = os.path.splitext(name)
+    return (ext in (".js", ".css")) and not base.endswith(".min") and \
+        os.path.exists(os.path.join(folder, base + ".min" + ext))
+
+
+def store_asset(src, dst_folder, name, url):
+    with open(src, "rb") as f:
+        raw = f.read()
+
+    packed = gzip.compress(raw, 9, mtime=0)
+    if (len(packed) <= len(raw) * (1.0 - GZIP_MIN_SAVING)) and (len(url) + 3 <= SPIFFS_MAX_NAME):
+        data = packed
+        name += ".gz"
+    else:
+        data = raw
+
+    with open(os.path.join(dst_folder, name), "wb") as f:
+        f.write(data)
+
+    return len(raw), len(data), '"%s"' % hashlib.sha1(data).hexdigest()[:16]
+
+
+def prepare_data(src_dir, dst_dir):
+    assets = []
+    total_raw = 0
+    total_stored = 0
+
+    shutil.rmtree(dst_dir, ignore_errors=True)
+
+    for folder, _, files in os.walk(src_dir):
+        rel = os.path.relpath(folder, src_dir)
+        out = os.path.join(dst_dir, rel)
+        os.makedirs(out, exist_ok=True)
+
+        for name in sorted(files):
+            src = os.path.join(folder, name)
+            url = "/" + os.path.normpath(os.path.join(rel, name)).replace(os.sep, "/")
+
+            if name.endswith(TEMPLATE_PAGES):
+                shutil.copy(src, os.path.join(out, name))
+                continue
+
+            if has_minified_copy(folder, name):
+                print("Assets: skipping %s, using the minified copy" % url)
+                continue
+
+            raw, stored, etag = store_asset(src, out, name, url)
+            total_raw += raw
+            total_stored += stored
+            assets.append((url, etag))
+
+    version = hashlib.sha1("".join(tag for _, tag in assets).encode()).hexdigest()[:8]
+
+    with open(os.path.join(dst_dir, MANIFEST_NAME), "w", newline="\n") as f:
+        f.write("version %s\n" % version)
+        for url, etag in assets:
+            f.write("%s %s\n" % (url, etag))
+
+    print("Assets: %d files, %d KB -> %d KB, version %s" %
+          (len(assets), total_raw // 1024, total_stored // 1024, version))
+
+
+if set(["buildfs", "uploadfs", "uploadfsota"]) & set(COMMAND_LINE_TARGETS):
+    data_dir = os.path.join(env.subst("$BUILD_DIR"), "data")
+    prepare_data(env.subst("$PROJECT_DATA_DIR"), data_dir)
+    env.Replace(PROJECT_DATA_DIR=data_dir)
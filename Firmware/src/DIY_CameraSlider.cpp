@@ -10,11 +10,14 @@
 #include "DIY_CameraSlider_CameraControl.h"
 #include "SliderConfig.h"
 #include "DIY_CameraSlider_Web.h"
+#include "DIY_CameraSlider_Tasks.h"
 
 // Peristent device config
 PersistSettings<SliderConfigStruct> SliderConfig(SliderConfigStruct::Version);
 
 AsyncWebServer server(80);
+AsyncWebSocket ws("/ws");
+AsyncWebSocket telemetryWs("/telemetry");
 int WiFi_status = WL_IDLE_STATUS; 
 
 void setup()
@@ -37,13 +40,18 @@ void setup()
 	pinMode(PIN_LED, OUTPUT);
 	pinMode(PIN_MTR_nRST, OUTPUT);
 	pinMode(PIN_MTR_nEN, OUTPUT);
-	pinMode(PIN_SHUTTER, OUTPUT);
 	pinMode(PIN_END_SWICH_X_LEFT, INPUT_PULLUP);
 	pinMode(PIN_END_SWICH_X_RIGHT, INPUT_PULLUP);
+	if(PAN_HOMING_MODE == PAN_HOMING_SWITCH)
+	{
+		pinMode(PIN_HOME_SWITCH_PAN, INPUT);
+	}
 	digitalWrite(PIN_LED, HIGH);
 	digitalWrite(PIN_MTR_nRST, HIGH);
 	digitalWrite(PIN_MTR_nEN, HIGH);
-	digitalWrite(PIN_SHUTTER, LOW);
+
+    // Camera remote lines and the camera event queue
+	CameraControl_Begin();
 
 	delay(1000);
 
@@ -86,16 +94,16 @@ void setup()
 	setupWebServer();
 	server.begin();
 
-    // Debug message to signal we are initialized and entering loop
+    // Motion, camera control and logging run in their own tasks from now on
+	CameraSlider_StartTasks();
+
+    // Debug message to signal we are initialized
 	Serial.println("Ready to go.");
 }
 
 
 void loop()
 {
-	while(1)
-	{
-		CameraSlider_tick();
-        CameraControl_tick();
-	}
+	// Nothing left to do here, see CameraSlider_StartTasks()
+	vTaskDelete(NULL);
 }
@@ -1,61 +1,358 @@
 /*
 CameraSlider - Camera Control
-Description: This file contains the main loop for the camera control.
+Description: This file contains the camera control. Focus and shutter lines of the camera remote
+are driven by the camera task only, everyone else posts events to its queue (CameraControl_Post()).
+Position triggered shots are the exception, the step interrupt pulses the shutter trough the RMT.
 */
 
 #include <Arduino.h>
+#include <driver/rmt.h>
+#include <soc/rmt_struct.h>
 #include "DIY_CameraSlider_CameraControl.h"
 
+#define CAMERA_TRIGGER_RMT_MAX_HALF 32767       // Longest half of an RMT item, in ticks (us)
+
 // Internal state variables
 CameraState_t cameraState = CAMERA_IDLE;
 
-void CameraControl_tick()
+static QueueHandle_t cameraQueue = NULL;
+static bool bCameraDeadline = false;            // A timed state ends at cameraDeadline_InMS
+static uint32_t cameraDeadline_InMS = 0;
+static uint32_t cameraPressDuration_InMS = 0;   // Of the press that waits for the focus pre-wake
+static CameraEventType_t cameraPressType = CAMERA_EVENT_SHUTTER_PRESS;
+static bool bCameraPending = false;             // Press that came in while the shutter was down
+static CameraEvent_t cameraPending;
+static uint32_t bulbStart_InUS = 0;
+static uint32_t lastBulb_InUS = 0;
+
+// Position triggered shots pulse the shutter line from the RMT, a hardware one-shot with
+// a pulse width exact to the microsecond. The pulse sits in RMT memory, starting it from
+// the step interrupt is a register write. While attached the RMT owns the shutter pin.
+static volatile bool bTriggerAttached = false;
+static volatile uint32_t triggerShots = 0;
+
+// One high level of width_InUS, split over as many RMT item halves as it takes
+static void CameraControl_WriteTriggerPulse(uint32_t width_InUS)
 {
-    switch(cameraState)
+    volatile rmt_item32_t *pItem = RMTMEM.chan[CAMERA_TRIGGER_RMT_CHANNEL].data32;
+    uint32_t chunk_InUS;
+    uint16_t half = 0;
+
+    // Last item has to end the transmission
+    while((width_InUS > 0) && (half < 2 * (RMT_MEM_ITEM_NUM - 1)))
     {
-        case CAMERA_IDLE:
-            break;
+        chunk_InUS = (width_InUS > CAMERA_TRIGGER_RMT_MAX_HALF) ? CAMERA_TRIGGER_RMT_MAX_HALF : width_InUS;
+        if(half & 1)
+        {
+            pItem[half / 2].duration1 = chunk_InUS;
+            pItem[half / 2].level1 = 1;
+        }
+        else
+        {
+            pItem[half / 2].val = 0;
+            pItem[half / 2].duration0 = chunk_InUS;
+            pItem[half / 2].level0 = 1;
+        }
+        width_InUS -= chunk_InUS;
+        half++;
+    }
 
-        case CAMERA_SHUTTER_FOCUS:
-            break;
+    // Zero duration marks the end, the line goes back to the idle level
+    if(half & 1)
+    {
+        pItem[half / 2].duration1 = 0;
+        pItem[half / 2].level1 = 0;
+    }
+    else
+    {
+        pItem[half / 2].val = 0;
+    }
+}
 
-        case CAMERA_SHUTTER_FOCUSING:
-            break;
+// Create the event queue, before the camera task starts
+void CameraControl_Begin()
+{
+    pinMode(PIN_FOCUS, OUTPUT);
+    pinMode(PIN_SHUTTER, OUTPUT);
+    digitalWrite(PIN_FOCUS, LOW);
+    digitalWrite(PIN_SHUTTER, LOW);
+
+    cameraQueue = xQueueCreate(TASK_CAMERA_QUEUE_LENGTH, sizeof(CameraEvent_t));
+
+    // RMT ticks are 1us (80MHz APB / 80), low while idle
+    rmt_config_t config = {};
+    config.rmt_mode = RMT_MODE_TX;
+    config.channel = (rmt_channel_t)CAMERA_TRIGGER_RMT_CHANNEL;
+    config.gpio_num = (gpio_num_t)PIN_SHUTTER;
+    config.mem_block_num = 1;
+    config.clk_div = 80;
+    config.tx_config.loop_en = false;
+    config.tx_config.carrier_en = false;
+    config.tx_config.idle_output_en = true;
+    config.tx_config.idle_level = RMT_IDLE_LEVEL_LOW;
+    rmt_config(&config);
+    CameraControl_WriteTriggerPulse(CAMERA_TRIGGER_PULSE_US);
+
+    // Shutter pin stays with the camera task until triggers are attached
+    pinMatrixOutDetach(PIN_SHUTTER, false, false);
+}
+
+// Queue an event for the camera task, doesn't wait for room in the queue
+// returns
+//      - false     -> queue full (or not created yet), event dropped
+bool CameraControl_Post(CameraEventType_t type, uint32_t duration_InMS)
+{
+    CameraEvent_t event;
+
+    if(cameraQueue == NULL)
+    {
+        return false;
+    }
+
+    event.type = type;
+    event.duration_InMS = duration_InMS;
+
+    if(xQueueSend(cameraQueue, &event, 0) != pdTRUE)
+    {
+        Serial.println("Camera queue full, event dropped.");
+        return false;
+    }
+
+    return true;
+}
+
+// Camera task side, waits for the next event or until the running timed state ends
+// returns
+//      - true      -> pEvent holds an event
+//      - false     -> timed out, deadline reached
+bool CameraControl_WaitEvent(CameraEvent_t *pEvent)
+{
+    TickType_t wait = portMAX_DELAY;
+    int32_t left_InMS;
+
+    if(bCameraDeadline)
+    {
+        left_InMS = (int32_t)(cameraDeadline_InMS - millis());
+        wait = (left_InMS > 0) ? pdMS_TO_TICKS(left_InMS) : 0;
+    }
+
+    return (xQueueReceive(cameraQueue, pEvent, wait) == pdTRUE);
+}
+
+static void CameraControl_SetDeadline(uint32_t duration_InMS)
+{
+    bCameraDeadline = (duration_InMS > 0);
+    cameraDeadline_InMS = millis() + duration_InMS;
+}
+
+// Shutter down, the press itself or the bulb exposure
+static void CameraControl_Press(CameraEventType_t type, uint32_t duration_InMS)
+{
+    // Focus held from the pre-wake stays down until the shutter lets go,
+    // without the pre-wake the press is shutter only
+    if(SliderConfig.Config.focus_prewake_ms > 0)
+    {
+        digitalWrite(PIN_FOCUS, HIGH);
+    }
+    digitalWrite(PIN_SHUTTER, HIGH);
+    CameraControl_SetDeadline(duration_InMS);
+
+    if(type == CAMERA_EVENT_BULB_START)
+    {
+        bulbStart_InUS = micros();
+        cameraState = CAMERA_BULB;
+    }
+    else
+    {
+        cameraState = CAMERA_SHUTTER_PRESSED;
+    }
+}
+
+static void CameraControl_Release()
+{
+    digitalWrite(PIN_SHUTTER, LOW);
+    digitalWrite(PIN_FOCUS, LOW);
+
+    if(cameraState == CAMERA_BULB)
+    {
+        lastBulb_InUS = micros() - bulbStart_InUS;
+    }
+
+    bCameraDeadline = false;
+    cameraState = CAMERA_IDLE;
+}
+
+// Shutter press or bulb start. With a focus pre-wake the camera gets focus first,
+// unless focus is held already (CameraControl_Focus() ahead of the shot).
+static void CameraControl_StartPress(const CameraEvent_t *pEvent)
+{
+    uint16_t prewake_InMS = SliderConfig.Config.focus_prewake_ms;
+
+    if((cameraState == CAMERA_SHUTTER_PRESSED) || (cameraState == CAMERA_BULB) || (cameraState == CAMERA_FOCUSING))
+    {
+        // Comes after the running one
+        cameraPending = *pEvent;
+        bCameraPending = true;
+        return;
+    }
+
+    if((prewake_InMS > 0) && (cameraState != CAMERA_FOCUS))
+    {
+        digitalWrite(PIN_FOCUS, HIGH);
+        cameraPressType = pEvent->type;
+        cameraPressDuration_InMS = pEvent->duration_InMS;
+        CameraControl_SetDeadline(prewake_InMS);
+        cameraState = CAMERA_FOCUSING;
+        return;
+    }
 
-        case CAMERA_SHUTTER_RELEASE:
-            CameraControl_ReleaseShutter();
+    CameraControl_Press(pEvent->type, pEvent->duration_InMS);
+}
+
+// Handles one event (pEvent NULL when none came) and the end of timed states
+void CameraControl_tick(const CameraEvent_t *pEvent)
+{
+    if(pEvent != NULL)
+    {
+        switch(pEvent->type)
+        {
+            case CAMERA_EVENT_FOCUS:
+                if(cameraState == CAMERA_IDLE)
+                {
+                    digitalWrite(PIN_FOCUS, HIGH);
+                    CameraControl_SetDeadline(pEvent->duration_InMS);
+                    cameraState = CAMERA_FOCUS;
+                }
+                break;
+
+            case CAMERA_EVENT_FOCUS_RELEASE:
+                if(cameraState == CAMERA_FOCUS)
+                {
+                    CameraControl_Release();
+                }
+                break;
+
+            case CAMERA_EVENT_SHUTTER_PRESS:
+            case CAMERA_EVENT_BULB_START:
+                CameraControl_StartPress(pEvent);
+                break;
+
+            case CAMERA_EVENT_SHUTTER_RELEASE:
+            case CAMERA_EVENT_BULB_STOP:
+                bCameraPending = false;
+                CameraControl_Release();
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    if(!bCameraDeadline || ((int32_t)(millis() - cameraDeadline_InMS) < 0))
+    {
+        return;
+    }
+
+    switch(cameraState)
+    {
+        case CAMERA_FOCUSING:
+            CameraControl_Press(cameraPressType, cameraPressDuration_InMS);
             break;
 
-        case CAMERA_SHUTTER_RELEASING:
+        case CAMERA_FOCUS:
+        case CAMERA_SHUTTER_PRESSED:
+        case CAMERA_BULB:
+            CameraControl_Release();
+            if(bCameraPending)
+            {
+                bCameraPending = false;
+                CameraControl_StartPress(&cameraPending);
+            }
             break;
 
         default:
+            bCameraDeadline = false;
             break;
     }
 }
 
-void setPinHigh(void *parameter)
+// Take a picture: shutter pressed for CAMERA_SHUTTER_PULSE_MS
+void CameraControl_ReleaseShutter()
+{
+    if(CameraControl_Post(CAMERA_EVENT_SHUTTER_PRESS, CAMERA_SHUTTER_PULSE_MS))
+    {
+        Serial.println("Shutter released.");
+    }
+}
+
+// Wake the camera ahead of a shot that is due in the focus pre-wake time.
+// Does nothing with the pre-wake off.
+void CameraControl_Focus()
 {
-    PinDelayParameters *pinDelayParams = (PinDelayParameters *)parameter;
-    digitalWrite(pinDelayParams->pin, HIGH);
-    vTaskDelay(pdMS_TO_TICKS(pinDelayParams->delayTime));
-    digitalWrite(pinDelayParams->pin, LOW);
-    vTaskDelete(NULL); // Delete the task after it is done
+    if(SliderConfig.Config.focus_prewake_ms > 0)
+    {
+        CameraControl_Post(CAMERA_EVENT_FOCUS, SliderConfig.Config.focus_prewake_ms + CAMERA_FOCUS_HOLD_MS);
+    }
 }
 
-void setPinHighAsync(int pin, int delayTime)
+// Hand the shutter pin to the RMT for position triggered shots (true) or back to the
+// camera task (false). With the focus pre-wake on, focus is held while attached so
+// the camera stays awake for every shot.
+void CameraControl_AttachTrigger(bool attach)
 {
-    static PinDelayParameters pinDelayParams;
-    pinDelayParams.pin = pin;
-    pinDelayParams.delayTime = delayTime;
-    xTaskCreate(setPinHigh, "Set Pin High", 1000, &pinDelayParams, 1, NULL);
+    if(attach == bTriggerAttached)
+    {
+        return;
+    }
+
+    if(attach)
+    {
+        bTriggerAttached = true;
+        rmt_set_pin((rmt_channel_t)CAMERA_TRIGGER_RMT_CHANNEL, RMT_MODE_TX, (gpio_num_t)PIN_SHUTTER);
+        if(SliderConfig.Config.focus_prewake_ms > 0)
+        {
+            CameraControl_Post(CAMERA_EVENT_FOCUS, 0);
+        }
+    }
+    else
+    {
+        bTriggerAttached = false;
+        digitalWrite(PIN_SHUTTER, LOW);
+        pinMatrixOutDetach(PIN_SHUTTER, false, false);
+        CameraControl_Post(CAMERA_EVENT_FOCUS_RELEASE, 0);
+    }
 }
 
-void CameraControl_ReleaseShutter()
+// Shutter pulse of CAMERA_TRIGGER_PULSE_US, from the step interrupt. A pulse still
+// running starts over, shots closer than the pulse width merge.
+void IRAM_ATTR CameraControl_TriggerShutterFromISR()
 {
-    // Focus
-    setPinHighAsync(PIN_SHUTTER, 300);
-    cameraState = CAMERA_SHUTTER_RELEASING;
+    if(!bTriggerAttached)
+    {
+        return;
+    }
 
-    Serial.println("Shutter released.");
-}
\ No newline at end of file
+    RMT.conf_ch[CAMERA_TRIGGER_RMT_CHANNEL].conf1.mem_rd_rst = 1;
+    RMT.conf_ch[CAMERA_TRIGGER_RMT_CHANNEL].conf1.mem_rd_rst = 0;
+    RMT.conf_ch[CAMERA_TRIGGER_RMT_CHANNEL].conf1.tx_start = 1;
+    triggerShots = triggerShots + 1;
+}
+
+// True from posting a shot until the shutter is up again, the slider must not move
+bool CameraControl_IsExposing()
+{
+    return ((cameraQueue != NULL) && (uxQueueMessagesWaiting(cameraQueue) > 0)) || bCameraPending ||
+           (cameraState == CAMERA_FOCUSING) || (cameraState == CAMERA_SHUTTER_PRESSED) || (cameraState == CAMERA_BULB);
+}
+
+// Position triggered shots since power up
+uint32_t CameraControl_GetTriggerShots()
+{
+    return triggerShots;
+}
+
+// Length of the last bulb exposure, as the shutter line was really held
+uint32_t CameraControl_GetLastBulb()
+{
+    return lastBulb_InUS;
+}
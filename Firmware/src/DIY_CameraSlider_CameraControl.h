@@ -1,6 +1,8 @@
 /*
 CameraSlider - Camera Control
-Description: This file contains the main loop for the camera control.
+Description: This file contains the camera control. Focus and shutter lines of the camera remote
+are driven by the camera task only, everyone else posts events to its queue (CameraControl_Post()).
+Position triggered shots are the exception, the step interrupt pulses the shutter trough the RMT.
 */
 
 #include <Arduino.h>
@@ -9,18 +11,20 @@ Description: This file contains the main loop for the camera control.
 // Internal state variables
 extern CameraState_t cameraState;
 
-void CameraControl_tick();
+void CameraControl_Begin();
+bool CameraControl_Post(CameraEventType_t type, uint32_t duration_InMS);
 
-struct PinDelayParameters
-{
-    int pin;
-    int delayTime;
-};
+// Camera task
+bool CameraControl_WaitEvent(CameraEvent_t *pEvent);
+void CameraControl_tick(const CameraEvent_t *pEvent);
 
+void CameraControl_ReleaseShutter();
+void CameraControl_Focus();
+bool CameraControl_IsExposing();
 
-void setPinHigh(void *parameter);
+// Position triggered shots
+void CameraControl_AttachTrigger(bool attach);
+void CameraControl_TriggerShutterFromISR();
+uint32_t CameraControl_GetTriggerShots();
 
-
-void setPinHighAsync(int pin, int delayTime);
-
-void CameraControl_ReleaseShutter();
\ No newline at end of file
+uint32_t CameraControl_GetLastBulb();
@@ -5,24 +5,163 @@ Description: This file contains all the functions we use to initialize, configur
 
 #include "SliderConfig.h"
 #include <FlexyStepper.h>
+#include <StepEngine.h>
+#ifdef ARDUINO_ARCH_ESP32
+#include <StepEngineHal_ESP32.h>
+#else
+#include <StepEngineHal_Virtual.h>
+#endif
+#include <FlexyStepSource.h>
+#include <CoordinatedStepSource.h>
+#include <KeyframeStepSource.h>
 #include "DIY_CameraSlider_MotorControl.h"
 #include "DIY_CameraSlider_CameraControl.h"
-
-FlexyStepper stepper_slide;
-FlexyStepper stepper_pan;
+#include "DIY_CameraSlider_Tasks.h"
+#include "TelemetryFrame.h"
+
+FlexyStepperT<SLIDE_RAMP_GENERATOR> stepper_slide;
+FlexyStepperT<PAN_RAMP_GENERATOR> stepper_pan;
+
+// Step pulses are generated from a hardware timer interrupt by the step engine.
+// The steppers only plan the steps (trough motionSource) ahead of the interrupt.
+// Built for the host (host/sim) steps run against a virtual clock instead.
+#ifdef ARDUINO_ARCH_ESP32
+typedef StepEngineHal_ESP32 SliderStepEngineHal;
+#else
+typedef StepEngineHal_Virtual SliderStepEngineHal;
+#endif
+SliderStepEngineHal stepEngineHal;
+StepEngine<SliderStepEngineHal> stepEngine(stepEngineHal);
+FlexyStepSource motionSource;
+volatile bool bStepperResyncPending = false;
+
+// Endstop hit while moving. The interrupt only latches where and when and
+// has the step engine brake, the motion task finishes the stop.
+volatile bool bEndstopLatched = false;
+volatile bool bEndstopBraking = false;      // Motors were running when it was hit
+volatile uint8_t endstopSide = 0;           // 0 left, 1 right
+volatile long endstopLatch_InSteps = 0;
+volatile uint32_t endstopLatch_InUS = 0;
+uint32_t endstopDecel_InStepsPerSecondPerSecond = 0;
+
+// Endstop stops, latency is from the switch edge to the last step emitted,
+// overrun how many steps that was past the edge
+uint32_t endstopStops = 0;
+uint32_t endstopLatency_InUS = 0;
+uint32_t endstopMaxLatency_InUS = 0;
+long endstopOverrun_InSteps = 0;
+
+// Soft limits, targets are checked once per move before it is planned.
+// The last refused target and the limits it was against, in steps.
+envelopeError_t envelopeError = ENVELOPE_OK;
+long envelopeTarget_InSteps = 0;
+long envelopeMin_InSteps = 0;
+long envelopeMax_InSteps = 0;
+
+// Coordinated moves drive slide and pan from one speed profile,
+// so both axes start and finish together
+CoordinatedStepSource coordinatedSource;
+bool bCoordinatedMotion = false;
+
+// Keyframe sequences run trough all keyframes without stopping, planned
+// in one go once the slider stands on the first keyframe
+KeyframeStepSource keyframeSource;
+Keyframe keyframes[KEYFRAME_MAX_KEYFRAMES];
+uint8_t keyframeCount = 0;
+bool bKeyframeMotion = false;
+static_assert(MAX_KEYFRAMES <= KEYFRAME_MAX_KEYFRAMES, "MAX_KEYFRAMES is more than the keyframe source takes");
 
 // Internal state variables
 sliderState_t sliderState = SLIDER_IDLE;
 sliderState_t prev_sliderState = SLIDER_IDLE;
 bool bmotorState          = true;
 bool bhomingComplete      = false;
+
+// Homing, see CameraSlider_ProcessHoming()
+homingPhase_t homingPhase = HOMING_PHASE_NONE;
+homingError_t homingError = HOMING_ERROR_NONE;
+CameraSliderAxis_t homingRequestAxis = SLIDER_AXIS_SLIDE;
+volatile bool bHomingCancelRequest = false;
+bool bHomingMoveStarted   = false;
+uint32_t homingPhaseStart_InMS = 0;
+long homingPhaseStart_InSteps = 0;
+volatile bool bHomingLatched = false;
+volatile long homingLatch_InSteps = 0;     // Step the switch edge was seen at
+long homingSeekEdge_InSteps = 0;
+long homingHome_InSteps = 0;
+bool bPanHomed            = false;
+uint8_t panHomingMode     = PAN_HOMING_MODE;    // PAN_HOMING_xxx, the host tools try all of them
+
+// Axis being homed, everything in steps
+typedef struct
+{
+    CameraSliderAxis_t axis;
+    int switchPin;              // -1 homes against a mechanical stop
+    int direction;
+    long range_InSteps;         // Farthest the seek goes
+    long retract_InSteps;       // Home is this far off the switch
+    float seekSpeed_InStepsPerSecond;
+    float approachSpeed_InStepsPerSecond;
+    float accel_InStepsPerSecondPerSecond;
+    bool bFromHome;             // Started from a good home
+} HomingAxis;
+
+HomingAxis homingAxis = {SLIDER_AXIS_SLIDE, -1};
+
+// Where the switch edge was found, against where the last homing left it.
+// Only homing cycles that start from a good home count.
+typedef struct
+{
+    uint32_t cycles;
+    long min_InSteps;
+    long max_InSteps;
+    long last_InSteps;
+    long seekOffset_InSteps;    // Edge of the fast seek against the slow approach, last homing
+} HomingRepeatability;
+
+HomingRepeatability homingRepeatability[SLIDER_AXIS_PAN + 1];
+
 float fSliderPos          = 0.0;
 float fRotationPos        = 0.0;
 
-float stepDist = 0;
-int currentStep = 0;
-int maxSteps = 0;
-float startPos = 0;
+// Shoot-move-shoot stepping, driven by deadlines from CameraSlider_tick()
+CameraSliderStepping_t steppingConfig;
+uint16_t steppingFrame = 0;     // Frames shot
+long steppingStartSlide_InSteps = 0;
+long steppingStartPan_InSteps = 0;
+bool bSteppingExposing = false;
+bool bSteppingFocused = false;      // Focus pre-wake sent for the frame
+uint32_t steppingDeadline_InMS = 0;
+
+// Intervalometer, frame n is shot at steppingStart_InMS + n * interval no
+// matter how long the frames before took. Slack is how long a frame stood
+// ready before its shutter time, negative when it was late (overrun).
+uint32_t steppingStart_InMS = 0;
+int32_t steppingSlack_InMS[STEPPING_SLACK_LOG];    // Last frames, by frame % STEPPING_SLACK_LOG
+int32_t steppingMinSlack_InMS = 0;
+uint16_t steppingOverruns = 0;
+uint32_t steppingMaxLate_InMS = 0;                  // Shutter after its time, while not overrun
+int32_t steppingPlannedMinSlack_InMS = 0;           // Least slack the plan expects, see CameraSlider_FitFrames()
+steppingError_t steppingError = STEPPING_ERROR_NONE;
+uint16_t steppingNoFitFrame = 0;
+uint32_t steppingNoFitNeed_InMS = 0;
+
+// Bulb ramping, every frame is a bulb exposure of exposureRamp_InMS[frame]
+ExposureKeyframe_t exposureKeyframes[EXPOSURE_RAMP_MAX_KEYFRAMES];
+uint8_t exposureKeyframeCount = 0;
+uint32_t exposureRamp_InMS[EXPOSURE_RAMP_MAX_FRAMES];
+bool bExposureRamp = false;
+
+// Position triggers, the shutter fires every triggerEvery_InMM while the timed move
+// (start to end position) runs. Armed one after the other in the step engine, the
+// step interrupt fires the shot and arms the next one (CameraSlider_PositionTriggerISR()).
+float triggerEvery_InMM = 0.0;
+bool bTriggersArmed = false;
+volatile long triggerNext_InSteps = 0;
+long triggerSpacing_InSteps = 0;            // Signed, direction of the move
+volatile uint16_t triggersLeft = 0;
+uint32_t triggerLead_InUS = 0;
+volatile long triggerLastLead_InSteps = 0;  // How far ahead of its position the last one fired
 
 // Start and stop positions
 float fStartPos_Slider    = 0.0;
@@ -34,6 +173,33 @@ float fEndPos_Rotation    = 0.0;
 float fSlidingSpeed       = 0.0;
 float fRotatingSpeed      = 0.0;
 
+// Status last pushed to the browsers, see CameraSlider_StatusChanged()
+typedef struct
+{
+    sliderState_t state;
+    bool bMotors;
+    bool bHomed;
+    bool bPanHomed;
+    homingPhase_t homingPhase;
+    int homingProgress;
+    homingError_t homingError;
+    uint16_t frame;
+    uint32_t triggerShots;
+    float startSlide;
+    float startPan;
+    float endSlide;
+    float endPan;
+    long slide_InSteps;
+    long pan_InSteps;
+} StatusSnapshot;
+
+StatusSnapshot statusPushed;
+
+// Binary telemetry, positions of the last frame are what the next one is delta encoded against
+uint16_t telemetrySequence = 0;
+long telemetrySlide_InSteps = 0;
+long telemetryPan_InSteps = 0;
+
 uint32_t slideDurationSec = 1;
 
 // Main motor control function.
@@ -47,9 +213,38 @@ void CameraSlider_tick()
     if(sliderState != prev_sliderState)
     {
         Serial.println(sliderStateStr[sliderState]);
+
+        if(prev_sliderState == SLIDER_HOMING_FAILED)
+        {
+            digitalWrite(PIN_LED, LOW);
+        }
         prev_sliderState = sliderState;
     }
 
+    // Nothing else moves until the endstop stop is over
+    if(bEndstopLatched && !CameraSlider_FinishEndstopStop())
+    {
+        return;
+    }
+
+    // Homing was left for another state (motors turned off, a move was requested)
+    if((homingPhase != HOMING_PHASE_NONE) && (sliderState != SLIDER_HOMING))
+    {
+        CameraSlider_EndHoming(HOMING_ERROR_CANCELLED);
+    }
+
+    // Timed move is over or was left for something else
+    if(bTriggersArmed && (sliderState != SLIDER_MOVING_TO_END))
+    {
+        CameraSlider_DisarmPositionTriggers();
+    }
+
+    // Motors were stopped in the middle of a move
+    if(bStepperResyncPending)
+    {
+        CameraSlider_ResyncSteppers();
+    }
+
     switch(sliderState)
     {
         case SLIDER_MOTORS_OFF:
@@ -59,17 +254,19 @@ void CameraSlider_tick()
         break;
 
         case SLIDER_MOVING_TO_START:
-            // Moving to start
-            if((!stepper_slide.motionComplete()) || (!stepper_pan.motionComplete()))
-            {
-                stepper_slide.processMovement();
-                stepper_pan.processMovement();
-            }
-            // Move complete
-            else
+            // Moving to start, step engine executes the move in the background
+            if(CameraSlider_MotionComplete())
             {
+                if(bKeyframeMotion)
+                {
+                    CameraSlider_SetState(CameraSlider_RunKeyframes() ? SLIDER_MOVING_TO_END : SLIDER_IDLE);
+                    break;
+                }
+
                 if(slideDurationSec <=0 ) { slideDurationSec = 1; }
 
+                CameraSlider_ArmPositionTriggers(fStartPos_Slider, fEndPos_Slider);
+
                 // Calculate speed
                 if(fEndPos_Slider >= fStartPos_Slider)
                 {
@@ -89,6 +286,20 @@ void CameraSlider_tick()
                     fRotatingSpeed = (fStartPos_Rotation - fEndPos_Rotation) / (slideDurationSec);
                 }
 
+                if(bCoordinatedMotion)
+                {
+                    float slideAccel = SliderConfig.Config.default_slider_accel * SliderConfig.Config.slide_steps_per_mm;
+                    float panAccel = SliderConfig.Config.default_slider_accel * SliderConfig.Config.pan_steps_per_degree;
+
+                    // Whole move, including acceleration and deceleration, takes slideDurationSec
+                    CameraSlider_MoveCoordinated(round(fEndPos_Slider * SliderConfig.Config.slide_steps_per_mm), round(fEndPos_Rotation),
+                                                 0.0, slideAccel, 0.0, panAccel, slideDurationSec);
+                    CameraSlider_SetState(SLIDER_MOVING_TO_END);
+                    break;
+                }
+
+                stepEngine.lockSource();
+
                 // Configure slider
                 stepper_slide.setSpeedInMillimetersPerSecond(fSlidingSpeed);
                 stepper_slide.setAccelerationInMillimetersPerSecondPerSecond(SliderConfig.Config.default_slider_accel);
@@ -99,51 +310,45 @@ void CameraSlider_tick()
                 stepper_pan.setAccelerationInStepsPerSecondPerSecond(SliderConfig.Config.default_slider_accel * SliderConfig.Config.pan_steps_per_degree);
                 stepper_pan.setTargetPositionInSteps(fEndPos_Rotation);
 
+                stepEngine.unlockSource();
+
+                CameraSlider_StartMotors();
                 CameraSlider_SetState(SLIDER_MOVING_TO_END);
             }
         break;
 
         case SLIDER_MOVING_TO_END:
             // Moving to end position
-            if((!stepper_slide.motionComplete()) || (!stepper_pan.motionComplete()))
-            {
-                stepper_slide.processMovement();
-                stepper_pan.processMovement();
-            }
-            // Move completed
-            else
+            if(CameraSlider_MotionComplete())
             {
                 CameraSlider_SetState(SLIDER_READY);
             }
             break;
 
         case SLIDER_HOMING:
-            CameraSlider_HomeSlidingRail();
+            CameraSlider_ProcessHoming();
+        break;
+
+        case SLIDER_HOMING_FAILED:
+            digitalWrite(PIN_LED, ((millis() / HOMING_FAILED_BLINK_MS) & 1) ? HIGH : LOW);
         break;
 
         case SLIDER_READY:
         break;
 
         case SLIDER_WORKING:
-            if((!stepper_slide.motionComplete()) || (!stepper_pan.motionComplete()))
-            {
-                stepper_slide.processMovement();
-                stepper_pan.processMovement();
-            }
+            // Step engine executes the move in the background
         break;
 
         case SLIDER_STEP_FINISHED:
-            ProcessStepping();
+            CameraSlider_ProcessStepping();
         break;
 
         case SLIDER_STEPPING:
-            if((!stepper_slide.motionComplete()))
-            {
-                stepper_slide.processMovement();
-            }
-            else
+            // Moving to the next frame
+            if(CameraSlider_MotionComplete())
             {
-                sliderState = SLIDER_STEP_FINISHED;
+                CameraSlider_StandForFrame();
             }
         break;
 
@@ -154,6 +359,7 @@ void CameraSlider_tick()
 
 void setupMotors()
 {
+    endstopDecel_InStepsPerSecondPerSecond = ENDSTOP_STOP_DECEL * SliderConfig.Config.slide_steps_per_mm;
     EnableEndstopInterrupt();
 
     // Connect to motors
@@ -173,267 +379,277 @@ void setupMotors()
     // -- Revolution in steps
     stepper_pan.setSpeedInStepsPerSecond(SliderConfig.Config.pan_steps_per_degree);
     stepper_pan.setAccelerationInStepsPerSecondPerSecond(SliderConfig.Config.default_slider_accel * SliderConfig.Config.pan_steps_per_degree);
-}
-
-void CameraSlider_MoveToPositionRelative(float xPos, float xSpeed, float xAccel, float rAngle, float rSpeed, float rAccel)
-{
-    // Invert slider or pan motor if necessary
-    xPos = SliderConfig.Config.slider_direction * xPos;
-    rAngle = SliderConfig.Config.rotate_direction * rAngle;
-
-    // Setup slider
-    stepper_slide.setTargetPositionInMillimeters(xPos);
-    stepper_slide.setSpeedInMillimetersPerSecond(xSpeed);
-    stepper_slide.setAccelerationInMillimetersPerSecondPerSecond(xAccel);
-
-    // Setup pan
-    stepper_pan.setTargetPositionRelativeInSteps(rAngle * SliderConfig.Config.pan_steps_per_degree);
-    stepper_pan.setSpeedInStepsPerSecond(rSpeed * SliderConfig.Config.pan_steps_per_degree);
-    stepper_pan.setAccelerationInStepsPerSecondPerSecond(rAccel * SliderConfig.Config.pan_steps_per_degree);
 
-    // Updatestate machine
-    sliderState = SLIDER_WORKING;
+    // S-curve (jerk limited) or trapezoidal motion profile
+    CameraSlider_UpdateJerk();
+
+    // Configure step engine
+    motionSource.attachStepper(SLIDER_AXIS_SLIDE, &stepper_slide);
+    motionSource.attachStepper(SLIDER_AXIS_PAN, &stepper_pan);
+    coordinatedSource.attachStepper(SLIDER_AXIS_SLIDE, &stepper_slide);
+    coordinatedSource.attachStepper(SLIDER_AXIS_PAN, &stepper_pan);
+    keyframeSource.attachStepper(SLIDER_AXIS_SLIDE, &stepper_slide);
+    keyframeSource.attachStepper(SLIDER_AXIS_PAN, &stepper_pan);
+
+    stepEngineHal.attachAxis(SLIDER_AXIS_SLIDE, PIN_MOTOR_X_STEP, PIN_MOTOR_X_DIR);
+    stepEngineHal.attachAxis(SLIDER_AXIS_PAN, PIN_MOTOR_Z_STEP, PIN_MOTOR_Z_DIR);
+    stepEngineHal.begin(STEP_ENGINE_TIMER, CameraSlider_StepEngineISR, CameraSlider_StepEngineRefill);
+    stepEngine.setTriggerHandler(CameraSlider_PositionTriggerISR, NULL);
 }
 
-void CameraSlider_MoveToPositionAbsolute(float xPos, float xSpeed, float xAccel, float rSteps, float rSpeed, float rAccel)
+// Step engine timer interrupt
+void IRAM_ATTR CameraSlider_StepEngineISR(void)
 {
-    // Invert slider or pan motor if necessary
-    xPos = SliderConfig.Config.slider_direction * xPos;
-    rSteps = SliderConfig.Config.rotate_direction * rSteps;
-
-    // Setup slider
-    stepper_slide.setTargetPositionInMillimeters(xPos);
-    stepper_slide.setSpeedInMillimetersPerSecond(xSpeed);
-    stepper_slide.setAccelerationInMillimetersPerSecondPerSecond(xAccel);
-
-    // Setup pan
-    stepper_pan.setTargetPositionInSteps(rSteps);
-    stepper_pan.setSpeedInStepsPerSecond(rSpeed * SliderConfig.Config.pan_steps_per_degree);
-    stepper_pan.setAccelerationInStepsPerSecondPerSecond(rAccel * SliderConfig.Config.pan_steps_per_degree);
-
-    // Updatestate machine
-    sliderState = SLIDER_WORKING;
+    stepEngine.onAlarm();
 }
 
-// Copy of CameraSlider_MoveToPositionAbsolute without changing sliderState, refactor sometime
-void CameraSlider_MoveToPositionAbsoluteStep(float xPos, float xSpeed, float xAccel)
+// Step engine refill task, plans steps ahead of the timer interrupt
+void CameraSlider_StepEngineRefill(void)
 {
-    // Invert slider or pan motor if necessary
-    xPos = SliderConfig.Config.slider_direction * xPos;
+    uint32_t start_InUS = micros();
 
-    // Setup slider
-    stepper_slide.setTargetPositionInMillimeters(xPos);
-    stepper_slide.setSpeedInMillimetersPerSecond(xSpeed);
-    stepper_slide.setAccelerationInMillimetersPerSecondPerSecond(xAccel);
+    stepEngine.refill();
+    CameraSlider_AddBusyTime(CAMERA_SLIDER_TASK_PLANNER, micros() - start_InUS);
 }
 
-void CameraSlider_StartStepping()
+// Hand the current stepper targets over to the step engine.
+// Call this every time a target, speed or acceleration changes.
+void CameraSlider_StartMotors(void)
 {
-    Serial.println("Start Stepping");
-
-    float dist = 550;
-    stepDist = 2;
-
-    // floor to int
-    currentStep = 0;
-    maxSteps = floor(dist/stepDist);
-    startPos = abs(getSliderPos());
+    if(stepEngine.isIdle())
+    {
+        // Nothing is queued, planned and emitted positions are the same
+        stepEngine.setPosition(SLIDER_AXIS_SLIDE, stepper_slide.getCurrentPositionInSteps());
+        stepEngine.setPosition(SLIDER_AXIS_PAN, stepper_pan.getCurrentPositionInSteps());
+    }
 
-    CameraSlider_EnableMotors(true);
-    ProcessStepping();
+    stepEngine.start(&motionSource);
 }
 
-void ProcessStepping()
+// Stop right away without decelerating, queued steps are discarded.
+// Steppers are synced to the steps that were actually emitted later,
+// in CameraSlider_tick(), so this is safe to call from an interrupt.
+void CameraSlider_StopMotors(void)
 {
-    currentStep += 1;
-
-    if(currentStep > maxSteps)
+    if(!stepEngine.isIdle())
     {
-        sliderState = SLIDER_IDLE;
-
-        currentStep = 0;
-        maxSteps = 0;
-
-        CameraSlider_EnableMotors(false);
-        
-        Serial.println("Reached final step, stopped stepping");
-
-        return;
+        stepEngine.stop();
+        bStepperResyncPending = true;
     }
-    
-    delay(600);
-    CameraControl_ReleaseShutter();
-    delay(500);
-
-    // getSliderPos seems to be unreliable, counting the position myself
-    //float startPos = getSliderPos();
-
-    float nextPos = startPos + (currentStep * stepDist);
-    CameraSlider_MoveToPositionAbsoluteStep(nextPos, 4, 20);
-
-    sliderState = SLIDER_STEPPING;
-    
-    Serial.print("Started step ");
-    Serial.print(currentStep);
-    Serial.print(" / ");
-    Serial.print(maxSteps); 
-    Serial.print(", Target Pos: "); 
-    Serial.println(nextPos);
 }
 
-void CameraSlider_MoveToStart(float xSpeed, float xAccel, float rSpeed, float rAccel)
+// Steppers plan ahead of the step engine, after a stop bring their
+// position back to the last step that was emitted
+void CameraSlider_ResyncSteppers(void)
 {
-    CameraSlider_MoveToPositionAbsolute(fStartPos_Slider, xSpeed, xAccel, fStartPos_Rotation, rSpeed, rAccel);
+    stepEngine.lockSource();
+    stepper_slide.abortMotion(stepEngine.getPosition(SLIDER_AXIS_SLIDE));
+    stepper_pan.abortMotion(stepEngine.getPosition(SLIDER_AXIS_PAN));
+    bStepperResyncPending = false;
+    stepEngine.unlockSource();
 }
 
-void CameraSlider_MoveToEnd(float xSpeed, float xAccel, float rSpeed, float rAccel)
+// True once all planned steps were emitted
+bool CameraSlider_MotionComplete(void)
 {
-    CameraSlider_MoveToPositionAbsolute(fEndPos_Slider, xSpeed, xAccel, fEndPos_Rotation, rSpeed, rAccel);
+    return stepEngine.isIdle();
 }
 
-void CameraSlider_HomeSlidingRail(void)
+// Stop and bring the steppers back to the last emitted step, so a new
+// move can be planned from where the motors really are
+void CameraSlider_HaltMotors(void)
 {
-    Serial.println("Homing...");
+    CameraSlider_StopMotors();
 
-    DisableEndstopInterrupt();
+    if(bStepperResyncPending)
+    {
+        CameraSlider_ResyncSteppers();
+    }
+}
 
-    CameraSlider_EnableMotors(true);
+// Select if the following moves drive slide and pan together (true)
+// or each axis with its own speed profile (false). Can't change while
+// the motors run, false then.
+bool CameraSlider_SetCoordinatedMotion(bool coordinated)
+{
+    if((coordinated != bCoordinatedMotion) && !stepEngine.isIdle())
+    {
+        return false;
+    }
 
-    stepper_slide.setSpeedInMillimetersPerSecond(SliderConfig.Config.homing_speed_slide);
-    stepper_slide.setAccelerationInMillimetersPerSecondPerSecond(SliderConfig.Config.default_slider_accel);
+    bCoordinatedMotion = coordinated;
+    return true;
+}
 
-    Serial.println("Homing linear rail");
-    Serial.print("Dir: ");
-    Serial.println(SliderConfig.Config.homing_direction, DEC);
-    Serial.print("EndSW: ");
-    Serial.println(PIN_END_SWICH_X_LEFT, DEC);
+// A new move can only take over from the running one if the steppers plan both,
+// FlexyStepper then ramps from the speed it has to the new target. Everything
+// else has to wait for standstill, a new step source would jump the speed.
+bool CameraSlider_CanStartMove(bool coordinated)
+{
+    return stepEngine.isIdle() || (!coordinated && (stepEngine.getSource() == &motionSource));
+}
 
-    if(stepper_slide.moveToHomeInMillimeters(SliderConfig.Config.homing_direction, SliderConfig.Config.homing_speed_slide, SliderConfig.Config.rail_length, PIN_END_SWICH_X_LEFT, LOW) != true)
+// Move slide and pan along one speed profile, both axes finish on the same step.
+// All values are in steps, speed and acceleration are the limits of each axis.
+// With durationSec > 0 speeds are ignored and picked so the move takes durationSec.
+// False while the motors still run, the move starts from standstill.
+bool CameraSlider_MoveCoordinated(long slideTarget_InSteps, long panTarget_InSteps, float slideSpeed, float slideAccel, float panSpeed, float panAccel, float durationSec)
+{
+    long target_InSteps[STEP_ENGINE_MAX_AXES] = {0};
+    float speed_InStepsPerSecond[STEP_ENGINE_MAX_AXES] = {0};
+    float accel_InStepsPerSecondPerSecond[STEP_ENGINE_MAX_AXES] = {0};
+
+    target_InSteps[SLIDER_AXIS_SLIDE] = slideTarget_InSteps;
+    target_InSteps[SLIDER_AXIS_PAN] = panTarget_InSteps;
+    speed_InStepsPerSecond[SLIDER_AXIS_SLIDE] = slideSpeed;
+    speed_InStepsPerSecond[SLIDER_AXIS_PAN] = panSpeed;
+    accel_InStepsPerSecondPerSecond[SLIDER_AXIS_SLIDE] = slideAccel;
+    accel_InStepsPerSecondPerSecond[SLIDER_AXIS_PAN] = panAccel;
+
+    // Coordinated move always starts from standstill
+    if(!stepEngine.isIdle())
     {
-        //
-        // this code is executed only if homing fails because it has moved farther
-        // than maxHomingDistanceInMM and never finds the limit switch, blink the
-        // LED fast forever indicating a problem
-        //
-        Serial.println("Failed homing!!!");
-
-        CameraSlider_EnableMotors(false);
-
-        while(true)
-        {
-        	digitalWrite(PIN_LED, HIGH);
-        	delay(200);
-        	digitalWrite(PIN_LED, LOW);
-        	delay(200);
-        }
+        return false;
     }
 
-    // Move 1mm away from endstop to avoid falsely triggering it again due to bouncing when starting next move
-    stepper_slide.setSpeedInMillimetersPerSecond(SliderConfig.Config.homing_speed_slide);
-    stepper_slide.setAccelerationInMillimetersPerSecondPerSecond(SliderConfig.Config.default_slider_accel);
-    stepper_slide.setTargetPositionInMillimeters(-2.0);
-    while(!stepper_slide.processMovement()) { }
-
-    // Reset homed position to 0
-    stepper_slide.setCurrentPositionInMillimeters(0.0);
+    if(bStepperResyncPending)
+    {
+        CameraSlider_ResyncSteppers();
+    }
 
-    sliderState = SLIDER_READY;
-    bhomingComplete = true;
+    stepEngine.lockSource();
+    if(durationSec > 0.0)
+    {
+        coordinatedSource.beginTimedMove(target_InSteps, durationSec, accel_InStepsPerSecondPerSecond);
+    }
+    else
+    {
+        coordinatedSource.beginMove(target_InSteps, speed_InStepsPerSecond, accel_InStepsPerSecondPerSecond);
+    }
+    stepEngine.unlockSource();
 
-    CameraSlider_EnableMotors(false);
+    stepEngine.setPosition(SLIDER_AXIS_SLIDE, stepper_slide.getCurrentPositionInSteps());
+    stepEngine.setPosition(SLIDER_AXIS_PAN, stepper_pan.getCurrentPositionInSteps());
+    stepEngine.start(&coordinatedSource);
 
-    Serial.println("done.");
-    
-    EnableEndstopInterrupt();
+    return true;
 }
 
-
-bool CameraSlider_getMotorState()
+// Soft limits of the slide, from home to SOFT_LIMIT_MARGIN_MM off the
+// endstop at the other end of the rail, opposite of the homing direction
+static void CameraSlider_GetSlideLimits(long *pMin_InSteps, long *pMax_InSteps)
 {
-  return bmotorState;
-}
+    long travel_InSteps = lround(fmax(SliderConfig.Config.rail_length - 2.0 * SOFT_LIMIT_MARGIN_MM, 0.0) * SliderConfig.Config.slide_steps_per_mm);
 
+    *pMin_InSteps = (SliderConfig.Config.homing_direction < 0) ? 0 : -travel_InSteps;
+    *pMax_InSteps = (SliderConfig.Config.homing_direction < 0) ? travel_InSteps : 0;
+}
 
-bool CameraSlider_SetState(sliderState_t newState)
+// Soft limits of pan, false if there are none
+static bool CameraSlider_GetPanLimits(long *pMin_InSteps, long *pMax_InSteps)
 {
-    if(newState <= SLIDER_FIRST)
+    long min_InSteps = SliderConfig.Config.rotate_direction * SliderConfig.Config.pan_limit_min_deg * SliderConfig.Config.pan_steps_per_degree;
+    long max_InSteps = SliderConfig.Config.rotate_direction * SliderConfig.Config.pan_limit_max_deg * SliderConfig.Config.pan_steps_per_degree;
+
+    if(SliderConfig.Config.pan_limit_min_deg >= SliderConfig.Config.pan_limit_max_deg)
     {
-        Serial.println("Invalid state requested! (state <= SLIDER_FIRST)");
         return false;
     }
-    else if( newState >= SLIDER_LAST )
+
+    *pMin_InSteps = (min_InSteps < max_InSteps) ? min_InSteps : max_InSteps;
+    *pMax_InSteps = (min_InSteps < max_InSteps) ? max_InSteps : min_InSteps;
+
+    return true;
+}
+
+// Check one axis target against its limits, clamp it or remember why it was refused
+static bool CameraSlider_CheckLimit(long *pTarget_InSteps, long min_InSteps, long max_InSteps, bool clamp, envelopeError_t error)
+{
+    if((*pTarget_InSteps >= min_InSteps) && (*pTarget_InSteps <= max_InSteps))
     {
-        Serial.println("Invalid state requested! (state >= SLIDER_LAST)");
-        return false;
+        return true;
     }
-    else
+
+    if(clamp)
     {
-        sliderState = newState;
+        *pTarget_InSteps = (*pTarget_InSteps < min_InSteps) ? min_InSteps : max_InSteps;
         return true;
     }
 
+    envelopeError = error;
+    envelopeTarget_InSteps = *pTarget_InSteps;
+    envelopeMin_InSteps = min_InSteps;
+    envelopeMax_InSteps = max_InSteps;
+
     return false;
 }
 
-
-void CameraSlider_EnableMotors(bool enable)
+// Check the targets of a move (motor steps) against the soft limits, before
+// anything is planned. Only homed axes have limits. With clamp, targets
+// outside are moved onto the limit, otherwise the move has to be refused.
+bool CameraSlider_CheckEnvelope(long *pSlide_InSteps, long *pPan_InSteps, bool clamp)
 {
-    if(enable == true)
+    long min_InSteps;
+    long max_InSteps;
+
+    envelopeError = ENVELOPE_OK;
+
+    if(bhomingComplete)
     {
-        digitalWrite(PIN_MTR_nEN, LOW);
-        bmotorState = true;
-        CameraSlider_SetState(SLIDER_IDLE);
+        CameraSlider_GetSlideLimits(&min_InSteps, &max_InSteps);
+        if(!CameraSlider_CheckLimit(pSlide_InSteps, min_InSteps, max_InSteps, clamp, ENVELOPE_SLIDE))
+        {
+            return false;
+        }
     }
-    else
+
+    if(bPanHomed && CameraSlider_GetPanLimits(&min_InSteps, &max_InSteps))
     {
-        digitalWrite(PIN_MTR_nEN, HIGH);
-        bmotorState = false;
-        CameraSlider_SetState(SLIDER_MOTORS_OFF);
+        if(!CameraSlider_CheckLimit(pPan_InSteps, min_InSteps, max_InSteps, clamp, ENVELOPE_PAN))
+        {
+            return false;
+        }
     }
+
+    return true;
 }
 
+envelopeError_t CameraSlider_GetEnvelopeError(void)
+{
+    return envelopeError;
+}
 
-bool CameraSlider_FormatJSON_CameraSliderStatus(char *buff, int size)
+// Why the last move was refused, in mm or degrees as the web API takes them
+bool CameraSlider_FormatEnvelopeError(char *buff, int size)
 {
+    float scale;
+    float target;
+    float limitA;
+    float limitB;
     int len;
-    len = snprintf(buff, size, "{\"homed\":%d,\"motors\":%d,\"state\":%d,\"posX\":%f,\"posZ\":%f,\"spX\":%f,\"spZ\":%f,\"epX\":%f,\"epZ\":%f}",
-                 bhomingComplete,
-                 bmotorState,
-                 sliderState,
-                 getSliderPos(),
-                 getRotationPos(true),
-                 fStartPos_Slider,
-                 SliderConfig.Config.rotate_direction*(fStartPos_Rotation/SliderConfig.Config.pan_steps_per_degree),
-                 fEndPos_Slider,
-                 SliderConfig.Config.rotate_direction*(fEndPos_Rotation/SliderConfig.Config.pan_steps_per_degree)
 
-                );
-
-    if(len > 0)
+    if(envelopeError == ENVELOPE_SLIDE)
     {
-        return true;
+        scale = (float)SliderConfig.Config.slider_direction / SliderConfig.Config.slide_steps_per_mm;
     }
     else
     {
-        return false;
+        scale = (float)SliderConfig.Config.rotate_direction / SliderConfig.Config.pan_steps_per_degree;
     }
-}
 
-bool CameraSlider_FormatJSON_CameraConfig(char *buff, int size)
-{
-    int len;
-    len = snprintf(buff, size, "{\"rail_length\":%d,\"dir_homing\":%d,\"dir_slider\":%d,\"dir_rotation\":%d,\"slider_steps_per_mm\":%d,\"rotation_steps_per_deg\":%d,\"homing_speed_slider\":%d,\"homing_speed_rotation\":%d}",
-                SliderConfig.Config.rail_length,
-                SliderConfig.Config.homing_direction,
-                SliderConfig.Config.slider_direction,
-                SliderConfig.Config.rotate_direction,
-                SliderConfig.Config.slide_steps_per_mm,
-                SliderConfig.Config.pan_steps_per_degree,
-                SliderConfig.Config.homing_speed_slide,
-                SliderConfig.Config.homing_speed_pan
-            );
+    target = envelopeTarget_InSteps * scale;
+    limitA = envelopeMin_InSteps * scale;
+    limitB = envelopeMax_InSteps * scale;
 
-    if(len > 0)
+    len = snprintf(buff, size, "%s target %.1f %s is outside the soft limits %.1f to %.1f %s",
+                   (envelopeError == ENVELOPE_SLIDE) ? "Slide" : "Pan",
+                   target,
+                   (envelopeError == ENVELOPE_SLIDE) ? "mm" : "deg",
+                   fmin(limitA, limitB),
+                   fmax(limitA, limitB),
+                   (envelopeError == ENVELOPE_SLIDE) ? "mm" : "deg");
+
+    if((envelopeError != ENVELOPE_OK) && (len > 0) && (len < size))
     {
         return true;
     }
@@ -443,59 +659,1564 @@ bool CameraSlider_FormatJSON_CameraConfig(char *buff, int size)
     }
 }
 
-bool CameraSlider_getHomingState(void)
-{
-  return bhomingComplete;
-}
-
-
-bool CameraSlider_StartMotion(void)
+// Slide to xPos (mm) and pan by rAngle (deg). False if the move was refused
+// for the soft limits (clamp moves onto them instead), see CameraSlider_FormatEnvelopeError(),
+// or if it can't take over from the running move (CameraSlider_CanStartMove()).
+bool CameraSlider_MoveToPositionRelative(float xPos, float xSpeed, float xAccel, float rAngle, float rSpeed, float rAccel, bool clamp)
 {
-    // Configure slider
-    stepper_slide.setTargetPositionInMillimeters(fStartPos_Slider);
-    stepper_slide.setSpeedInMillimetersPerSecond(SliderConfig.Config.default_slider_speed);
-    stepper_slide.setAccelerationInMillimetersPerSecondPerSecond(SliderConfig.Config.default_slider_accel);
+    long slide_InSteps;
+    long pan_InSteps;
 
-    // Configure pan
-    stepper_pan.setTargetPositionInSteps(fStartPos_Rotation);
-    stepper_pan.setSpeedInStepsPerSecond(SliderConfig.Config.default_rotate_speed * SliderConfig.Config.pan_steps_per_degree);
-    stepper_pan.setAccelerationInStepsPerSecondPerSecond(SliderConfig.Config.default_rotate_accel * SliderConfig.Config.pan_steps_per_degree);
+    // Invert slider or pan motor if necessary
+    xPos = SliderConfig.Config.slider_direction * xPos;
+    rAngle = SliderConfig.Config.rotate_direction * rAngle;
 
-    CameraSlider_SetState(SLIDER_MOVING_TO_START);
+    // Pan is relative to where it stands. A coordinated move starts from standstill,
+    // from the step the motor is at, the stepper plans ahead of it.
+    slide_InSteps = round(xPos * SliderConfig.Config.slide_steps_per_mm);
+    pan_InSteps = (bCoordinatedMotion ? stepEngine.getPosition(SLIDER_AXIS_PAN) : stepper_pan.getCurrentPositionInSteps()) +
+                  round(rAngle * SliderConfig.Config.pan_steps_per_degree);
+    if(!CameraSlider_CheckEnvelope(&slide_InSteps, &pan_InSteps, clamp) || !CameraSlider_CanStartMove(bCoordinatedMotion))
+    {
+        return false;
+    }
 
-    return true;
-}
+    if(bCoordinatedMotion)
+    {
+        CameraSlider_MoveCoordinated(slide_InSteps, pan_InSteps,
+                                     xSpeed * SliderConfig.Config.slide_steps_per_mm, xAccel * SliderConfig.Config.slide_steps_per_mm,
+                                     rSpeed * SliderConfig.Config.pan_steps_per_degree, rAccel * SliderConfig.Config.pan_steps_per_degree, 0.0);
+        CameraSlider_SetState(SLIDER_WORKING);
+        return true;
+    }
 
-bool CameraSlider_SetDuration(uint32_t durationSec)
-{
-    slideDurationSec = durationSec;
-    return true;
-}
+    stepEngine.lockSource();
 
-bool CameraSlider_SetStartPosition(float slideStartPos, float rotStartPos)
-{
-    fStartPos_Slider = slideStartPos;
-    fStartPos_Rotation = rotStartPos;
+    // Setup slider
+    stepper_slide.setTargetPositionInSteps(slide_InSteps);
+    stepper_slide.setSpeedInMillimetersPerSecond(xSpeed);
+    stepper_slide.setAccelerationInMillimetersPerSecondPerSecond(xAccel);
 
-    return true;
-}
+    // Setup pan
+    stepper_pan.setTargetPositionInSteps(pan_InSteps);
+    stepper_pan.setSpeedInStepsPerSecond(rSpeed * SliderConfig.Config.pan_steps_per_degree);
+    stepper_pan.setAccelerationInStepsPerSecondPerSecond(rAccel * SliderConfig.Config.pan_steps_per_degree);
 
+    stepEngine.unlockSource();
+    CameraSlider_StartMotors();
 
-bool CameraSlider_SetEndPosition(float slideEndPos, float rotEndPos)
-{
-    fEndPos_Slider = slideEndPos;
-    fEndPos_Rotation = rotEndPos;
+    // Updatestate machine
+    CameraSlider_SetState(SLIDER_WORKING);
 
     return true;
 }
 
-bool CameraSlider_StoreAsStartPosition(void)
+// Slide to xPos (mm) and pan to rSteps. False if the move was refused
+// for the soft limits (clamp moves onto them instead), see CameraSlider_FormatEnvelopeError(),
+// or if it can't take over from the running move (CameraSlider_CanStartMove()).
+bool CameraSlider_MoveToPositionAbsolute(float xPos, float xSpeed, float xAccel, float rSteps, float rSpeed, float rAccel, bool clamp)
 {
-    fStartPos_Slider = getSliderPos();
-    fStartPos_Rotation = getRotationPos(false);
+    long slide_InSteps;
+    long pan_InSteps;
 
-    return true;
-}
+    // Invert slider or pan motor if necessary
+    xPos = SliderConfig.Config.slider_direction * xPos;
+    rSteps = SliderConfig.Config.rotate_direction * rSteps;
+
+    slide_InSteps = round(xPos * SliderConfig.Config.slide_steps_per_mm);
+    pan_InSteps = round(rSteps);
+    if(!CameraSlider_CheckEnvelope(&slide_InSteps, &pan_InSteps, clamp) || !CameraSlider_CanStartMove(bCoordinatedMotion))
+    {
+        return false;
+    }
+
+    if(bCoordinatedMotion)
+    {
+        CameraSlider_MoveCoordinated(slide_InSteps, pan_InSteps,
+                                     xSpeed * SliderConfig.Config.slide_steps_per_mm, xAccel * SliderConfig.Config.slide_steps_per_mm,
+                                     rSpeed * SliderConfig.Config.pan_steps_per_degree, rAccel * SliderConfig.Config.pan_steps_per_degree, 0.0);
+        CameraSlider_SetState(SLIDER_WORKING);
+        return true;
+    }
+
+    stepEngine.lockSource();
+
+    // Setup slider
+    stepper_slide.setTargetPositionInSteps(slide_InSteps);
+    stepper_slide.setSpeedInMillimetersPerSecond(xSpeed);
+    stepper_slide.setAccelerationInMillimetersPerSecondPerSecond(xAccel);
+
+    // Setup pan
+    stepper_pan.setTargetPositionInSteps(pan_InSteps);
+    stepper_pan.setSpeedInStepsPerSecond(rSpeed * SliderConfig.Config.pan_steps_per_degree);
+    stepper_pan.setAccelerationInStepsPerSecondPerSecond(rAccel * SliderConfig.Config.pan_steps_per_degree);
+
+    stepEngine.unlockSource();
+    CameraSlider_StartMotors();
+
+    // Updatestate machine
+    CameraSlider_SetState(SLIDER_WORKING);
+
+    return true;
+}
+
+// Bulb ramp for the following steppings, count 0 shoots fixed exposures again.
+// Keyframes need increasing frames and bulb times of 1ms to EXPOSURE_RAMP_MAX_BULB_MS.
+bool CameraSlider_SetExposureRamp(const ExposureKeyframe_t *pKeyframes, uint8_t count)
+{
+    if(count > EXPOSURE_RAMP_MAX_KEYFRAMES)
+    {
+        return false;
+    }
+
+    for(uint8_t i = 0; i < count; i++)
+    {
+        if((pKeyframes[i].bulb_InMS == 0) || (pKeyframes[i].bulb_InMS > EXPOSURE_RAMP_MAX_BULB_MS) ||
+           ((i > 0) && (pKeyframes[i].frame <= pKeyframes[i - 1].frame)))
+        {
+            return false;
+        }
+    }
+
+    memcpy(exposureKeyframes, pKeyframes, count * sizeof(ExposureKeyframe_t));
+    exposureKeyframeCount = count;
+    return true;
+}
+
+// Bulb time of a frame on the ramp. Exposure changes by the same number of
+// stops every frame between two keyframes, flat before the first and after
+// the last keyframe.
+static uint32_t CameraSlider_RampBulb(uint16_t frame)
+{
+    const ExposureKeyframe_t *pFrom;
+    const ExposureKeyframe_t *pTo;
+    float fraction;
+    uint8_t i;
+
+    if(frame <= exposureKeyframes[0].frame)
+    {
+        return exposureKeyframes[0].bulb_InMS;
+    }
+
+    for(i = 1; (i < exposureKeyframeCount) && (frame > exposureKeyframes[i].frame); i++)
+    {
+    }
+
+    if(i >= exposureKeyframeCount)
+    {
+        return exposureKeyframes[exposureKeyframeCount - 1].bulb_InMS;
+    }
+
+    pFrom = &exposureKeyframes[i - 1];
+    pTo = &exposureKeyframes[i];
+    fraction = (float)(frame - pFrom->frame) / (pTo->frame - pFrom->frame);
+
+    return lround(pFrom->bulb_InMS * pow((float)pTo->bulb_InMS / pFrom->bulb_InMS, fraction));
+}
+
+// Time a move takes from standstill to standstill, planned step by step with
+// the ramp generator of the stepper that runs it
+template <class RampGenerator>
+static float CameraSlider_PlanMoveTime(long distance_InSteps, float speed_InStepsPerSecond, float accel_InStepsPerSecondPerSecond, float jerk_InStepsPerSecondPerSecondPerSecond)
+{
+    FlexyStepperT<RampGenerator> stepper;
+    float period_InUS;
+    int direction;
+    double time_InUS = 0.0;
+
+    if((speed_InStepsPerSecond <= 0.0) || (accel_InStepsPerSecondPerSecond <= 0.0))
+    {
+        return 0.0;
+    }
+
+    stepper.setSpeedInStepsPerSecond(speed_InStepsPerSecond);
+    stepper.setAccelerationInStepsPerSecondPerSecond(accel_InStepsPerSecondPerSecond);
+    stepper.setJerkInStepsPerSecondPerSecondPerSecond(jerk_InStepsPerSecondPerSecondPerSecond);
+    stepper.setTargetPositionInSteps(labs(distance_InSteps));
+
+    while(stepper.planNextStep(&period_InUS, &direction))
+    {
+        time_InUS += period_InUS;
+    }
+
+    return time_InUS / 1000000.0;
+}
+
+// With an interval, every frame has to be done with the exposure of the
+// frame before, the move and the settle time by its shutter time. Finds the
+// frame with the least slack, false if that one doesn't fit. Moves are
+// planned like CameraSlider_ProcessStepping() sets them up.
+static bool CameraSlider_FitFrames(void)
+{
+    float stepsPerMM = SliderConfig.Config.slide_steps_per_mm;
+    float stepsPerDeg = SliderConfig.Config.pan_steps_per_degree;
+    float slide_InS = CameraSlider_PlanMoveTime<SLIDE_RAMP_GENERATOR>(lround(steppingConfig.step_InMM * stepsPerMM),
+                                                                      STEPPING_SLIDE_SPEED * stepsPerMM, STEPPING_SLIDE_ACCEL * stepsPerMM,
+                                                                      SliderConfig.Config.slide_jerk * stepsPerMM);
+    float pan_InS = CameraSlider_PlanMoveTime<PAN_RAMP_GENERATOR>(lround(steppingConfig.pan_InDeg * stepsPerDeg),
+                                                                  SliderConfig.Config.default_rotate_speed * stepsPerDeg, SliderConfig.Config.default_rotate_accel * stepsPerDeg,
+                                                                  SliderConfig.Config.pan_jerk * stepsPerDeg);
+    uint32_t move_InMS = ceil(1000.0 * fmax(slide_InS, pan_InS)) + 2 * TASK_MOTION_POLL_MS;
+    uint32_t need_InMS;
+    int32_t slack_InMS;
+
+    steppingPlannedMinSlack_InMS = 0;
+    if(steppingConfig.interval_InMS == 0)
+    {
+        return true;
+    }
+
+    for(uint16_t frame = 1; frame < steppingConfig.frames; frame++)
+    {
+        need_InMS = (bExposureRamp ? exposureRamp_InMS[frame - 1] : 0) + steppingConfig.exposure_InMS + move_InMS + steppingConfig.settle_InMS;
+        slack_InMS = (int32_t)steppingConfig.interval_InMS - (int32_t)need_InMS;
+
+        if((frame == 1) || (slack_InMS < steppingPlannedMinSlack_InMS))
+        {
+            steppingPlannedMinSlack_InMS = slack_InMS;
+            steppingNoFitFrame = frame;
+            steppingNoFitNeed_InMS = need_InMS;
+        }
+    }
+
+    return (steppingPlannedMinSlack_InMS >= 0);
+}
+
+// Shoot-move-shoot: settle, release the shutter, wait for the exposure
+// and move on to the next frame, for pConfig->frames frames starting
+// where the slider stands, so only from standstill. Runs from CameraSlider_tick() without blocking.
+// With a bulb ramp (CameraSlider_SetExposureRamp()) every frame is a bulb
+// exposure from the ramp, the next move waits for the bulb and exposure_InMS.
+bool CameraSlider_StartStepping(const CameraSliderStepping_t *pConfig)
+{
+    long lastSlide_InSteps;
+    long lastPan_InSteps;
+
+    if(!stepEngine.isIdle())
+    {
+        steppingError = STEPPING_ERROR_BUSY;
+        return false;
+    }
+
+    // Frames count from the last step the motors made
+    if(bStepperResyncPending)
+    {
+        CameraSlider_ResyncSteppers();
+    }
+
+    steppingConfig = *pConfig;
+    steppingError = STEPPING_ERROR_NONE;
+
+    if((steppingConfig.frames == 0) && (steppingConfig.step_InMM != 0.0))
+    {
+        steppingConfig.frames = fmin(floor(fabs(steppingConfig.distance_InMM / steppingConfig.step_InMM)) + 1, 65535.0);
+    }
+
+    if(steppingConfig.frames == 0)
+    {
+        steppingError = STEPPING_ERROR_NO_FRAMES;
+        return false;
+    }
+
+    // Last frame, counted from where the slider stands like CameraSlider_ProcessStepping() does
+    lastSlide_InSteps = stepper_slide.getCurrentPositionInSteps() + lround(SliderConfig.Config.slider_direction * (steppingConfig.frames - 1) * steppingConfig.step_InMM * SliderConfig.Config.slide_steps_per_mm);
+    lastPan_InSteps = stepper_pan.getCurrentPositionInSteps() + lround(SliderConfig.Config.rotate_direction * (steppingConfig.frames - 1) * steppingConfig.pan_InDeg * SliderConfig.Config.pan_steps_per_degree);
+    if(!CameraSlider_CheckEnvelope(&lastSlide_InSteps, &lastPan_InSteps, false))
+    {
+        steppingError = STEPPING_ERROR_LIMITS;
+        return false;
+    }
+
+    bExposureRamp = (exposureKeyframeCount > 0);
+    if(bExposureRamp)
+    {
+        if(steppingConfig.frames > EXPOSURE_RAMP_MAX_FRAMES)
+        {
+            steppingError = STEPPING_ERROR_RAMP_TOO_LONG;
+            return false;
+        }
+
+        for(uint16_t frame = 0; frame < steppingConfig.frames; frame++)
+        {
+            exposureRamp_InMS[frame] = CameraSlider_RampBulb(frame);
+        }
+    }
+
+    // A frame that doesn't fit shifts the bulbs of a ramp off the frames they belong to.
+    // With a fixed exposure it only runs late, the overruns show in the stepping metrics.
+    if(!CameraSlider_FitFrames())
+    {
+        Serial.print("Frame ");
+        Serial.print(steppingNoFitFrame);
+        Serial.print(" needs ");
+        Serial.print(steppingNoFitNeed_InMS);
+        Serial.println(" ms, longer than the interval");
+
+        if(bExposureRamp)
+        {
+            steppingError = STEPPING_ERROR_NO_FIT;
+            return false;
+        }
+    }
+
+    Serial.print("Start Stepping, frames: ");
+    Serial.println(steppingConfig.frames);
+
+    CameraSlider_EnableMotors(true);
+
+    steppingFrame = 0;
+    steppingStartSlide_InSteps = stepper_slide.getCurrentPositionInSteps();
+    steppingStartPan_InSteps = stepper_pan.getCurrentPositionInSteps();
+
+    steppingStart_InMS = millis() + steppingConfig.settle_InMS;
+    steppingMinSlack_InMS = 0;
+    steppingOverruns = 0;
+    steppingMaxLate_InMS = 0;
+    memset(steppingSlack_InMS, 0, sizeof(steppingSlack_InMS));
+
+    CameraSlider_StandForFrame();
+
+    return true;
+}
+
+// Arrived at a frame, shutter goes once it stood still for the settle time.
+// With an interval not before the shutter time of the frame, a late frame
+// goes right away and the frames after it stay on their times.
+void CameraSlider_StandForFrame(void)
+{
+    uint32_t ready_InMS = millis() + steppingConfig.settle_InMS;
+    uint32_t shutter_InMS;
+    int32_t slack_InMS;
+
+    bSteppingExposing = false;
+    bSteppingFocused = false;
+    steppingDeadline_InMS = ready_InMS;
+
+    if(steppingConfig.interval_InMS > 0)
+    {
+        shutter_InMS = steppingStart_InMS + steppingFrame * steppingConfig.interval_InMS;
+        slack_InMS = (int32_t)(shutter_InMS - ready_InMS);
+
+        // The first frame sets the times, it can't be early or late
+        steppingSlack_InMS[steppingFrame % STEPPING_SLACK_LOG] = slack_InMS;
+        if((steppingFrame == 1) || ((steppingFrame > 1) && (slack_InMS < steppingMinSlack_InMS)))
+        {
+            steppingMinSlack_InMS = slack_InMS;
+        }
+
+        if(slack_InMS >= 0)
+        {
+            steppingDeadline_InMS = shutter_InMS;
+        }
+        else
+        {
+            steppingOverruns++;
+            Serial.print("Frame ");
+            Serial.print(steppingFrame);
+            Serial.print(" overrun by ");
+            Serial.print(-slack_InMS);
+            Serial.println(" ms");
+        }
+    }
+
+    CameraSlider_SetState(SLIDER_STEP_FINISHED);
+}
+
+// Standing at a frame (SLIDER_STEP_FINISHED), called from CameraSlider_tick()
+void CameraSlider_ProcessStepping(void)
+{
+    long slide_InSteps;
+    long pan_InSteps;
+
+    if((int32_t)(millis() - steppingDeadline_InMS) < 0)
+    {
+        // Wake the camera the pre-wake time before the shot
+        if(!bSteppingExposing && !bSteppingFocused &&
+           ((int32_t)(millis() + SliderConfig.Config.focus_prewake_ms - steppingDeadline_InMS) >= 0))
+        {
+            CameraControl_Focus();
+            bSteppingFocused = true;
+        }
+        return;
+    }
+
+    if(!bSteppingExposing)
+    {
+        // How late the motion task got here, doesn't add up over the frames
+        if((uint32_t)(millis() - steppingDeadline_InMS) > steppingMaxLate_InMS)
+        {
+            steppingMaxLate_InMS = millis() - steppingDeadline_InMS;
+        }
+
+        if(bExposureRamp)
+        {
+            CameraControl_Post(CAMERA_EVENT_BULB_START, exposureRamp_InMS[steppingFrame]);
+            steppingDeadline_InMS = millis() + exposureRamp_InMS[steppingFrame] + steppingConfig.exposure_InMS;
+        }
+        else
+        {
+            CameraControl_ReleaseShutter();
+            steppingDeadline_InMS = millis() + steppingConfig.exposure_InMS;
+        }
+        steppingFrame++;
+        bSteppingExposing = true;
+        return;
+    }
+
+    // Never move while the camera still exposes
+    if(CameraControl_IsExposing())
+    {
+        return;
+    }
+
+    if(steppingFrame >= steppingConfig.frames)
+    {
+        Serial.println("Reached final step, stopped stepping");
+        CameraSlider_EnableMotors(false);
+        return;
+    }
+
+    // Frame positions count from the start, rounding doesn't add up
+    slide_InSteps = steppingStartSlide_InSteps + lround(SliderConfig.Config.slider_direction * steppingFrame * steppingConfig.step_InMM * SliderConfig.Config.slide_steps_per_mm);
+    pan_InSteps = steppingStartPan_InSteps + lround(SliderConfig.Config.rotate_direction * steppingFrame * steppingConfig.pan_InDeg * SliderConfig.Config.pan_steps_per_degree);
+
+    stepEngine.lockSource();
+    stepper_slide.setTargetPositionInSteps(slide_InSteps);
+    stepper_slide.setSpeedInMillimetersPerSecond(STEPPING_SLIDE_SPEED);
+    stepper_slide.setAccelerationInMillimetersPerSecondPerSecond(STEPPING_SLIDE_ACCEL);
+    stepper_pan.setTargetPositionInSteps(pan_InSteps);
+    stepper_pan.setSpeedInStepsPerSecond(SliderConfig.Config.default_rotate_speed * SliderConfig.Config.pan_steps_per_degree);
+    stepper_pan.setAccelerationInStepsPerSecondPerSecond(SliderConfig.Config.default_rotate_accel * SliderConfig.Config.pan_steps_per_degree);
+    stepEngine.unlockSource();
+    CameraSlider_StartMotors();
+
+    CameraSlider_SetState(SLIDER_STEPPING);
+
+    Serial.print("Started step ");
+    Serial.print(steppingFrame);
+    Serial.print(" / ");
+    Serial.println(steppingConfig.frames - 1);
+}
+
+// Shoot every every_InMM of the timed move, counted from its start position.
+// 0 turns position triggers off. Takes effect with the next timed move.
+bool CameraSlider_SetPositionTriggers(float every_InMM)
+{
+    if(!(every_InMM >= 0.0))
+    {
+        return false;
+    }
+
+    triggerEvery_InMM = every_InMM;
+    return true;
+}
+
+// Top slide speed of the timed move in mm/s, the same profile CameraSlider_tick() starts
+static float CameraSlider_TimedMoveSpeed(void)
+{
+    float distance = fabs(fEndPos_Slider - fStartPos_Slider);
+    float duration = (slideDurationSec > 0) ? slideDurationSec : 1;
+    float accel = SliderConfig.Config.default_slider_accel;
+    float discriminant;
+
+    // Slide stepper cruises at the average speed
+    if(!bCoordinatedMotion)
+    {
+        return distance / duration;
+    }
+
+    // Trapezoid that takes the whole duration, see CoordinatedStepSource::beginTimedMove()
+    discriminant = accel * accel * duration * duration - 4.0 * accel * distance;
+    if(discriminant < 0.0)
+    {
+        return sqrt(accel * distance);
+    }
+    return (accel * duration - sqrt(discriminant)) / 2.0;
+}
+
+// Check the position triggers against the timed move set up for CameraSlider_StartMotion().
+// The shutter fires shutter_latency_ms ahead of every position, false if at the top speed
+// that lead is a whole trigger spacing or more (pLead_InMM) and shots would run together.
+bool CameraSlider_CheckPositionTriggers(float *pLead_InMM)
+{
+    *pLead_InMM = SliderConfig.Config.shutter_latency_ms / 1000.0 * CameraSlider_TimedMoveSpeed();
+
+    return (triggerEvery_InMM <= 0.0) || (*pLead_InMM < triggerEvery_InMM);
+}
+
+// Arm the first trigger of a move from from_InMM to to_InMM, before it starts
+void CameraSlider_ArmPositionTriggers(float from_InMM, float to_InMM)
+{
+    float count = 0.0;
+
+    CameraSlider_DisarmPositionTriggers();
+
+    if(triggerEvery_InMM > 0.0)
+    {
+        count = floor(fabs(to_InMM - from_InMM) / triggerEvery_InMM + 1E-3);
+    }
+    if(count < 1.0)
+    {
+        return;
+    }
+
+    // Shots land on their positions with the latency of the camera
+    triggerLead_InUS = SliderConfig.Config.shutter_latency_ms * 1000;
+    triggerSpacing_InSteps = lround(((to_InMM >= from_InMM) ? triggerEvery_InMM : -triggerEvery_InMM) * SliderConfig.Config.slide_steps_per_mm);
+    triggerNext_InSteps = lround(from_InMM * SliderConfig.Config.slide_steps_per_mm) + triggerSpacing_InSteps;
+    triggersLeft = (count > 65535.0) ? 65535 : (uint16_t)count;
+    triggerLastLead_InSteps = 0;
+
+    CameraControl_AttachTrigger(true);
+    bTriggersArmed = true;
+    stepEngine.armTrigger(SLIDER_AXIS_SLIDE, triggerNext_InSteps, triggerLead_InUS);
+
+    Serial.print("Position triggers: ");
+    Serial.print(triggersLeft);
+    Serial.print(" shots every ");
+    Serial.print(triggerEvery_InMM);
+    Serial.println(" mm");
+}
+
+void CameraSlider_DisarmPositionTriggers(void)
+{
+    if(!bTriggersArmed)
+    {
+        return;
+    }
+
+    stepEngine.disarmTrigger();
+    CameraControl_AttachTrigger(false);
+    bTriggersArmed = false;
+}
+
+// Step interrupt, the slide reached the next trigger (or is its lead time away)
+void IRAM_ATTR CameraSlider_PositionTriggerISR(void *pContext, uint8_t axis, long position)
+{
+    CameraControl_TriggerShutterFromISR();
+
+    triggerLastLead_InSteps = (triggerSpacing_InSteps > 0) ? (triggerNext_InSteps - position) : (position - triggerNext_InSteps);
+    triggersLeft = triggersLeft - 1;
+    if(triggersLeft > 0)
+    {
+        triggerNext_InSteps = triggerNext_InSteps + triggerSpacing_InSteps;
+        stepEngine.armTrigger(SLIDER_AXIS_SLIDE, triggerNext_InSteps, triggerLead_InUS);
+    }
+}
+
+bool CameraSlider_MoveToStart(float xSpeed, float xAccel, float rSpeed, float rAccel, bool clamp)
+{
+    return CameraSlider_MoveToPositionAbsolute(fStartPos_Slider, xSpeed, xAccel, fStartPos_Rotation, rSpeed, rAccel, clamp);
+}
+
+bool CameraSlider_MoveToEnd(float xSpeed, float xAccel, float rSpeed, float rAccel, bool clamp)
+{
+    return CameraSlider_MoveToPositionAbsolute(fEndPos_Slider, xSpeed, xAccel, fEndPos_Rotation, rSpeed, rAccel, clamp);
+}
+
+// Homing drives one axis at a time, pick the stepper
+static long CameraSlider_HomingPosition(void)
+{
+    if(homingAxis.axis == SLIDER_AXIS_PAN)
+    {
+        return stepper_pan.getCurrentPositionInSteps();
+    }
+    return stepper_slide.getCurrentPositionInSteps();
+}
+
+// Start homing an axis, runs from CameraSlider_tick() in SLIDER_HOMING
+void CameraSlider_StartHoming(CameraSliderAxis_t axis)
+{
+    homingAxis.axis = axis;
+
+    if(axis == SLIDER_AXIS_PAN)
+    {
+        homingAxis.switchPin = (panHomingMode == PAN_HOMING_SWITCH) ? PIN_HOME_SWITCH_PAN : -1;
+        homingAxis.direction = PAN_HOMING_DIRECTION;
+        homingAxis.range_InSteps = lround(PAN_HOMING_RANGE_DEG * SliderConfig.Config.pan_steps_per_degree);
+        homingAxis.retract_InSteps = lround(PAN_HOMING_RETRACT_DEG * SliderConfig.Config.pan_steps_per_degree);
+        homingAxis.seekSpeed_InStepsPerSecond = SliderConfig.Config.homing_speed_pan;
+        homingAxis.approachSpeed_InStepsPerSecond = PAN_HOMING_APPROACH_SPEED * SliderConfig.Config.pan_steps_per_degree;
+        homingAxis.accel_InStepsPerSecondPerSecond = SliderConfig.Config.default_rotate_accel * SliderConfig.Config.pan_steps_per_degree;
+        homingAxis.bFromHome = bPanHomed;
+        bPanHomed = false;
+
+        Serial.println("Homing pan");
+    }
+    else
+    {
+        homingAxis.switchPin = PIN_END_SWICH_X_LEFT;
+        homingAxis.direction = SliderConfig.Config.homing_direction;
+        homingAxis.range_InSteps = (long)SliderConfig.Config.rail_length * SliderConfig.Config.slide_steps_per_mm;
+        homingAxis.retract_InSteps = lround(HOMING_RETRACT_MM * SliderConfig.Config.slide_steps_per_mm);
+        homingAxis.seekSpeed_InStepsPerSecond = SliderConfig.Config.homing_speed_slide * SliderConfig.Config.slide_steps_per_mm;
+        homingAxis.approachSpeed_InStepsPerSecond = HOMING_APPROACH_SPEED * SliderConfig.Config.slide_steps_per_mm;
+        homingAxis.accel_InStepsPerSecondPerSecond = SliderConfig.Config.default_slider_accel * SliderConfig.Config.slide_steps_per_mm;
+        homingAxis.bFromHome = bhomingComplete;
+        bhomingComplete = false;
+
+        // Homing drives into the endstop on purpose
+        DisableEndstopInterrupt();
+
+        Serial.println("Homing linear rail");
+    }
+
+    Serial.print("Dir: ");
+    Serial.println(homingAxis.direction, DEC);
+    Serial.print("EndSW: ");
+    Serial.println(homingAxis.switchPin, DEC);
+
+    CameraSlider_HaltMotors();
+    digitalWrite(PIN_MTR_nEN, LOW);
+    bmotorState = true;
+
+    bHomingCancelRequest = false;
+    homingError = HOMING_ERROR_NONE;
+    CameraSlider_NextHomingPhase(HOMING_PHASE_SEEK);
+}
+
+// Home the pan axis as set by PAN_HOMING_MODE, without a switch or a
+// stop the current angle becomes 0
+bool CameraSlider_StartPanHoming(void)
+{
+    if(panHomingMode == PAN_HOMING_NONE)
+    {
+        CameraSlider_StoreAsRotationHome();
+        bPanHomed = true;
+        return true;
+    }
+
+    homingRequestAxis = SLIDER_AXIS_PAN;
+    return CameraSlider_SetState(SLIDER_HOMING);
+}
+
+// Move on to the next homing phase, its move starts once the axis
+// stood still for HOMING_SETTLE_MS
+void CameraSlider_NextHomingPhase(homingPhase_t phase)
+{
+    if(homingAxis.switchPin >= 0)
+    {
+        detachInterrupt(digitalPinToInterrupt(homingAxis.switchPin));
+    }
+
+    homingPhase = phase;
+    bHomingMoveStarted = false;
+    homingPhaseStart_InMS = millis();
+}
+
+// Leave homing, the state is up to the caller
+void CameraSlider_EndHoming(homingError_t error)
+{
+    if(homingAxis.switchPin >= 0)
+    {
+        detachInterrupt(digitalPinToInterrupt(homingAxis.switchPin));
+    }
+
+    homingPhase = HOMING_PHASE_NONE;
+    homingError = error;
+    bHomingCancelRequest = false;
+
+    EnableEndstopInterrupt();
+}
+
+// Stop homing from any task, the motion task stops the motor with its next tick
+bool CameraSlider_CancelHoming(void)
+{
+    if(sliderState != SLIDER_HOMING)
+    {
+        return false;
+    }
+
+    bHomingCancelRequest = true;
+    CameraSlider_WakeMotion();
+
+    return true;
+}
+
+// Home switch pressed while seeking or approaching. Latch the last emitted
+// step right at the edge, so the home position doesn't depend on when the
+// motion task gets to look at the switch, and stop the axis. Only calls
+// what is in IRAM, the motion task brings the steppers to the stop.
+void IRAM_ATTR CameraSlider_HomingLatchISR(void)
+{
+    if(!bHomingLatched)
+    {
+        homingLatch_InSteps = stepEngine.getPosition(homingAxis.axis);
+        bHomingLatched = true;
+        stepEngine.stop();
+        bStepperResyncPending = true;
+        CameraSlider_WakeMotion();
+    }
+}
+
+// Homing move to target_InSteps. Moves onto the switch latch the
+// switch edge with CameraSlider_HomingLatchISR().
+static void CameraSlider_StartHomingMove(long target_InSteps, float speed_InStepsPerSecond, bool latchEdge)
+{
+    stepEngine.lockSource();
+    if(homingAxis.axis == SLIDER_AXIS_PAN)
+    {
+        stepper_pan.setSpeedInStepsPerSecond(speed_InStepsPerSecond);
+        stepper_pan.setAccelerationInStepsPerSecondPerSecond(homingAxis.accel_InStepsPerSecondPerSecond);
+        stepper_pan.setTargetPositionInSteps(target_InSteps);
+    }
+    else
+    {
+        stepper_slide.setSpeedInStepsPerSecond(speed_InStepsPerSecond);
+        stepper_slide.setAccelerationInStepsPerSecondPerSecond(homingAxis.accel_InStepsPerSecondPerSecond);
+        stepper_slide.setTargetPositionInSteps(target_InSteps);
+    }
+    stepEngine.unlockSource();
+
+    homingPhaseStart_InSteps = CameraSlider_HomingPosition();
+
+    // A latch of an earlier move (or axis) is no edge of this one
+    bHomingLatched = false;
+    if(latchEdge && (homingAxis.switchPin >= 0))
+    {
+        attachInterrupt(digitalPinToInterrupt(homingAxis.switchPin), CameraSlider_HomingLatchISR, RISING);
+    }
+
+    CameraSlider_StartMotors();
+    bHomingMoveStarted = true;
+}
+
+// Switch edge of the slow approach (or the mechanical stop), in steps of
+// the coordinates the axis had before this homing
+static void CameraSlider_HomingEdgeFound(long edge_InSteps)
+{
+    HomingRepeatability *pStats = &homingRepeatability[homingAxis.axis];
+    long deviation_InSteps;
+
+    // Against a stop the motor loses steps, nothing to compare
+    if(homingAxis.bFromHome && (homingAxis.switchPin >= 0))
+    {
+        // Last homing put 0 retract_InSteps away from the edge
+        deviation_InSteps = edge_InSteps - homingAxis.direction * homingAxis.retract_InSteps;
+
+        if((pStats->cycles == 0) || (deviation_InSteps < pStats->min_InSteps))
+        {
+            pStats->min_InSteps = deviation_InSteps;
+        }
+        if((pStats->cycles == 0) || (deviation_InSteps > pStats->max_InSteps))
+        {
+            pStats->max_InSteps = deviation_InSteps;
+        }
+        pStats->last_InSteps = deviation_InSteps;
+        pStats->cycles++;
+    }
+
+    // How far the fast seek latched from the slow approach
+    pStats->seekOffset_InSteps = homingSeekEdge_InSteps - edge_InSteps;
+
+    homingHome_InSteps = edge_InSteps - homingAxis.direction * homingAxis.retract_InSteps;
+}
+
+// Homing finished, home becomes position 0
+static void CameraSlider_HomingDone(void)
+{
+    stepEngine.lockSource();
+    if(homingAxis.axis == SLIDER_AXIS_PAN)
+    {
+        stepper_pan.setCurrentPositionInSteps(0);
+        stepper_pan.setTargetPositionInSteps(0);
+        bPanHomed = true;
+    }
+    else
+    {
+        stepper_slide.setCurrentPositionInSteps(0);
+        stepper_slide.setTargetPositionInSteps(0);
+        bhomingComplete = true;
+    }
+    stepEngine.unlockSource();
+
+    CameraSlider_EndHoming(HOMING_ERROR_NONE);
+    CameraSlider_EnableMotors(false);
+
+    Serial.println("Homing done.");
+}
+
+// One homing step, called from CameraSlider_tick() in SLIDER_HOMING.
+// The step engine moves the axis, this only watches the switch and
+// switches phases, so it never blocks the motion task.
+//
+// Two speeds: the seek finds the switch fast, backs off and approaches
+// again slowly. Only the switch edge of the slow approach sets home.
+// Without a switch the seek drives against a mechanical stop for the
+// whole range, where the stop is is home.
+void CameraSlider_ProcessHoming(void)
+{
+    long toHome_InSteps;
+    long current_InSteps;
+    long edge_InSteps;
+    bool bEndstop = false;
+
+    if(homingPhase == HOMING_PHASE_NONE)
+    {
+        CameraSlider_StartHoming(homingRequestAxis);
+        homingRequestAxis = SLIDER_AXIS_SLIDE;
+    }
+
+    if(bHomingCancelRequest)
+    {
+        Serial.println("Homing cancelled");
+        CameraSlider_HaltMotors();
+        CameraSlider_EndHoming(HOMING_ERROR_CANCELLED);
+        CameraSlider_SetState(SLIDER_IDLE);
+        return;
+    }
+
+    toHome_InSteps = homingAxis.direction * homingAxis.range_InSteps;
+
+    if(homingAxis.switchPin >= 0)
+    {
+        bEndstop = (digitalRead(homingAxis.switchPin) == HIGH);
+    }
+
+    if(!bHomingMoveStarted)
+    {
+        if((millis() - homingPhaseStart_InMS) < HOMING_SETTLE_MS)
+        {
+            return;
+        }
+
+        current_InSteps = CameraSlider_HomingPosition();
+
+        switch(homingPhase)
+        {
+            case HOMING_PHASE_SEEK:
+                if(bEndstop)
+                {
+                    // Already on the endstop
+                    homingSeekEdge_InSteps = current_InSteps;
+                    CameraSlider_NextHomingPhase(HOMING_PHASE_BACK_OFF);
+                    return;
+                }
+                CameraSlider_StartHomingMove(current_InSteps + toHome_InSteps, homingAxis.seekSpeed_InStepsPerSecond, true);
+            break;
+
+            case HOMING_PHASE_BACK_OFF:
+                CameraSlider_StartHomingMove(current_InSteps - toHome_InSteps, homingAxis.seekSpeed_InStepsPerSecond, false);
+            break;
+
+            case HOMING_PHASE_APPROACH:
+                CameraSlider_StartHomingMove(current_InSteps + toHome_InSteps, homingAxis.approachSpeed_InStepsPerSecond, true);
+            break;
+
+            case HOMING_PHASE_RETRACT:
+                // Off the endstop, so it doesn't trigger again by bouncing when the next move starts
+                CameraSlider_StartHomingMove(homingHome_InSteps, homingAxis.seekSpeed_InStepsPerSecond, false);
+            break;
+
+            default:
+            break;
+        }
+        return;
+    }
+
+    switch(homingPhase)
+    {
+        case HOMING_PHASE_SEEK:
+        case HOMING_PHASE_APPROACH:
+            if((homingAxis.axis == SLIDER_AXIS_SLIDE) && (digitalRead(PIN_END_SWICH_X_RIGHT) == HIGH))
+            {
+                CameraSlider_FailHoming(HOMING_ERROR_WRONG_ENDSTOP);
+            }
+            else if(bHomingLatched || bEndstop)
+            {
+                CameraSlider_HaltMotors();
+
+                // Without the edge interrupt (pressed before it was attached)
+                // home is where the axis stopped
+                edge_InSteps = bHomingLatched ? homingLatch_InSteps : CameraSlider_HomingPosition();
+
+                if(homingPhase == HOMING_PHASE_SEEK)
+                {
+                    homingSeekEdge_InSteps = edge_InSteps;
+                    CameraSlider_NextHomingPhase(HOMING_PHASE_BACK_OFF);
+                }
+                else
+                {
+                    CameraSlider_HomingEdgeFound(edge_InSteps);
+                    CameraSlider_NextHomingPhase(HOMING_PHASE_RETRACT);
+                }
+            }
+            else if(CameraSlider_MotionComplete())
+            {
+                if(homingAxis.switchPin < 0)
+                {
+                    // Stalled against the stop for the rest of the range
+                    homingSeekEdge_InSteps = CameraSlider_HomingPosition();
+                    CameraSlider_HomingEdgeFound(homingSeekEdge_InSteps);
+                    CameraSlider_NextHomingPhase(HOMING_PHASE_RETRACT);
+                }
+                else
+                {
+                    CameraSlider_FailHoming(HOMING_ERROR_NOT_FOUND);
+                }
+            }
+        break;
+
+        case HOMING_PHASE_BACK_OFF:
+            if(!bEndstop)
+            {
+                CameraSlider_HaltMotors();
+                CameraSlider_NextHomingPhase(HOMING_PHASE_APPROACH);
+            }
+            else if(CameraSlider_MotionComplete())
+            {
+                CameraSlider_FailHoming(HOMING_ERROR_NOT_RELEASED);
+            }
+        break;
+
+        case HOMING_PHASE_RETRACT:
+            if(CameraSlider_MotionComplete())
+            {
+                CameraSlider_HomingDone();
+            }
+        break;
+
+        default:
+        break;
+    }
+}
+
+// Homing didn't find the endstop, motors go off and the slider
+// waits in SLIDER_HOMING_FAILED (LED blinks) until homed again
+void CameraSlider_FailHoming(homingError_t error)
+{
+    Serial.print("Failed homing!!! Error: ");
+    Serial.println(error, DEC);
+
+    CameraSlider_HaltMotors();
+    CameraSlider_EndHoming(error);
+    CameraSlider_EnableMotors(false);
+    CameraSlider_SetState(SLIDER_HOMING_FAILED);
+}
+
+// Homing progress in %, every phase is a quarter, the search for the
+// endstop advances with the share of the range already searched
+int CameraSlider_GetHomingProgress(void)
+{
+    long searched_InSteps;
+    int progress;
+
+    if(homingPhase == HOMING_PHASE_NONE)
+    {
+        return ((homingAxis.axis == SLIDER_AXIS_PAN) ? bPanHomed : bhomingComplete) ? 100 : 0;
+    }
+
+    progress = (homingPhase - HOMING_PHASE_SEEK) * 25;
+
+    if((homingPhase == HOMING_PHASE_SEEK) && bHomingMoveStarted)
+    {
+        searched_InSteps = labs(stepEngine.getPosition(homingAxis.axis) - homingPhaseStart_InSteps);
+        if((homingAxis.range_InSteps > 0) && (searched_InSteps < homingAxis.range_InSteps))
+        {
+            progress += searched_InSteps * 25 / homingAxis.range_InSteps;
+        }
+    }
+
+    return progress;
+}
+
+
+bool CameraSlider_getMotorState()
+{
+  return bmotorState;
+}
+
+
+bool CameraSlider_SetState(sliderState_t newState)
+{
+    if(newState <= SLIDER_FIRST)
+    {
+        Serial.println("Invalid state requested! (state <= SLIDER_FIRST)");
+        return false;
+    }
+    else if( newState >= SLIDER_LAST )
+    {
+        Serial.println("Invalid state requested! (state >= SLIDER_LAST)");
+        return false;
+    }
+    else
+    {
+        sliderState = newState;
+        CameraSlider_WakeMotion();
+        return true;
+    }
+
+    return false;
+}
+
+// True in the states CameraSlider_tick() has nothing to do in,
+// it only has to run again once the state changes
+bool CameraSlider_IsWaiting(void)
+{
+    if(bEndstopLatched)
+    {
+        return false;
+    }
+
+    return (sliderState == SLIDER_IDLE) || (sliderState == SLIDER_MOTORS_OFF) || (sliderState == SLIDER_READY);
+}
+
+
+void CameraSlider_EnableMotors(bool enable)
+{
+    if(enable == true)
+    {
+        if(bStepperResyncPending)
+        {
+            CameraSlider_ResyncSteppers();
+        }
+
+        digitalWrite(PIN_MTR_nEN, LOW);
+        bmotorState = true;
+        CameraSlider_SetState(SLIDER_IDLE);
+    }
+    else
+    {
+        CameraSlider_StopMotors();
+        digitalWrite(PIN_MTR_nEN, HIGH);
+        bmotorState = false;
+        CameraSlider_SetState(SLIDER_MOTORS_OFF);
+    }
+}
+
+
+bool CameraSlider_FormatJSON_CameraSliderStatus(char *buff, int size)
+{
+    int len;
+    len = snprintf(buff, size, "{\"homed\":%d,\"panHomed\":%d,\"homingAxis\":%d,\"homingPhase\":%d,\"homingProgress\":%d,\"homingError\":%d,\"frame\":%u,\"frames\":%u,\"slack\":%d,\"triggerShots\":%u,\"triggersLeft\":%u,\"triggerLead\":%ld,\"motors\":%d,\"state\":%d,\"posX\":%f,\"posZ\":%f,\"spX\":%f,\"spZ\":%f,\"epX\":%f,\"epZ\":%f,\"underruns\":%u,\"queueLow\":%u}",
+                 bhomingComplete,
+                 bPanHomed,
+                 homingAxis.axis,
+                 homingPhase,
+                 CameraSlider_GetHomingProgress(),
+                 homingError,
+                 steppingFrame,
+                 steppingConfig.frames,
+                 (steppingFrame > 0) ? steppingSlack_InMS[(steppingFrame - 1) % STEPPING_SLACK_LOG] : 0,
+                 CameraControl_GetTriggerShots(),
+                 bTriggersArmed ? triggersLeft : 0,
+                 triggerLastLead_InSteps,
+                 bmotorState,
+                 sliderState,
+                 getSliderPos(),
+                 getRotationPos(true),
+                 fStartPos_Slider,
+                 SliderConfig.Config.rotate_direction*(fStartPos_Rotation/SliderConfig.Config.pan_steps_per_degree),
+                 fEndPos_Slider,
+                 SliderConfig.Config.rotate_direction*(fEndPos_Rotation/SliderConfig.Config.pan_steps_per_degree),
+                 stepEngine.getUnderrunCount(),
+                 stepEngine.getQueueLowWater()
+                );
+
+    if(len > 0)
+    {
+        return true;
+    }
+    else
+    {
+        return false;
+    }
+}
+
+// Tells the status push whether there is anything new since the last status it sent:
+// any state change, or a motor that moved more than STATUS_PUSH_SLIDE_MM / STATUS_PUSH_PAN_DEG.
+// Compares a handful of values, so the status JSON only gets formatted when it is needed.
+// Takes the current status as the pushed one when it returns true.
+bool CameraSlider_StatusChanged(void)
+{
+    StatusSnapshot now;
+    long slideThreshold_InSteps = (long)(STATUS_PUSH_SLIDE_MM * SliderConfig.Config.slide_steps_per_mm);
+    long panThreshold_InSteps = (long)(STATUS_PUSH_PAN_DEG * SliderConfig.Config.pan_steps_per_degree);
+
+    now.state = sliderState;
+    now.bMotors = bmotorState;
+    now.bHomed = bhomingComplete;
+    now.bPanHomed = bPanHomed;
+    now.homingPhase = homingPhase;
+    now.homingProgress = CameraSlider_GetHomingProgress();
+    now.homingError = homingError;
+    now.frame = steppingFrame;
+    now.triggerShots = CameraControl_GetTriggerShots();
+    now.startSlide = fStartPos_Slider;
+    now.startPan = fStartPos_Rotation;
+    now.endSlide = fEndPos_Slider;
+    now.endPan = fEndPos_Rotation;
+    now.slide_InSteps = stepEngine.getPosition(SLIDER_AXIS_SLIDE);
+    now.pan_InSteps = stepEngine.getPosition(SLIDER_AXIS_PAN);
+
+    if((now.state == statusPushed.state) &&
+       (now.bMotors == statusPushed.bMotors) &&
+       (now.bHomed == statusPushed.bHomed) &&
+       (now.bPanHomed == statusPushed.bPanHomed) &&
+       (now.homingPhase == statusPushed.homingPhase) &&
+       (now.homingProgress == statusPushed.homingProgress) &&
+       (now.homingError == statusPushed.homingError) &&
+       (now.frame == statusPushed.frame) &&
+       (now.triggerShots == statusPushed.triggerShots) &&
+       (now.startSlide == statusPushed.startSlide) &&
+       (now.startPan == statusPushed.startPan) &&
+       (now.endSlide == statusPushed.endSlide) &&
+       (now.endPan == statusPushed.endPan) &&
+       (labs(now.slide_InSteps - statusPushed.slide_InSteps) <= slideThreshold_InSteps) &&
+       (labs(now.pan_InSteps - statusPushed.pan_InSteps) <= panThreshold_InSteps))
+    {
+        return false;
+    }
+
+    statusPushed = now;
+    return true;
+}
+
+// One binary telemetry frame (see TelemetryFrame.h) into buff, a key frame carries absolute
+// positions, the others the change since the frame before. Returns its length, 0 if it does not fit.
+int CameraSlider_FormatTelemetry(uint8_t *buff, int size, bool keyFrame)
+{
+    long slide_InSteps = stepEngine.getPosition(SLIDER_AXIS_SLIDE);
+    long pan_InSteps = stepEngine.getPosition(SLIDER_AXIS_PAN);
+    uint32_t now_InUS = micros();
+    uint8_t flags = 0;
+    int len;
+
+    if(size < TELEMETRY_MAX_FRAME_SIZE)
+    {
+        return 0;
+    }
+
+    flags |= keyFrame ? TELEMETRY_FLAG_KEY : 0;
+    flags |= bmotorState ? TELEMETRY_FLAG_MOTORS : 0;
+    flags |= bhomingComplete ? TELEMETRY_FLAG_HOMED : 0;
+    flags |= bPanHomed ? TELEMETRY_FLAG_PAN_HOMED : 0;
+    flags |= CameraControl_IsExposing() ? TELEMETRY_FLAG_EXPOSING : 0;
+
+    buff[0] = TELEMETRY_MAGIC;
+    buff[1] = flags;
+    buff[2] = telemetrySequence & 0xFF;
+    buff[3] = (telemetrySequence >> 8) & 0xFF;
+    buff[4] = now_InUS & 0xFF;
+    buff[5] = (now_InUS >> 8) & 0xFF;
+    buff[6] = (now_InUS >> 16) & 0xFF;
+    buff[7] = (now_InUS >> 24) & 0xFF;
+    buff[8] = sliderState;
+    len = TELEMETRY_HEADER_SIZE;
+
+    len += Telemetry_PutVarint(&buff[len], keyFrame ? slide_InSteps : slide_InSteps - telemetrySlide_InSteps);
+    len += Telemetry_PutVarint(&buff[len], keyFrame ? pan_InSteps : pan_InSteps - telemetryPan_InSteps);
+    len += Telemetry_PutVarint(&buff[len], stepEngine.getVelocity(SLIDER_AXIS_SLIDE));
+    len += Telemetry_PutVarint(&buff[len], stepEngine.getVelocity(SLIDER_AXIS_PAN));
+
+    telemetrySequence++;
+    telemetrySlide_InSteps = slide_InSteps;
+    telemetryPan_InSteps = pan_InSteps;
+
+    return len;
+}
+
+// Step timing of both motors: how late steps fired against their schedule,
+// as a log scale histogram (bucket n: 2^(n-1)..2^n-1 us late), and how many
+// missed the deadline. Uptime helps lining it up with other logs.
+bool CameraSlider_FormatJSON_StepMetrics(char *buff, int size)
+{
+    static const char *axisName[] = {"slide", "pan"};
+    StepTiming timing;
+    int len;
+    int axis;
+    int bucket;
+
+    len = snprintf(buff, size, "{\"uptime_ms\":%lu,\"deadline_us\":%u,\"underruns\":%u,\"queueLow\":%u,\"axes\":[",
+                   millis(),
+                   stepEngine.getDeadline(),
+                   stepEngine.getUnderrunCount(),
+                   stepEngine.getQueueLowWater());
+
+    for(axis = SLIDER_AXIS_SLIDE; (axis <= SLIDER_AXIS_PAN) && (len > 0) && (len < size); axis++)
+    {
+        stepEngine.getTiming(axis, &timing);
+
+        len += snprintf(buff + len, size - len, "%s{\"axis\":\"%s\",\"steps\":%u,\"missed\":%u,\"max_us\":%u,\"histogram\":[",
+                        (axis == SLIDER_AXIS_SLIDE) ? "" : ",",
+                        axisName[axis],
+                        timing.steps,
+                        timing.missedDeadlines,
+                        timing.maxLateness_InUS);
+
+        for(bucket = 0; (bucket < STEP_ENGINE_JITTER_BUCKETS) && (len > 0) && (len < size); bucket++)
+        {
+            len += snprintf(buff + len, size - len, "%s%u", (bucket == 0) ? "" : ",", timing.histogram[bucket]);
+        }
+
+        if((len > 0) && (len < size))
+        {
+            len += snprintf(buff + len, size - len, "]}");
+        }
+    }
+
+    if((len > 0) && (len < size))
+    {
+        len += snprintf(buff + len, size - len, "]}");
+    }
+
+    if((len > 0) && (len < size))
+    {
+        return true;
+    }
+    else
+    {
+        return false;
+    }
+}
+
+// Start over with step timing, underruns and queue level
+void CameraSlider_ResetStepMetrics(void)
+{
+    stepEngine.resetTiming();
+    stepEngine.resetStatistics();
+}
+
+// Steps firing later than this count as missed deadline
+void CameraSlider_SetStepDeadline(uint32_t deadline_InUS)
+{
+    stepEngine.setDeadline(deadline_InUS);
+}
+
+// Homing repeatability of both axes: spread of the switch edge over the
+// homing cycles since the last reset, in steps and um (slide) or degrees (pan)
+bool CameraSlider_FormatJSON_HomingMetrics(char *buff, int size)
+{
+    static const char *axisName[] = {"slide", "pan"};
+    HomingRepeatability *pStats;
+    long spread_InSteps;
+    int len;
+    int axis;
+
+    len = snprintf(buff, size, "{\"axes\":[");
+
+    for(axis = SLIDER_AXIS_SLIDE; (axis <= SLIDER_AXIS_PAN) && (len > 0) && (len < size); axis++)
+    {
+        pStats = &homingRepeatability[axis];
+        spread_InSteps = pStats->max_InSteps - pStats->min_InSteps;
+
+        len += snprintf(buff + len, size - len, "%s{\"axis\":\"%s\",\"cycles\":%u,\"spread_steps\":%ld,\"%s\":%.3f,\"min_steps\":%ld,\"max_steps\":%ld,\"last_steps\":%ld,\"seek_offset_steps\":%ld}",
+                        (axis == SLIDER_AXIS_SLIDE) ? "" : ",",
+                        axisName[axis],
+                        pStats->cycles,
+                        spread_InSteps,
+                        (axis == SLIDER_AXIS_SLIDE) ? "spread_um" : "spread_deg",
+                        (axis == SLIDER_AXIS_SLIDE) ? spread_InSteps * 1000.0 / SliderConfig.Config.slide_steps_per_mm
+                                                    : spread_InSteps / (double)SliderConfig.Config.pan_steps_per_degree,
+                        pStats->min_InSteps,
+                        pStats->max_InSteps,
+                        pStats->last_InSteps,
+                        pStats->seekOffset_InSteps);
+    }
+
+    if((len > 0) && (len < size))
+    {
+        len += snprintf(buff + len, size - len, "]}");
+    }
+
+    if((len > 0) && (len < size))
+    {
+        return true;
+    }
+    else
+    {
+        return false;
+    }
+}
+
+// Why the last CameraSlider_StartStepping() failed. With STEPPING_ERROR_NO_FIT
+// the frame with the least slack and the time it needs from the shutter of
+// the frame before.
+steppingError_t CameraSlider_GetSteppingError(uint16_t *pFrame, uint32_t *pNeed_InMS)
+{
+    *pFrame = steppingNoFitFrame;
+    *pNeed_InMS = steppingNoFitNeed_InMS;
+    return steppingError;
+}
+
+// Intervalometer timing of the running (or last) stepping: slack of the
+// last frames (oldest first), least slack and how many frames were late.
+// A frame overrun by more than one interval pushes the frames after it late too.
+bool CameraSlider_FormatJSON_SteppingMetrics(char *buff, int size)
+{
+    uint16_t first = (steppingFrame > STEPPING_SLACK_LOG) ? (steppingFrame - STEPPING_SLACK_LOG) : 0;
+    int len;
+
+    len = snprintf(buff, size, "{\"interval_ms\":%u,\"frame\":%u,\"frames\":%u,\"min_slack_ms\":%d,\"overruns\":%u,\"max_late_ms\":%u,\"planned_min_slack_ms\":%d,\"bulb_ms\":%u,\"last_bulb_us\":%u,\"first_frame\":%u,\"slack_ms\":[",
+                   steppingConfig.interval_InMS,
+                   steppingFrame,
+                   steppingConfig.frames,
+                   steppingMinSlack_InMS,
+                   steppingOverruns,
+                   steppingMaxLate_InMS,
+                   steppingPlannedMinSlack_InMS,
+                   (bExposureRamp && (steppingFrame > 0)) ? exposureRamp_InMS[steppingFrame - 1] : 0,
+                   CameraControl_GetLastBulb(),
+                   first);
+
+    for(uint16_t frame = first; (frame < steppingFrame) && (len > 0) && (len < size); frame++)
+    {
+        len += snprintf(buff + len, size - len, "%s%d", (frame == first) ? "" : ",", steppingSlack_InMS[frame % STEPPING_SLACK_LOG]);
+    }
+
+    if((len > 0) && (len < size))
+    {
+        len += snprintf(buff + len, size - len, "]}");
+    }
+
+    if((len > 0) && (len < size))
+    {
+        return true;
+    }
+    else
+    {
+        return false;
+    }
+}
+
+void CameraSlider_ResetHomingMetrics(void)
+{
+    memset(homingRepeatability, 0, sizeof(homingRepeatability));
+}
+
+bool CameraSlider_FormatJSON_CameraConfig(char *buff, int size)
+{
+    int len;
+    len = snprintf(buff, size, "{\"rail_length\":%d,\"dir_homing\":%d,\"dir_slider\":%d,\"dir_rotation\":%d,\"slider_steps_per_mm\":%d,\"rotation_steps_per_deg\":%d,\"homing_speed_slider\":%d,\"homing_speed_rotation\":%d,\"slide_jerk\":%d,\"pan_jerk\":%d,\"focus_prewake_ms\":%d,\"shutter_latency_ms\":%d,\"pan_limit_min_deg\":%d,\"pan_limit_max_deg\":%d}",
+                SliderConfig.Config.rail_length,
+                SliderConfig.Config.homing_direction,
+                SliderConfig.Config.slider_direction,
+                SliderConfig.Config.rotate_direction,
+                SliderConfig.Config.slide_steps_per_mm,
+                SliderConfig.Config.pan_steps_per_degree,
+                SliderConfig.Config.homing_speed_slide,
+                SliderConfig.Config.homing_speed_pan,
+                SliderConfig.Config.slide_jerk,
+                SliderConfig.Config.pan_jerk,
+                SliderConfig.Config.focus_prewake_ms,
+                SliderConfig.Config.shutter_latency_ms,
+                SliderConfig.Config.pan_limit_min_deg,
+                SliderConfig.Config.pan_limit_max_deg
+            );
+
+    if(len > 0)
+    {
+        return true;
+    }
+    else
+    {
+        return false;
+    }
+}
+
+bool CameraSlider_getHomingState(void)
+{
+  return bhomingComplete;
+}
+
+
+bool CameraSlider_StartMotion(void)
+{
+    long slide_InSteps = round(fStartPos_Slider * SliderConfig.Config.slide_steps_per_mm);
+    long pan_InSteps = round(fStartPos_Rotation);
+
+    // Both ends of the timed move, nothing moves if either is outside
+    if(!CameraSlider_CheckEnvelope(&slide_InSteps, &pan_InSteps, false))
+    {
+        return false;
+    }
+
+    slide_InSteps = round(fEndPos_Slider * SliderConfig.Config.slide_steps_per_mm);
+    pan_InSteps = round(fEndPos_Rotation);
+    if(!CameraSlider_CheckEnvelope(&slide_InSteps, &pan_InSteps, false))
+    {
+        return false;
+    }
+
+    // Steppers drive to the start, see CameraSlider_CanStartMove()
+    if(!CameraSlider_CanStartMove(false))
+    {
+        return false;
+    }
+
+    bKeyframeMotion = false;
+
+    stepEngine.lockSource();
+
+    // Configure slider
+    stepper_slide.setTargetPositionInMillimeters(fStartPos_Slider);
+    stepper_slide.setSpeedInMillimetersPerSecond(SliderConfig.Config.default_slider_speed);
+    stepper_slide.setAccelerationInMillimetersPerSecondPerSecond(SliderConfig.Config.default_slider_accel);
+
+    // Configure pan
+    stepper_pan.setTargetPositionInSteps(fStartPos_Rotation);
+    stepper_pan.setSpeedInStepsPerSecond(SliderConfig.Config.default_rotate_speed * SliderConfig.Config.pan_steps_per_degree);
+    stepper_pan.setAccelerationInStepsPerSecondPerSecond(SliderConfig.Config.default_rotate_accel * SliderConfig.Config.pan_steps_per_degree);
+
+    stepEngine.unlockSource();
+    CameraSlider_StartMotors();
+
+    CameraSlider_SetState(SLIDER_MOVING_TO_START);
+
+    return true;
+}
+
+// Store a keyframe sequence, started later with CameraSlider_StartKeyframes().
+//      - pSlidePos     -> slide position of each keyframe, in mm
+//      - pPanAngle     -> pan angle of each keyframe, in degrees
+//      - pTimeSec      -> time of each keyframe, in seconds since the first keyframe
+bool CameraSlider_SetKeyframes(const float *pSlidePos, const float *pPanAngle, const float *pTimeSec, uint8_t count)
+{
+    Keyframe sequence[KEYFRAME_MAX_KEYFRAMES];
+
+    envelopeError = ENVELOPE_OK;
+
+    // The running sequence plans from keyframes[] until the slider stands on the first one
+    if(CameraSlider_KeyframesRunning() || (count < 2) || (count > KEYFRAME_MAX_KEYFRAMES))
+    {
+        return false;
+    }
+
+    // Checked before anything is stored, a broken sequence leaves the last one as it was
+    for(uint8_t i = 0; i < count; i++)
+    {
+        if((i > 0) && (pTimeSec[i] <= pTimeSec[i - 1]))
+        {
+            return false;
+        }
+
+        // Invert slider or pan motor if necessary
+        memset(&sequence[i], 0, sizeof(Keyframe));
+        sequence[i].position_InSteps[SLIDER_AXIS_SLIDE] = round(SliderConfig.Config.slider_direction * pSlidePos[i] * SliderConfig.Config.slide_steps_per_mm);
+        sequence[i].position_InSteps[SLIDER_AXIS_PAN] = round(SliderConfig.Config.rotate_direction * pPanAngle[i] * SliderConfig.Config.pan_steps_per_degree);
+        sequence[i].time_InSeconds = pTimeSec[i];
+
+        // A keyframe outside the soft limits drops the whole sequence
+        if(!CameraSlider_CheckEnvelope(&sequence[i].position_InSteps[SLIDER_AXIS_SLIDE], &sequence[i].position_InSteps[SLIDER_AXIS_PAN], false))
+        {
+            return false;
+        }
+    }
+
+    memcpy(keyframes, sequence, count * sizeof(Keyframe));
+    keyframeCount = count;
+
+    return true;
+}
+
+// True from CameraSlider_StartKeyframes() until the sequence has been run
+bool CameraSlider_KeyframesRunning(void)
+{
+    return (bKeyframeMotion && (sliderState == SLIDER_MOVING_TO_START)) ||
+           (!stepEngine.isIdle() && (stepEngine.getSource() == &keyframeSource));
+}
+
+// Move to the first keyframe, the sequence itself starts from CameraSlider_tick()
+// once the slider stands there. False while the motors still run.
+bool CameraSlider_StartKeyframes(void)
+{
+    if((keyframeCount < 2) || !stepEngine.isIdle())
+    {
+        return false;
+    }
+
+    if(bStepperResyncPending)
+    {
+        CameraSlider_ResyncSteppers();
+    }
+
+    stepEngine.lockSource();
+
+    // Configure slider
+    stepper_slide.setTargetPositionInSteps(keyframes[0].position_InSteps[SLIDER_AXIS_SLIDE]);
+    stepper_slide.setSpeedInMillimetersPerSecond(SliderConfig.Config.default_slider_speed);
+    stepper_slide.setAccelerationInMillimetersPerSecondPerSecond(SliderConfig.Config.default_slider_accel);
+
+    // Configure pan
+    stepper_pan.setTargetPositionInSteps(keyframes[0].position_InSteps[SLIDER_AXIS_PAN]);
+    stepper_pan.setSpeedInStepsPerSecond(SliderConfig.Config.default_rotate_speed * SliderConfig.Config.pan_steps_per_degree);
+    stepper_pan.setAccelerationInStepsPerSecondPerSecond(SliderConfig.Config.default_rotate_accel * SliderConfig.Config.pan_steps_per_degree);
+
+    stepEngine.unlockSource();
+    CameraSlider_StartMotors();
+
+    bKeyframeMotion = true;
+    CameraSlider_SetState(SLIDER_MOVING_TO_START);
+
+    return true;
+}
+
+// Plan the whole keyframe sequence and hand it to the step engine,
+// the slider has to stand on the first keyframe. False if it could not be planned.
+bool CameraSlider_RunKeyframes(void)
+{
+    float speed_InStepsPerSecond[STEP_ENGINE_MAX_AXES] = {0};
+    float accel_InStepsPerSecondPerSecond[STEP_ENGINE_MAX_AXES] = {0};
+    bool planned;
+
+    bKeyframeMotion = false;
+
+    speed_InStepsPerSecond[SLIDER_AXIS_SLIDE] = KEYFRAME_MAX_SLIDE_SPEED * SliderConfig.Config.slide_steps_per_mm;
+    speed_InStepsPerSecond[SLIDER_AXIS_PAN] = KEYFRAME_MAX_PAN_SPEED * SliderConfig.Config.pan_steps_per_degree;
+    accel_InStepsPerSecondPerSecond[SLIDER_AXIS_SLIDE] = SliderConfig.Config.default_slider_accel * SliderConfig.Config.slide_steps_per_mm;
+    accel_InStepsPerSecondPerSecond[SLIDER_AXIS_PAN] = SliderConfig.Config.default_rotate_accel * SliderConfig.Config.pan_steps_per_degree;
+
+    stepEngine.lockSource();
+    planned = keyframeSource.plan(keyframes, keyframeCount, speed_InStepsPerSecond, accel_InStepsPerSecondPerSecond);
+    stepEngine.unlockSource();
+
+    if(!planned)
+    {
+        Serial.println("Keyframe sequence could not be planned");
+        return false;
+    }
+
+    Serial.print("Keyframe sequence takes ");
+    Serial.print(keyframeSource.getDuration());
+    Serial.println(" s");
+
+    stepEngine.setPosition(SLIDER_AXIS_SLIDE, stepper_slide.getCurrentPositionInSteps());
+    stepEngine.setPosition(SLIDER_AXIS_PAN, stepper_pan.getCurrentPositionInSteps());
+    stepEngine.start(&keyframeSource);
+
+    return true;
+}
+
+bool CameraSlider_SetDuration(uint32_t durationSec)
+{
+    slideDurationSec = durationSec;
+    return true;
+}
+
+bool CameraSlider_SetStartPosition(float slideStartPos, float rotStartPos)
+{
+    fStartPos_Slider = slideStartPos;
+    fStartPos_Rotation = rotStartPos;
+
+    return true;
+}
+
+
+bool CameraSlider_SetEndPosition(float slideEndPos, float rotEndPos)
+{
+    fEndPos_Slider = slideEndPos;
+    fEndPos_Rotation = rotEndPos;
+
+    return true;
+}
+
+bool CameraSlider_StoreAsStartPosition(void)
+{
+    fStartPos_Slider = getSliderPos();
+    fStartPos_Rotation = getRotationPos(false);
+
+    return true;
+}
 
 
 bool CameraSlider_StoreAsEndPosition(void)
@@ -508,10 +2229,12 @@ bool CameraSlider_StoreAsEndPosition(void)
 
 bool CameraSlider_StoreAsRotationHome(void)
 {
+    stepEngine.lockSource();
     stepper_pan.setTargetPositionInSteps(0);
     stepper_pan.setCurrentPositionInMillimeters(0);
     stepper_pan.setCurrentPositionInRevolutions(0);
     stepper_pan.setCurrentPositionInSteps(0);
+    stepEngine.unlockSource();
 
     return true;
 }
@@ -543,6 +2266,27 @@ void CameraSlider_UpdateRailLength(uint32_t rail_length)
     SliderConfig.Write();
 }
 
+// Apply jerk from the config to both motors, 0 gives a trapezoidal profile
+void CameraSlider_UpdateJerk(void)
+{
+    stepEngine.lockSource();
+    stepper_slide.setJerkInMillimetersPerSecondPerSecondPerSecond(SliderConfig.Config.slide_jerk);
+    stepper_pan.setJerkInStepsPerSecondPerSecondPerSecond(SliderConfig.Config.pan_jerk * SliderConfig.Config.pan_steps_per_degree);
+    stepEngine.unlockSource();
+}
+
+// Apply steps/mm from the config to the slide and to what it sets in steps
+void CameraSlider_UpdateStepsPerMM(void)
+{
+    endstopDecel_InStepsPerSecondPerSecond = ENDSTOP_STOP_DECEL * SliderConfig.Config.slide_steps_per_mm;
+
+    stepEngine.lockSource();
+    stepper_slide.setStepsPerMillimeter(SliderConfig.Config.slide_steps_per_mm);
+    stepEngine.unlockSource();
+
+    CameraSlider_UpdateJerk();
+}
+
 void EnableEndstopInterrupt()
 {
     attachInterrupt(digitalPinToInterrupt(PIN_END_SWICH_X_LEFT), endstopISR_Left, RISING);
@@ -555,22 +2299,112 @@ void DisableEndstopInterrupt()
     detachInterrupt(digitalPinToInterrupt(PIN_END_SWICH_X_RIGHT));
 }
 
-void endstopISR_Left()
+// Endstop pressed. Only latch the edge (switch bounce is ignored until the
+// motion task finished the stop) and have the step engine brake, the motion
+// task picks it up in CameraSlider_FinishEndstopStop().
+static void IRAM_ATTR CameraSlider_LatchEndstop(uint8_t side)
 {
-    DisableEndstopInterrupt();
+    // Left endstop is the one homing drives into
+    int towards = (side == 0) ? SliderConfig.Config.homing_direction : -SliderConfig.Config.homing_direction;
 
-    CameraSlider_EnableMotors(false);
-    Serial.println("Left Endstop triggered! Stopped motors.");
+    if(bEndstopLatched)
+    {
+        return;
+    }
 
-    EnableEndstopInterrupt();
+    // Switch bouncing as it lets go, while the slide drives off it
+    if(!stepEngine.isIdle() && (stepEngine.getDirection(SLIDER_AXIS_SLIDE) != towards))
+    {
+        return;
+    }
+
+    endstopLatch_InUS = stepEngineHal.nowInUS();
+    endstopLatch_InSteps = stepEngine.getPosition(SLIDER_AXIS_SLIDE);
+    endstopSide = side;
+    bEndstopBraking = !stepEngine.isIdle();
+    bEndstopLatched = true;
+
+    stepEngine.brake(SLIDER_AXIS_SLIDE, endstopDecel_InStepsPerSecondPerSecond);
+    CameraSlider_WakeMotion();
 }
 
-void endstopISR_Right()
+void IRAM_ATTR endstopISR_Left()
 {
-    DisableEndstopInterrupt();
+    CameraSlider_LatchEndstop(0);
+}
 
-    CameraSlider_EnableMotors(false);
-    Serial.println("Right Endstop triggered! Stopped motors.");
+void IRAM_ATTR endstopISR_Right()
+{
+    CameraSlider_LatchEndstop(1);
+}
 
-    EnableEndstopInterrupt();
+// Motion task side of an endstop hit. Waits for the brake, then brings the
+// steppers to where the motors stopped, so the position stays valid and the
+// slider can move off the endstop right away. False while still braking.
+bool CameraSlider_FinishEndstopStop(void)
+{
+    uint32_t latency_InUS;
+
+    if(!stepEngine.isIdle())
+    {
+        return false;
+    }
+
+    if(bEndstopBraking)
+    {
+        CameraSlider_ResyncSteppers();
+
+        latency_InUS = stepEngine.getLastStepTime() - endstopLatch_InUS;
+        endstopLatency_InUS = ((int32_t)latency_InUS > 0) ? latency_InUS : 0;
+        endstopOverrun_InSteps = labs(stepEngine.getPosition(SLIDER_AXIS_SLIDE) - endstopLatch_InSteps);
+        if(endstopLatency_InUS > endstopMaxLatency_InUS)
+        {
+            endstopMaxLatency_InUS = endstopLatency_InUS;
+        }
+        endstopStops++;
+
+        if((sliderState != SLIDER_MOTORS_OFF) && (sliderState != SLIDER_HOMING))
+        {
+            CameraSlider_SetState(SLIDER_IDLE);
+        }
+
+        Serial.print(endstopSide ? "Right" : "Left");
+        Serial.print(" Endstop triggered! Stopped motors after ");
+        Serial.print(endstopOverrun_InSteps);
+        Serial.print(" steps, ");
+        Serial.print(endstopLatency_InUS);
+        Serial.println(" us");
+    }
+    else
+    {
+        Serial.println(endstopSide ? "Right Endstop triggered!" : "Left Endstop triggered!");
+    }
+
+    bEndstopBraking = false;
+    bEndstopLatched = false;
+
+    return true;
+}
+
+bool CameraSlider_FormatJSON_EndstopMetrics(char *buff, int size)
+{
+    int len;
+
+    len = snprintf(buff, size, "{\"stops\":%u,\"side\":\"%s\",\"latency_us\":%u,\"max_latency_us\":%u,\"overrun_steps\":%ld,\"overrun_mm\":%f,\"decel\":%f}",
+                   endstopStops,
+                   endstopSide ? "right" : "left",
+                   endstopLatency_InUS,
+                   endstopMaxLatency_InUS,
+                   endstopOverrun_InSteps,
+                   (float)endstopOverrun_InSteps / SliderConfig.Config.slide_steps_per_mm,
+                   ENDSTOP_STOP_DECEL);
+
+    if((len > 0) && (len < size))
+    {
+        return true;
+    }
+    else
+    {
+        return false;
+    }
 }
\ No newline at end of file
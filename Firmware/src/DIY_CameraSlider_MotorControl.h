@@ -9,37 +9,79 @@ Description: This file contains all the functions we use to initialize, configur
 void CameraSlider_tick();
 
 void setupMotors();
-void CameraSlider_MoveToPositionRelative(float xPos, float xSpeed, float xAccel, float rAngle, float rSpeed, float rAccel);
-void CameraSlider_MoveToPositionAbsolute(float xPos, float xSpeed, float xAccel, float rSteps, float rSpeed, float rAccel);
-
-// Copy of CameraSlider_MoveToPositionAbsolute without changing sliderState, refactor sometime
-void CameraSlider_MoveToPositionAbsoluteStep(float xPos, float xSpeed, float xAccel);
-void CameraSlider_StartStepping();
-
-void ProcessStepping();
-
-void CameraSlider_MoveToStart(float xSpeed, float xAccel, float rSpeed, float rAccel);
-
-void CameraSlider_MoveToEnd(float xSpeed, float xAccel, float rSpeed, float rAccel);
-
-void CameraSlider_HomeSlidingRail(void);
+void CameraSlider_StepEngineISR(void);
+void CameraSlider_StepEngineRefill(void);
+void CameraSlider_StartMotors(void);
+void CameraSlider_StopMotors(void);
+void CameraSlider_ResyncSteppers(void);
+bool CameraSlider_MotionComplete(void);
+void CameraSlider_HaltMotors(void);
+bool CameraSlider_SetCoordinatedMotion(bool coordinated);
+bool CameraSlider_CanStartMove(bool coordinated);
+bool CameraSlider_MoveCoordinated(long slideTarget_InSteps, long panTarget_InSteps, float slideSpeed, float slideAccel, float panSpeed, float panAccel, float durationSec);
+bool CameraSlider_MoveToPositionRelative(float xPos, float xSpeed, float xAccel, float rAngle, float rSpeed, float rAccel, bool clamp);
+bool CameraSlider_MoveToPositionAbsolute(float xPos, float xSpeed, float xAccel, float rSteps, float rSpeed, float rAccel, bool clamp);
+
+bool CameraSlider_CheckEnvelope(long *pSlide_InSteps, long *pPan_InSteps, bool clamp);
+envelopeError_t CameraSlider_GetEnvelopeError(void);
+bool CameraSlider_FormatEnvelopeError(char *buff, int size);
+
+bool CameraSlider_SetExposureRamp(const ExposureKeyframe_t *pKeyframes, uint8_t count);
+bool CameraSlider_StartStepping(const CameraSliderStepping_t *pConfig);
+steppingError_t CameraSlider_GetSteppingError(uint16_t *pFrame, uint32_t *pNeed_InMS);
+void CameraSlider_StandForFrame(void);
+void CameraSlider_ProcessStepping(void);
+
+bool CameraSlider_MoveToStart(float xSpeed, float xAccel, float rSpeed, float rAccel, bool clamp);
+
+bool CameraSlider_MoveToEnd(float xSpeed, float xAccel, float rSpeed, float rAccel, bool clamp);
+
+void CameraSlider_StartHoming(CameraSliderAxis_t axis);
+bool CameraSlider_StartPanHoming(void);
+void CameraSlider_NextHomingPhase(homingPhase_t phase);
+void CameraSlider_EndHoming(homingError_t error);
+bool CameraSlider_CancelHoming(void);
+void CameraSlider_HomingLatchISR(void);
+void CameraSlider_ProcessHoming(void);
+void CameraSlider_FailHoming(homingError_t error);
+int CameraSlider_GetHomingProgress(void);
 
 bool CameraSlider_getMotorState();
 
 
 bool CameraSlider_SetState(sliderState_t newState);
+bool CameraSlider_IsWaiting(void);
 
 
 void CameraSlider_EnableMotors(bool enable);
 
 
 bool CameraSlider_FormatJSON_CameraSliderStatus(char *buff, int size);
+bool CameraSlider_StatusChanged(void);
+int CameraSlider_FormatTelemetry(uint8_t *buff, int size, bool keyFrame);
 bool CameraSlider_FormatJSON_CameraConfig(char *buff, int size);
+bool CameraSlider_FormatJSON_StepMetrics(char *buff, int size);
+void CameraSlider_ResetStepMetrics(void);
+void CameraSlider_SetStepDeadline(uint32_t deadline_InUS);
+bool CameraSlider_FormatJSON_HomingMetrics(char *buff, int size);
+void CameraSlider_ResetHomingMetrics(void);
+bool CameraSlider_FormatJSON_SteppingMetrics(char *buff, int size);
+
+bool CameraSlider_SetPositionTriggers(float every_InMM);
+bool CameraSlider_CheckPositionTriggers(float *pLead_InMM);
+void CameraSlider_ArmPositionTriggers(float from_InMM, float to_InMM);
+void CameraSlider_DisarmPositionTriggers(void);
+void CameraSlider_PositionTriggerISR(void *pContext, uint8_t axis, long position);
 
 bool CameraSlider_getHomingState(void);
 
 bool CameraSlider_StartMotion(void);
 
+bool CameraSlider_SetKeyframes(const float *pSlidePos, const float *pPanAngle, const float *pTimeSec, uint8_t count);
+bool CameraSlider_StartKeyframes(void);
+bool CameraSlider_KeyframesRunning(void);
+bool CameraSlider_RunKeyframes(void);
+
 bool CameraSlider_SetDuration(uint32_t durationSec);
 
 bool CameraSlider_SetStartPosition(float slideStartPos, float rotStartPos);
@@ -58,9 +100,13 @@ float getSliderPos();
 float getRotationPos(bool calculateDegrees);
 
 void CameraSlider_UpdateRailLength(uint32_t rail_length);
+void CameraSlider_UpdateJerk(void);
+void CameraSlider_UpdateStepsPerMM(void);
 void EnableEndstopInterrupt();
 void DisableEndstopInterrupt();
 
 void endstopISR_Left();
 
-void endstopISR_Right();
\ No newline at end of file
+void endstopISR_Right();
+bool CameraSlider_FinishEndstopStop(void);
+bool CameraSlider_FormatJSON_EndstopMetrics(char *buff, int size);
\ No newline at end of file
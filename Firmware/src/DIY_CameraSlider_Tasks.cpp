@@ -0,0 +1,284 @@
+/*
+CameraSlider - Tasks
+Description: This file contains the FreeRTOS tasks the camera slider runs in, their core
+assignment and priority (see SliderConfig.h), and the CPU usage measurement of each task
+*/
+
+#include <Arduino.h>
+#include <esp_freertos_hooks.h>
+#include <StepEngineHal_ESP32.h>
+#include "SliderConfig.h"
+#include "DIY_CameraSlider_Tasks.h"
+#include "DIY_CameraSlider_MotorControl.h"
+#include "DIY_CameraSlider_CameraControl.h"
+#include "DIY_CameraSlider_Web.h"
+
+typedef struct
+{
+    const char *name;
+    uint8_t core;
+    uint8_t priority;
+    TaskHandle_t handle;                // NULL for tasks we don't own
+    volatile uint32_t busy_InUS;        // Running total, wraps around
+    uint32_t windowBusy_InUS;           // busy_InUS at the start of the window
+    float usage;                        // % of one core, last window
+} TaskStats_t;
+
+static TaskStats_t taskStats[CAMERA_SLIDER_TASK_COUNT] =
+{
+    {"motion",  TASK_MOTION_CORE,           TASK_MOTION_PRIORITY,           NULL, 0, 0, 0.0},
+    {"camera",  TASK_CAMERA_CORE,           TASK_CAMERA_PRIORITY,           NULL, 0, 0, 0.0},
+    {"planner", STEP_ENGINE_REFILL_CORE,    STEP_ENGINE_REFILL_PRIORITY,    NULL, 0, 0, 0.0},
+    {"log",     TASK_LOG_CORE,              TASK_LOG_PRIORITY,              NULL, 0, 0, 0.0},
+    {"status",  TASK_STATUS_CORE,           TASK_STATUS_PRIORITY,           NULL, 0, 0, 0.0},
+    {"telemetry", TASK_TELEMETRY_CORE,      TASK_TELEMETRY_PRIORITY,        NULL, 0, 0, 0.0}
+};
+
+// Load of each core, from the FreeRTOS tick hooks: ticks seen and how many of them
+// came in while the idle task was running
+static TaskHandle_t idleTask[portNUM_PROCESSORS];
+static volatile uint32_t ticks[portNUM_PROCESSORS];
+static volatile uint32_t idleTicks[portNUM_PROCESSORS];
+static uint32_t windowTicks[portNUM_PROCESSORS];
+static uint32_t windowIdleTicks[portNUM_PROCESSORS];
+static float coreLoad[portNUM_PROCESSORS];
+
+static void CameraSlider_MotionTask(void *pParameter);
+static void CameraSlider_CameraTask(void *pParameter);
+static void CameraSlider_LogTask(void *pParameter);
+static void CameraSlider_StatusTask(void *pParameter);
+static void CameraSlider_TelemetryTask(void *pParameter);
+static void CameraSlider_TickHookCore0(void);
+static void CameraSlider_TickHookCore1(void);
+
+// Replaces the Arduino loop(), every part gets its own task pinned to its core.
+// Call once at the end of setup().
+void CameraSlider_StartTasks(void)
+{
+    for(int i = 0; i < portNUM_PROCESSORS; i++)
+    {
+        idleTask[i] = xTaskGetIdleTaskHandleForCPU(i);
+    }
+    esp_register_freertos_tick_hook_for_cpu(CameraSlider_TickHookCore0, 0);
+    esp_register_freertos_tick_hook_for_cpu(CameraSlider_TickHookCore1, 1);
+
+    xTaskCreatePinnedToCore(CameraSlider_MotionTask, "Motion", TASK_MOTION_STACK, NULL, TASK_MOTION_PRIORITY,
+                            &taskStats[CAMERA_SLIDER_TASK_MOTION].handle, TASK_MOTION_CORE);
+    xTaskCreatePinnedToCore(CameraSlider_CameraTask, "Camera", TASK_CAMERA_STACK, NULL, TASK_CAMERA_PRIORITY,
+                            &taskStats[CAMERA_SLIDER_TASK_CAMERA].handle, TASK_CAMERA_CORE);
+    xTaskCreatePinnedToCore(CameraSlider_LogTask, "Log", TASK_LOG_STACK, NULL, TASK_LOG_PRIORITY,
+                            &taskStats[CAMERA_SLIDER_TASK_LOG].handle, TASK_LOG_CORE);
+    xTaskCreatePinnedToCore(CameraSlider_StatusTask, "Status", TASK_STATUS_STACK, NULL, TASK_STATUS_PRIORITY,
+                            &taskStats[CAMERA_SLIDER_TASK_STATUS].handle, TASK_STATUS_CORE);
+    xTaskCreatePinnedToCore(CameraSlider_TelemetryTask, "Telemetry", TASK_TELEMETRY_STACK, NULL, TASK_TELEMETRY_PRIORITY,
+                            &taskStats[CAMERA_SLIDER_TASK_TELEMETRY].handle, TASK_TELEMETRY_CORE);
+}
+
+// Let the motion task run CameraSlider_tick(), needed whenever the slider
+// leaves one of the states it waits in. Safe to call from an interrupt.
+void IRAM_ATTR CameraSlider_WakeMotion(void)
+{
+    TaskHandle_t handle = taskStats[CAMERA_SLIDER_TASK_MOTION].handle;
+    BaseType_t higherPriorityTaskWoken = pdFALSE;
+
+    if(handle == NULL)
+    {
+        return;
+    }
+
+    if(xPortInIsrContext())
+    {
+        vTaskNotifyGiveFromISR(handle, &higherPriorityTaskWoken);
+        if(higherPriorityTaskWoken)
+        {
+            portYIELD_FROM_ISR();
+        }
+    }
+    else
+    {
+        xTaskNotifyGive(handle);
+    }
+}
+
+// Account time a task spent working, for the CPU usage report
+void CameraSlider_AddBusyTime(CameraSliderTask_t task, uint32_t busy_InUS)
+{
+    if(task < CAMERA_SLIDER_TASK_COUNT)
+    {
+        taskStats[task].busy_InUS += busy_InUS;
+    }
+}
+
+// CPU usage of the last measurement window, per core and per task.
+// Task usage is in % of one core, stack is the lowest free stack seen in bytes.
+bool CameraSlider_FormatJSON_TaskStats(char *buff, int size)
+{
+    int len;
+    int i;
+
+    len = snprintf(buff, size, "{\"period_ms\":%d,\"cores\":[%.1f,%.1f],\"tasks\":[", TASK_STATS_PERIOD_MS, coreLoad[0], coreLoad[1]);
+
+    for(i = 0; (i < CAMERA_SLIDER_TASK_COUNT) && (len > 0) && (len < size); i++)
+    {
+        len += snprintf(buff + len, size - len, "%s{\"name\":\"%s\",\"core\":%d,\"priority\":%d,\"cpu\":%.2f,\"stack\":%d}",
+                        (i == 0) ? "" : ",",
+                        taskStats[i].name,
+                        taskStats[i].core,
+                        taskStats[i].priority,
+                        taskStats[i].usage,
+                        (taskStats[i].handle != NULL) ? (int)uxTaskGetStackHighWaterMark(taskStats[i].handle) : -1);
+    }
+
+    if((len > 0) && (len < size))
+    {
+        len += snprintf(buff + len, size - len, "]}");
+    }
+
+    if((len > 0) && (len < size))
+    {
+        return true;
+    }
+    else
+    {
+        return false;
+    }
+}
+
+// Runs the camera slider state machine. Moves are executed by the step engine,
+// while one runs we only check on it every TASK_MOTION_POLL_MS. In the idle
+// states there is nothing to do until someone changes the state.
+static void CameraSlider_MotionTask(void *pParameter)
+{
+    uint32_t start_InUS;
+
+    while(1)
+    {
+        start_InUS = micros();
+        CameraSlider_tick();
+        CameraSlider_AddBusyTime(CAMERA_SLIDER_TASK_MOTION, micros() - start_InUS);
+
+        ulTaskNotifyTake(pdTRUE, CameraSlider_IsWaiting() ? portMAX_DELAY : pdMS_TO_TICKS(TASK_MOTION_POLL_MS));
+    }
+}
+
+// Drives the camera remote, sleeps until an event comes in or a
+// timed state (shutter press, pre-wake, bulb) ends
+static void CameraSlider_CameraTask(void *pParameter)
+{
+    CameraEvent_t event;
+    bool bEvent;
+    uint32_t start_InUS;
+
+    while(1)
+    {
+        bEvent = CameraControl_WaitEvent(&event);
+
+        start_InUS = micros();
+        CameraControl_tick(bEvent ? &event : NULL);
+        CameraSlider_AddBusyTime(CAMERA_SLIDER_TASK_CAMERA, micros() - start_InUS);
+    }
+}
+
+// Low priority housekeeping, works out the CPU usage of every measurement window
+static void CameraSlider_LogTask(void *pParameter)
+{
+    uint32_t windowStart_InUS = micros();
+    uint32_t now_InUS;
+    uint32_t window_InUS;
+    uint32_t value;
+    uint32_t idle;
+    int i;
+
+    while(1)
+    {
+        vTaskDelay(pdMS_TO_TICKS(TASK_STATS_PERIOD_MS));
+
+        now_InUS = micros();
+        window_InUS = now_InUS - windowStart_InUS;
+        windowStart_InUS = now_InUS;
+
+        for(i = 0; i < portNUM_PROCESSORS; i++)
+        {
+            idle = idleTicks[i];
+            value = ticks[i];
+            if(value != windowTicks[i])
+            {
+                coreLoad[i] = 100.0 - 100.0 * (float)(idle - windowIdleTicks[i]) / (value - windowTicks[i]);
+            }
+            windowIdleTicks[i] = idle;
+            windowTicks[i] = value;
+        }
+
+        for(i = 0; i < CAMERA_SLIDER_TASK_COUNT; i++)
+        {
+            value = taskStats[i].busy_InUS;
+            taskStats[i].usage = 100.0 * (float)(value - taskStats[i].windowBusy_InUS) / window_InUS;
+            taskStats[i].windowBusy_InUS = value;
+        }
+
+        #if TASK_STATS_TO_SERIAL
+        Serial.printf("CPU core0 %.1f%% core1 %.1f%% |", coreLoad[0], coreLoad[1]);
+        for(i = 0; i < CAMERA_SLIDER_TASK_COUNT; i++)
+        {
+            Serial.printf(" %s %.2f%%", taskStats[i].name, taskStats[i].usage);
+        }
+        Serial.println();
+        #endif
+    }
+}
+
+// Pushes the status to the browsers over the WebSocket, at most every
+// STATUS_PUSH_PERIOD_MS and only when it changed (see WebAPI_PushStatus())
+static void CameraSlider_StatusTask(void *pParameter)
+{
+    TickType_t lastWake = xTaskGetTickCount();
+    uint32_t start_InUS;
+
+    while(1)
+    {
+        vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(STATUS_PUSH_PERIOD_MS));
+
+        start_InUS = micros();
+        WebAPI_PushStatus();
+        CameraSlider_AddBusyTime(CAMERA_SLIDER_TASK_STATUS, micros() - start_InUS);
+    }
+}
+
+// Samples one binary telemetry frame per period of the telemetry rate (see WebAPI_PushTelemetry())
+static void CameraSlider_TelemetryTask(void *pParameter)
+{
+    TickType_t lastWake = xTaskGetTickCount();
+    uint32_t start_InUS;
+
+    while(1)
+    {
+        vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(WebAPI_GetTelemetryPeriod()));
+
+        start_InUS = micros();
+        WebAPI_PushTelemetry();
+        CameraSlider_AddBusyTime(CAMERA_SLIDER_TASK_TELEMETRY, micros() - start_InUS);
+    }
+}
+
+// Tick hooks sample what every core is doing once per FreeRTOS tick. No idle hooks are
+// registered, so an idle core sleeps in waiti until the next interrupt. Tasks that wake on
+// a tick and are done before the next one are not seen, the load of the tasks themselves
+// comes from CameraSlider_AddBusyTime().
+static void IRAM_ATTR CameraSlider_TickHook(int core)
+{
+    ticks[core]++;
+    if(xTaskGetCurrentTaskHandleForCPU(core) == idleTask[core])
+    {
+        idleTicks[core]++;
+    }
+}
+
+static void IRAM_ATTR CameraSlider_TickHookCore0(void)
+{
+    CameraSlider_TickHook(0);
+}
+
+static void IRAM_ATTR CameraSlider_TickHookCore1(void)
+{
+    CameraSlider_TickHook(1);
+}
@@ -0,0 +1,30 @@
+/*
+CameraSlider - Tasks
+Description: This file contains the FreeRTOS tasks the camera slider runs in, their core
+assignment and priority (see SliderConfig.h), and the CPU usage measurement of each task
+*/
+
+#ifndef __CAMERASLIDER_TASKS__
+#define __CAMERASLIDER_TASKS__
+
+#include <Arduino.h>
+
+typedef enum
+{
+    CAMERA_SLIDER_TASK_MOTION = 0,
+    CAMERA_SLIDER_TASK_CAMERA,
+    CAMERA_SLIDER_TASK_PLANNER,
+    CAMERA_SLIDER_TASK_LOG,
+    CAMERA_SLIDER_TASK_STATUS,
+    CAMERA_SLIDER_TASK_TELEMETRY,
+    CAMERA_SLIDER_TASK_COUNT
+} CameraSliderTask_t;
+
+void CameraSlider_StartTasks(void);
+
+void CameraSlider_WakeMotion(void);
+
+void CameraSlider_AddBusyTime(CameraSliderTask_t task, uint32_t busy_InUS);
+bool CameraSlider_FormatJSON_TaskStats(char *buff, int size);
+
+#endif
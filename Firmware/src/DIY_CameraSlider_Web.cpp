@@ -9,6 +9,7 @@ Description: This file contains all the functions we use for receiving and respo
 #include "SPIFFS.h"
 #include "DIY_CameraSlider_MotorControl.h"
 #include "DIY_CameraSlider_CameraControl.h"
+#include "DIY_CameraSlider_Tasks.h"
 #include "SliderConfig.h"
 
 const char* sliderStateStr[] = {
@@ -22,9 +23,27 @@ const char* sliderStateStr[] = {
     "SLIDER_WORKING",
     "SLIDER_STEPPING",
     "SLIDER_STEP_FINISHED",
+    "SLIDER_HOMING_FAILED",
     "SLIDER_LAST"
 };
 
+// Binary telemetry, frames collected for the next message (see WebAPI_PushTelemetry())
+uint8_t telemetryMessage[TELEMETRY_MESSAGE_SIZE];
+int telemetryLength = 0;
+uint32_t telemetryMessageStart_InMS = 0;
+uint32_t telemetryRate_InHz = TELEMETRY_DEFAULT_RATE_HZ;
+
+// Static assets and their ETags, from ASSET_MANIFEST_FILE (see WebAPI_LoadAssetTags())
+typedef struct
+{
+    char path[32];              // SPIFFS names are 31 characters at most
+    char etag[20];              // Quoted
+} WebAsset_t;
+
+WebAsset_t webAssets[ASSET_MAX_FILES];
+uint8_t webAssetCount = 0;
+char webAssetVersion[12] = "";
+
 // Helper function that allows us to replace template variable in .html file
 // with a value from our running code.
 // ie. Any instance of %RAIL_LENGTH% will be replaced with the actual
@@ -34,6 +53,9 @@ String template_const_processor(const String& var)
     if(var == "RAIL_LENGTH") {
         return String(SliderConfig.Config.rail_length);
     }
+    else if (var == "ASSET_VERSION") {
+        return String(webAssetVersion);
+    }
     else if (var == "FW_VERSION") {
         return String(String(VERSION_MAJOR) + "." + String(VERSION_MINOR) + "." + String(VERSION_PATCH));
     }
@@ -55,6 +77,24 @@ String template_const_processor(const String& var)
     else if (var == "ROTATION_STEPS_PER_MM") {
         return String(SliderConfig.Config.pan_steps_per_degree);
     }
+    else if (var == "SLIDE_JERK") {
+        return String(SliderConfig.Config.slide_jerk);
+    }
+    else if (var == "PAN_JERK") {
+        return String(SliderConfig.Config.pan_jerk);
+    }
+    else if (var == "FOCUS_PREWAKE") {
+        return String(SliderConfig.Config.focus_prewake_ms);
+    }
+    else if (var == "SHUTTER_LATENCY") {
+        return String(SliderConfig.Config.shutter_latency_ms);
+    }
+    else if (var == "PAN_LIMIT_MIN") {
+        return String(SliderConfig.Config.pan_limit_min_deg);
+    }
+    else if (var == "PAN_LIMIT_MAX") {
+        return String(SliderConfig.Config.pan_limit_max_deg);
+    }
     else if (var == "CHECK_BOX_HOMING_INVERTED") {
         if(SliderConfig.Config.homing_direction == 1) {
             return String("");
@@ -107,11 +147,20 @@ void setupWebServer(void)
         request->send(SPIFFS, "/index.html", "text/html", false, template_const_processor);
     });
 
-    server.serveStatic("/js/", SPIFFS, "/js/");
-    server.serveStatic("/css/", SPIFFS, "/css/");
-    server.serveStatic("/webfonts/", SPIFFS, "/webfonts/");
-    server.serveStatic("/favicon.png", SPIFFS, "/favicon.png");
-    server.serveStatic("/favicon.ico", SPIFFS, "/favicon.ico");
+    // Static assets, gzipped and with ETags, see WebAPI_ServeAsset()
+    WebAPI_LoadAssetTags();
+    server.on("/js", HTTP_GET, WebAPI_ServeAsset);
+    server.on("/css", HTTP_GET, WebAPI_ServeAsset);
+    server.on("/webfonts", HTTP_GET, WebAPI_ServeAsset);
+    server.on("/favicon.png", HTTP_GET, WebAPI_ServeAsset);
+    server.on("/favicon.ico", HTTP_GET, WebAPI_ServeAsset);
+
+    // Status push and commands, see WebAPI_WebSocketEvent()
+    ws.onEvent(WebAPI_WebSocketEvent);
+    server.addHandler(&ws);
+
+    // Binary telemetry, see WebAPI_PushTelemetry()
+    server.addHandler(&telemetryWs);
 
     // Homing request - Sliding
     server.on("/api/home-slider", HTTP_GET, [] (AsyncWebServerRequest *request) {
@@ -125,11 +174,28 @@ void setupWebServer(void)
         }
     });
 
+    // Cancel homing - Sliding or rotation
+    server.on("/api/home-slider-cancel", HTTP_GET, [] (AsyncWebServerRequest *request) {
+        Serial.println("HOME cancel received...");
+
+        if(CameraSlider_CancelHoming()) {
+            request->send(200, "text/plain", "OK");
+        }
+        else {
+            request->send(500, "text/plain", "NOT HOMING");
+        }
+    });
+
     // Homing request - Rotation
     server.on("/api/home-rotation", HTTP_GET, [] (AsyncWebServerRequest *request) {
         Serial.println("Rotation HOME request received...");
-        CameraSlider_StoreAsRotationHome();
-        request->send(200, "text/plain", "OK");
+
+        if(CameraSlider_StartPanHoming()) {
+            request->send(200, "text/plain", "OK");
+        }
+        else {
+            request->send(500, "text/plain", "INVALID STATE");
+        }
     });
 
     // Motors Off request
@@ -148,10 +214,106 @@ void setupWebServer(void)
         request->send(200, "text/plain", "OK");
     });
 
-    // Start stepping
+    // Start stepping (shoot-move-shoot) from where the slider stands, all parameters are optional
+    // distance=<mm>&step=<mm>&pan=<deg per frame>&settle=<ms>&exposure=<ms>&interval=<ms>&frames=<count>
+    // Without frames the frame count comes from distance and step. With an interval frames
+    // are shot on a fixed cadence, see /api/metrics/stepping for the slack of every frame
+    // Bulb ramping: ramp=frame,bulbMs;frame,bulbMs;... every frame is a bulb exposure from the ramp
     server.on("/api/start-stepping", HTTP_GET, [] (AsyncWebServerRequest *request) {
-        CameraSlider_StartStepping();
-        request->send(200, "text/plain", "OK");
+        CameraSliderStepping_t stepping;
+
+        stepping.distance_InMM = STEPPING_DEFAULT_DISTANCE;
+        stepping.step_InMM = STEPPING_DEFAULT_STEP;
+        stepping.pan_InDeg = STEPPING_DEFAULT_PAN;
+        stepping.settle_InMS = STEPPING_DEFAULT_SETTLE_MS;
+        stepping.exposure_InMS = STEPPING_DEFAULT_EXPOSURE_MS;
+        stepping.interval_InMS = 0;
+        stepping.frames = 0;
+
+        if ( request->hasParam("distance") ) {
+            stepping.distance_InMM = request->getParam("distance")->value().toFloat();
+        }
+        if ( request->hasParam("step") ) {
+            stepping.step_InMM = request->getParam("step")->value().toFloat();
+        }
+        if ( request->hasParam("pan") ) {
+            stepping.pan_InDeg = request->getParam("pan")->value().toFloat();
+        }
+        if ( request->hasParam("settle") ) {
+            stepping.settle_InMS = request->getParam("settle")->value().toInt();
+        }
+        if ( request->hasParam("exposure") ) {
+            stepping.exposure_InMS = request->getParam("exposure")->value().toInt();
+        }
+        if ( request->hasParam("interval") ) {
+            stepping.interval_InMS = request->getParam("interval")->value().toInt();
+        }
+        if ( request->hasParam("frames") ) {
+            stepping.frames = request->getParam("frames")->value().toInt();
+        }
+
+        ExposureKeyframe_t ramp[EXPOSURE_RAMP_MAX_KEYFRAMES];
+        uint8_t count = 0;
+
+        if ( request->hasParam("ramp") ) {
+            String keyframes = request->getParam("ramp")->value();
+            int start = 0;
+            unsigned int frame;
+            unsigned long bulb;
+
+            while ( start < (int)keyframes.length() ) {
+                int end = keyframes.indexOf(';', start);
+                if ( end < 0 ) {
+                    end = keyframes.length();
+                }
+
+                if ( count >= EXPOSURE_RAMP_MAX_KEYFRAMES ||
+                     sscanf(keyframes.substring(start, end).c_str(), "%u,%lu", &frame, &bulb) != 2 ) {
+                    request->send(400, "text/plain", "Invalid ramp");
+                    return;
+                }
+
+                ramp[count].frame = frame;
+                ramp[count].bulb_InMS = bulb;
+                count++;
+                start = end + 1;
+            }
+        }
+
+        if ( !CameraSlider_SetExposureRamp(ramp, count) ) {
+            request->send(400, "text/plain", "Ramp needs up to " + String(EXPOSURE_RAMP_MAX_KEYFRAMES) + " keyframes with increasing frames and bulb times of 1 to " + String(EXPOSURE_RAMP_MAX_BULB_MS) + " ms");
+            return;
+        }
+
+        if(CameraSlider_StartStepping(&stepping)) {
+            request->send(200, "text/plain", "OK");
+            return;
+        }
+
+        uint16_t noFitFrame;
+        uint32_t noFitNeed_InMS;
+
+        switch(CameraSlider_GetSteppingError(&noFitFrame, &noFitNeed_InMS)) {
+            case STEPPING_ERROR_RAMP_TOO_LONG:
+                request->send(400, "text/plain", "Bulb ramp can't have more than " + String(EXPOSURE_RAMP_MAX_FRAMES) + " frames");
+            break;
+
+            case STEPPING_ERROR_NO_FIT:
+                request->send(409, "text/plain", "Frame " + String(noFitFrame) + " needs " + String((int)noFitNeed_InMS) + " ms for exposure, move and settle, longer than the interval");
+            break;
+
+            case STEPPING_ERROR_LIMITS:
+                WebAPI_SendEnvelopeError(request);
+            break;
+
+            case STEPPING_ERROR_BUSY:
+                WebAPI_SendBusy(request);
+            break;
+
+            default:
+                request->send(400, "text/plain", "Need frames or a step");
+            break;
+        }
     });
 
     // Release shutter request
@@ -160,11 +322,96 @@ void setupWebServer(void)
         request->send(200, "text/plain", "OK");
     });
 
+    // Get CPU usage of every core and task
+    server.on("/api/metrics/tasks", HTTP_GET, [] (AsyncWebServerRequest *request) {
+        char buff[600] = {0};
+
+        if(CameraSlider_FormatJSON_TaskStats(buff, sizeof(buff)))
+        {
+            request->send(200, "text/plain", buff);
+        }
+        else
+        {
+            request->send(500, "text/plain", "CameraSlider_FormatJSON_TaskStats failed");
+        }
+    });
+
+    // Get step timing (jitter histogram and missed deadlines) of both motors
+    // deadline=<us> changes the missed deadline threshold, reset=1 starts over after this report
+    server.on("/api/metrics/steps", HTTP_GET, [] (AsyncWebServerRequest *request) {
+        char buff[1024] = {0};
+
+        if ( request->hasParam("deadline") ) {
+            CameraSlider_SetStepDeadline(request->getParam("deadline")->value().toInt());
+        }
+
+        if(CameraSlider_FormatJSON_StepMetrics(buff, sizeof(buff)))
+        {
+            request->send(200, "text/plain", buff);
+        }
+        else
+        {
+            request->send(500, "text/plain", "CameraSlider_FormatJSON_StepMetrics failed");
+        }
+
+        if ( request->hasParam("reset") && request->getParam("reset")->value().toInt() != 0 ) {
+            CameraSlider_ResetStepMetrics();
+        }
+    });
+
+    // Get homing repeatability of both axes, spread of the home switch edge over repeated homing cycles
+    // reset=1 starts over after this report
+    server.on("/api/metrics/homing", HTTP_GET, [] (AsyncWebServerRequest *request) {
+        char buff[500] = {0};
+
+        if(CameraSlider_FormatJSON_HomingMetrics(buff, sizeof(buff)))
+        {
+            request->send(200, "text/plain", buff);
+        }
+        else
+        {
+            request->send(500, "text/plain", "CameraSlider_FormatJSON_HomingMetrics failed");
+        }
+
+        if ( request->hasParam("reset") && request->getParam("reset")->value().toInt() != 0 ) {
+            CameraSlider_ResetHomingMetrics();
+        }
+    });
+
+    // Get the last endstop stop, how long the motors kept stepping after the switch edge and how far
+    server.on("/api/metrics/endstop", HTTP_GET, [] (AsyncWebServerRequest *request) {
+        char buff[300] = {0};
+
+        if(CameraSlider_FormatJSON_EndstopMetrics(buff, sizeof(buff)))
+        {
+            request->send(200, "text/plain", buff);
+        }
+        else
+        {
+            request->send(500, "text/plain", "CameraSlider_FormatJSON_EndstopMetrics failed");
+        }
+    });
+
+    // Get intervalometer timing of stepping, slack of the last frames before their shutter time
+    // (negative when a frame was late) and how many frames overran their interval
+    server.on("/api/metrics/stepping", HTTP_GET, [] (AsyncWebServerRequest *request) {
+        char buff[600] = {0};
+
+        if(CameraSlider_FormatJSON_SteppingMetrics(buff, sizeof(buff)))
+        {
+            request->send(200, "text/plain", buff);
+        }
+        else
+        {
+            request->send(500, "text/plain", "CameraSlider_FormatJSON_SteppingMetrics failed");
+        }
+    });
+
     // Get status
     server.on("/api/camera-slider-status", HTTP_GET, [] (AsyncWebServerRequest *request) {
-        char buff[300] = {0};
+        char buff[512] = {0};
 
-        if(CameraSlider_FormatJSON_CameraSliderStatus(buff, 200))
+        if(CameraSlider_FormatJSON_CameraSliderStatus(buff, sizeof(buff)))
         {
             request->send(200, "text/plain", buff);
         }
@@ -174,6 +421,18 @@ void setupWebServer(void)
         }
     });
 
+    // Frames per second of the binary telemetry at /telemetry, value=<TELEMETRY_MIN_RATE_HZ..TELEMETRY_MAX_RATE_HZ>
+    server.on("/api/telemetry-rate", HTTP_GET, [] (AsyncWebServerRequest *request) {
+        int32_t value = 0;
+
+        if(WebAPI_GetIntValueFromRequest(request, "value", &value) && WebAPI_SetTelemetryRate(value)) {
+            request->send(200, "text/plain", "OK");
+        }
+        else {
+            request->send(400, "text/plain", "Rate out of range");
+        }
+    });
+
     // Get camera slider config
     server.on("/api/camera-slider-config", HTTP_GET, [] (AsyncWebServerRequest *request) {
         char buff[300] = {0};
@@ -235,6 +494,28 @@ void setupWebServer(void)
             uint32_t u32Seconds = 0.0;
             u32Seconds = request->getParam("seconds")->value().toInt();
 
+            // Slide and pan share one speed profile unless coordinated=0
+            bool bCoordinated = true;
+            if ( request->hasParam("coordinated") ) {
+                bCoordinated = (request->getParam("coordinated")->value().toInt() != 0);
+            }
+            // The steppers take the slider to the start, they can't take over from a coordinated move
+            if ( !CameraSlider_SetCoordinatedMotion(bCoordinated) || !CameraSlider_CanStartMove(false) ) {
+                WebAPI_SendBusy(request);
+                return;
+            }
+
+            // Shoot every shutterEvery mm while sliding, without stopping. Has to be more than the
+            // slide moves within the shutter latency, see WebAPI_CheckPositionTriggers()
+            float fShutterEvery = 0.0;
+            if ( request->hasParam("shutterEvery") ) {
+                fShutterEvery = request->getParam("shutterEvery")->value().toFloat();
+            }
+            if ( !CameraSlider_SetPositionTriggers(fShutterEvery) ) {
+                request->send(400, "text/plain", "Bad Request");
+                return;
+            }
+
             if ( request->hasParam("startPos") && request->hasParam("endPos") && request->hasParam("rotateBy") ) {
                 Serial.println("Start-Stop position explicitly specified");
                 float fStartPos = 0.0;
@@ -249,8 +530,15 @@ void setupWebServer(void)
                 CameraSlider_SetEndPosition(fEndPos, fRotateBy);
                 CameraSlider_SetDuration(u32Seconds);
 
+                if(!WebAPI_CheckPositionTriggers(request, fShutterEvery)) {
+                    return;
+                }
+
                 Serial.println("Starting motion");
-                CameraSlider_StartMotion();
+                if(!CameraSlider_StartMotion()) {
+                    WebAPI_SendEnvelopeError(request);
+                    return;
+                }
 
                 request->send(200, "text/plain", "OK");
                 return;
@@ -261,8 +549,15 @@ void setupWebServer(void)
                 Serial.print("u32Seconds: ");
                 Serial.println(u32Seconds);
 
+                if(!WebAPI_CheckPositionTriggers(request, fShutterEvery)) {
+                    return;
+                }
+
                 Serial.println("Starting motion");
-                CameraSlider_StartMotion();
+                if(!CameraSlider_StartMotion()) {
+                    WebAPI_SendEnvelopeError(request);
+                    return;
+                }
 
                 request->send(200, "text/plain", "OK");
                 return;
@@ -271,6 +566,73 @@ void setupWebServer(void)
         }
     });
 
+    // Move trough a keyframe sequence without stopping at the keyframes
+    // keyframes=slidePos,panAngle,seconds;slidePos,panAngle,seconds;...
+    // Seconds are counted from the first keyframe, the slider moves there first
+    server.on("/api/move-keyframes", HTTP_GET, [] (AsyncWebServerRequest *request) {
+        Serial.println("Moving camera trough keyframes");
+
+        if(CameraSlider_getMotorState() == false) {
+            Serial.println("Motors are OFF");
+            request->send(409, "text/plain", "Motors are OFF");
+            return;
+        }
+        else if(CameraSlider_getHomingState() == false) {
+            Serial.println("Homing not complete!");
+            request->send(409, "text/plain", "Homing not complete! Please home your camera slider first.");
+            return;
+        }
+
+        if ( !request->hasParam("keyframes") ) {
+            request->send(400, "text/plain", "Missing keyframes");
+            return;
+        }
+
+        // A sequence starts from standstill and keeps its keyframes until it has run
+        if ( CameraSlider_KeyframesRunning() || !CameraSlider_MotionComplete() ) {
+            WebAPI_SendBusy(request);
+            return;
+        }
+
+        float slidePos[MAX_KEYFRAMES];
+        float panAngle[MAX_KEYFRAMES];
+        float timeSec[MAX_KEYFRAMES];
+        uint8_t count = 0;
+        String keyframes = request->getParam("keyframes")->value();
+        int start = 0;
+
+        while ( start < (int)keyframes.length() ) {
+            int end = keyframes.indexOf(';', start);
+            if ( end < 0 ) {
+                end = keyframes.length();
+            }
+
+            if ( count >= MAX_KEYFRAMES ||
+                 sscanf(keyframes.substring(start, end).c_str(), "%f,%f,%f", &slidePos[count], &panAngle[count], &timeSec[count]) != 3 ) {
+                request->send(400, "text/plain", "Invalid keyframes");
+                return;
+            }
+
+            count++;
+            start = end + 1;
+        }
+
+        if ( !CameraSlider_SetKeyframes(slidePos, panAngle, timeSec, count) ) {
+            if ( CameraSlider_GetEnvelopeError() != ENVELOPE_OK ) {
+                WebAPI_SendEnvelopeError(request);
+                return;
+            }
+            request->send(400, "text/plain", "Need 2 to " + String(MAX_KEYFRAMES) + " keyframes with increasing times");
+            return;
+        }
+
+        if ( !CameraSlider_StartKeyframes() ) {
+            WebAPI_SendBusy(request);
+            return;
+        }
+        request->send(200, "text/plain", "OK");
+    });
+
     // Move to location
     server.on("/api/move-to-position", HTTP_GET, [] (AsyncWebServerRequest *request) {
         WebAPI_MoveToPosition(MOVE_RELATIVE, request);
@@ -398,6 +760,83 @@ void setupWebServer(void)
         }
     });
 
+    // Configure camera - Jerk of the slider, 0 for trapezoidal motion profile
+    server.on("/api/set-slide-jerk", HTTP_GET, [] (AsyncWebServerRequest *request) {
+        Serial.println("Updating slider jerk");
+        if(WebAPI_UpdateMotorConfig(SLIDE_JERK, request)) {
+            request->send(200, "text/plain", "OK");
+            return;
+        }
+        else {
+            request->send(400, "text/plain", "Bad Request");
+            return;
+        }
+    });
+
+    // Configure camera - Jerk of the pan, 0 for trapezoidal motion profile
+    server.on("/api/set-pan-jerk", HTTP_GET, [] (AsyncWebServerRequest *request) {
+        Serial.println("Updating pan jerk");
+        if(WebAPI_UpdateMotorConfig(PAN_JERK, request)) {
+            request->send(200, "text/plain", "OK");
+            return;
+        }
+        else {
+            request->send(400, "text/plain", "Bad Request");
+            return;
+        }
+    });
+
+    // Configure camera - Focus this many ms ahead of the shutter to wake the camera, 0 for off
+    server.on("/api/set-focus-prewake", HTTP_GET, [] (AsyncWebServerRequest *request) {
+        Serial.println("Updating focus pre-wake");
+        if(WebAPI_UpdateMotorConfig(FOCUS_PREWAKE, request)) {
+            request->send(200, "text/plain", "OK");
+            return;
+        }
+        else {
+            request->send(400, "text/plain", "Bad Request");
+            return;
+        }
+    });
+
+    // Configure camera - Shutter latency of the camera in ms, position triggered shots fire this much early
+    server.on("/api/set-shutter-latency", HTTP_GET, [] (AsyncWebServerRequest *request) {
+        Serial.println("Updating shutter latency");
+        if(WebAPI_UpdateMotorConfig(SHUTTER_LATENCY, request)) {
+            request->send(200, "text/plain", "OK");
+            return;
+        }
+        else {
+            request->send(400, "text/plain", "Bad Request");
+            return;
+        }
+    });
+
+    // Configure camera - Soft limits of pan in degrees from pan home, both 0 for no limits
+    server.on("/api/set-pan-limit-min", HTTP_GET, [] (AsyncWebServerRequest *request) {
+        Serial.println("Updating pan limit min");
+        if(WebAPI_UpdateMotorConfig(PAN_LIMIT_MIN, request)) {
+            request->send(200, "text/plain", "OK");
+            return;
+        }
+        else {
+            request->send(400, "text/plain", "Bad Request");
+            return;
+        }
+    });
+
+    server.on("/api/set-pan-limit-max", HTTP_GET, [] (AsyncWebServerRequest *request) {
+        Serial.println("Updating pan limit max");
+        if(WebAPI_UpdateMotorConfig(PAN_LIMIT_MAX, request)) {
+            request->send(200, "text/plain", "OK");
+            return;
+        }
+        else {
+            request->send(400, "text/plain", "Bad Request");
+            return;
+        }
+    });
+
     // Configure camera - Reset settings to their default values
     server.on("/api/settings-reset", HTTP_GET, [] (AsyncWebServerRequest *request) {
         Serial.println("Resetting settings to default values");
@@ -425,6 +864,9 @@ void WebAPI_MoveToPosition(CameraSliderMovement_t move_type, AsyncWebServerReque
     float fRotPos       = 0.0;
     float fRotSpeed     = SliderConfig.Config.default_rotate_speed;
     float fRotAccel     = SliderConfig.Config.default_rotate_accel;
+    bool bCoordinated   = false;
+    bool bClamp         = false;
+    bool bMoving        = false;
 
     if ( request->hasParam("xPos") ) {
         fSlidePos = request->getParam("xPos")->value().toFloat();
@@ -450,6 +892,16 @@ void WebAPI_MoveToPosition(CameraSliderMovement_t move_type, AsyncWebServerReque
         fRotAccel = request->getParam("rAccel")->value().toFloat();
     }
 
+    // coordinated=1 makes slide and pan start and finish together
+    if ( request->hasParam("coordinated") ) {
+        bCoordinated = (request->getParam("coordinated")->value().toInt() != 0);
+    }
+
+    // clamp=1 stops at the soft limits instead of refusing moves past them
+    if ( request->hasParam("clamp") ) {
+        bClamp = (request->getParam("clamp")->value().toInt() != 0);
+    }
+
     // Debug printout
     Serial.print("xPosition: ");
     Serial.println(fSlidePos);
@@ -469,26 +921,391 @@ void WebAPI_MoveToPosition(CameraSliderMovement_t move_type, AsyncWebServerReque
     Serial.print("rAccel: ");
     Serial.println(fRotAccel);
 
-    if ( move_type == MOVE_RELATIVE) {
-        CameraSlider_MoveToPositionRelative(fSlidePos, fSlideSpeed,  fSlideAccel, fRotPos, fRotSpeed, fRotAccel);
-        request->send(200, "text/plain", "OK");
+    Serial.print("coordinated: ");
+    Serial.println(bCoordinated);
+
+    if ( !CameraSlider_SetCoordinatedMotion(bCoordinated) || !CameraSlider_CanStartMove(bCoordinated) ) {
+        WebAPI_SendBusy(request);
         return;
     }
+
+    if ( move_type == MOVE_RELATIVE) {
+        bMoving = CameraSlider_MoveToPositionRelative(fSlidePos, fSlideSpeed,  fSlideAccel, fRotPos, fRotSpeed, fRotAccel, bClamp);
+    }
     else if (move_type == MOVE_TO_STORED_POSITION_START) {
-        CameraSlider_MoveToStart(fSlideSpeed,  fSlideAccel, fRotSpeed, fRotAccel);
-        request->send(200, "text/plain", "OK");
+        bMoving = CameraSlider_MoveToStart(fSlideSpeed,  fSlideAccel, fRotSpeed, fRotAccel, bClamp);
     }
     else if (move_type == MOVE_TO_STORED_POSITION_END) {
-        CameraSlider_MoveToEnd(fSlideSpeed,  fSlideAccel, fRotSpeed, fRotAccel);
-        request->send(200, "text/plain", "OK");
+        bMoving = CameraSlider_MoveToEnd(fSlideSpeed,  fSlideAccel, fRotSpeed, fRotAccel, bClamp);
     }
     else {
         Serial.print("Invalid request!");
         request->send(400, "text/plain", "Malformed request");
+        return;
+    }
+
+    if ( bMoving ) {
+        request->send(200, "text/plain", "OK");
+    }
+    else {
+        WebAPI_SendEnvelopeError(request);
+    }
+}
+
+// Position triggers closer together than the slide moves within the shutter latency
+// of the camera would overlap, refuse the timed move with a 400 that says why
+bool WebAPI_CheckPositionTriggers(AsyncWebServerRequest *request, float shutterEvery_InMM)
+{
+    char buff[160] = {0};
+    float lead_InMM = 0.0;
+
+    if(CameraSlider_CheckPositionTriggers(&lead_InMM))
+    {
+        return true;
+    }
+
+    // Don't leave them set for the next timed move
+    CameraSlider_SetPositionTriggers(0.0);
+
+    snprintf(buff, sizeof(buff), "shutterEvery %.1f mm is too short, the slide moves %.1f mm within the shutter latency of %d ms",
+             shutterEvery_InMM, lead_InMM, SliderConfig.Config.shutter_latency_ms);
+    Serial.println(buff);
+    request->send(400, "text/plain", buff);
+    return false;
+}
+
+// Move refused because it can't take over from the running one (CameraSlider_CanStartMove())
+void WebAPI_SendBusy(AsyncWebServerRequest *request)
+{
+    Serial.println("Slider is moving, move refused");
+    request->send(409, "text/plain", "Slider is moving, wait until it stands");
+}
+
+// Move refused for the soft limits, tell which limit and where it is
+void WebAPI_SendEnvelopeError(AsyncWebServerRequest *request)
+{
+    char buff[120] = {0};
+
+    if(CameraSlider_FormatEnvelopeError(buff, sizeof(buff)))
+    {
+        Serial.println(buff);
+        request->send(400, "text/plain", buff);
+    }
+    else
+    {
+        request->send(400, "text/plain", "Outside the soft limits");
+    }
+}
+
+
+// WebSocket at /ws. Every browser gets the status (same JSON as /api/camera-slider-status)
+// right when it connects, after that WebAPI_PushStatus() sends it to all of them whenever
+// it changes. Text messages from the browser are commands, see WebAPI_RunCommand().
+void WebAPI_WebSocketEvent(AsyncWebSocket *pServer, AsyncWebSocketClient *pClient, AwsEventType type, void *arg, uint8_t *data, size_t len)
+{
+    AwsFrameInfo *pInfo = (AwsFrameInfo *)arg;
+    char buff[512] = {0};
+    char command[64] = {0};
+
+    if(type == WS_EVT_CONNECT)
+    {
+        Serial.printf("WebSocket client %u connected\n", pClient->id());
+
+        if(CameraSlider_FormatJSON_CameraSliderStatus(buff, sizeof(buff)))
+        {
+            pClient->text(buff);
+        }
+    }
+    else if(type == WS_EVT_DISCONNECT)
+    {
+        Serial.printf("WebSocket client %u disconnected\n", pClient->id());
+    }
+    else if(type == WS_EVT_DATA)
+    {
+        // Commands are short, they come in one text frame
+        if(pInfo->final && (pInfo->index == 0) && (pInfo->len == len) && (pInfo->opcode == WS_TEXT) && (len < sizeof(command)))
+        {
+            memcpy(command, data, len);
+            WebAPI_RunCommand(pClient, command);
+        }
+        else
+        {
+            pClient->text("ERROR Malformed command");
+        }
+    }
+}
+
+// Commands over the WebSocket, named after the HTTP requests doing the same. Moves to
+// the start and end position go with the default speeds. Every command is answered with
+// "OK <command>" or "ERROR <command>: <reason>", status answers with the status JSON.
+void WebAPI_RunCommand(AsyncWebSocketClient *pClient, const char *pCommand)
+{
+    char buff[512] = {0};
+    char reason[120] = {0};
+    const char *pError = NULL;
+    bool bMoving;
+
+    if(strcmp(pCommand, "status") == 0)
+    {
+        if(CameraSlider_FormatJSON_CameraSliderStatus(buff, sizeof(buff)))
+        {
+            pClient->text(buff);
+        }
+        return;
+    }
+    else if(strcmp(pCommand, "home-slider") == 0)
+    {
+        if(!CameraSlider_SetState(SLIDER_HOMING)) {
+            pError = "INVALID STATE";
+        }
+    }
+    else if(strcmp(pCommand, "home-slider-cancel") == 0)
+    {
+        if(!CameraSlider_CancelHoming()) {
+            pError = "NOT HOMING";
+        }
+    }
+    else if(strcmp(pCommand, "home-rotation") == 0)
+    {
+        if(!CameraSlider_StartPanHoming()) {
+            pError = "INVALID STATE";
+        }
+    }
+    else if(strcmp(pCommand, "motors-turn-off") == 0)
+    {
+        CameraSlider_EnableMotors(false);
+    }
+    else if(strcmp(pCommand, "motors-turn-on") == 0)
+    {
+        CameraSlider_EnableMotors(true);
+    }
+    else if(strcmp(pCommand, "release-shutter") == 0)
+    {
+        CameraControl_ReleaseShutter();
+    }
+    else if(strcmp(pCommand, "position-save-start") == 0)
+    {
+        CameraSlider_StoreAsStartPosition();
+    }
+    else if(strcmp(pCommand, "position-save-end") == 0)
+    {
+        CameraSlider_StoreAsEndPosition();
+    }
+    else if((strcmp(pCommand, "position-goto-start") == 0) || (strcmp(pCommand, "position-goto-end") == 0))
+    {
+        if(CameraSlider_getMotorState() == false) {
+            pError = "Motors are OFF";
+        }
+        else if(!CameraSlider_SetCoordinatedMotion(false) || !CameraSlider_CanStartMove(false)) {
+            pError = "Slider is moving";
+        }
+        else {
+            if(strcmp(pCommand, "position-goto-start") == 0) {
+                bMoving = CameraSlider_MoveToStart(SliderConfig.Config.default_slider_speed, SliderConfig.Config.default_slider_accel,
+                                                   SliderConfig.Config.default_rotate_speed, SliderConfig.Config.default_rotate_accel, false);
+            }
+            else {
+                bMoving = CameraSlider_MoveToEnd(SliderConfig.Config.default_slider_speed, SliderConfig.Config.default_slider_accel,
+                                                 SliderConfig.Config.default_rotate_speed, SliderConfig.Config.default_rotate_accel, false);
+            }
+
+            if(!bMoving) {
+                if(!CameraSlider_FormatEnvelopeError(reason, sizeof(reason))) {
+                    snprintf(reason, sizeof(reason), "Outside the soft limits");
+                }
+                pError = reason;
+            }
+        }
+    }
+    else
+    {
+        pError = "Unknown command";
+    }
+
+    if(pError == NULL)
+    {
+        snprintf(buff, sizeof(buff), "OK %s", pCommand);
+    }
+    else
+    {
+        snprintf(buff, sizeof(buff), "ERROR %s: %s", pCommand, pError);
+    }
+    pClient->text(buff);
+}
+
+// Called by the status task every STATUS_PUSH_PERIOD_MS. Sends the status to all browsers
+// at once, only when it changed (see CameraSlider_StatusChanged()), so an idle slider costs
+// a few compares per period no matter how many browser tabs are open. While a client still
+// has the last status queued the change waits for the next period.
+void WebAPI_PushStatus(void)
+{
+    char buff[512] = {0};
+
+    ws.cleanupClients(STATUS_PUSH_MAX_CLIENTS);
+
+    if((ws.count() == 0) || !ws.availableForWriteAll())
+    {
+        return;
+    }
+
+    if(CameraSlider_StatusChanged() && CameraSlider_FormatJSON_CameraSliderStatus(buff, sizeof(buff)))
+    {
+        ws.textAll(buff);
+    }
+}
+
+
+bool WebAPI_SetTelemetryRate(uint32_t rate_InHz)
+{
+    if((rate_InHz < TELEMETRY_MIN_RATE_HZ) || (rate_InHz > TELEMETRY_MAX_RATE_HZ))
+    {
+        return false;
+    }
+
+    telemetryRate_InHz = rate_InHz;
+    return true;
+}
+
+// How long the telemetry task sleeps between two frames
+uint32_t WebAPI_GetTelemetryPeriod(void)
+{
+    return 1000 / telemetryRate_InHz;
+}
+
+// Called by the telemetry task once per frame. Frames are collected and sent to all
+// listeners once every TELEMETRY_SEND_PERIOD_MS, as one binary message starting with a
+// key frame, so a listener can start with any message and a lost one costs no more than
+// its own frames. Nothing is sampled while nobody listens.
+void WebAPI_PushTelemetry(void)
+{
+    int len;
+
+    telemetryWs.cleanupClients(TELEMETRY_MAX_CLIENTS);
+
+    if(telemetryWs.count() == 0)
+    {
+        telemetryLength = 0;
+        return;
+    }
+
+    if(telemetryLength == 0)
+    {
+        telemetryMessageStart_InMS = millis();
+    }
+
+    len = CameraSlider_FormatTelemetry(&telemetryMessage[telemetryLength], sizeof(telemetryMessage) - telemetryLength, telemetryLength == 0);
+    telemetryLength += len;
+
+    if((len == 0) || (millis() - telemetryMessageStart_InMS >= TELEMETRY_SEND_PERIOD_MS))
+    {
+        // A listener that still has the last message queued misses this one
+        if(telemetryWs.availableForWriteAll())
+        {
+            telemetryWs.binaryAll(telemetryMessage, telemetryLength);
+        }
+        telemetryLength = 0;
     }
 }
 
 
+// Reads the ETags of the static assets and the asset version from ASSET_MANIFEST_FILE,
+// "version <hash>" and then "<path> <etag>" per line. Without it (file system uploaded
+// without scripts/gzip_assets.py) the assets are served without ETags.
+void WebAPI_LoadAssetTags(void)
+{
+    File file = SPIFFS.open(ASSET_MANIFEST_FILE, "r");
+    String line;
+    int space;
+
+    webAssetCount = 0;
+    webAssetVersion[0] = '\0';
+
+    if(!file)
+    {
+        Serial.println("No asset manifest, serving assets without ETags");
+        return;
+    }
+
+    while(file.available() && (webAssetCount < ASSET_MAX_FILES))
+    {
+        line = file.readStringUntil('\n');
+        line.trim();
+        space = line.indexOf(' ');
+        if(space <= 0)
+        {
+            continue;
+        }
+
+        if(line.startsWith("version "))
+        {
+            snprintf(webAssetVersion, sizeof(webAssetVersion), "%s", line.substring(space + 1).c_str());
+        }
+        else
+        {
+            snprintf(webAssets[webAssetCount].path, sizeof(webAssets[0].path), "%s", line.substring(0, space).c_str());
+            snprintf(webAssets[webAssetCount].etag, sizeof(webAssets[0].etag), "%s", line.substring(space + 1).c_str());
+            webAssetCount++;
+        }
+    }
+    file.close();
+
+    Serial.printf("%u assets, version %s\n", webAssetCount, webAssetVersion);
+}
+
+// ETag of an asset, NULL if the manifest does not know it
+const char *WebAPI_GetAssetTag(const char *pPath)
+{
+    for(uint8_t i = 0; i < webAssetCount; i++)
+    {
+        if(strcmp(webAssets[i].path, pPath) == 0)
+        {
+            return webAssets[i].etag;
+        }
+    }
+
+    return NULL;
+}
+
+// Static assets (js, css, fonts, icons). Most of them are only in the file system as <name>.gz,
+// the file response sends those with Content-Encoding: gzip. A browser that has the asset
+// already (If-None-Match is its ETag) gets a 304. The pages link the assets with the asset
+// version (?v=%ASSET_VERSION%), those links change with every new file system image so the
+// browser may keep them for good. Anything else has to be revalidated.
+void WebAPI_ServeAsset(AsyncWebServerRequest *request)
+{
+    String path = request->url();
+    const char *pTag = WebAPI_GetAssetTag(path.c_str());
+    const char *pCacheControl = ASSET_CACHE_REVALIDATE;
+    AsyncWebServerResponse *response;
+
+    if((webAssetVersion[0] != '\0') && request->hasParam("v") && (request->getParam("v")->value() == webAssetVersion))
+    {
+        pCacheControl = ASSET_CACHE_IMMUTABLE;
+    }
+
+    if((pTag != NULL) && request->hasHeader("If-None-Match") && (request->header("If-None-Match").indexOf(pTag) >= 0))
+    {
+        response = request->beginResponse(304);
+    }
+    else if(SPIFFS.exists(path) || SPIFFS.exists(path + ".gz"))
+    {
+        response = request->beginResponse(SPIFFS, path);
+    }
+    else
+    {
+        request->send(404);
+        return;
+    }
+
+    if(pTag != NULL)
+    {
+        response->addHeader("ETag", pTag);
+    }
+    response->addHeader("Cache-Control", pCacheControl);
+    request->send(response);
+}
+
+
 // Helper function to retrieve integer value from HTTP request
 // arguments
 //      - request   -> HTTP request pointer
@@ -567,12 +1384,14 @@ bool WebAPI_UpdateMotorConfig(CameraSliderConfig_t parameter, AsyncWebServerRequ
         case SLIDER_STEPS_PER_MM:
             SliderConfig.Config.slide_steps_per_mm = value;
             SliderConfig.Write();
+            CameraSlider_UpdateStepsPerMM();
             return true;
         break;
 
         case ROTATION_STEPS_PER_DEG:
             SliderConfig.Config.pan_steps_per_degree = value;
             SliderConfig.Write();
+            CameraSlider_UpdateJerk();
             return true;
         break;
 
@@ -594,6 +1413,44 @@ bool WebAPI_UpdateMotorConfig(CameraSliderConfig_t parameter, AsyncWebServerRequ
             return true;
         break;
 
+        case SLIDE_JERK:
+            SliderConfig.Config.slide_jerk = value;
+            SliderConfig.Write();
+            CameraSlider_UpdateJerk();
+            return true;
+        break;
+
+        case PAN_JERK:
+            SliderConfig.Config.pan_jerk = value;
+            SliderConfig.Write();
+            CameraSlider_UpdateJerk();
+            return true;
+        break;
+
+        case FOCUS_PREWAKE:
+            SliderConfig.Config.focus_prewake_ms = value;
+            SliderConfig.Write();
+            return true;
+        break;
+
+        case SHUTTER_LATENCY:
+            SliderConfig.Config.shutter_latency_ms = value;
+            SliderConfig.Write();
+            return true;
+        break;
+
+        case PAN_LIMIT_MIN:
+            SliderConfig.Config.pan_limit_min_deg = value;
+            SliderConfig.Write();
+            return true;
+        break;
+
+        case PAN_LIMIT_MAX:
+            SliderConfig.Config.pan_limit_max_deg = value;
+            SliderConfig.Write();
+            return true;
+        break;
+
         default:
             return false;
         break;
@@ -8,9 +8,29 @@ Description: This file contains all the functions we use for receiving and respo
 #include "SliderConfig.h"
 
 extern AsyncWebServer server;
+extern AsyncWebSocket ws;
+extern AsyncWebSocket telemetryWs;
 
 String template_const_processor(const String& var);
 void setupWebServer(void);
 void WebAPI_MoveToPosition(CameraSliderMovement_t move_type, AsyncWebServerRequest *request);
+void WebAPI_SendBusy(AsyncWebServerRequest *request);
+void WebAPI_SendEnvelopeError(AsyncWebServerRequest *request);
+bool WebAPI_CheckPositionTriggers(AsyncWebServerRequest *request, float shutterEvery_InMM);
 bool WebAPI_GetIntValueFromRequest(AsyncWebServerRequest *pRequest, const char *argName, int32_t *pInt);
-bool WebAPI_UpdateMotorConfig(CameraSliderConfig_t parameter, AsyncWebServerRequest *pRequest);
\ No newline at end of file
+bool WebAPI_UpdateMotorConfig(CameraSliderConfig_t parameter, AsyncWebServerRequest *pRequest);
+
+// Static assets, see scripts/gzip_assets.py
+void WebAPI_LoadAssetTags(void);
+const char *WebAPI_GetAssetTag(const char *pPath);
+void WebAPI_ServeAsset(AsyncWebServerRequest *request);
+
+// Status push and commands over the WebSocket
+void WebAPI_WebSocketEvent(AsyncWebSocket *pServer, AsyncWebSocketClient *pClient, AwsEventType type, void *arg, uint8_t *data, size_t len);
+void WebAPI_RunCommand(AsyncWebSocketClient *pClient, const char *pCommand);
+void WebAPI_PushStatus(void);
+
+// Binary telemetry, see TelemetryFrame.h
+bool WebAPI_SetTelemetryRate(uint32_t rate_InHz);
+uint32_t WebAPI_GetTelemetryPeriod(void);
+void WebAPI_PushTelemetry(void);
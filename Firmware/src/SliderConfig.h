@@ -21,6 +21,59 @@
 #define PIN_END_SWICH_X_RIGHT	    32
 #define PIN_FOCUS   			    22
 #define PIN_SHUTTER   			    23
+#define PIN_HOME_SWITCH_PAN         35        // Optional, only used with PAN_HOMING_SWITCH. Input only without internal pull-up,
+                                              // needs an external pull-up, pressed reads high like the endstops (normally closed switch to GND)
+
+// Hardware timer used to generate step pulses
+#define STEP_ENGINE_TIMER           0
+
+// Task layout. WiFi, web server (AsyncTCP, see platformio.ini), step planning and
+// logging run on core 0, motion and camera control next to the step interrupt on core 1.
+#define TASK_MOTION_CORE            1
+#define TASK_MOTION_PRIORITY        5
+#define TASK_MOTION_STACK           4096
+#define TASK_MOTION_POLL_MS         2         // Motion task period while a move runs, idle states wait for a notification
+#define TASK_CAMERA_CORE            1
+#define TASK_CAMERA_PRIORITY        4
+#define TASK_CAMERA_STACK           2048
+#define TASK_CAMERA_QUEUE_LENGTH    8
+#define TASK_LOG_CORE               0
+#define TASK_LOG_PRIORITY           1
+#define TASK_LOG_STACK              3072
+#define TASK_STATS_PERIOD_MS        5000      // CPU usage measurement window
+#define TASK_STATS_TO_SERIAL        0         // 1 -> print CPU usage after every window
+#define TASK_STATUS_CORE            0
+#define TASK_STATUS_PRIORITY        1
+#define TASK_STATUS_STACK           3072
+#define TASK_TELEMETRY_CORE         0
+#define TASK_TELEMETRY_PRIORITY     1
+#define TASK_TELEMETRY_STACK        3072
+
+// Status push to the browsers over the WebSocket (/ws), a status only goes out when something changed
+#define STATUS_PUSH_PERIOD_MS       100       // At most one status per period, to all clients at once
+#define STATUS_PUSH_SLIDE_MM        0.5       // Slide movement that counts as a change
+#define STATUS_PUSH_PAN_DEG         0.5       // Pan movement that counts as a change
+#define STATUS_PUSH_MAX_CLIENTS     4         // The oldest connection is closed beyond this
+
+// Binary telemetry over the WebSocket at /telemetry (see TelemetryFrame.h), only sampled while someone listens
+#define TELEMETRY_DEFAULT_RATE_HZ   50        // Frames per second, /api/telemetry-rate changes it
+#define TELEMETRY_MIN_RATE_HZ       10
+#define TELEMETRY_MAX_RATE_HZ       200
+#define TELEMETRY_SEND_PERIOD_MS    100       // Frames go out in one message per period
+#define TELEMETRY_MESSAGE_SIZE      768       // Room for a full period at the highest rate
+#define TELEMETRY_MAX_CLIENTS       2
+
+// Static web assets (js, css, fonts, icons), gzipped into the file system image by scripts/gzip_assets.py
+#define ASSET_MANIFEST_FILE         "/assets.txt"     // ETag of every asset, written by the build
+#define ASSET_MAX_FILES             32
+#define ASSET_CACHE_IMMUTABLE       "public, max-age=31536000, immutable"   // Links with the current asset version
+#define ASSET_CACHE_REVALIDATE      "no-cache"        // Everything else, the browser asks and mostly gets a 304
+
+// Ramp generator of each motor, see FlexyStepperRamp.h (FlexyRampFloat, FlexyRampFixed,
+// FlexyRampLeib, FlexyRampAvr446, FlexyRampSCurve). Measure with the bench_ramp host tool before changing.
+// FlexyRampSCurve uses the jerk settings below, with a jerk of 0 it is the same as FlexyRampFloat.
+#define SLIDE_RAMP_GENERATOR        FlexyRampSCurve
+#define PAN_RAMP_GENERATOR          FlexyRampSCurve
 
 
 // "Mechanical" configuration of the camera slider
@@ -37,12 +90,79 @@
 #define DEFAULT_ROTATE_TO_POS_SPEED 30.0
 #define DEFAULT_ROTATE_TO_POS_ACCEL 60.0
 
+// Jerk limits S-curve motion profiles (see bench_scurve host tool), 0 for a trapezoidal profile.
+// Only moves of a single motor or both motors on their own, coordinated moves and keyframes stay trapezoidal.
+#define DEFAULT_SLIDE_JERK          0         // mm/s^3, 600 reaches the default acceleration in 0.1s
+#define DEFAULT_PAN_JERK            0         // deg/s^3
+
+
+// Camera remote, focus (half press) and shutter lines
+#define CAMERA_SHUTTER_PULSE_MS     300       // How long a shot holds the shutter
+#define CAMERA_FOCUS_HOLD_MS        1000      // Focus pre-wake lets go by itself after this, if no shot follows
+#define DEFAULT_FOCUS_PREWAKE_MS    0         // Focus ahead of the shutter to wake the camera, 0 -> off
+
+// Shots at slide positions while the slider moves, pulsed by the RMT (hardware one-shot)
+#define CAMERA_TRIGGER_PULSE_US     100000    // Shutter pulse of a position triggered shot
+#define CAMERA_TRIGGER_RMT_CHANNEL  0
+#define DEFAULT_SHUTTER_LATENCY_MS  0         // Shutter pulse to exposure of the camera, triggers fire this much early
+
+// Keyframe sequences, speed limits while moving between keyframes
+#define MAX_KEYFRAMES               16        // Not more than KEYFRAME_MAX_KEYFRAMES (KeyframeStepSource.h)
+#define KEYFRAME_MAX_SLIDE_SPEED    100.0     // mm/s
+#define KEYFRAME_MAX_PAN_SPEED      90.0      // deg/s
+
 
-#define DEFAULT_HOMING_SPEED_SLIDE  DEFAULT_SLIDE_TO_POS_SPEED
+// Shoot-move-shoot stepping, defaults for parameters /api/start-stepping doesn't get
+#define STEPPING_DEFAULT_DISTANCE   550.0     // mm
+#define STEPPING_DEFAULT_STEP       2.0       // mm per frame
+#define STEPPING_DEFAULT_PAN        0.0       // deg per frame
+#define STEPPING_DEFAULT_SETTLE_MS  600       // Standing still before the shutter
+#define STEPPING_DEFAULT_EXPOSURE_MS 500      // Shutter to the next move
+#define STEPPING_SLIDE_SPEED        4.0       // mm/s between frames
+#define STEPPING_SLIDE_ACCEL        20.0      // mm/s^2
+#define STEPPING_SLACK_LOG          32        // Frames the intervalometer keeps the slack of
+
+// Bulb ramping, exposure of every stepping frame from a curve (see CameraSlider_SetExposureRamp())
+#define EXPOSURE_RAMP_MAX_KEYFRAMES 16
+#define EXPOSURE_RAMP_MAX_FRAMES    2048      // Bulb times are worked out for every frame up front
+#define EXPOSURE_RAMP_MAX_BULB_MS   600000
+
+
+#define DEFAULT_HOMING_SPEED_SLIDE  30        // mm/s, fast seek for the endstop, home is set by the slow approach
 #define DEFAULT_HOMING_SPEED_PAN    PAN_STEPS_PER_DEGREE
 
 
 // Homing settings
+#define HOMING_SETTLE_MS            25        // Pause between homing moves, lets the carriage and the endstop settle
+#define HOMING_APPROACH_SPEED       1.0       // mm/s, slow approach onto the endstop that sets home
+#define HOMING_RETRACT_MM           2.0       // Home (0) is this far off the endstop
+#define HOMING_FAILED_BLINK_MS      200       // LED blink period after a failed homing
+
+// Endstop hit outside of homing, the step engine brakes at this deceleration
+// (about 0.6mm past the switch from 50mm/s) instead of cutting the drivers
+#define ENDSTOP_STOP_DECEL          2000.0    // mm/s^2
+
+// Pan homing, the stock slider has neither a pan switch nor a stop
+//  PAN_HOMING_NONE         -> homing pan only sets the current angle as 0
+//  PAN_HOMING_SWITCH       -> homes to a switch on PIN_HOME_SWITCH_PAN like the slide
+//  PAN_HOMING_HARD_STOP    -> drives the whole range against a mechanical stop at homing_speed_pan (steps/s),
+//                             keep that slow so the motor stalls against the stop without damage
+#define PAN_HOMING_NONE             0
+#define PAN_HOMING_SWITCH           1
+#define PAN_HOMING_HARD_STOP        2
+#define PAN_HOMING_MODE             PAN_HOMING_NONE
+#define PAN_HOMING_DIRECTION        -1
+#define PAN_HOMING_RANGE_DEG        370.0     // Farthest the search for the switch or stop goes
+#define PAN_HOMING_APPROACH_SPEED   2.0       // deg/s, slow approach onto the switch that sets home
+#define PAN_HOMING_RETRACT_DEG      2.0       // Home (0) is this far off the switch or stop
+
+// Soft limits, moves are checked against them before any step is planned.
+// The slide stays between home and this far off the endstop at the other end
+// of the rail, once homed. Pan stays between the pan limits once pan is homed,
+// both limits 0 means pan turns freely.
+#define SOFT_LIMIT_MARGIN_MM        HOMING_RETRACT_MM
+#define DEFAULT_PAN_LIMIT_MIN_DEG   0
+#define DEFAULT_PAN_LIMIT_MAX_DEG   0
 
 typedef enum 
 { 
@@ -56,11 +176,69 @@ typedef enum
     SLIDER_WORKING,    
     SLIDER_STEPPING,
     SLIDER_STEP_FINISHED,
+    SLIDER_HOMING_FAILED,
     SLIDER_LAST
 } sliderState_t;
 
 extern const char* sliderStateStr[];
 
+// Shoot-move-shoot stepping, see CameraSlider_StartStepping()
+typedef struct
+{
+    float distance_InMM;        // Only used to count frames when frames is 0
+    float step_InMM;            // Slide per frame, negative to slide backwards
+    float pan_InDeg;            // Pan per frame
+    uint32_t settle_InMS;
+    uint32_t exposure_InMS;     // Shutter to the next move, after the bulb with a bulb ramp
+    uint32_t interval_InMS;     // Shutter to shutter, 0 -> next frame as soon as possible
+    uint16_t frames;            // 0 -> distance / step + 1
+} CameraSliderStepping_t;
+
+// Point of a bulb ramp, bulb times between keyframes follow a straight line in stops
+typedef struct
+{
+    uint16_t frame;
+    uint32_t bulb_InMS;
+} ExposureKeyframe_t;
+
+// Why CameraSlider_StartStepping() refused to start
+typedef enum
+{
+    STEPPING_ERROR_NONE = 0,
+    STEPPING_ERROR_NO_FRAMES,       // Neither frames nor a step given
+    STEPPING_ERROR_RAMP_TOO_LONG,   // Bulb ramp over more than EXPOSURE_RAMP_MAX_FRAMES frames
+    STEPPING_ERROR_NO_FIT,          // Bulb, move and settle of a frame take longer than the interval
+    STEPPING_ERROR_LIMITS,          // Last frame is outside the soft limits
+    STEPPING_ERROR_BUSY             // Motors still run, the first frame is where the slider stands
+} steppingError_t;
+
+// Which soft limit a move was refused for
+typedef enum
+{
+    ENVELOPE_OK = 0,
+    ENVELOPE_SLIDE,
+    ENVELOPE_PAN
+} envelopeError_t;
+
+// Homing runs trough these phases while the slider is in SLIDER_HOMING
+typedef enum
+{
+    HOMING_PHASE_NONE = 0,
+    HOMING_PHASE_SEEK,          // Toward the endstop at homing speed
+    HOMING_PHASE_BACK_OFF,      // Away from the endstop until it releases
+    HOMING_PHASE_APPROACH,      // Slowly back onto the endstop
+    HOMING_PHASE_RETRACT        // Off the endstop to home
+} homingPhase_t;
+
+typedef enum
+{
+    HOMING_ERROR_NONE = 0,
+    HOMING_ERROR_NOT_FOUND,     // Endstop not reached within the rail length
+    HOMING_ERROR_NOT_RELEASED,  // Endstop still pressed after backing off the rail length
+    HOMING_ERROR_WRONG_ENDSTOP, // Ran into the endstop at the other end, check the homing direction
+    HOMING_ERROR_CANCELLED
+} homingError_t;
+
 typedef enum
 {
     HOMING_DIRECTION = 0,
@@ -70,10 +248,23 @@ typedef enum
     ROTATION_STEPS_PER_DEG,
     HOMING_SPEED_SLIDE,
     HOMING_SPEED_PAN,
-    MIN_SLIDER_STEP
+    MIN_SLIDER_STEP,
+    SLIDE_JERK,
+    PAN_JERK,
+    FOCUS_PREWAKE,
+    SHUTTER_LATENCY,
+    PAN_LIMIT_MIN,
+    PAN_LIMIT_MAX
 } CameraSliderConfig_t;
 
 
+// Axis index of each motor within the step engine
+typedef enum
+{
+    SLIDER_AXIS_SLIDE = 0,
+    SLIDER_AXIS_PAN
+} CameraSliderAxis_t;
+
 typedef enum
 {
     MOVE_RELATIVE = 0,
@@ -85,12 +276,29 @@ typedef enum
 typedef enum 
 { 
     CAMERA_IDLE = 0,
-    CAMERA_SHUTTER_FOCUS,    
-    CAMERA_SHUTTER_FOCUSING,
-	CAMERA_SHUTTER_RELEASE,
-	CAMERA_SHUTTER_RELEASING
+    CAMERA_FOCUS,               // Focus held, camera awake
+    CAMERA_FOCUSING,            // Focus held for the pre-wake, shutter follows
+    CAMERA_SHUTTER_PRESSED,
+    CAMERA_BULB                 // Shutter held for a bulb exposure
 } CameraState_t;
 
+// Events for the camera task (see CameraControl_Post()), handled one after the other
+typedef enum
+{
+    CAMERA_EVENT_FOCUS = 0,         // Hold focus for duration (0 -> until the shutter is released)
+    CAMERA_EVENT_FOCUS_RELEASE,
+    CAMERA_EVENT_SHUTTER_PRESS,     // Press for duration (0 -> until CAMERA_EVENT_SHUTTER_RELEASE)
+    CAMERA_EVENT_SHUTTER_RELEASE,
+    CAMERA_EVENT_BULB_START,        // Open for duration (0 -> until CAMERA_EVENT_BULB_STOP)
+    CAMERA_EVENT_BULB_STOP
+} CameraEventType_t;
+
+typedef struct
+{
+    CameraEventType_t type;
+    uint32_t duration_InMS;
+} CameraEvent_t;
+
 
 
 
@@ -101,7 +309,7 @@ typedef enum
 // Note: You should not edit config below. Instead modify defaults inside `config_cameraslider.h`
 struct SliderConfigStruct
 {
-    static const unsigned int Version = 1;
+    static const unsigned int Version = 5;
 
     uint16_t rail_length = RAIL_LENGTH_MM;
     uint16_t min_slider_step = MIN_STEP_SLIDER;
@@ -121,6 +329,15 @@ struct SliderConfigStruct
     float default_slider_accel = DEFAULT_SLIDE_TO_POS_ACCEL;
     float default_rotate_speed = DEFAULT_ROTATE_TO_POS_SPEED;
     float default_rotate_accel = DEFAULT_ROTATE_TO_POS_ACCEL;
+
+    uint16_t slide_jerk = DEFAULT_SLIDE_JERK;   // mm/s^3, 0 -> trapezoidal profile
+    uint16_t pan_jerk   = DEFAULT_PAN_JERK;     // deg/s^3, 0 -> trapezoidal profile
+
+    uint16_t focus_prewake_ms = DEFAULT_FOCUS_PREWAKE_MS;  // Focus this long ahead of the shutter, 0 -> off
+    uint16_t shutter_latency_ms = DEFAULT_SHUTTER_LATENCY_MS; // Of the camera, position triggers fire this much early
+
+    int16_t pan_limit_min_deg = DEFAULT_PAN_LIMIT_MIN_DEG;  // Soft limits of pan, both 0 -> no limits
+    int16_t pan_limit_max_deg = DEFAULT_PAN_LIMIT_MAX_DEG;
 };
 
 extern PersistSettings<SliderConfigStruct> SliderConfig;
@@ -0,0 +1,84 @@
+/*
+CameraSlider - Telemetry frame
+Description: Binary telemetry frame, sent by the slider over the WebSocket at /telemetry and read by
+the host decoder (host/telemetry). Kept free of Arduino so both sides build it.
+
+Frame, multi byte fields little endian:
+    0   uint8       TELEMETRY_MAGIC
+    1   uint8       Flags, TELEMETRY_FLAG_xxx
+    2   uint16      Sequence number, one up every frame
+    4   uint32      Time in us (micros() of the slider)
+    8   uint8       Slider state (sliderState_t)
+    9   varint      Slide position in steps
+        varint      Pan position in steps
+        varint      Slide velocity in steps/s
+        varint      Pan velocity in steps/s
+
+Varints are zigzag encoded (small negative numbers stay short), 7 bits per byte, lowest first.
+Positions are the change since the previous frame, in a key frame (TELEMETRY_FLAG_KEY) they are
+absolute. Frames follow each other back to back in a message, every message starts with a key frame.
+*/
+
+#ifndef __CAMERASLIDER_TELEMETRY__
+#define __CAMERASLIDER_TELEMETRY__
+
+#include <stdint.h>
+
+#define TELEMETRY_MAGIC             0xCA
+#define TELEMETRY_HEADER_SIZE       9
+#define TELEMETRY_MAX_FRAME_SIZE    (TELEMETRY_HEADER_SIZE + 4 * 5)
+
+#define TELEMETRY_FLAG_KEY          0x01      // Positions are absolute
+#define TELEMETRY_FLAG_MOTORS       0x02      // Motors powered
+#define TELEMETRY_FLAG_HOMED        0x04      // Slide homed
+#define TELEMETRY_FLAG_PAN_HOMED    0x08      // Pan homed
+#define TELEMETRY_FLAG_EXPOSING     0x10      // Shutter open
+
+typedef struct
+{
+    uint8_t flags;
+    uint16_t sequence;
+    uint32_t time_InUS;
+    uint8_t state;
+    int32_t slide_InSteps;
+    int32_t pan_InSteps;
+    int32_t slideVelocity_InStepsPerSecond;
+    int32_t panVelocity_InStepsPerSecond;
+} TelemetryFrame_t;
+
+// Writes value at pBuff, returns the bytes used
+static inline int Telemetry_PutVarint(uint8_t *pBuff, int32_t value)
+{
+    uint32_t zigzag = ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+    int len = 0;
+
+    while(zigzag >= 0x80)
+    {
+        pBuff[len++] = (uint8_t)(zigzag | 0x80);
+        zigzag >>= 7;
+    }
+    pBuff[len++] = (uint8_t)zigzag;
+
+    return len;
+}
+
+// Reads a value from at most size bytes, returns the bytes used or 0 if it runs past the end
+static inline int Telemetry_GetVarint(const uint8_t *pBuff, int size, int32_t *pValue)
+{
+    uint32_t zigzag = 0;
+    int len = 0;
+
+    do
+    {
+        if((len >= size) || (len > 4))
+        {
+            return 0;
+        }
+        zigzag |= (uint32_t)(pBuff[len] & 0x7F) << (7 * len);
+    } while(pBuff[len++] & 0x80);
+
+    *pValue = (int32_t)(zigzag >> 1) ^ -(int32_t)(zigzag & 1);
+    return len;
+}
+
+#endif